@@ -1,8 +1,13 @@
 #include "Application.h"
 
+#include <chrono>
+#include <ctime>
+
 Application::Application()
 {
 	terrain = nullptr;
+	streamer = nullptr;
+	voxels = nullptr;
 	shader = nullptr;
 	nameChain = nullptr;
 	light = nullptr;
@@ -31,9 +36,23 @@ void Application::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int scre
 
 	terrain->BuildHeightMap();
 
+	//A new session starts from a different seed each launch, which can be typed back in to reproduce it
+	seed = (int)std::time(0);
+	terrain->setNoiseSeed(seed);
+	nameRandom = Random(Random::deriveKey(seed, RandomStream::MarkovChain));
+
+	streamer.reset(new TerrainStreamer(seed));
+	voxels.reset(new VoxelTerrain(seed));
+
 	nameChain.reset(new MarkovChain("name-corpus.txt", 3));
 
-	markovName = nameChain->generateSentence("The");
+	markovName = nameChain->generateSentence("The", nameRandom);
+}
+
+//Each random operation gets its own stream, so replaying the same steps from the same seed gives the same result
+uint64_t Application::nextOperationSeed()
+{
+	return Random::deriveKey(seed, operationCount++);
 }
 
 
@@ -81,9 +100,49 @@ bool Application::render()
 
 	// Send geometry data, set shader parameters, render object with shader
 	ID3D11ShaderResourceView* textures[] = { textureMgr->getTexture(L"sand"), textureMgr->getTexture(L"snow") };
-	terrain->sendData(renderer->getDeviceContext());
 	shader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textures, light);
-	shader->render(renderer->getDeviceContext(), terrain->getIndexCount());
+
+	if (voxelWorld)
+	{
+		//A few chunks are meshed each frame until everything in range has been built
+		voxels->Update(renderer->getDevice(), camera->getPosition());
+		voxels->Cull(worldMatrix, viewMatrix, projectionMatrix);
+
+		for (int c = 0; c < voxels->getVisibleChunkCount(); c++)
+		{
+			voxels->sendChunkData(renderer->getDeviceContext(), c);
+			shader->render(renderer->getDeviceContext(), voxels->getChunkIndexCount(c));
+		}
+	}
+
+	else if (streaming)
+	{
+		//Tiles arrive from the workers over the next few frames, whatever is ready is drawn
+		streamer->Update(renderer->getDevice(), camera->getPosition());
+		streamer->Cull(worldMatrix, viewMatrix, projectionMatrix);
+
+		for (int t = 0; t < streamer->getVisibleTileCount(); t++)
+		{
+			streamer->sendTileData(renderer->getDeviceContext(), t);
+			shader->render(renderer->getDeviceContext(), streamer->getIndexCount());
+		}
+	}
+
+	else
+	{
+		//Only the chunks inside the view frustum are drawn
+		auto cullStart = std::chrono::high_resolution_clock::now();
+		terrain->Cull(worldMatrix, viewMatrix, projectionMatrix);
+		cullMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+
+		terrain->SelectLevels(renderer->getDevice(), camera->getPosition(), projectionMatrix, (float)sHeight);
+
+		for (int c = 0; c < terrain->getDrawnChunkCount(); c++)
+		{
+			terrain->sendChunkData(renderer->getDeviceContext(), c);
+			shader->render(renderer->getDeviceContext(), terrain->getChunkIndexCount(c));
+		}
+	}
 
 	// Render GUI
 	gui();
@@ -117,7 +176,35 @@ void Application::gui()
 	ImGui::Text("General");
 	ImGui::Spacing();
 	ImGui::Text("FPS: %.2f", timer->getFPS());
+	ImGui::Text("Chunks: %d / %d visible in %d draws, culled in %.3f ms", terrain->getVisibleChunkCount(), terrain->getChunkCount(), terrain->getDrawnChunkCount(), cullMilliseconds);
+
+	int triangles = 0;
+	for (int c = 0; c < terrain->getDrawnChunkCount(); c++)
+	{
+		triangles += terrain->getChunkIndexCount(c) / 3;
+	}
+
+	ImGui::Text("Triangles: %d", triangles);
+
+	bool lodEnabled = terrain->getLodEnabled();
+	float lodPixelError = terrain->getLodPixelError();
+
+	ImGui::Checkbox("Level of Detail", &lodEnabled);
+	ImGui::DragFloat("LOD Pixel Error", &lodPixelError, 0.1f, 0.1f, 20.0f, "%.1f");
+
+	terrain->setLodEnabled(lodEnabled);
+	terrain->setLodPixelError(lodPixelError);
 	ImGui::Checkbox("Toggle Wireframe", &wireframeToggle);
+
+	if (ImGui::InputInt("Seed", &seed))
+	{
+		terrain->setNoiseSeed(seed);
+		streamer->setNoiseSeed(seed);
+		voxels->setNoiseSeed(seed);
+		nameRandom = Random(Random::deriveKey(seed, RandomStream::MarkovChain));
+		operationCount = 0;
+	}
+
 	ImGui::DragFloat("Camera Speed", &cameraSpeed, 0.1f, 0.1f, 15.0f);
 	ImGui::Spacing();
 	if (ImGui::Button("Generate Sample Terrain"))
@@ -160,7 +247,7 @@ void Application::gui()
 
 	if (ImGui::Button("Generate Name"))
 	{
-		markovName = nameChain->generateSentence("The");
+		markovName = nameChain->generateSentence("The", nameRandom);
 	}
 
 	ImGui::Separator();
@@ -172,7 +259,10 @@ void Application::gui()
 	static float amplitude = terrain->getAmplitude();
 	static float frequency = terrain->getFrequency();
 
+	static int threadCount = terrain->getThreadCount();
+
 	ImGui::SliderInt("Resolution", &terrainResolution, 2, 1024);
+	ImGui::SliderInt("Threads", &threadCount, 1, 64);
 	ImGui::DragFloat("Amplitude", &amplitude, 0.1f, 0.1f, 25.0f, "%.1f");
 	ImGui::DragFloat("Frequency", &frequency, 0.001f, 0.001f, 0.999f, "%.3f");
 
@@ -180,6 +270,19 @@ void Application::gui()
 	shader->setAmplitude(amplitude);
 	terrain->setFrequency(frequency);
 
+	if (threadCount != terrain->getThreadCount())
+	{
+		terrain->setThreadCount(threadCount);
+	}
+
+	bool centralDifference = terrain->getNormalMode() == NormalMode::CentralDifference;
+
+	if (ImGui::Checkbox("Central Difference Normals", &centralDifference))
+	{
+		terrain->setNormalMode(centralDifference ? NormalMode::CentralDifference : NormalMode::Smoothed);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
 	if (ImGui::Button("Flatten"))
 	{
 		terrain->flatten();
@@ -190,7 +293,7 @@ void Application::gui()
 
 	if (ImGui::Button("Randomise"))
 	{
-		terrain->random();
+		terrain->random(nextOperationSeed());
 		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
 	}
 
@@ -214,7 +317,7 @@ void Application::gui()
 	static int faultItrs = 5;
 	if (ImGui::Button("Fault "))
 	{
-		terrain->fault(faultItrs);
+		terrain->fault(faultItrs, nextOperationSeed());
 		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
 	}
 	ImGui::SameLine();
@@ -236,6 +339,35 @@ void Application::gui()
 	ImGui::Separator();
 	ImGui::Spacing();
 
+	ImGui::Text("Brush");
+	ImGui::Spacing();
+
+	static float brushCentre[2] = { 50.0f, 50.0f };
+	static float brushRadius = 5.0f;
+	static float brushStrength = 1.0f;
+
+	ImGui::DragFloat2("Centre", brushCentre, 0.5f, 0.0f, terrain->getTerrainSize(), "%.1f");
+	ImGui::DragFloat("Radius", &brushRadius, 0.1f, 0.1f, 50.0f, "%.1f");
+	ImGui::DragFloat("Strength", &brushStrength, 0.1f, 0.1f, 25.0f, "%.1f");
+
+	//Only the vertices under the brush are rebuilt and sent to the GPU
+	if (ImGui::Button("Raise"))
+	{
+		terrain->brush(brushCentre[0], brushCentre[1], brushRadius, brushStrength);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	ImGui::SameLine();
+
+	if (ImGui::Button("Lower"))
+	{
+		terrain->brush(brushCentre[0], brushCentre[1], brushRadius, -brushStrength);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	ImGui::Separator();
+	ImGui::Spacing();
+
 	ImGui::Text("Noise");
 	ImGui::Spacing();
 
@@ -248,6 +380,13 @@ void Application::gui()
 	static float freqInfl = 1.2f;
 	ImGui::DragFloat("Freq. Infl.", &freqInfl, 0.1f, 0.01f, 10.0f);
 
+	//Only the FBM operators use the choice, the Perlin buttons always show Perlin noise
+	static int noiseType = (int)terrain->getNoiseType();
+	if (ImGui::Combo("Noise Type", &noiseType, "Improved Perlin\0Simplex\0OpenSimplex2\0"))
+	{
+		terrain->setNoiseType((NoiseType)noiseType);
+	}
+
 	ImGui::Spacing();
 
 	if (ImGui::Button("Original Perlin"))
@@ -262,6 +401,20 @@ void Application::gui()
 		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
 	}
 
+	//Cellular noise for plateaus, cracks and regions, added with the same amplitude and frequency as the Perlin buttons
+	static int worleyFeature = 0;
+	static int worleyDistance = 0;
+	static float worleyJitter = 1.0f;
+	ImGui::Combo("Worley Feature", &worleyFeature, "F1\0F2\0F2 - F1\0");
+	ImGui::Combo("Worley Distance", &worleyDistance, "Euclidean\0Manhattan\0Chebyshev\0");
+	ImGui::SliderFloat("Worley Jitter", &worleyJitter, 0.0f, 1.0f);
+
+	if (ImGui::Button("Worley"))
+	{
+		terrain->worley((WorleyFeature)worleyFeature, (WorleyDistance)worleyDistance, worleyJitter);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
 	if (ImGui::Button("FBM"))
 	{
 		terrain->generateFBM(octs, amplInfl, freqInfl);
@@ -274,6 +427,98 @@ void Application::gui()
 		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
 	}
 
+	//Repeats across the map's edges, for terrain that is tiled
+	if (ImGui::Button("Tileable FBM"))
+	{
+		terrain->generateTileableFBM(octs, amplInfl, freqInfl);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	//The warp is only rebuilt when its octaves or frequency change, so the other settings can be tweaked quickly
+	static int warpOctaves = 4;
+	static float warpFrequency = 0.01f;
+	static float warpStrength = 40.0f;
+	ImGui::DragInt("Warp Octaves", &warpOctaves, 1, 1, 10);
+	ImGui::DragFloat("Warp Frequency", &warpFrequency, 0.001f, 0.001f, 0.1f, "%.3f");
+	ImGui::DragFloat("Warp Strength", &warpStrength, 1.0f, 0.0f, 200.0f);
+
+	if (ImGui::Button("Warped FBM"))
+	{
+		terrain->generateWarpedFBM(octs, amplInfl, freqInfl, warpOctaves, warpFrequency, warpStrength);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	//Adds FBM with its normals taken from the noise's own slope, as long as the map's slope is known, e.g. straight after Flatten
+	static float slopeErosion = 0.0f;
+	ImGui::DragFloat("Slope Erosion", &slopeErosion, 0.05f, 0.0f, 10.0f);
+
+	if (ImGui::Button("Analytic FBM"))
+	{
+		terrain->generateDerivativeFBM(octs, amplInfl, freqInfl, slopeErosion);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	ImGui::Separator();
+	ImGui::Spacing();
+
+	ImGui::Text("Streaming World");
+	ImGui::Spacing();
+
+	static float viewDistance = streamer->getViewDistance();
+	static int memoryBudget = (int)(streamer->getMemoryBudget() / (1024 * 1024));
+
+	//The endless world is built with the FBM settings above, changing them rebuilds every tile
+	ImGui::Checkbox("Stream Infinite World", &streaming);
+	ImGui::DragFloat("View Distance", &viewDistance, 1.0f, 25.0f, 200.0f, "%.0f");
+	ImGui::SliderInt("Tile Budget (MB)", &memoryBudget, 1, 512);
+
+	streamer->setViewDistance(viewDistance);
+	streamer->setMemoryBudget((size_t)memoryBudget * 1024 * 1024);
+
+	if (streaming)
+	{
+		streamer->setFractal(octs, amplitude, frequency, amplInfl, freqInfl);
+	}
+
+	uint64_t lookups = streamer->getCacheHits() + streamer->getCacheMisses();
+
+	ImGui::Text("Tiles: %d cached, %d visible, %d generating", streamer->getCachedTileCount(), streamer->getVisibleTileCount(), streamer->getPendingTileCount());
+	ImGui::Text("Memory: %.1f / %d MB", (float)streamer->getMemoryUsed() / (1024.0f * 1024.0f), memoryBudget);
+	ImGui::Text("In range: %d of %d tiles ready", streamer->getResidentTileCount(), streamer->getWantedTileCount());
+	ImGui::Text("Hit rate: %.1f%% of %llu requests, latency %.1f ms (max %.1f)", lookups ? 100.0 * (double)streamer->getCacheHits() / (double)lookups : 0.0, (unsigned long long)lookups, streamer->getAverageLatency(), streamer->getMaxLatency());
+
+	ImGui::Separator();
+	ImGui::Spacing();
+
+	ImGui::Text("Voxel World");
+	ImGui::Spacing();
+
+	static float voxelDistance = voxels->getViewDistance();
+	static int voxelBudget = (int)(voxels->getMemoryBudget() / (1024 * 1024));
+	static float overhangs = 12.0f;
+	static float caveFrequency = 0.04f;
+	static float tunnelWidth = 0.08f;
+
+	//The ground uses the FBM settings above, like the streamed world, and changing anything here rebuilds every chunk
+	ImGui::Checkbox("Caves and Overhangs", &voxelWorld);
+	ImGui::DragFloat("Voxel View Distance", &voxelDistance, 1.0f, 25.0f, 200.0f, "%.0f");
+	ImGui::SliderInt("Chunk Budget (MB)", &voxelBudget, 1, 512);
+	ImGui::DragFloat("Overhangs", &overhangs, 0.1f, 0.0f, 40.0f, "%.1f");
+	ImGui::DragFloat("Cave Frequency", &caveFrequency, 0.001f, 0.005f, 0.2f, "%.3f");
+	ImGui::DragFloat("Tunnel Width", &tunnelWidth, 0.005f, 0.0f, 0.5f, "%.3f");
+
+	voxels->setViewDistance(voxelDistance);
+	voxels->setMemoryBudget((size_t)voxelBudget * 1024 * 1024);
+
+	if (voxelWorld)
+	{
+		voxels->setFractal(octs, amplitude, frequency, amplInfl, freqInfl);
+		voxels->setCaves(overhangs, caveFrequency, tunnelWidth);
+	}
+
+	ImGui::Text("Chunks: %d cached, %d visible, %d building, %.1f ms each", voxels->getCachedChunkCount(), voxels->getVisibleChunkCount(), voxels->getPendingChunkCount(), voxels->getAverageBuildTime());
+	ImGui::Text("Memory: %.1f / %d MB", (float)voxels->getMemoryUsed() / (1024.0f * 1024.0f), voxelBudget);
+
 	ImGui::Separator();
 	ImGui::Spacing();
 
@@ -281,6 +526,7 @@ void Application::gui()
 	ImGui::Spacing();
 
 	static bool weightedParticles = true;
+	static bool tiledErosion = true;
 	static float dt = 0.25f;
 	static int particleDensity = 5000;
 	static float particleVelocity[3] = { 1.0f, 0.0f, 1.0f };
@@ -292,6 +538,7 @@ void Application::gui()
 	static float settling = 0.5f;
 
 	ImGui::Checkbox("Weighted Particles", &weightedParticles);
+	ImGui::Checkbox("Tiled (all threads)", &tiledErosion);
 	ImGui::DragFloat("Delta", &dt, 0.01f, 0.01f, 1.0f, "%.2f");
 	ImGui::DragInt("P. Density", &particleDensity, 10, 1, 100000);
 	ImGui::DragFloat3("Particle Vel.", particleVelocity, 0.01f, -1.0f, 1.0f, "%.2f");
@@ -306,11 +553,111 @@ void Application::gui()
 
 	if (ImGui::Button("Apply Wind Erosion"))
 	{
-		terrain->windErosion(dt, particleDensity, particleVelocity,
-			windVelocity, sediment, suspension, abrasion, roughness, settling, weightedParticles);
+		if (tiledErosion)
+		{
+			terrain->windErosionParallel(dt, particleDensity, particleVelocity,
+				windVelocity, sediment, suspension, abrasion, roughness, settling, weightedParticles, nextOperationSeed());
+		}
+
+		else
+		{
+			terrain->windErosion(dt, particleDensity, particleVelocity,
+				windVelocity, sediment, suspension, abrasion, roughness, settling, weightedParticles, nextOperationSeed());
+		}
+
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	ImGui::Separator();
+	ImGui::Spacing();
+
+	ImGui::Text("Hydraulic Erosion");
+	ImGui::Spacing();
+
+	static HydraulicSettings hydraulic;
+	static int hydraulicIterations = 1000;
+
+	ImGui::DragInt("Steps", &hydraulicIterations, 10, 1, 20000);
+	ImGui::DragFloat("Time Step", &hydraulic.timeStep, 0.001f, 0.001f, 0.1f, "%.3f");
+	ImGui::DragFloat("Rain", &hydraulic.rain, 0.001f, 0.0f, 0.1f, "%.3f");
+	ImGui::DragFloat("Capacity", &hydraulic.capacity, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Dissolving", &hydraulic.dissolving, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Deposition", &hydraulic.deposition, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Evaporation", &hydraulic.evaporation, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Min. Tilt", &hydraulic.minimumTilt, 0.01f, 0.0f, 1.0f, "%.2f");
+
+	ImGui::Spacing();
+
+	if (ImGui::Button("Apply Hydraulic Erosion"))
+	{
+		terrain->hydraulicErosion(hydraulicIterations, hydraulic);
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	ImGui::Separator();
+	ImGui::Spacing();
+
+	ImGui::Text("Droplet Erosion");
+	ImGui::Spacing();
+
+	static DropletSettings droplet;
+	static int dropletCount = 50000;
+	static bool tiledDroplets = true;
+
+	ImGui::Checkbox("Tiled Droplets (all threads)", &tiledDroplets);
+	ImGui::DragInt("Droplets", &dropletCount, 100, 1, 1000000);
+	ImGui::DragInt("Radius", &droplet.radius, 1, 1, DropletErosion::maxRadius);
+	ImGui::DragInt("Lifetime", &droplet.lifetime, 1, 1, 200);
+	ImGui::DragFloat("Inertia", &droplet.inertia, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Drop Capacity", &droplet.capacity, 0.1f, 0.0f, 20.0f, "%.1f");
+	ImGui::DragFloat("Erosion", &droplet.erosion, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Drop Deposition", &droplet.deposition, 0.01f, 0.0f, 1.0f, "%.2f");
+	ImGui::DragFloat("Drop Evaporation", &droplet.evaporation, 0.01f, 0.0f, 1.0f, "%.2f");
+
+	ImGui::Spacing();
+
+	if (ImGui::Button("Apply Droplet Erosion"))
+	{
+		if (tiledDroplets)
+		{
+			terrain->dropletErosionParallel(dropletCount, droplet, nextOperationSeed());
+		}
+
+		else
+		{
+			terrain->dropletErosion(dropletCount, droplet, nextOperationSeed());
+		}
+
+		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
+	}
+
+	ImGui::Separator();
+	ImGui::Spacing();
+
+	ImGui::Text("Thermal Erosion");
+	ImGui::Spacing();
+
+	static float talusAngle = 35.0f;
+	static float thermalRate = 0.5f;
+	static int thermalIterations = 500;
+	static float thermalThreshold = 0.001f;
+	static int thermalIterationsRun = 0;
+
+	ImGui::DragFloat("Talus Angle", &talusAngle, 0.5f, 0.0f, 89.0f, "%.1f");
+	ImGui::DragFloat("Shed Rate", &thermalRate, 0.01f, 0.01f, 1.0f, "%.2f");
+	ImGui::DragInt("Max Iterations", &thermalIterations, 10, 1, 10000);
+	ImGui::DragFloat("Rest Threshold", &thermalThreshold, 0.0001f, 0.0f, 0.1f, "%.4f");
+
+	ImGui::Spacing();
+
+	if (ImGui::Button("Apply Thermal Erosion"))
+	{
+		thermalIterationsRun = terrain->thermalErosion(talusAngle, thermalRate, thermalIterations, thermalThreshold);
 		terrain->Regenerate(renderer->getDevice(), renderer->getDeviceContext());
 	}
 
+	ImGui::Text("Iterations run: %d", thermalIterationsRun);
+
 	ImGui::Separator();
 
 	// Render UI
@@ -6,6 +6,8 @@
 #include "DXF.h"	// include dxframework
 #include "LightShader.h"
 #include "TerrainMesh.h"
+#include "TerrainStreamer.h"
+#include "VoxelTerrain.h"
 #include "MarkovChain.h"
 
 class Application : public BaseApplication
@@ -21,15 +23,28 @@ protected:
 	bool render();
 	void gui();
 
+	uint64_t nextOperationSeed();
+
 private:
 	std::unique_ptr<LightShader> shader;
 	std::unique_ptr<TerrainMesh> terrain;
+	std::unique_ptr<TerrainStreamer> streamer;
+	std::unique_ptr<VoxelTerrain> voxels;
 	std::unique_ptr<Light> light;
 
 	std::unique_ptr<MarkovChain> nameChain;
 
 	std::string markovName;
 
+	int seed = 0;	//Every random choice in the session follows from this, so the same seed reproduces the same terrain
+	uint64_t operationCount = 0;	//How many random operations have been applied since the seed was set
+	Random nameRandom;
+
+	float cullMilliseconds = 0.0f;	//CPU time spent on frustum culling the terrain chunks last frame
+
+	bool streaming = false;	//Draw the endless streamed world around the camera instead of the editable terrain
+	bool voxelWorld = false;	//Draw the voxel world with its caves and overhangs instead, takes precedence over streaming
+
 	bool startup = true; //To check if the application has just launched and the sample terrain should be generated
 };
 
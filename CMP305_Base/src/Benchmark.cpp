@@ -0,0 +1,2714 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "MathsUtils.h"
+#include "PerlinNoise.h"
+#include "SimplexNoise.h"
+#include "TerrainMesh.h"
+#include "TerrainNormals.h"
+#include "TerrainStreamer.h"
+#include "ThreadPool.h"
+#include "VoxelTerrain.h"
+#include "WorleyNoise.h"
+
+//Times a number of runs of an operation, calling setup before each one without including it in the timing
+template<typename Setup, typename Function>
+static double timeRuns(int runs, Setup setup, Function function)
+{
+	double total = 0.0;
+
+	for (int r = 0; r < runs; r++)
+	{
+		setup();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		total += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	return total / (double)runs;
+}
+
+//Larger maps take long enough that fewer runs still give a stable average
+static int runsFor(int resolution)
+{
+	int runs = (2048 * 2048) / (resolution * resolution);
+
+	return MathsUtils::clamp(runs, 1, 10);
+}
+
+static std::string comparisonNote(double before, double after, bool identical)
+{
+	char note[64];
+	snprintf(note, sizeof(note), "%.2fx speedup, %s", before / after, identical ? "bit-identical" : "OUTPUT MISMATCH");
+
+	return std::string(note);
+}
+
+//The average angle in degrees between matching unit normals in two packed arrays
+static float meanAngleBetween(const std::vector<float>& first, const std::vector<float>& second)
+{
+	double total = 0.0;
+
+	for (size_t n = 0; n + 2 < first.size(); n += 3)
+	{
+		float dot = first[n] * second[n] + first[n + 1] * second[n + 1] + first[n + 2] * second[n + 2];
+		total += acosf((std::max)(-1.0f, (std::min)(1.0f, dot)));
+	}
+
+	return (float)(total / (double)(first.size() / 3)) * (180.0f / 3.14159265f);
+}
+
+//The largest angle in degrees between matching unit normals in two packed arrays
+static float maxAngleBetween(const std::vector<float>& first, const std::vector<float>& second)
+{
+	float minDot = 1.0f;
+
+	for (size_t n = 0; n + 2 < first.size(); n += 3)
+	{
+		float dot = first[n] * second[n] + first[n + 1] * second[n + 1] + first[n + 2] * second[n + 2];
+		minDot = (std::min)(minDot, dot);
+	}
+
+	return acosf((std::max)(-1.0f, (std::min)(1.0f, minDot))) * (180.0f / 3.14159265f);
+}
+
+//The cost of one sample and how many a second that works out to, for an operation that produced samples of them in milliseconds
+static std::vector<BenchmarkMetric> throughputMetrics(double milliseconds, double samples)
+{
+	return
+	{
+		{ "ns_per_sample", { (milliseconds * 1000000.0) / samples } },
+		{ "samples_per_second", { samples / (milliseconds / 1000.0) } }
+	};
+}
+
+//In-place radix-2 FFT of a power of two number of values, held as their real and imaginary parts
+//Improved Perlin FBM with the octave count fixed when compiled, so the octave loops unroll and each height is added to in one pass over the row
+//Sums in the same order as TerrainMesh::generateFBM, to check whether compiling a loop per octave count would be worth it
+template<int Octaves>
+static void fixedOctaveFBM(const PerlinNoise& noise, ThreadPool& pool, float* heights, int resolution, const float* a, const float* f)
+{
+	pool.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(Octaves * resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heights[j * resolution];
+
+			for (int o = 0; o < Octaves; o++)
+			{
+				noise.generateImprovedPerlinSpan(0.0f, f[o], (float)j * f[o], resolution, &samples[o * resolution]);
+			}
+
+			for (int i = 0; i < resolution; i++)
+			{
+				float height = row[i];
+
+				for (int o = 0; o < Octaves; o++)
+				{
+					height += samples[o * resolution + i] * a[o];
+				}
+
+				row[i] = height;
+			}
+		}
+	});
+}
+
+static void fourierTransform(std::vector<double>& real, std::vector<double>& imaginary)
+{
+	const size_t count = real.size();
+
+	for (size_t i = 1, j = 0; i < count; i++)
+	{
+		size_t bit = count >> 1;
+
+		for (; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+
+		j ^= bit;
+
+		if (i < j)
+		{
+			std::swap(real[i], real[j]);
+			std::swap(imaginary[i], imaginary[j]);
+		}
+	}
+
+	for (size_t length = 2; length <= count; length <<= 1)
+	{
+		const double angle = -2.0 * 3.14159265358979323846 / (double)length;
+
+		for (size_t k = 0; k < length / 2; k++)
+		{
+			const double twiddleReal = cos(angle * (double)k);
+			const double twiddleImaginary = sin(angle * (double)k);
+
+			for (size_t start = 0; start < count; start += length)
+			{
+				const size_t even = start + k;
+				const size_t odd = even + length / 2;
+
+				double oddReal = real[odd] * twiddleReal - imaginary[odd] * twiddleImaginary;
+				double oddImaginary = real[odd] * twiddleImaginary + imaginary[odd] * twiddleReal;
+
+				real[odd] = real[even] - oddReal;
+				imaginary[odd] = imaginary[even] - oddImaginary;
+				real[even] += oddReal;
+				imaginary[even] += oddImaginary;
+			}
+		}
+	}
+}
+
+//The slope of log power against log frequency, from the rows' power spectra averaged together
+//Only frequencies from twice the lattice's, firstBin cycles a row, up to half of Nyquist are fitted: below that is the flat part every noise has,
+//above it the fall off shows how smooth the noise is, a smoother fade curve giving a steeper slope
+static double spectralSlope(const float* field, int width, int height, int firstBin)
+{
+	std::vector<double> power(width / 2 + 1, 0.0);
+	std::vector<double> real(width), imaginary(width);
+
+	for (int j = 0; j < height; j++)
+	{
+		double mean = 0.0;
+
+		for (int i = 0; i < width; i++)
+		{
+			mean += field[j * width + i];
+		}
+
+		mean /= (double)width;
+
+		//A Hann window keeps the jump between the row's two ends from leaking into every frequency
+		for (int i = 0; i < width; i++)
+		{
+			double window = 0.5 - 0.5 * cos(2.0 * 3.14159265358979323846 * (double)i / (double)(width - 1));
+			real[i] = (field[j * width + i] - mean) * window;
+			imaginary[i] = 0.0;
+		}
+
+		fourierTransform(real, imaginary);
+
+		for (int k = 0; k <= width / 2; k++)
+		{
+			power[k] += real[k] * real[k] + imaginary[k] * imaginary[k];
+		}
+	}
+
+	const int lastBin = width / 4;
+	firstBin = MathsUtils::clamp(firstBin, 1, lastBin - 1);
+
+	double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+	int fitted = 0;
+
+	for (int k = firstBin; k <= lastBin; k++)
+	{
+		if (power[k] <= 0.0)
+		{
+			continue;
+		}
+
+		double x = log((double)k);
+		double y = log(power[k]);
+
+		sumX += x;
+		sumY += y;
+		sumXX += x * x;
+		sumXY += x * y;
+		fitted++;
+	}
+
+	double denominator = (double)fitted * sumXX - sumX * sumX;
+
+	return fitted > 1 && denominator != 0.0 ? ((double)fitted * sumXY - sumX * sumY) / denominator : 0.0;
+}
+
+//Mean, variance, range, a 32 bin histogram across the range and the spectral slope of a field of samples
+//Returns a short summary for the text report, the JSON report gets the lot
+static std::string qualityMetrics(const float* field, int width, int height, int latticeBin, std::vector<BenchmarkMetric>& metrics)
+{
+	const int count = width * height;
+	const int bins = 32;
+
+	double mean = 0.0;
+	float lowest = field[0];
+	float highest = field[0];
+
+	for (int n = 0; n < count; n++)
+	{
+		mean += field[n];
+		lowest = (std::min)(lowest, field[n]);
+		highest = (std::max)(highest, field[n]);
+	}
+
+	mean /= (double)count;
+
+	double variance = 0.0;
+	std::vector<double> histogram(bins, 0.0);
+	const double binScale = highest > lowest ? (double)bins / ((double)highest - (double)lowest) : 0.0;
+
+	for (int n = 0; n < count; n++)
+	{
+		double difference = field[n] - mean;
+		variance += difference * difference;
+
+		int bin = (int)(((double)field[n] - (double)lowest) * binScale);
+		histogram[MathsUtils::clamp(bin, 0, bins - 1)] += 1.0;
+	}
+
+	variance /= (double)count;
+
+	//As fractions of the samples, so maps of different sizes can be compared
+	for (double& bin : histogram)
+	{
+		bin /= (double)count;
+	}
+
+	double slope = spectralSlope(field, width, height, latticeBin * 2);
+
+	metrics.push_back({ "mean", { mean } });
+	metrics.push_back({ "variance", { variance } });
+	metrics.push_back({ "min", { (double)lowest } });
+	metrics.push_back({ "max", { (double)highest } });
+	metrics.push_back({ "histogram", histogram });
+	metrics.push_back({ "spectral_slope", { slope } });
+
+	char summary[160];
+	snprintf(summary, sizeof(summary), "mean %.4f, variance %.4f, range %.3f to %.3f, spectral slope %.2f", mean, variance, lowest, highest, slope);
+
+	return std::string(summary);
+}
+
+//Quoted, with the characters JSON does not allow inside a string escaped
+static std::string jsonString(const std::string& text)
+{
+	std::string escaped = "\"";
+
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+
+		else if ((unsigned char)c < 0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+			escaped += code;
+		}
+
+		else
+		{
+			escaped += c;
+		}
+	}
+
+	return escaped + "\"";
+}
+
+//JSON has no infinities or NaN, so those are written as null
+static std::string jsonNumber(double value)
+{
+	if (value != value || value > DBL_MAX || value < -DBL_MAX)
+	{
+		return "null";
+	}
+
+	char number[32];
+	snprintf(number, sizeof(number), "%.9g", value);
+
+	return std::string(number);
+}
+
+struct CameraView
+{
+	const char* name;
+	XMFLOAT3 eye;
+	XMFLOAT3 target;
+};
+
+//Fixed cameras over the terrain, which covers 0 to 100 on x and z
+static const CameraView views[] =
+{
+	{ "overview", XMFLOAT3(50.0f, 90.0f, -40.0f), XMFLOAT3(50.0f, 0.0f, 50.0f) },
+	{ "ground level", XMFLOAT3(5.0f, 15.0f, 5.0f), XMFLOAT3(60.0f, 5.0f, 40.0f) },
+	{ "close up", XMFLOAT3(50.0f, 30.0f, 50.0f), XMFLOAT3(55.0f, 0.0f, 55.0f) },
+	{ "facing away", XMFLOAT3(50.0f, 20.0f, -10.0f), XMFLOAT3(50.0f, 20.0f, -100.0f) }
+};
+
+static XMMATRIX viewMatrixFor(const CameraView& view)
+{
+	return XMMatrixLookAtLH(XMVectorSet(view.eye.x, view.eye.y, view.eye.z, 1.0f), XMVectorSet(view.target.x, view.target.y, view.target.z, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+//The same projection and viewport the renderer sets up by default
+static const float viewportWidth = 1200.0f;
+static const float viewportHeight = 675.0f;
+
+static XMMATRIX projectionMatrix()
+{
+	return XMMatrixPerspectiveFovLH(XM_PI / 4.0f, viewportWidth / viewportHeight, 0.1f, 200.0f);
+}
+
+Benchmark::Benchmark()
+{
+	//No window or swap chain is needed, just a device the terrain can create its buffers with
+	HRESULT result = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &deviceContext);
+
+	if (FAILED(result))
+	{
+		//Fall back to the software rasteriser on machines without a suitable GPU
+		D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &deviceContext);
+	}
+}
+
+Benchmark::~Benchmark()
+{
+	if (deviceContext)
+	{
+		deviceContext->Release();
+		deviceContext = nullptr;
+	}
+
+	if (device)
+	{
+		device->Release();
+		device = nullptr;
+	}
+}
+
+void Benchmark::run(const char* fileName, const char* jsonFileName)
+{
+	if (device)
+	{
+		TerrainMesh terrain(device, deviceContext);
+
+		const int resolutions[] = { 128, 256, 512, 1024, 2048, 4096 };
+
+		for (int resolution : resolutions)
+		{
+			benchmarkFBM(terrain, resolution);
+		}
+
+		benchmarkFixedOctaveFBM(terrain, 2048);
+		benchmarkWarpedFBM(terrain, 1024);
+		benchmarkNoiseSpan(2048);
+		benchmarkSimplexSpan(2048);
+		benchmarkNoiseSamples(1024);
+		benchmarkNoiseQuality(1024);
+		benchmarkFBMQuality(terrain);
+		benchmarkNoiseRange(2048);
+		benchmarkTileable(terrain, 1024);
+		benchmarkNoiseTypes(terrain, 1024);
+		benchmarkWorley(1024);
+		benchmarkThreads(terrain, 4096);
+		benchmarkWindErosion(terrain, 2048);
+		benchmarkWindBatches(terrain, 1024);
+		benchmarkHydraulicErosion(terrain, 2048);
+
+		const int dropletResolutions[] = { 512, 1024, 2048, 4096 };
+
+		for (int resolution : dropletResolutions)
+		{
+			benchmarkDropletErosion(terrain, resolution);
+		}
+
+		benchmarkThermalErosion(terrain, 2048);
+
+		benchmarkIncremental(terrain, 2048);
+
+		const int normalResolutions[] = { 1024, 2048, 4096 };
+
+		for (int resolution : normalResolutions)
+		{
+			benchmarkNormals(terrain, resolution);
+		}
+
+		benchmarkDerivativeFBM(terrain, 2048);
+
+		benchmarkChunks(terrain, 2048);
+		benchmarkChunks(terrain, 4096);
+
+		benchmarkLevelsOfDetail(terrain, 1024);
+		benchmarkLevelsOfDetail(terrain, 4096);
+
+		benchmarkStreaming(terrain);
+		benchmarkVoxels();
+	}
+
+	writeReport(fileName);
+
+	if (jsonFileName)
+	{
+		writeJsonReport(jsonFileName);
+	}
+}
+
+void Benchmark::benchmarkFBM(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int runs = runsFor(resolution);
+
+	std::vector<float> expected(cells);
+
+	//Using the same settings as the sample terrain
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	double multiPass = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateFBMMultiPass(8, 0.5f, 1.1f); });
+	memcpy(expected.data(), terrain.getHeightMap(), sizeof(float) * cells);
+
+	double fused = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateFBM(8, 0.5f, 1.1f); });
+	bool identical = memcmp(expected.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+
+	results.push_back({ "FBM (multi-pass)", resolution, multiPass, "" });
+	results.push_back({ "FBM (fused)", resolution, fused, comparisonNote(multiPass, fused, identical) });
+
+	terrain.setFrequency(0.033f);
+
+	multiPass = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateRidgedFBMMultiPass(8, 0.4f, 1.2f); });
+	memcpy(expected.data(), terrain.getHeightMap(), sizeof(float) * cells);
+
+	fused = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateRidgedFBM(8, 0.4f, 1.2f); });
+	identical = memcmp(expected.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+
+	results.push_back({ "Ridged FBM (multi-pass)", resolution, multiPass, "" });
+	results.push_back({ "Ridged FBM (fused)", resolution, fused, comparisonNote(multiPass, fused, identical) });
+}
+
+void Benchmark::benchmarkFixedOctaveFBM(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int runs = runsFor(resolution);
+	const int octaves = 8;
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	terrain.setNoiseType(NoiseType::ImprovedPerlin);
+
+	double runtime = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateFBM(octaves, 0.5f, 1.1f); });
+
+	//The same octaves generateFBM works out, from the terrain's unseeded improved Perlin noise
+	float a[octaves], f[octaves];
+	a[0] = 28.0f;
+	f[0] = 0.015f;
+
+	for (int o = 1; o < octaves; o++)
+	{
+		a[o] = a[o - 1] * 0.5f;
+		f[o] = f[o - 1] * 1.1f;
+	}
+
+	PerlinNoise noise;
+	ThreadPool pool;
+	std::vector<float> heights(cells);
+
+	double fixed = timeRuns(runs, [&]() { std::fill(heights.begin(), heights.end(), 0.0f); }, [&]() { fixedOctaveFBM<octaves>(noise, pool, heights.data(), resolution, a, f); });
+	bool identical = memcmp(heights.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+
+	//The noise spans take nearly all the time, so this has stayed within the run to run spread and generateFBM keeps its runtime loop
+	results.push_back({ "FBM (runtime octaves)", resolution, runtime, "" });
+	results.push_back({ "FBM (8 octaves fixed when compiled)", resolution, fixed, comparisonNote(runtime, fixed, identical) });
+}
+
+void Benchmark::benchmarkWarpedFBM(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int runs = runsFor(resolution);
+
+	//The point batches first, scattered points have to match the scalar noise exactly at every level
+	PerlinNoise noise;
+	Random random(Random::deriveKey(0, RandomStream::HeightMap));
+	std::vector<float> pointX(cells), pointY(cells), samples(cells), expected(cells);
+
+	for (int n = 0; n < cells; n++)
+	{
+		pointX[n] = (random.nextFloat() - 0.5f) * 2000.0f;
+		pointY[n] = (random.nextFloat() - 0.5f) * 2000.0f;
+	}
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* names[] = { "Improved Perlin points (scalar)", "Improved Perlin points (SSE2)", "Improved Perlin points (AVX2)" };
+
+	double scalar = 0.0;
+
+	for (int l = 0; l < 3; l++)
+	{
+		noise.setSimdLevel(levels[l]);
+
+		if (noise.getSimdLevel() != levels[l])
+		{
+			results.push_back({ names[l], resolution, 0.0, "not supported by this CPU" });
+			continue;
+		}
+
+		double time = timeRuns(runs, []() {}, [&]() { noise.generateImprovedPerlinPoints(pointX.data(), pointY.data(), cells, samples.data()); });
+
+		if (l == 0)
+		{
+			scalar = time;
+			expected = samples;
+			results.push_back({ names[l], resolution, time, "" });
+		}
+
+		else
+		{
+			bool identical = memcmp(expected.data(), samples.data(), sizeof(float) * cells) == 0;
+			results.push_back({ names[l], resolution, time, comparisonNote(scalar, time, identical) });
+		}
+	}
+
+	//The warped operator, first building its warp and then reusing it while only the base FBM changes
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	double plain = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateFBM(8, 0.5f, 1.1f); });
+
+	double cold = timeRuns(runs, [&]()
+	{
+		terrain.flatten();
+		terrain.setNoiseSeed(0);	//Same noise, but the cached warp is thrown away
+	},
+	[&]() { terrain.generateWarpedFBM(8, 0.5f, 1.1f, 4, 0.01f, 40.0f); });
+
+	std::vector<float> coldHeights(terrain.getHeightMap(), terrain.getHeightMap() + cells);
+
+	double warm = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateWarpedFBM(8, 0.5f, 1.1f, 4, 0.01f, 40.0f); });
+	bool identical = memcmp(coldHeights.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+
+	//Changing the base FBM and the strength keeps the warp, changing its frequency does not
+	double tweaked = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateWarpedFBM(6, 0.45f, 1.3f, 4, 0.01f, 25.0f); });
+
+	char note[128];
+	snprintf(note, sizeof(note), "%.2fx the time of plain FBM", cold / plain);
+	results.push_back({ "FBM (plain)", resolution, plain, "" });
+	results.push_back({ "Warped FBM (cold, building the warp)", resolution, cold, note });
+
+	snprintf(note, sizeof(note), "%.2fx faster than cold, %s", cold / warm, identical ? "bit-identical to cold" : "MISMATCH WITH COLD");
+	results.push_back({ "Warped FBM (warm, cached warp)", resolution, warm, note });
+
+	snprintf(note, sizeof(note), "%.2fx faster than cold", cold / tweaked);
+	results.push_back({ "Warped FBM (warm, base FBM and strength changed)", resolution, tweaked, note });
+}
+
+void Benchmark::benchmarkNoiseSpan(int resolution)
+{
+	PerlinNoise noise;
+
+	const float frequency = 0.015f;
+	const int runs = runsFor(resolution);
+
+	std::vector<float> expected(resolution * resolution);
+	std::vector<float> samples(resolution * resolution);
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* names[] = { "Improved Perlin span (scalar)", "Improved Perlin span (SSE2)", "Improved Perlin span (AVX2)" };
+
+	double scalar = 0.0;
+
+	for (int l = 0; l < 3; l++)
+	{
+		noise.setSimdLevel(levels[l]);
+
+		//Levels the CPU cannot run are clamped down, so there is nothing new to measure
+		if (noise.getSimdLevel() != levels[l])
+		{
+			results.push_back({ names[l], resolution, 0.0, "not supported by this CPU" });
+			continue;
+		}
+
+		double time = timeRuns(runs, []() {}, [&]()
+		{
+			for (int j = 0; j < resolution; j++)
+			{
+				noise.generateImprovedPerlinSpan(0.0f, frequency, (float)j * frequency, resolution, &samples[j * resolution]);
+			}
+		});
+
+		char note[128];
+
+		if (l == 0)
+		{
+			scalar = time;
+			expected = samples;
+			snprintf(note, sizeof(note), "%.2f ns/sample", (time * 1000000.0) / (double)samples.size());
+		}
+
+		else
+		{
+			float maxError = 0.0f;
+
+			for (size_t n = 0; n < samples.size(); n++)
+			{
+				maxError = (std::max)(maxError, fabsf(samples[n] - expected[n]));
+			}
+
+			snprintf(note, sizeof(note), "%.2f ns/sample, %.2fx speedup, max difference %g", (time * 1000000.0) / (double)samples.size(), scalar / time, maxError);
+		}
+
+		results.push_back({ names[l], resolution, time, note });
+	}
+}
+
+void Benchmark::benchmarkSimplexSpan(int resolution)
+{
+	SimplexNoise noise;
+
+	struct Span
+	{
+		const char* name;
+		std::function<void(int, float*)> row;
+	};
+
+	const float frequency = 0.015f;
+
+	//The 3D rows run through a slice part of the way between lattice planes, so every tetrahedron gets used
+	const Span spans[] =
+	{
+		{ "Simplex span", [&](int j, float* output) { noise.generateSimplexSpan(0.0f, frequency, (float)j * frequency, resolution, output); } },
+		{ "Simplex 3D span", [&](int j, float* output) { noise.generateSimplex3DSpan(0.0f, frequency, (float)j * frequency, 0.37f, resolution, output); } }
+	};
+
+	const int runs = runsFor(resolution);
+
+	std::vector<float> expected(resolution * resolution);
+	std::vector<float> samples(resolution * resolution);
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* levelNames[] = { "scalar", "SSE2", "AVX2" };
+
+	for (const Span& span : spans)
+	{
+		double scalar = 0.0;
+
+		for (int l = 0; l < 3; l++)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "%s (%s)", span.name, levelNames[l]);
+
+			noise.setSimdLevel(levels[l]);
+
+			if (noise.getSimdLevel() != levels[l])
+			{
+				results.push_back({ name, resolution, 0.0, "not supported by this CPU" });
+				continue;
+			}
+
+			double time = timeRuns(runs, []() {}, [&]()
+			{
+				for (int j = 0; j < resolution; j++)
+				{
+					span.row(j, &samples[j * resolution]);
+				}
+			});
+
+			char note[128];
+
+			if (l == 0)
+			{
+				scalar = time;
+				expected = samples;
+				snprintf(note, sizeof(note), "%.2f ns/sample", (time * 1000000.0) / (double)samples.size());
+			}
+
+			else
+			{
+				bool identical = memcmp(samples.data(), expected.data(), samples.size() * sizeof(float)) == 0;
+				snprintf(note, sizeof(note), "%.2f ns/sample, %s", (time * 1000000.0) / (double)samples.size(), comparisonNote(scalar, time, identical).c_str());
+			}
+
+			results.push_back({ name, resolution, time, note, throughputMetrics(time, (double)samples.size()) });
+		}
+	}
+}
+
+void Benchmark::benchmarkNoiseSamples(int resolution)
+{
+	PerlinNoise noise;
+
+	struct Generator
+	{
+		const char* name;
+		std::function<float(float, float)> sample;
+	};
+
+	const Generator generators[] =
+	{
+		{ "Perlin 1D sample", [&](float x, float y) { return noise.generatePerlin1D(x + y); } },
+		{ "Original Perlin sample", [&](float x, float y) { return noise.generatePerlin2D(x, y); } },
+		{ "Improved Perlin sample", [&](float x, float y) { return noise.generateImprovedPerlin(x, y); } },
+		{ "Improved Perlin sample (periodic)", [&](float x, float y) { return noise.generateImprovedPerlin(x, y, 48); } },
+		{ "Improved Perlin 3D sample", [&](float x, float y) { return noise.generateImprovedPerlin3D(x, y, 0.37f); } }
+	};
+
+	const int samples = resolution * resolution;
+	const int runs = runsFor(resolution);
+
+	//A row at a time the lookups walk through the tables in order, scattered points hit them anywhere
+	std::vector<float> pointX(samples), pointY(samples), output(samples);
+	Random random(Random::deriveKey(0, RandomStream::HeightMap));
+
+	for (int n = 0; n < samples; n++)
+	{
+		pointX[n] = random.nextFloat() * 512.0f;
+		pointY[n] = random.nextFloat() * 512.0f;
+	}
+
+	for (const Generator& generator : generators)
+	{
+		const float spacing = 0.05f;
+
+		double rows = timeRuns(runs, []() {}, [&]()
+		{
+			for (int j = 0; j < resolution; j++)
+			{
+				for (int i = 0; i < resolution; i++)
+				{
+					output[j * resolution + i] = generator.sample((float)i * spacing, (float)j * spacing);
+				}
+			}
+		});
+
+		//A checksum of the outputs, so runs before and after a change to the tables can be compared for the same noise
+		uint32_t checksum = 0;
+
+		for (float value : output)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			checksum = (checksum ^ bits) * 16777619u;
+		}
+
+		double scattered = timeRuns(runs, []() {}, [&]()
+		{
+			for (int n = 0; n < samples; n++)
+			{
+				output[n] = generator.sample(pointX[n], pointY[n]);
+			}
+		});
+
+		char name[96];
+		char note[128];
+
+		snprintf(name, sizeof(name), "%s (along rows)", generator.name);
+		snprintf(note, sizeof(note), "%.2f ns/sample, checksum %08x", (rows * 1000000.0) / (double)samples, checksum);
+		results.push_back({ name, resolution, rows, note, throughputMetrics(rows, samples) });
+
+		snprintf(name, sizeof(name), "%s (scattered)", generator.name);
+		snprintf(note, sizeof(note), "%.2f ns/sample", (scattered * 1000000.0) / (double)samples);
+		results.push_back({ name, resolution, scattered, note, throughputMetrics(scattered, samples) });
+	}
+}
+
+void Benchmark::benchmarkNoiseQuality(int resolution)
+{
+	PerlinNoise noise;
+
+	struct Generator
+	{
+		const char* name;
+		std::function<float(float, float)> sample;
+	};
+
+	//Each row of the 1D noise starts somewhere new along the line, so the rows are independent like the 2D noise's
+	const Generator generators[] =
+	{
+		{ "Perlin 1D", [&](float x, float y) { return noise.generatePerlin1D(x + y * 97.0f); } },
+		{ "Original Perlin", [&](float x, float y) { return noise.generatePerlin2D(x, y); } },
+		{ "Improved Perlin", [&](float x, float y) { return noise.generateImprovedPerlin(x, y); } }
+	};
+
+	const float spacing = 0.05f;	//About twenty samples a lattice cell
+	const int latticeBin = (int)((float)resolution * spacing);	//Lattice cells along a row
+	const int samples = resolution * resolution;
+	std::vector<float> field(samples);
+
+	for (const Generator& generator : generators)
+	{
+		double time = timeRuns(1, []() {}, [&]()
+		{
+			for (int j = 0; j < resolution; j++)
+			{
+				for (int i = 0; i < resolution; i++)
+				{
+					field[j * resolution + i] = generator.sample((float)i * spacing, (float)j * spacing);
+				}
+			}
+		});
+
+		std::vector<BenchmarkMetric> metrics = throughputMetrics(time, samples);
+		std::string note = qualityMetrics(field.data(), resolution, resolution, latticeBin, metrics);
+
+		char name[96];
+		snprintf(name, sizeof(name), "%s quality", generator.name);
+		results.push_back({ name, resolution, time, note, metrics });
+	}
+}
+
+void Benchmark::benchmarkFBMQuality(TerrainMesh& terrain)
+{
+	const int resolutions[] = { 256, 1024, 2048 };
+	const int octaveCounts[] = { 1, 4, 8 };
+
+	for (int resolution : resolutions)
+	{
+		const int cells = resolution * resolution;
+		const int runs = runsFor(resolution);
+
+		terrain.Resize(resolution);
+		terrain.setAmplitude(28.0f);
+
+		for (int ridged = 0; ridged < 2; ridged++)
+		{
+			//The sample terrain's settings for each
+			const float frequency = ridged ? 0.033f : 0.015f;
+			const float ampl = ridged ? 0.4f : 0.5f;
+			const float freq = ridged ? 1.2f : 1.1f;
+
+			terrain.setFrequency(frequency);
+
+			for (int octaves : octaveCounts)
+			{
+				double time = timeRuns(runs, [&]() { terrain.flatten(); }, [&]()
+				{
+					ridged ? terrain.generateRidgedFBM(octaves, ampl, freq) : terrain.generateFBM(octaves, ampl, freq);
+				});
+
+				//Per height, however many octaves went into it
+				std::vector<BenchmarkMetric> metrics = throughputMetrics(time, cells);
+				metrics.push_back({ "octaves", { (double)octaves } });
+				metrics.push_back({ "threads", { (double)terrain.getThreadCount() } });
+
+				std::string note = qualityMetrics(terrain.getHeightMap(), resolution, resolution, (int)((float)resolution * frequency), metrics);
+
+				char name[96];
+				snprintf(name, sizeof(name), "%s, %d octave%s", ridged ? "Ridged FBM" : "FBM", octaves, octaves == 1 ? "" : "s");
+				results.push_back({ name, resolution, time, note, metrics });
+			}
+		}
+	}
+}
+
+void Benchmark::benchmarkNoiseRange(int resolution)
+{
+	PerlinNoise noise;
+
+	const float frequency = 0.015f;
+	const int runs = runsFor(resolution);
+
+	struct Window
+	{
+		const char* name;
+		int first;	//First sample along each axis, in samples from the origin
+	};
+
+	//The lattice used to be clamped to 0..511, flattening everything past about 34000 samples at this frequency and below zero
+	const Window windows[] =
+	{
+		{ "origin", 0 },
+		{ "negative", -resolution - 1000 },
+		{ "far", 1 << 22 }
+	};
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* levelNames[] = { "scalar", "SSE2", "AVX2" };
+
+	std::vector<float> expected(resolution * resolution);
+	std::vector<float> samples(resolution * resolution);
+
+	for (const Window& window : windows)
+	{
+		for (int l = 0; l < 3; l++)
+		{
+			noise.setSimdLevel(levels[l]);
+
+			if (noise.getSimdLevel() != levels[l])
+			{
+				continue;
+			}
+
+			double time = timeRuns(runs, []() {}, [&]()
+			{
+				for (int j = 0; j < resolution; j++)
+				{
+					noise.generateImprovedPerlinSpan(0.0f, frequency, (float)(window.first + j) * frequency, resolution, &samples[j * resolution], window.first);
+				}
+			});
+
+			if (l == 0)
+			{
+				expected = samples;
+			}
+
+			//A flattened lattice shows up as long runs of samples that barely change
+			float lowest = samples[0];
+			float highest = samples[0];
+
+			for (float sample : samples)
+			{
+				lowest = (std::min)(lowest, sample);
+				highest = (std::max)(highest, sample);
+			}
+
+			char name[64];
+			char note[128];
+			snprintf(name, sizeof(name), "Improved Perlin span, %s (%s)", window.name, levelNames[l]);
+			snprintf(note, sizeof(note), "%.2f ns/sample, range %.3f to %.3f, %s", (time * 1000000.0) / (double)samples.size(), lowest, highest,
+				memcmp(expected.data(), samples.data(), sizeof(float) * samples.size()) == 0 ? "bit-identical to scalar" : "OUTPUT MISMATCH");
+
+			results.push_back({ name, resolution, time, note });
+		}
+	}
+
+	//Moving a point a whole number of lattice periods away must give the same noise, however far that is
+	const double period = 512.0;
+	int mismatches = 0;
+
+	double farTime = timeRuns(1, []() {}, [&]()
+	{
+		for (int j = 0; j < resolution; j++)
+		{
+			for (int i = 0; i < resolution; i++)
+			{
+				float x = (float)i * 0.25f;
+				float y = (float)j * 0.25f;
+
+				samples[j * resolution + i] = noise.generateImprovedPerlinFar((double)x + period * 1099511627776.0, (double)y - period * 1073741824.0);
+			}
+		}
+	});
+
+	for (int j = 0; j < resolution; j++)
+	{
+		for (int i = 0; i < resolution; i++)
+		{
+			mismatches += samples[j * resolution + i] != noise.generateImprovedPerlin((float)i * 0.25f, (float)j * 0.25f) ? 1 : 0;
+		}
+	}
+
+	char note[128];
+	snprintf(note, sizeof(note), "%.2f ns/sample at 2^49 cells from the origin, %s", (farTime * 1000000.0) / (double)samples.size(),
+		mismatches == 0 ? "identical to the wrapped point near the origin" : "OUTPUT MISMATCH");
+
+	results.push_back({ "Improved Perlin far from origin (scalar)", resolution, farTime, note });
+}
+
+void Benchmark::benchmarkTileable(TerrainMesh& terrain, int resolution)
+{
+	PerlinNoise noise;
+
+	//Starting below zero and covering more than two periods, so the wrap is taken on both sides of the origin
+	const float start = -8.0f;
+	const float frequency = 0.015f;
+	const int period = 7;
+	const int runs = runsFor(resolution);
+
+	std::vector<float> samples(resolution * resolution);
+	std::vector<float> expected(resolution * resolution);
+
+	auto fill = [&](int repeat)
+	{
+		for (int j = 0; j < resolution; j++)
+		{
+			noise.generateImprovedPerlinSpan(start, frequency, start + (float)j * frequency, resolution, &samples[j * resolution], 0, repeat);
+		}
+	};
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* names[] = { "Periodic Perlin span (scalar)", "Periodic Perlin span (SSE2)", "Periodic Perlin span (AVX2)" };
+
+	for (int l = 0; l < 3; l++)
+	{
+		noise.setSimdLevel(levels[l]);
+
+		if (noise.getSimdLevel() != levels[l])
+		{
+			results.push_back({ names[l], resolution, 0.0, "not supported by this CPU" });
+			continue;
+		}
+
+		double plain = timeRuns(runs, []() {}, [&]() { fill(0); });
+		double periodic = timeRuns(runs, []() {}, [&]() { fill(period); });
+
+		char note[160];
+		int length = snprintf(note, sizeof(note), "%+.1f%% against no period", (periodic / plain - 1.0) * 100.0);
+
+		if (l == 0)
+		{
+			expected = samples;
+		}
+
+		else
+		{
+			bool identical = memcmp(expected.data(), samples.data(), sizeof(float) * samples.size()) == 0;
+			snprintf(note + length, sizeof(note) - length, ", %s", identical ? "bit-identical to scalar" : "SCALAR MISMATCH");
+		}
+
+		results.push_back({ names[l], resolution, periodic, note });
+	}
+
+	//Steps of 1/64 keep every position exact, so a row moved on by whole periods has to give exactly the same samples
+	noise.setSimdLevel(CpuFeatures::bestSimdLevel());
+
+	std::vector<float> shifted(resolution);
+	int mismatches = 0;
+
+	for (int j = 0; j < resolution; j += 16)
+	{
+		float y = -20.0f + (float)j / 64.0f;
+
+		noise.generateImprovedPerlinSpan(-20.0f, 1.0f / 64.0f, y, resolution, samples.data(), 0, period);
+		noise.generateImprovedPerlinSpan(-20.0f + (float)(3 * period), 1.0f / 64.0f, y - (float)period, resolution, shifted.data(), 0, period);
+
+		for (int i = 0; i < resolution; i++)
+		{
+			mismatches += samples[i] == shifted[i] ? 0 : 1;
+		}
+	}
+
+	results.push_back({ "Periodic Perlin, shifted by whole periods", resolution, 0.0, mismatches == 0 ? "repeats exactly" : "DOES NOT REPEAT" });
+
+	//A step this long crosses more cells than a span wraps at once, so it is also done in pieces, which must not show
+	const int longPeriod = 600;
+	mismatches = 0;
+
+	for (int j = 0; j < resolution; j += 64)
+	{
+		float y = -300.0f + (float)j * 1.37f;
+		noise.generateImprovedPerlinSpan(-700.0f, 1.37f, y, resolution, samples.data(), 5, longPeriod);
+
+		for (int i = 0; i < resolution; i++)
+		{
+			mismatches += samples[i] == noise.generateImprovedPerlin(-700.0f + (float)(5 + i) * 1.37f, y, longPeriod) ? 0 : 1;
+		}
+	}
+
+	results.push_back({ "Periodic Perlin span, against single samples", resolution, 0.0, mismatches == 0 ? "bit-identical" : "SAMPLE MISMATCH" });
+
+	//The tileable operator, its opposite edges have to be equal and the step across them no bigger than any other
+	const int size = resolution + 1;
+	const int tileSize = size - 1;
+
+	terrain.Resize(size);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	double plain = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateFBM(8, 0.5f, 1.1f); });
+	double tileable = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateTileableFBM(8, 0.5f, 1.1f); });
+
+	const float* heights = terrain.getHeightMap();
+	bool edgesMatch = true;
+	float seamStep = 0.0f;
+	float interiorStep = 0.0f;
+
+	for (int n = 0; n < size; n++)
+	{
+		edgesMatch = edgesMatch && heights[n] == heights[tileSize * size + n] && heights[n * size] == heights[n * size + tileSize];
+
+		//Across the seam the neighbour of the last column but one is the first column of the next tile
+		seamStep = (std::max)(seamStep, fabsf(heights[n * size + tileSize - 1] - heights[n * size]));
+		seamStep = (std::max)(seamStep, fabsf(heights[(tileSize - 1) * size + n] - heights[n]));
+
+		for (int i = 0; i + 1 < size; i++)
+		{
+			interiorStep = (std::max)(interiorStep, fabsf(heights[n * size + i + 1] - heights[n * size + i]));
+			interiorStep = (std::max)(interiorStep, fabsf(heights[(i + 1) * size + n] - heights[i * size + n]));
+		}
+	}
+
+	char note[160];
+	snprintf(note, sizeof(note), "%.2fx the time of plain FBM, edges %s, largest step %.3f across the seam and %.3f inside", tileable / plain, edgesMatch ? "bit-identical" : "DIFFER", seamStep, interiorStep);
+	results.push_back({ "Tileable FBM", size, tileable, note });
+}
+
+void Benchmark::benchmarkNoiseTypes(TerrainMesh& terrain, int resolution)
+{
+	PerlinNoise perlin;
+	SimplexNoise simplex;
+
+	struct Generator
+	{
+		const char* name;
+		std::function<float(float, float)> sample;
+	};
+
+	//The 3D generators are measured on a slice, which is how a 2D terrain would use them
+	const Generator generators[] =
+	{
+		{ "Improved Perlin", [&](float x, float y) { return perlin.generateImprovedPerlin(x, y); } },
+		{ "Simplex 2D", [&](float x, float y) { return simplex.generateSimplex2D(x, y); } },
+		{ "OpenSimplex2 2D", [&](float x, float y) { return simplex.generateOpenSimplex2D(x, y); } },
+		{ "Simplex 3D", [&](float x, float y) { return simplex.generateSimplex3D(x, y, 0.37f); } },
+		{ "OpenSimplex2 3D", [&](float x, float y) { return simplex.generateOpenSimplex3D(x, y, 0.37f); } }
+	};
+
+	const float spacing = 0.05f;	//About twenty samples a lattice cell
+	const int runs = runsFor(resolution);
+	std::vector<float> samples(resolution * resolution);
+
+	double perlinTime = 0.0;
+
+	for (const Generator& generator : generators)
+	{
+		double time = timeRuns(runs, []() {}, [&]()
+		{
+			for (int j = 0; j < resolution; j++)
+			{
+				for (int i = 0; i < resolution; i++)
+				{
+					samples[j * resolution + i] = generator.sample((float)i * spacing, (float)j * spacing);
+				}
+			}
+		});
+
+		if (perlinTime == 0.0)
+		{
+			perlinTime = time;
+		}
+
+		double mean = 0.0;
+		float lowest = samples[0];
+		float highest = samples[0];
+
+		for (float sample : samples)
+		{
+			mean += sample;
+			lowest = (std::min)(lowest, sample);
+			highest = (std::max)(highest, sample);
+		}
+
+		mean /= (double)samples.size();
+
+		//How much the noise changes over a short step in each of four directions, the same in every direction for isotropic noise
+		const float step = 0.25f;
+		const float directions[4][2] = { { 1.0f, 0.0f }, { 0.70710678f, 0.70710678f }, { 0.0f, 1.0f }, { -0.70710678f, 0.70710678f } };
+		double variation[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+		for (int j = 0; j < resolution; j += 4)
+		{
+			for (int i = 0; i < resolution; i += 4)
+			{
+				float x = (float)i * spacing;
+				float y = (float)j * spacing;
+				float centre = samples[j * resolution + i];
+
+				for (int d = 0; d < 4; d++)
+				{
+					float difference = generator.sample(x + directions[d][0] * step, y + directions[d][1] * step) - centre;
+					variation[d] += (double)difference * difference;
+				}
+			}
+		}
+
+		double leastVariation = *std::min_element(variation, variation + 4);
+		double mostVariation = *std::max_element(variation, variation + 4);
+
+		char name[64];
+		char note[192];
+		snprintf(name, sizeof(name), "Noise sample (%s)", generator.name);
+		snprintf(note, sizeof(note), "%.1f M samples/s, %.2fx improved Perlin, range %.3f to %.3f, mean %.4f, anisotropy %.3f",
+			(double)samples.size() / (time * 1000.0), perlinTime / time, lowest, highest, mean, mostVariation / leastVariation);
+
+		results.push_back({ name, resolution, time, note });
+	}
+
+	//The same comparison through the FBM operator, each using its fastest batch path
+	struct Basis
+	{
+		const char* name;
+		NoiseType type;
+	};
+
+	const Basis bases[] =
+	{
+		{ "improved Perlin", NoiseType::ImprovedPerlin },
+		{ "Simplex", NoiseType::Simplex },
+		{ "OpenSimplex2", NoiseType::OpenSimplex2 }
+	};
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	double perlinFBM = 0.0;
+
+	for (const Basis& basis : bases)
+	{
+		terrain.setNoiseType(basis.type);
+
+		double time = timeRuns(runs, [&]() { terrain.flatten(); }, [&]() { terrain.generateFBM(8, 0.5f, 1.1f); });
+
+		if (basis.type == NoiseType::ImprovedPerlin)
+		{
+			perlinFBM = time;
+		}
+
+		char name[64];
+		char note[64];
+		snprintf(name, sizeof(name), "FBM (%s)", basis.name);
+		snprintf(note, sizeof(note), "%.2fx improved Perlin", perlinFBM / time);
+
+		results.push_back({ name, resolution, time, note });
+	}
+
+	terrain.setNoiseType(NoiseType::ImprovedPerlin);
+}
+
+void Benchmark::benchmarkWorley(int resolution)
+{
+	WorleyNoise worley;
+	PerlinNoise perlin;
+
+	const float frequency = 0.05f;	//About twenty samples a cell, as the terrain would use it
+	const int runs = runsFor(resolution);
+	std::vector<float> samples(resolution * resolution);
+	std::vector<float> expected(resolution * resolution);
+
+	auto fill = [&]()
+	{
+		for (int j = 0; j < resolution; j++)
+		{
+			worley.generateWorleySpan(0.0f, frequency, (float)j * frequency, resolution, &samples[j * resolution]);
+		}
+	};
+
+	//Improved Perlin's best span as the yardstick
+	double perlinTime = timeRuns(runs, []() {}, [&]()
+	{
+		for (int j = 0; j < resolution; j++)
+		{
+			perlin.generateImprovedPerlinSpan(0.0f, frequency, (float)j * frequency, resolution, &samples[j * resolution]);
+		}
+	});
+
+	struct Variant
+	{
+		const char* name;
+		WorleyFeature feature;
+		WorleyDistance distance;
+	};
+
+	const Variant variants[] =
+	{
+		{ "F1, Euclidean", WorleyFeature::F1, WorleyDistance::Euclidean },
+		{ "F1, Manhattan", WorleyFeature::F1, WorleyDistance::Manhattan },
+		{ "F1, Chebyshev", WorleyFeature::F1, WorleyDistance::Chebyshev },
+		{ "F2, Euclidean", WorleyFeature::F2, WorleyDistance::Euclidean },
+		{ "F2 - F1, Euclidean", WorleyFeature::F2MinusF1, WorleyDistance::Euclidean }
+	};
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* levelNames[] = { "scalar", "SSE2", "AVX2" };
+
+	for (const Variant& variant : variants)
+	{
+		worley.setFeature(variant.feature);
+		worley.setDistance(variant.distance);
+
+		double scalar = 0.0;
+
+		for (int l = 0; l < 3; l++)
+		{
+			char name[96];
+			snprintf(name, sizeof(name), "Worley span, %s (%s)", variant.name, levelNames[l]);
+
+			worley.setSimdLevel(levels[l]);
+
+			if (worley.getSimdLevel() != levels[l])
+			{
+				results.push_back({ name, resolution, 0.0, "not supported by this CPU" });
+				continue;
+			}
+
+			double time = timeRuns(runs, []() {}, fill);
+
+			char note[192];
+			int length = snprintf(note, sizeof(note), "%.1f M samples/s, %.2fx the time of improved Perlin", (double)samples.size() / (time * 1000.0), time / perlinTime);
+
+			if (l == 0)
+			{
+				scalar = time;
+				expected = samples;
+
+				float lowest = *std::min_element(samples.begin(), samples.end());
+				float highest = *std::max_element(samples.begin(), samples.end());
+				snprintf(note + length, sizeof(note) - length, ", range %.3f to %.3f", lowest, highest);
+			}
+
+			else
+			{
+				bool identical = memcmp(expected.data(), samples.data(), sizeof(float) * samples.size()) == 0;
+				snprintf(note + length, sizeof(note) - length, ", %.2fx speedup, %s", scalar / time, identical ? "bit-identical to scalar" : "SCALAR MISMATCH");
+			}
+
+			results.push_back({ name, resolution, time, note });
+		}
+	}
+}
+
+void Benchmark::sweepThreads(TerrainMesh& terrain, const std::string& name, int resolution, int runs, const std::function<void()>& setup, const std::function<void()>& run, double work,
+	const std::function<std::string(double)>& describe, const std::function<std::string(double)>& checkBaseline)
+{
+	const int cells = resolution * resolution;
+	const int hardwareThreads = (int)std::thread::hardware_concurrency();
+	const int previousThreads = terrain.getThreadCount();
+
+	std::vector<float> expected(cells);
+	double singleThreaded = 0.0;
+
+	for (int threads = 1; threads <= 16; threads *= 2)
+	{
+		//Always measure one thread as the baseline, and the full core count even if it is not a power of two
+		if (threads > 1 && threads > hardwareThreads)
+		{
+			threads = hardwareThreads;
+
+			if (threads <= 1 || threads == terrain.getThreadCount())
+			{
+				break;
+			}
+		}
+
+		terrain.setThreadCount(threads);
+
+		double time = timeRuns(runs, setup, run);
+
+		std::string note = describe ? describe(time) : "";
+		std::string check;
+
+		if (threads == 1)
+		{
+			singleThreaded = time;
+			memcpy(expected.data(), terrain.getHeightMap(), sizeof(float) * cells);
+
+			check = checkBaseline ? checkBaseline(time) : "";
+		}
+
+		else
+		{
+			bool identical = memcmp(expected.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+
+			char speedup[96];
+			snprintf(speedup, sizeof(speedup), "%.2fx speedup over 1 thread, %s", singleThreaded / time, identical ? "bit-identical to 1 thread" : "OUTPUT MISMATCH");
+			check = speedup;
+		}
+
+		if (!check.empty())
+		{
+			note += (note.empty() ? "" : ", ") + check;
+		}
+
+		char threadName[96];
+		snprintf(threadName, sizeof(threadName), "%s (%d threads)", name.c_str(), threads);
+
+		std::vector<BenchmarkMetric> metrics = throughputMetrics(time, work);
+		metrics.push_back({ "threads", { (double)threads } });
+		results.push_back({ threadName, resolution, time, note, metrics });
+
+		if (threads == hardwareThreads)
+		{
+			break;
+		}
+	}
+
+	terrain.setThreadCount(previousThreads);
+}
+
+void Benchmark::benchmarkThreads(TerrainMesh& terrain, int resolution)
+{
+	struct Operator
+	{
+		const char* name;
+		std::function<void()> apply;
+	};
+
+	const Operator operators[] =
+	{
+		{ "Flatten", [&]() { terrain.flatten(); } },
+		{ "Invert", [&]() { terrain.invert(); } },
+		{ "Original Perlin", [&]() { terrain.perlinOriginal(); } },
+		{ "Improved Perlin", [&]() { terrain.perlinImproved(); } },
+		{ "FBM", [&]() { terrain.generateFBM(8, 0.5f, 1.1f); } },
+		{ "Ridged FBM", [&]() { terrain.generateRidgedFBM(8, 0.4f, 1.2f); } },
+		{ "Fault", [&]() { terrain.fault(25, 1); } }
+	};
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	for (const Operator& op : operators)
+	{
+		sweepThreads(terrain, op.name, resolution, runsFor(resolution), [&]() { terrain.flatten(); }, op.apply, (double)resolution * resolution);
+	}
+}
+
+void Benchmark::benchmarkWindErosion(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int particles = 20000;
+
+	//The GUI's default settings
+	float particleVelocity[3] = { 1.0f, 0.0f, 1.0f };
+	float windVelocity[3] = { 1.0f, -1.0f, 1.0f };
+
+	auto erode = [&](bool parallel)
+	{
+		if (parallel)
+		{
+			terrain.windErosionParallel(0.25f, particles, particleVelocity, windVelocity, 0.4f, 0.02f, 0.25f, 0.01f, 0.5f, true, 1);
+		}
+
+		else
+		{
+			terrain.windErosion(0.25f, particles, particleVelocity, windVelocity, 0.4f, 0.02f, 0.25f, 0.01f, 0.5f, true, 1);
+		}
+	};
+
+	//BuildHeightMap clears the sediment left by the last run as well
+	auto setup = [&]()
+	{
+		terrain.BuildHeightMap();
+		terrain.flatten();
+		terrain.generateFBM(8, 0.5f, 1.1f);
+	};
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	char note[128];
+
+	double serial = timeRuns(1, setup, [&]() { erode(false); });
+	snprintf(note, sizeof(note), "%.0f particles/s", (double)particles / (serial / 1000.0));
+	results.push_back({ "Wind erosion (one particle at a time)", resolution, serial, note, throughputMetrics(serial, particles) });
+
+	auto throughput = [&](double time)
+	{
+		snprintf(note, sizeof(note), "%.0f particles/s", (double)particles / (time / 1000.0));
+		return std::string(note);
+	};
+
+	sweepThreads(terrain, "Tiled wind erosion", resolution, 1, setup, [&]() { erode(true); }, particles, throughput, [&](double time)
+	{
+		const std::vector<float> first(terrain.getHeightMap(), terrain.getHeightMap() + cells);
+
+		//Flown again straight away, the same seed has to give the same map
+		timeRuns(1, setup, [&]() { erode(true); });
+		bool repeatable = memcmp(first.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+
+		snprintf(note, sizeof(note), "%.2fx the one at a time rate, %s", serial / time, repeatable ? "repeats exactly" : "DIFFERS BETWEEN RUNS");
+		return std::string(note);
+	});
+}
+
+void Benchmark::benchmarkWindBatches(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int particles = 5000;
+	const float dt = 0.25f;
+	const float amplitude = 28.0f;
+	const XMINT2 wholeMap(resolution, resolution);
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(amplitude);
+	terrain.setFrequency(0.015f);
+	terrain.flatten();
+	terrain.generateFBM(8, 0.5f, 1.1f);
+
+	const std::vector<float> terrainHeights(terrain.getHeightMap(), terrain.getHeightMap() + cells);
+
+	//The GUI's default settings, with particles launched from the low edges the way the terrain launches them
+	WindErosion wind(1.0f, -1.0f, 1.0f);
+	wind.setWindAttributes(0.4f, 0.02f, 0.25f, 0.01f, 0.5f, true);
+
+	const uint64_t key = Random::deriveKey(1, RandomStream::WindErosion);
+	std::vector<WindFlight> launched(particles);
+	std::vector<int> order(particles);
+
+	for (int j = 0; j < particles; j++)
+	{
+		WindParticle particle;
+		particle.velocity = XMFLOAT3(1.0f, 0.0f, 1.0f);
+
+		int shift = Random::at(key, j, resolution + resolution);
+		particle.position = shift < resolution ? XMFLOAT2((float)shift, 0.0f) : XMFLOAT2(0.0f, (float)(shift - resolution));
+
+		launched[j] = wind.launch(particle);
+		order[j] = j;
+	}
+
+	std::vector<float> heights, sediment;
+	std::vector<WindFlight> flights;
+
+	auto setup = [&]()
+	{
+		heights = terrainHeights;
+		sediment.assign(cells, 0.0f);
+		flights = launched;
+	};
+
+	//Every flight stays on the map, so none of them ever pauses
+	WindBatch batch;
+	std::vector<int> paused;
+
+	auto flyBatches = [&](int batchSize)
+	{
+		for (int first = 0; first < particles; first += batchSize)
+		{
+			wind.flyBatchWithin(dt, amplitude, heights.data(), sediment.data(), flights.data(), &order[first], (std::min)(batchSize, particles - first), resolution, XMINT2(0, 0), wholeMap, batch, paused);
+		}
+	};
+
+	//How much ground was worn away and how much sediment was left lying, which the order particles fly in should only nudge
+	auto totals = [&](double& eroded, double& deposited)
+	{
+		eroded = 0.0;
+		deposited = 0.0;
+
+		for (int i = 0; i < cells; i++)
+		{
+			eroded += (double)(terrainHeights[i] - heights[i]);
+			deposited += (double)sediment[i];
+		}
+	};
+
+	char note[192];
+
+	double single = timeRuns(1, setup, [&]()
+	{
+		for (int j = 0; j < particles; j++)
+		{
+			wind.flyWithin(dt, amplitude, heights.data(), sediment.data(), flights[j], resolution, XMINT2(0, 0), wholeMap);
+		}
+	});
+
+	std::vector<float> expectedHeights = heights;
+	std::vector<float> expectedSediment = sediment;
+	double expectedEroded, expectedDeposited;
+	totals(expectedEroded, expectedDeposited);
+
+	snprintf(note, sizeof(note), "%.0f particles/s, %.1f eroded, %.1f left as sediment", (double)particles / (single / 1000.0), expectedEroded, expectedDeposited);
+	results.push_back({ "Wind flight (one at a time)", resolution, single, note, throughputMetrics(single, particles) });
+
+	//A batch of one takes exactly flyWithin's steps
+	wind.setSimdLevel(CpuFeatures::bestSimdLevel());
+
+	double ones = timeRuns(1, setup, [&]() { flyBatches(1); });
+	bool identical = heights == expectedHeights && sediment == expectedSediment;
+
+	snprintf(note, sizeof(note), "%.0f particles/s, %s", (double)particles / (ones / 1000.0), identical ? "bit-identical to one at a time" : "MISMATCH WITH ONE AT A TIME");
+	results.push_back({ "Wind flight (batches of 1)", resolution, ones, note, throughputMetrics(ones, particles) });
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* levelNames[] = { "scalar", "SSE2", "AVX2" };
+
+	//About as many as the tiled erosion flies together in a tile, then more
+	const int batchSizes[] = { 8, 32 };
+
+	for (int batchSize : batchSizes)
+	{
+		double scalar = 0.0;
+
+		for (int l = 0; l < 3; l++)
+		{
+			char name[96];
+			snprintf(name, sizeof(name), "Wind flight (batches of %d, %s)", batchSize, levelNames[l]);
+
+			wind.setSimdLevel(levels[l]);
+
+			if (wind.getSimdLevel() != levels[l])
+			{
+				results.push_back({ name, resolution, 0.0, "not supported by this CPU" });
+				continue;
+			}
+
+			double time = timeRuns(1, setup, [&]() { flyBatches(batchSize); });
+
+			int length = snprintf(note, sizeof(note), "%.0f particles/s, %.2fx the one at a time rate", (double)particles / (time / 1000.0), single / time);
+			std::vector<BenchmarkMetric> metrics = throughputMetrics(time, particles);
+			metrics.push_back({ "batch_size", { (double)batchSize } });
+
+			if (l == 0)
+			{
+				scalar = time;
+				expectedHeights = heights;
+				expectedSediment = sediment;
+
+				//Lock-step changes which particles see each other's erosion, so the map can only be compared in total
+				double eroded, deposited;
+				totals(eroded, deposited);
+
+				double erodedDifference = fabs(eroded - expectedEroded) / expectedEroded;
+				double depositedDifference = fabs(deposited - expectedDeposited) / expectedDeposited;
+				bool withinTolerance = erodedDifference <= 0.1 && depositedDifference <= 0.1;
+
+				snprintf(note + length, sizeof(note) - length, ", erosion %.1f%% and sediment %.1f%% from one at a time, %s", erodedDifference * 100.0, depositedDifference * 100.0,
+					withinTolerance ? "within tolerance" : "OUTSIDE TOLERANCE");
+
+				metrics.push_back({ "eroded_difference", { erodedDifference } });
+				metrics.push_back({ "sediment_difference", { depositedDifference } });
+			}
+
+			else
+			{
+				identical = heights == expectedHeights && sediment == expectedSediment;
+				snprintf(note + length, sizeof(note) - length, ", %.2fx speedup, %s", scalar / time, identical ? "bit-identical to scalar" : "SCALAR MISMATCH");
+			}
+
+			results.push_back({ name, resolution, time, note, metrics });
+		}
+	}
+
+	wind.setSimdLevel(CpuFeatures::bestSimdLevel());
+}
+
+void Benchmark::benchmarkHydraulicErosion(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int steps = 20;
+	const double cellSteps = (double)cells * steps;
+
+	//The GUI's defaults
+	const HydraulicSettings settings;
+
+	//BuildHeightMap clears the sediment left by the last run as well
+	auto setup = [&]()
+	{
+		terrain.BuildHeightMap();
+		terrain.flatten();
+		terrain.generateFBM(8, 0.5f, 1.1f);
+	};
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	setup();
+
+	const std::vector<float> terrainHeights(terrain.getHeightMap(), terrain.getHeightMap() + cells);
+	std::vector<float> heights, sediment;
+
+	char note[192];
+
+	//The passes driven straight over the whole map on this thread, to compare the instruction sets alone
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2 };
+	const char* names[] = { "Hydraulic erosion (scalar)", "Hydraulic erosion (SSE2)" };
+
+	std::vector<float> expectedHeights, expectedSediment;
+	double scalar = 0.0;
+
+	for (int l = 0; l < 2; l++)
+	{
+		HydraulicErosion water(resolution, settings);
+		water.setSimdLevel(levels[l]);
+
+		if (water.getSimdLevel() != levels[l])
+		{
+			results.push_back({ names[l], resolution, 0.0, "not supported by this CPU" });
+			continue;
+		}
+
+		double time = timeRuns(1, [&]() { heights = terrainHeights; sediment.assign(cells, 0.0f); }, [&]()
+		{
+			for (int step = 0; step < steps; step++)
+			{
+				water.outflow(heights.data(), sediment.data(), 0, resolution);
+				water.transport(0, resolution);
+				water.erode(heights.data(), sediment.data(), 0, resolution);
+			}
+		});
+
+		int length = snprintf(note, sizeof(note), "%.1fM cell-steps/s", cellSteps / (time * 1000.0));
+
+		if (l == 0)
+		{
+			scalar = time;
+			expectedHeights = heights;
+			expectedSediment = sediment;
+		}
+
+		else
+		{
+			bool identical = heights == expectedHeights && sediment == expectedSediment;
+			snprintf(note + length, sizeof(note) - length, ", %s", comparisonNote(scalar, time, identical).c_str());
+		}
+
+		std::vector<BenchmarkMetric> metrics = throughputMetrics(time, cellSteps);
+		metrics.push_back({ "steps", { (double)steps } });
+		results.push_back({ names[l], resolution, time, note, metrics });
+	}
+
+	//The whole operator, settling included, across the worker threads
+	double before = 0.0;
+
+	for (int i = 0; i < cells; i++)
+	{
+		before += (double)terrainHeights[i];
+	}
+
+	auto throughput = [&](double time)
+	{
+		//How long the thousands of steps a finished terrain needs would take at this rate
+		snprintf(note, sizeof(note), "%.1fM cell-steps/s, 1000 steps in %.1f s", cellSteps / (time * 1000.0), time * (1000.0 / steps) / 1000.0);
+		return std::string(note);
+	};
+
+	sweepThreads(terrain, "Hydraulic erosion", resolution, 1, setup, [&]() { terrain.hydraulicErosion(steps, settings); }, cellSteps, throughput, [&](double)
+	{
+		//Sediment only moves around, so the ground plus the sediment lying on it should add up to what it started as
+		double after = 0.0;
+
+		for (int i = 0; i < cells; i++)
+		{
+			after += (double)terrain.getHeightMap()[i] + (double)terrain.getSedimentMap()[i];
+		}
+
+		snprintf(note, sizeof(note), "material changed by %.2g%%", fabs(after - before) / fabs(before) * 100.0);
+		return std::string(note);
+	});
+}
+
+void Benchmark::benchmarkDropletErosion(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int droplets = 50000;
+
+	//The GUI's defaults
+	const DropletSettings settings;
+
+	//BuildHeightMap clears the sediment left by the last run as well
+	auto setup = [&]()
+	{
+		terrain.BuildHeightMap();
+		terrain.flatten();
+		terrain.generateFBM(8, 0.5f, 1.1f);
+	};
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	setup();
+
+	const std::vector<float> terrainHeights(terrain.getHeightMap(), terrain.getHeightMap() + cells);
+
+	//How much ground was worn away in all, which the order droplets run in should only nudge
+	auto eroded = [&]()
+	{
+		double total = 0.0;
+
+		for (int i = 0; i < cells; i++)
+		{
+			total += (double)(terrainHeights[i] - terrain.getHeightMap()[i]);
+		}
+
+		return total;
+	};
+
+	char note[192];
+
+	double serial = timeRuns(1, setup, [&]() { terrain.dropletErosion(droplets, settings, 1); });
+	double serialEroded = eroded();
+
+	snprintf(note, sizeof(note), "%.0f droplets/s, %.1f eroded", (double)droplets / (serial / 1000.0), serialEroded);
+	results.push_back({ "Droplet erosion (one at a time)", resolution, serial, note, throughputMetrics(serial, droplets) });
+
+	auto throughput = [&](double time)
+	{
+		snprintf(note, sizeof(note), "%.0f droplets/s", (double)droplets / (time / 1000.0));
+		return std::string(note);
+	};
+
+	sweepThreads(terrain, "Tiled droplet erosion", resolution, 1, setup, [&]() { terrain.dropletErosionParallel(droplets, settings, 1); }, droplets, throughput, [&](double time)
+	{
+		//Tiles change which droplets see each other's erosion first, so the map can only be compared with one at a time in total
+		double difference = fabs(eroded() - serialEroded) / serialEroded;
+
+		snprintf(note, sizeof(note), "%.2fx the one at a time rate, erosion %.1f%% from one at a time, %s", serial / time, difference * 100.0, difference <= 0.05 ? "within tolerance" : "OUTSIDE TOLERANCE");
+		return std::string(note);
+	});
+}
+
+void Benchmark::benchmarkThermalErosion(TerrainMesh& terrain, int resolution)
+{
+	const int cells = resolution * resolution;
+	const int iterations = 20;
+	const double cellIterations = (double)cells * iterations;
+
+	//The GUI's defaults
+	const float talusAngle = 35.0f;
+	const float rate = 0.5f;
+
+	auto setup = [&]()
+	{
+		terrain.flatten();
+		terrain.generateFBM(8, 0.5f, 1.1f);
+	};
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	setup();
+
+	const std::vector<float> terrainHeights(terrain.getHeightMap(), terrain.getHeightMap() + cells);
+	const float talus = tanf(talusAngle * (XM_PI / 180.0f)) * (terrain.getTerrainSize() / (float)resolution);
+
+	char note[192];
+
+	//The passes driven straight over the whole map on this thread, to compare the instruction sets alone
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2 };
+	const char* names[] = { "Thermal erosion (scalar)", "Thermal erosion (SSE2)" };
+
+	std::vector<float> heights, settled(cells), expected;
+	double scalar = 0.0;
+
+	for (int l = 0; l < 2; l++)
+	{
+		ThermalErosion slope(resolution, talus, rate);
+		slope.setSimdLevel(levels[l]);
+
+		if (slope.getSimdLevel() != levels[l])
+		{
+			results.push_back({ names[l], resolution, 0.0, "not supported by this CPU" });
+			continue;
+		}
+
+		double time = timeRuns(1, [&]() { heights = terrainHeights; }, [&]()
+		{
+			for (int iteration = 0; iteration < iterations; iteration++)
+			{
+				slope.slide(heights.data(), 0, resolution);
+				slope.settle(heights.data(), settled.data(), 0, resolution);
+				heights.swap(settled);
+			}
+		});
+
+		int length = snprintf(note, sizeof(note), "%.1fM cells/s", cellIterations / (time * 1000.0));
+
+		if (l == 0)
+		{
+			scalar = time;
+			expected = heights;
+		}
+
+		else
+		{
+			snprintf(note + length, sizeof(note) - length, ", %s", comparisonNote(scalar, time, heights == expected).c_str());
+		}
+
+		std::vector<BenchmarkMetric> metrics = throughputMetrics(time, cellIterations);
+		metrics.push_back({ "iterations", { (double)iterations } });
+		results.push_back({ names[l], resolution, time, note, metrics });
+	}
+
+	//The whole operator across the worker threads, with no threshold so every run takes all of its iterations
+	double before = 0.0;
+
+	for (int i = 0; i < cells; i++)
+	{
+		before += (double)terrainHeights[i];
+	}
+
+	auto throughput = [&](double time)
+	{
+		snprintf(note, sizeof(note), "%.1fM cells/s", cellIterations / (time * 1000.0));
+		return std::string(note);
+	};
+
+	sweepThreads(terrain, "Thermal erosion", resolution, 1, setup, [&]() { terrain.thermalErosion(talusAngle, rate, iterations, -1.0f); }, cellIterations, throughput, [&](double)
+	{
+		//Material only moves between neighbours, so the heights should add up to what they started as
+		double after = 0.0;
+
+		for (int i = 0; i < cells; i++)
+		{
+			after += (double)terrain.getHeightMap()[i];
+		}
+
+		snprintf(note, sizeof(note), "material changed by %.2g%%", fabs(after - before) / fabs(before) * 100.0);
+		return std::string(note);
+	});
+
+	//How soon the GUI's threshold stops it on the default terrain, where a finished run spends its time
+	const int defaultResolution = 128;
+	const int defaultCells = defaultResolution * defaultResolution;
+
+	terrain.Resize(defaultResolution);
+	setup();
+
+	int ran = 0;
+	double converged = timeRuns(1, []() {}, [&]() { ran = terrain.thermalErosion(talusAngle, rate, 10000, 0.001f); });
+
+	snprintf(note, sizeof(note), "came to rest after %d iterations, %.1fM cells/s", ran, (double)defaultCells * ran / (converged * 1000.0));
+	results.push_back({ "Thermal erosion (until at rest)", defaultResolution, converged, note, throughputMetrics(converged, (double)defaultCells * ran) });
+}
+
+void Benchmark::benchmarkIncremental(TerrainMesh& terrain, int resolution)
+{
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+
+	//A resolution nothing else uses, so the first rebuild after resizing to it has to build its index buffer and later ones can reuse it
+	const int uncachedResolution = resolution + 1;
+	auto resize = [&]()
+	{
+		terrain.Resize(uncachedResolution);
+		terrain.flatten();
+	};
+
+	double uncached = timeRuns(1, resize, [&]() { terrain.Regenerate(device, deviceContext); });
+	double cached = timeRuns(runsFor(uncachedResolution), resize, [&]() { terrain.Regenerate(device, deviceContext); });
+
+	char note[96];
+	snprintf(note, sizeof(note), "%.2fx faster with cached indices", uncached / cached);
+
+	results.push_back({ "Regenerate after resize (new indices)", uncachedResolution, uncached, "" });
+	results.push_back({ "Regenerate after resize (cached indices)", uncachedResolution, cached, note });
+
+	terrain.Resize(resolution);
+	terrain.flatten();
+	terrain.generateFBM(8, 0.5f, 1.1f);
+	terrain.Regenerate(device, deviceContext);
+
+	const size_t bytes = sizeof(float) * 8 * terrain.getVertexCount();	//Position, texture coordinates and normal
+	std::vector<unsigned char> incremental(bytes);
+
+	//Brush strokes in the middle of the map, on an edge and in a corner, to cover the clamped borders
+	const float strokes[][2] = { { 50.0f, 50.0f }, { 0.0f, 30.0f }, { 99.9f, 99.9f }, { 20.0f, 70.0f } };
+	const int strokeCount = sizeof(strokes) / sizeof(strokes[0]);
+	const float radius = 2.0f;
+
+	int stroke = 0;
+
+	double brush = timeRuns(strokeCount, [&]() { terrain.brush(strokes[stroke][0], strokes[stroke][1], radius, 1.0f); }, [&]()
+	{
+		terrain.Regenerate(device, deviceContext);
+		stroke++;
+	});
+
+	memcpy(incremental.data(), terrain.getVertexData(), bytes);
+
+	//Rebuilding everything from the same heights has to give exactly the same vertices
+	double full = timeRuns(1, [&]() { terrain.MarkAllDirty(); }, [&]() { terrain.Regenerate(device, deviceContext); });
+	bool identical = memcmp(incremental.data(), terrain.getVertexData(), bytes) == 0;
+
+	snprintf(note, sizeof(note), "%.2fx faster than a full rebuild, %s", full / brush, identical ? "vertices identical to full rebuild" : "VERTEX MISMATCH");
+
+	results.push_back({ "Regenerate (full)", resolution, full, "" });
+	results.push_back({ "Regenerate (brush)", resolution, brush, note });
+}
+
+void Benchmark::benchmarkNormals(TerrainMesh& terrain, int resolution)
+{
+	const int runs = runsFor(resolution);
+	const float spacing = terrain.getTerrainSize() / (float)resolution;
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	terrain.flatten();
+	terrain.generateFBM(8, 0.5f, 1.1f);
+
+	const float* heights = terrain.getHeightMap();
+
+	std::vector<float> reference(3 * resolution * resolution);
+	std::vector<float> normals(3 * resolution * resolution);
+	std::vector<float> scalarNormals;
+
+	double twoPass = timeRuns(runs, []() {}, [&]() { TerrainNormals::generateReference(heights, resolution, spacing, reference.data(), 3); });
+	results.push_back({ "Normals (two-pass reference)", resolution, twoPass, "" });
+
+	struct Variant
+	{
+		const char* name;
+		NormalMode mode;
+		SimdLevel level;
+		bool threaded;
+	};
+
+	const Variant variants[] =
+	{
+		{ "Normals (smoothed, scalar)", NormalMode::Smoothed, SimdLevel::Scalar, false },
+		{ "Normals (smoothed, SIMD)", NormalMode::Smoothed, SimdLevel::SSE2, false },
+		{ "Normals (smoothed, SIMD, all threads)", NormalMode::Smoothed, SimdLevel::SSE2, true },
+		{ "Normals (central difference, SIMD, all threads)", NormalMode::CentralDifference, SimdLevel::SSE2, true }
+	};
+
+	ThreadPool pool;
+	TerrainNormals generator;
+
+	for (const Variant& variant : variants)
+	{
+		generator.setMode(variant.mode);
+		generator.setSimdLevel(variant.level);
+
+		double time = timeRuns(runs, []() {}, [&]()
+		{
+			if (variant.threaded)
+			{
+				pool.parallelFor(resolution, [&](int start, int end)
+				{
+					generator.generate(heights, resolution, spacing, start, end, 0, resolution, normals.data(), 3);
+				});
+			}
+
+			else
+			{
+				generator.generate(heights, resolution, spacing, 0, resolution, 0, resolution, normals.data(), 3);
+			}
+		});
+
+		char note[160];
+		int length = snprintf(note, sizeof(note), "%.2fx speedup over two-pass, max %.4f degrees from two-pass", twoPass / time, maxAngleBetween(reference, normals));
+
+		if (variant.mode == NormalMode::Smoothed)
+		{
+			//Every smoothed variant has to match the scalar kernel exactly, whatever the lanes or bands
+			if (scalarNormals.empty())
+			{
+				scalarNormals = normals;
+			}
+
+			else
+			{
+				bool identical = memcmp(scalarNormals.data(), normals.data(), sizeof(float) * normals.size()) == 0;
+				snprintf(note + length, sizeof(note) - length, ", %s", identical ? "bit-identical to scalar" : "SCALAR MISMATCH");
+			}
+		}
+
+		results.push_back({ variant.name, resolution, time, note });
+	}
+}
+
+void Benchmark::benchmarkDerivativeFBM(TerrainMesh& terrain, int resolution)
+{
+	//The derivative spans against the scalar path and against the plain noise, over a row crossing many cells
+	const int count = 4096;
+	const float dx = 0.0173f;
+	const float y = 37.61f;
+
+	PerlinNoise noise;
+	std::vector<float> values(count), scalar[3], vectorised[3];
+
+	for (int k = 0; k < 3; k++)
+	{
+		scalar[k].resize(count);
+		vectorised[k].resize(count);
+	}
+
+	noise.generateImprovedPerlinSpan(-20.0f, dx, y, count, values.data());
+	noise.setSimdLevel(SimdLevel::Scalar);
+	noise.generateImprovedPerlinDerivativeSpan(-20.0f, dx, y, count, scalar[0].data(), scalar[1].data(), scalar[2].data());
+
+	//A central difference checks the slopes themselves, to within its own error
+	float slopeError = 0.0f;
+	const float h = 1.0f / 1024.0f;
+
+	for (int n = 0; n < count; n++)
+	{
+		float x = -20.0f + (float)n * dx;
+		float differenceX = (noise.generateImprovedPerlin(x + h, y) - noise.generateImprovedPerlin(x - h, y)) / (2.0f * h);
+		float differenceY = (noise.generateImprovedPerlin(x, y + h) - noise.generateImprovedPerlin(x, y - h)) / (2.0f * h);
+
+		slopeError = (std::max)(slopeError, (std::max)(fabsf(differenceX - scalar[1][n]), fabsf(differenceY - scalar[2][n])));
+	}
+
+	//Timed over a whole map like the plain spans, to see what the slope adds to each sample
+	const int runs = runsFor(resolution);
+	const int cells = resolution * resolution;
+	const float frequency = 0.015f;
+
+	std::vector<float> map[3];
+
+	for (int k = 0; k < 3; k++)
+	{
+		map[k].resize(cells);
+	}
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const char* names[] = { "Perlin derivative span (scalar)", "Perlin derivative span (SSE2)", "Perlin derivative span (AVX2)" };
+
+	for (int l = 0; l < 3; l++)
+	{
+		noise.setSimdLevel(levels[l]);
+
+		if (noise.getSimdLevel() != levels[l])
+		{
+			results.push_back({ names[l], resolution, 0.0, "not supported by this CPU" });
+			continue;
+		}
+
+		double plain = timeRuns(runs, []() {}, [&]()
+		{
+			for (int j = 0; j < resolution; j++)
+			{
+				noise.generateImprovedPerlinSpan(0.0f, frequency, (float)j * frequency, resolution, &map[0][j * resolution]);
+			}
+		});
+
+		double time = timeRuns(runs, []() {}, [&]()
+		{
+			for (int j = 0; j < resolution; j++)
+			{
+				noise.generateImprovedPerlinDerivativeSpan(0.0f, frequency, (float)j * frequency, resolution, &map[0][j * resolution], &map[1][j * resolution], &map[2][j * resolution]);
+			}
+		});
+
+		noise.generateImprovedPerlinDerivativeSpan(-20.0f, dx, y, count, vectorised[0].data(), vectorised[1].data(), vectorised[2].data());
+
+		bool identical = true;
+
+		for (int k = 0; k < 3; k++)
+		{
+			identical = identical && memcmp(scalar[k].data(), vectorised[k].data(), sizeof(float) * count) == 0;
+		}
+
+		bool valuesMatch = memcmp(values.data(), vectorised[0].data(), sizeof(float) * count) == 0;
+
+		char note[192];
+		snprintf(note, sizeof(note), "%.2fx the time of the value span, %s, values %s, max slope error %.4f against central differences",
+			time / plain, identical ? "bit-identical to scalar" : "SCALAR MISMATCH", valuesMatch ? "match improved Perlin" : "DIFFER FROM IMPROVED PERLIN", slopeError);
+
+		results.push_back({ names[l], resolution, time, note });
+	}
+
+	//The whole rebuild, noise then normals, with normals differenced from the heights against taken from the slopes
+	//Summing the slopes costs more than the normal pass it saves, so this shows how much the analytic normals cost, not a speedup
+	const float spacing = terrain.getTerrainSize() / (float)resolution;
+
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	terrain.setNormalMode(NormalMode::Smoothed);
+	terrain.Regenerate(device, deviceContext);
+
+	std::vector<float> expected(cells);
+	std::vector<float> differenced(3 * cells);
+	std::vector<float> analytic(3 * cells);
+
+	auto copyNormals = [&](std::vector<float>& normals)
+	{
+		//Each vertex is a position, texture coordinate and normal, 8 floats with the normal last
+		const float* vertices = (const float*)terrain.getVertexData();
+
+		for (int n = 0; n < cells; n++)
+		{
+			memcpy(&normals[n * 3], &vertices[n * 8 + 5], sizeof(float) * 3);
+		}
+	};
+
+	double plain = timeRuns(runs, [&]() { terrain.flatten(); }, [&]()
+	{
+		terrain.generateFBM(8, 0.5f, 1.1f);
+		terrain.Regenerate(device, deviceContext);
+	});
+
+	memcpy(expected.data(), terrain.getHeightMap(), sizeof(float) * cells);
+	copyNormals(differenced);
+
+	double derivative = timeRuns(runs, [&]() { terrain.flatten(); }, [&]()
+	{
+		terrain.generateDerivativeFBM(8, 0.5f, 1.1f);
+		terrain.Regenerate(device, deviceContext);
+	});
+
+	bool identical = memcmp(expected.data(), terrain.getHeightMap(), sizeof(float) * cells) == 0;
+	copyNormals(analytic);
+
+	//Central differences converge on the true slope, so they show how close the analytic normals are, the smoothed ones blur it a little more
+	TerrainNormals generator;
+	generator.setMode(NormalMode::CentralDifference);
+	generator.generate(terrain.getHeightMap(), resolution, spacing, 0, resolution, 0, resolution, differenced.data(), 3);
+
+	char note[192];
+	snprintf(note, sizeof(note), "%.2fx the time of plain FBM, heights %s, normals %.3f degrees from central differences on average (max %.2f)",
+		derivative / plain, identical ? "bit-identical" : "MISMATCH", meanAngleBetween(differenced, analytic), maxAngleBetween(differenced, analytic));
+
+	results.push_back({ "FBM + smoothed normals", resolution, plain, "" });
+	results.push_back({ "Derivative FBM + slope normals", resolution, derivative, note });
+
+	//Eroded terrain differences its normals, so this is the cost of the damping on top of plain FBM
+	double eroded = timeRuns(runs, [&]() { terrain.flatten(); }, [&]()
+	{
+		terrain.generateDerivativeFBM(8, 0.5f, 1.1f, 1.0f);
+		terrain.Regenerate(device, deviceContext);
+	});
+
+	snprintf(note, sizeof(note), "%.2fx the time of plain FBM", eroded / plain);
+	results.push_back({ "Eroded derivative FBM + smoothed normals", resolution, eroded, note });
+}
+
+void Benchmark::benchmarkChunks(TerrainMesh& terrain, int resolution)
+{
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	terrain.flatten();
+	terrain.generateFBM(8, 0.5f, 1.1f);
+
+	//Building every chunk's vertex buffer and bounds from scratch
+	double build = timeRuns(1, []() {}, [&]() { terrain.Regenerate(device, deviceContext); });
+
+	char note[96];
+	snprintf(note, sizeof(note), "%d chunks of %dx%d quads", terrain.getChunkCount(), TerrainMesh::chunkQuads, TerrainMesh::chunkQuads);
+	results.push_back({ "Chunk build", resolution, build, note });
+
+	const XMMATRIX world = XMMatrixIdentity();
+	const XMMATRIX projection = projectionMatrix();
+
+	for (const CameraView& view : views)
+	{
+		XMMATRIX viewMatrix = viewMatrixFor(view);
+
+		//Culling is far quicker than the timer's resolution, so each run is many frames
+		const int frames = 1000;
+		double time = timeRuns(5, []() {}, [&]()
+		{
+			for (int f = 0; f < frames; f++)
+			{
+				terrain.Cull(world, viewMatrix, projection);
+			}
+		}) / (double)frames;
+
+		char name[64];
+		snprintf(name, sizeof(name), "Frustum cull (%s)", view.name);
+		snprintf(note, sizeof(note), "%d of %d chunks visible, %.2f us per frame", terrain.getVisibleChunkCount(), terrain.getChunkCount(), time * 1000.0);
+
+		results.push_back({ name, resolution, time, note });
+	}
+}
+
+void Benchmark::benchmarkLevelsOfDetail(TerrainMesh& terrain, int resolution)
+{
+	terrain.Resize(resolution);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	terrain.flatten();
+	terrain.generateFBM(8, 0.5f, 1.1f);
+
+	//Includes measuring every chunk's error at each level
+	double build = timeRuns(1, []() {}, [&]() { terrain.Regenerate(device, deviceContext); });
+	results.push_back({ "Chunk build with LOD errors", resolution, build, "" });
+
+	const XMMATRIX world = XMMatrixIdentity();
+	const XMMATRIX projection = projectionMatrix();
+	const float pixelsPerUnit = viewportHeight * 0.5f / tanf(XM_PI / 8.0f);
+	const int side = terrain.getChunksPerSide();
+
+	terrain.setLodEnabled(true);
+
+	//The usual views, plus one from far enough back that most of the map can be drawn coarsely
+	std::vector<CameraView> lodViews(std::begin(views), std::end(views));
+	lodViews.push_back({ "distant", XMFLOAT3(50.0f, 50.0f, -90.0f), XMFLOAT3(50.0f, 0.0f, 50.0f) });
+
+	for (const CameraView& view : lodViews)
+	{
+		terrain.Cull(world, viewMatrixFor(view), projection);
+
+		double time = timeRuns(5, []() {}, [&]() { terrain.SelectLevels(device, view.eye, projection, viewportHeight); });
+
+		long long triangles = 0;
+		long long fullTriangles = 0;
+		float maxError = 0.0f;
+		float maxPixels = 0.0f;
+		int mergedDraws = 0;
+
+		//A merged parent draws the same triangles as its chunks would, but also covers any of them off screen
+		for (int d = 0; d < terrain.getDrawnChunkCount(); d++)
+		{
+			triangles += terrain.getChunkIndexCount(d) / 3;
+			mergedDraws += terrain.getDrawnChunk(d).depth > 0 ? 1 : 0;
+		}
+
+		for (int v = 0; v < terrain.getVisibleChunkCount(); v++)
+		{
+			const int c = terrain.getVisibleChunk(v);
+			const TerrainChunk& chunk = terrain.getChunk(c);
+			float error = terrain.getChunkError(c, chunk.level);
+
+			fullTriangles += 2 * (chunk.width - 1) * (chunk.height - 1);
+
+			//The on-screen error, measured from the nearest point of the chunk like the selection does
+			float dx = (std::max)(0.0f, (std::max)(chunk.boundsMin.x - view.eye.x, view.eye.x - chunk.boundsMax.x));
+			float dy = (std::max)(0.0f, (std::max)(chunk.boundsMin.y - view.eye.y, view.eye.y - chunk.boundsMax.y));
+			float dz = (std::max)(0.0f, (std::max)(chunk.boundsMin.z - view.eye.z, view.eye.z - chunk.boundsMax.z));
+			float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+			maxError = (std::max)(maxError, error);
+
+			if (error > 0.0f)
+			{
+				maxPixels = (std::max)(maxPixels, distance > 0.0f ? error * pixelsPerUnit / distance : FLT_MAX);
+			}
+		}
+
+		//Every pair of neighbours has to agree on the vertices along their shared side
+		bool crackFree = true;
+
+		for (int cy = 0; cy < side; cy++)
+		{
+			for (int cx = 0; cx < side; cx++)
+			{
+				const TerrainChunk& chunk = terrain.getChunk(cy * side + cx);
+
+				if (cx + 1 < side)
+				{
+					const TerrainChunk& right = terrain.getChunk(cy * side + cx + 1);
+					int mine = chunk.level + ((chunk.stitchedEdges & TerrainChunk::EdgeMaxX) ? 1 : 0);
+					int theirs = right.level + ((right.stitchedEdges & TerrainChunk::EdgeMinX) ? 1 : 0);
+					crackFree = crackFree && mine == theirs;
+				}
+
+				if (cy + 1 < side)
+				{
+					const TerrainChunk& below = terrain.getChunk((cy + 1) * side + cx);
+					int mine = chunk.level + ((chunk.stitchedEdges & TerrainChunk::EdgeMaxY) ? 1 : 0);
+					int theirs = below.level + ((below.stitchedEdges & TerrainChunk::EdgeMinY) ? 1 : 0);
+					crackFree = crackFree && mine == theirs;
+				}
+			}
+		}
+
+		char name[64];
+		char note[256];
+		snprintf(name, sizeof(name), "LOD selection (%s)", view.name);
+		snprintf(note, sizeof(note), "%lld triangles drawn for %lld visible, %d draws for %d visible chunks (%d merged), max error %.4f units / %.2f pixels (limit %.1f), %s",
+			triangles, fullTriangles, terrain.getDrawnChunkCount(), terrain.getVisibleChunkCount(), mergedDraws, maxError, maxPixels, terrain.getLodPixelError(), crackFree ? "crack-free" : "CRACKS BETWEEN LEVELS");
+
+		std::vector<BenchmarkMetric> metrics = { { "draws", { (double)terrain.getDrawnChunkCount() } }, { "triangles", { (double)triangles } } };
+		results.push_back({ name, resolution, time, note, metrics });
+	}
+}
+
+void Benchmark::benchmarkStreaming(TerrainMesh& terrain)
+{
+	TerrainStreamer streamer;
+	streamer.setFractal(8, 28.0f, 0.015f, 0.5f, 1.1f);
+
+	const int tileVertices = TerrainStreamer::tileVertices;
+	const int padded = TerrainStreamer::paddedVertices;
+
+	//A tile at the origin covers the same vertices as a map of its size, so it should match the terrain's own FBM exactly
+	streamer.Update(device, XMFLOAT3(25.0f, 50.0f, 25.0f));
+	streamer.WaitForPending();
+	streamer.Update(device, XMFLOAT3(25.0f, 50.0f, 25.0f));
+
+	terrain.Resize(tileVertices);
+	terrain.setAmplitude(28.0f);
+	terrain.setFrequency(0.015f);
+	terrain.flatten();
+	terrain.generateFBM(8, 0.5f, 1.1f);
+
+	const TerrainTile* origin = streamer.getTile(0, 0);
+	bool matchesTerrain = origin != nullptr;
+
+	for (int j = 0; matchesTerrain && j < tileVertices; j++)
+	{
+		matchesTerrain = memcmp(&origin->heights[(j + 1) * padded + 1], &terrain.getHeightMap()[j * tileVertices], sizeof(float) * tileVertices) == 0;
+	}
+
+	//Fly across the world at a steady 60 frames a second with a budget too small to keep everything that has been seen
+	const int frames = 300;
+	const auto frameTime = std::chrono::microseconds(16667);
+	const float speed = 60.0f;
+
+	streamer.setMemoryBudget(12 * 1024 * 1024);
+	streamer.ResetStatistics();
+
+	double updateTotal = 0.0;
+	double updateMax = 0.0;
+	double residency = 0.0;
+	size_t peakMemory = 0;
+
+	for (int f = 0; f < frames; f++)
+	{
+		auto frameStart = std::chrono::high_resolution_clock::now();
+
+		//A gentle S-bend, so tiles come into range ahead and to the sides and drop out behind
+		float t = (float)f / 60.0f;
+		XMFLOAT3 eye(25.0f + speed * t, 40.0f, 25.0f + speed * t * 0.5f + 80.0f * sinf(t * 1.2f) * sinf(t * 1.2f));
+		XMFLOAT3 ahead(eye.x + 20.0f, 20.0f, eye.z + 10.0f);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		streamer.Update(device, eye);
+		double update = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		streamer.Cull(XMMatrixIdentity(), viewMatrixFor({ "flythrough", eye, ahead }), projectionMatrix());
+
+		updateTotal += update;
+		updateMax = (std::max)(updateMax, update);
+		residency += streamer.getWantedTileCount() ? (double)streamer.getResidentTileCount() / (double)streamer.getWantedTileCount() : 1.0;
+		peakMemory = (std::max)(peakMemory, streamer.getMemoryUsed());
+
+		std::this_thread::sleep_until(frameStart + frameTime);
+	}
+
+	streamer.WaitForPending();
+
+	//Neighbouring tiles must agree on the three columns (or rows) of heights around their shared edge, which the edge normals are built from
+	const int quads = TerrainStreamer::tileQuads;
+	int edges = 0;
+	bool seamless = true;
+
+	for (int ty = -8; ty < 32; ty++)
+	{
+		for (int tx = -8; tx < 32; tx++)
+		{
+			const TerrainTile* tile = streamer.getTile(tx, ty);
+			const TerrainTile* right = streamer.getTile(tx + 1, ty);
+			const TerrainTile* below = streamer.getTile(tx, ty + 1);
+
+			if (tile && right)
+			{
+				for (int j = 0; j < padded; j++)
+				{
+					seamless = seamless && memcmp(&tile->heights[j * padded + quads], &right->heights[j * padded], sizeof(float) * 3) == 0;
+				}
+
+				edges++;
+			}
+
+			if (tile && below)
+			{
+				seamless = seamless && memcmp(&tile->heights[quads * padded], &below->heights[0], sizeof(float) * padded * 3) == 0;
+				edges++;
+			}
+		}
+	}
+
+	uint64_t lookups = streamer.getCacheHits() + streamer.getCacheMisses();
+
+	//Hits are counted once per tile as it comes into range, residency is how much of what was in range each frame could be drawn
+	char note[384];
+	snprintf(note, sizeof(note), "%llu tiles generated in %.2f ms each, latency %.2f ms average / %.2f ms max, hit rate %.1f%% of %llu requests, %.1f%% resident per frame, %llu evicted, peak %.1f of %.1f MB, worst update %.3f ms, %d shared edges %s",
+		(unsigned long long)streamer.getTilesGenerated(), streamer.getAverageGenerationTime(), streamer.getAverageLatency(), streamer.getMaxLatency(),
+		lookups ? 100.0 * (double)streamer.getCacheHits() / (double)lookups : 0.0, (unsigned long long)lookups, 100.0 * residency / (double)frames, (unsigned long long)streamer.getTilesEvicted(),
+		(double)peakMemory / (1024.0 * 1024.0), (double)streamer.getMemoryBudget() / (1024.0 * 1024.0), updateMax, edges, seamless ? "seamless" : "SEAMS DO NOT MATCH");
+
+	results.push_back({ "Streaming flythrough (update per frame)", tileVertices, updateTotal / (double)frames, note });
+	results.push_back({ "Streaming tile generation", tileVertices, streamer.getAverageGenerationTime(), matchesTerrain ? "bit-identical to TerrainMesh::generateFBM" : "OUTPUT MISMATCH" });
+}
+
+void Benchmark::writeReport(const char* fileName)
+{
+	std::ofstream file(fileName);
+
+	if (!device)
+	{
+		file << "Could not create a Direct3D device, no benchmarks were run\n";
+		return;
+	}
+
+	for (const BenchmarkResult& result : results)
+	{
+		file << result.name << ", " << result.resolution << "x" << result.resolution << ", " << result.milliseconds << " ms";
+
+		if (!result.note.empty())
+		{
+			file << ", " << result.note;
+		}
+
+		file << "\n";
+	}
+}
+
+void Benchmark::writeJsonReport(const char* fileName)
+{
+	std::ofstream file(fileName);
+
+	file << "{\n\t\"device\": " << (device ? "true" : "false") << ",\n\t\"results\": [";
+
+	for (size_t r = 0; r < results.size(); r++)
+	{
+		const BenchmarkResult& result = results[r];
+
+		file << (r ? "," : "") << "\n\t\t{ \"name\": " << jsonString(result.name) << ", \"resolution\": " << result.resolution;
+		file << ", \"milliseconds\": " << jsonNumber(result.milliseconds) << ", \"note\": " << jsonString(result.note) << ", \"metrics\": {";
+
+		for (size_t m = 0; m < result.metrics.size(); m++)
+		{
+			const BenchmarkMetric& metric = result.metrics[m];
+			file << (m ? ", " : " ") << jsonString(metric.name) << ": ";
+
+			if (metric.values.size() == 1)
+			{
+				file << jsonNumber(metric.values[0]);
+				continue;
+			}
+
+			file << "[";
+
+			for (size_t v = 0; v < metric.values.size(); v++)
+			{
+				file << (v ? ", " : "") << jsonNumber(metric.values[v]);
+			}
+
+			file << "]";
+		}
+
+		file << (result.metrics.empty() ? "} }" : " } }");
+	}
+
+	file << "\n\t]\n}\n";
+}
+
+void Benchmark::benchmarkVoxels()
+{
+	//A cold world around a camera on the ground, timed until every chunk in range has been built and uploaded
+	const XMFLOAT3 camera(10.0f, 5.0f, 10.0f);
+	const float viewDistance = 60.0f;
+	const int hardwareThreads = (int)std::thread::hardware_concurrency();
+
+	double singleThreaded = 0.0;
+
+	for (int threads = 1; threads <= 16; threads *= 2)
+	{
+		if (threads > 1 && threads > hardwareThreads)
+		{
+			threads = hardwareThreads;
+
+			if (threads <= 1)
+			{
+				break;
+			}
+		}
+
+		VoxelTerrain voxels(0, threads);
+		voxels.setViewDistance(viewDistance);
+		voxels.setChunksPerUpdate(1 << 20);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		voxels.Update(device, camera);
+
+		//Each Update uploads what the workers finished and queues the next chunks, until nothing in range is left to build
+		while (voxels.getPendingChunkCount() > 0)
+		{
+			voxels.WaitForPending();
+			voxels.Update(device, camera);
+		}
+
+		double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		char name[64];
+		char note[256];
+		snprintf(name, sizeof(name), "Voxel chunks meshed (%d threads)", threads);
+		int length = snprintf(note, sizeof(note), "%.1f chunks/s, %llu chunks of which %llu empty, %.1f ms each, %llu triangles, %.2f MB cached",
+			(double)voxels.getChunksBuilt() * 1000.0 / time, (unsigned long long)voxels.getChunksBuilt(), (unsigned long long)voxels.getEmptyChunksBuilt(),
+			voxels.getAverageBuildTime(), (unsigned long long)voxels.getTrianglesBuilt(), (double)voxels.getMemoryUsed() / (1024.0 * 1024.0));
+
+		if (threads == 1)
+		{
+			singleThreaded = time;
+		}
+
+		else
+		{
+			snprintf(note + length, sizeof(note) - length, ", %.2fx speedup over 1 thread", singleThreaded / time);
+		}
+
+		results.push_back({ name, VoxelTerrain::chunkCells, time, note });
+
+		if (threads == hardwareThreads)
+		{
+			break;
+		}
+	}
+
+	//A block of chunks meshed on the CPU, to check the surface is closed across their borders and faces out of the ground
+	VoxelTerrain voxels;
+	const int blockChunks = 3;
+
+	struct Position
+	{
+		float x, y, z;
+
+		bool operator<(const Position& other) const
+		{
+			return x != other.x ? x < other.x : y != other.y ? y < other.y : z < other.z;
+		}
+	};
+
+	std::map<std::pair<Position, Position>, int> edgeUses;
+	int triangles = 0;
+	int facingOut = 0;
+
+	for (int cz = 0; cz < blockChunks; cz++)
+	{
+		for (int cy = -1; cy < blockChunks - 1; cy++)
+		{
+			for (int cx = 0; cx < blockChunks; cx++)
+			{
+				VoxelChunk chunk;
+				chunk.chunkX = cx;
+				chunk.chunkY = cy;
+				chunk.chunkZ = cz;
+				voxels.BuildChunk(chunk);
+
+				for (size_t n = 0; n + 2 < chunk.indices.size(); n += 3)
+				{
+					const VoxelChunk::Vertex* corners[3] = { &chunk.vertices[chunk.indices[n]], &chunk.vertices[chunk.indices[n + 1]], &chunk.vertices[chunk.indices[n + 2]] };
+
+					//Clockwise is the front, which for corners a, b and c faces along (c - a) x (b - a)
+					XMVECTOR a = XMLoadFloat3(&corners[0]->position);
+					XMVECTOR face = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&corners[2]->position), a), XMVectorSubtract(XMLoadFloat3(&corners[1]->position), a));
+					XMVECTOR normal = XMVectorAdd(XMVectorAdd(XMLoadFloat3(&corners[0]->normal), XMLoadFloat3(&corners[1]->normal)), XMLoadFloat3(&corners[2]->normal));
+
+					facingOut += XMVectorGetX(XMVector3Dot(face, normal)) > 0.0f ? 1 : 0;
+					triangles++;
+
+					for (int e = 0; e < 3; e++)
+					{
+						Position from = { corners[e]->position.x, corners[e]->position.y, corners[e]->position.z };
+						Position to = { corners[(e + 1) % 3]->position.x, corners[(e + 1) % 3]->position.y, corners[(e + 1) % 3]->position.z };
+
+						edgeUses[to < from ? std::make_pair(to, from) : std::make_pair(from, to)]++;
+					}
+				}
+			}
+		}
+	}
+
+	//A closed surface has no edge used by just one triangle, so any that are have to be on the outside of the block
+	//Surface nets can join four triangles along an edge where two pieces of surface touch, which leaves no hole
+	const float chunkSize = voxels.getChunkSize();
+	const float margin = 2.0f * chunkSize / (float)VoxelTerrain::chunkCells;
+	const float blockMin[3] = { margin, -chunkSize + margin, margin };
+	const float blockMax[3] = { blockChunks * chunkSize - margin, (blockChunks - 1) * chunkSize - margin, blockChunks * chunkSize - margin };
+	int openEdges = 0;
+	int sharedEdges = 0;
+
+	for (auto& edge : edgeUses)
+	{
+		const Position& p = edge.first.first;
+		bool inside = p.x > blockMin[0] && p.x < blockMax[0] && p.y > blockMin[1] && p.y < blockMax[1] && p.z > blockMin[2] && p.z < blockMax[2];
+
+		openEdges += (inside && edge.second == 1) ? 1 : 0;
+		sharedEdges += (inside && edge.second > 2) ? 1 : 0;
+	}
+
+	char note[256];
+	snprintf(note, sizeof(note), "%d chunks, %d triangles, %.2f%% facing out of the ground, %d open edges inside the block, %d where surfaces touch",
+		blockChunks * blockChunks * blockChunks, triangles, triangles ? 100.0 * (double)facingOut / (double)triangles : 0.0, openEdges, sharedEdges);
+	results.push_back({ "Voxel surface across chunk borders", VoxelTerrain::chunkCells, 0.0, note });
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "DXF.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class TerrainMesh;
+
+//A named measurement kept in machine readable form, one value for most and a list for things like histograms
+struct BenchmarkMetric
+{
+	std::string name;
+	std::vector<double> values;
+};
+
+struct BenchmarkResult
+{
+	std::string name;	//Which operation was measured
+	int resolution = 0;	//Width and height of the height map it ran on
+	double milliseconds = 0.0;	//Average time taken by a single run
+	std::string note;	//Extra information, such as the speedup or whether outputs matched
+	std::vector<BenchmarkMetric> metrics;	//Values worth tracking between releases, written to the JSON report as they are
+};
+
+//Runs the terrain generation code without a window and writes the timings to a file
+class Benchmark
+{
+public:
+	Benchmark();
+	~Benchmark();
+
+	//Writes a readable report to fileName and, if one is given, the same results as JSON to jsonFileName so runs can be compared by a script
+	void run(const char* fileName, const char* jsonFileName = nullptr);
+
+private:
+	void benchmarkFBM(TerrainMesh& terrain, int resolution);
+	void benchmarkFixedOctaveFBM(TerrainMesh& terrain, int resolution);
+	void benchmarkWarpedFBM(TerrainMesh& terrain, int resolution);
+	void benchmarkNoiseSpan(int resolution);
+	void benchmarkSimplexSpan(int resolution);
+	void benchmarkNoiseSamples(int resolution);
+	void benchmarkNoiseQuality(int resolution);
+	void benchmarkFBMQuality(TerrainMesh& terrain);
+	void benchmarkNoiseRange(int resolution);
+	void benchmarkTileable(TerrainMesh& terrain, int resolution);
+	void benchmarkNoiseTypes(TerrainMesh& terrain, int resolution);
+	void benchmarkWorley(int resolution);
+	void benchmarkThreads(TerrainMesh& terrain, int resolution);
+	void benchmarkWindErosion(TerrainMesh& terrain, int resolution);
+	void benchmarkWindBatches(TerrainMesh& terrain, int resolution);
+	void benchmarkHydraulicErosion(TerrainMesh& terrain, int resolution);
+	void benchmarkDropletErosion(TerrainMesh& terrain, int resolution);
+	void benchmarkThermalErosion(TerrainMesh& terrain, int resolution);
+	void benchmarkIncremental(TerrainMesh& terrain, int resolution);
+	void benchmarkNormals(TerrainMesh& terrain, int resolution);
+	void benchmarkDerivativeFBM(TerrainMesh& terrain, int resolution);
+	void benchmarkChunks(TerrainMesh& terrain, int resolution);
+	void benchmarkLevelsOfDetail(TerrainMesh& terrain, int resolution);
+	void benchmarkStreaming(TerrainMesh& terrain);
+	void benchmarkVoxels();
+
+	//Times run after setup once for every thread count from one up to the core count, checking each height map against one thread's bit for bit
+	//describe(time) starts each note, such as with a rate, checkBaseline(time) adds anything worth checking about the one thread run to its note,
+	//and work is what each run's throughput metrics count
+	void sweepThreads(TerrainMesh& terrain, const std::string& name, int resolution, int runs, const std::function<void()>& setup, const std::function<void()>& run, double work,
+		const std::function<std::string(double)>& describe = nullptr, const std::function<std::string(double)>& checkBaseline = nullptr);
+
+	void writeReport(const char* fileName);
+	void writeJsonReport(const char* fileName);
+
+	ID3D11Device* device = nullptr;
+	ID3D11DeviceContext* deviceContext = nullptr;
+
+	std::vector<BenchmarkResult> results;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <intrin.h>
+
+//The widest vector instruction set a batch kernel is allowed to use
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,	//4 floats at a time
+	AVX2	//8 floats at a time
+};
+
+class CpuFeatures
+{
+public:
+	//Detection only runs once, the result is kept for every later call
+	static const inline SimdLevel bestSimdLevel()
+	{
+		static const SimdLevel level = detectSimdLevel();
+
+		return level;
+	}
+
+	//Never hand back a level higher than the CPU actually supports
+	static const inline SimdLevel clampSimdLevel(SimdLevel requested)
+	{
+		return (int)requested > (int)bestSimdLevel() ? bestSimdLevel() : requested;
+	}
+
+private:
+	static SimdLevel detectSimdLevel()
+	{
+		int info[4];
+
+		__cpuid(info, 0);
+		int highestLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		if (!sse2)
+		{
+			return SimdLevel::Scalar;
+		}
+
+		//The operating system also has to preserve the 256-bit registers when switching threads
+		if (highestLeaf < 7 || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		{
+			return SimdLevel::SSE2;
+		}
+
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+
+		return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+	}
+};
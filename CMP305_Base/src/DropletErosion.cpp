@@ -0,0 +1,248 @@
+#include "DropletErosion.h"
+
+#include <cmath>
+
+#include "MathsUtils.h"
+
+static inline float minimum(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static inline float maximum(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+//Takes amount off a cell's ground, loose sediment first
+static inline void wear(float* heightMap, float* sedimentMap, int index, float amount)
+{
+	float taken = minimum(amount, maximum(sedimentMap[index], 0.0f));
+
+	sedimentMap[index] -= taken;
+	heightMap[index] -= amount - taken;
+}
+
+DropletErosion::DropletErosion(int resolution, const DropletSettings& settings) :
+	resolution(resolution),
+	settings(settings)
+{
+	this->settings.radius = MathsUtils::clamp(settings.radius, 1, maxRadius);
+
+	//Every cell closer than the radius to the centre, weighted by how much closer
+	const int radius = this->settings.radius;
+	float total = 0.0f;
+
+	for (int y = -radius; y <= radius; y++)
+	{
+		for (int x = -radius; x <= radius; x++)
+		{
+			float distance = sqrtf((float)(x * x + y * y));
+
+			if (distance < (float)radius)
+			{
+				brushX.push_back(x);
+				brushY.push_back(y);
+				brushOffsets.push_back(y * resolution + x);
+				brushWeights.push_back((float)radius - distance);
+
+				total += (float)radius - distance;
+			}
+		}
+	}
+
+	for (float& weight : brushWeights)
+	{
+		weight /= total;
+	}
+}
+
+DropletErosion::~DropletErosion()
+{
+}
+
+Droplet DropletErosion::launch(float x, float y) const
+{
+	Droplet droplet;
+	droplet.positionX = x;
+	droplet.positionY = y;
+	droplet.speed = settings.startSpeed;
+	droplet.water = settings.startWater;
+
+	return droplet;
+}
+
+void DropletErosion::fly(float* heightMap, float* sedimentMap, Droplet& droplet) const
+{
+	flyWithin(heightMap, sedimentMap, droplet, XMINT2(0, 0), XMINT2(resolution, resolution));
+}
+
+bool DropletErosion::flyWithin(float* heightMap, float* sedimentMap, Droplet& droplet, XMINT2 regionMin, XMINT2 regionMax) const
+{
+	const int reach = getReach();
+
+	while (droplet.steps < settings.lifetime)
+	{
+		const int cellX = (int)droplet.positionX;
+		const int cellY = (int)droplet.positionY;
+
+		bool outside = (regionMin.x > 0 && cellX - reach < regionMin.x) || (regionMax.x < resolution && cellX + reach >= regionMax.x) ||
+			(regionMin.y > 0 && cellY - reach < regionMin.y) || (regionMax.y < resolution && cellY + reach >= regionMax.y);
+
+		if (outside)
+		{
+			return true;
+		}
+
+		float slopeX, slopeY;
+		float height = sampleGround(heightMap, sedimentMap, droplet.positionX, droplet.positionY, slopeX, slopeY);
+
+		//Turns downhill, held back by its inertia, and always moves one cell's length
+		float directionX = droplet.directionX * settings.inertia - slopeX * (1.0f - settings.inertia);
+		float directionY = droplet.directionY * settings.inertia - slopeY * (1.0f - settings.inertia);
+		float length = sqrtf((directionX * directionX) + (directionY * directionY));
+
+		//Sitting in a perfectly flat hollow, it has nowhere to go
+		if (length == 0.0f)
+		{
+			break;
+		}
+
+		directionX /= length;
+		directionY /= length;
+
+		float x = droplet.positionX + directionX;
+		float y = droplet.positionY + directionY;
+
+		//Run off the map, carrying its sediment away with it
+		if (x < 0.0f || y < 0.0f || x >= (float)(resolution - 1) || y >= (float)(resolution - 1))
+		{
+			return false;
+		}
+
+		float unused;
+		float drop = sampleGround(heightMap, sedimentMap, x, y, unused, unused) - height;
+
+		//A faster, fuller droplet going further downhill can carry more
+		float capacity = maximum(-drop * droplet.speed * droplet.water * settings.capacity, settings.minimumCapacity);
+
+		if (droplet.sediment > capacity || drop > 0.0f)
+		{
+			//Climbing, it fills in the hollow behind it as far as it can, otherwise it drops part of what it cannot carry
+			float amount = drop > 0.0f ? minimum(drop, droplet.sediment) : (droplet.sediment - capacity) * settings.deposition;
+
+			deposit(sedimentMap, droplet, amount);
+		}
+
+		else
+		{
+			//Never wears away more than the drop, or it would dig a pit behind itself
+			float amount = minimum((capacity - droplet.sediment) * settings.erosion, -drop);
+
+			droplet.sediment += erode(heightMap, sedimentMap, cellX, cellY, amount);
+		}
+
+		droplet.speed = sqrtf(maximum((droplet.speed * droplet.speed) - drop * settings.gravity, 0.0f));
+		droplet.water *= 1.0f - settings.evaporation;
+
+		droplet.positionX = x;
+		droplet.positionY = y;
+		droplet.directionX = directionX;
+		droplet.directionY = directionY;
+		droplet.steps++;
+	}
+
+	//Whatever it still carries is left where it stopped
+	deposit(sedimentMap, droplet, droplet.sediment);
+
+	return false;
+}
+
+float DropletErosion::sampleGround(const float* heightMap, const float* sedimentMap, float x, float y, float& slopeX, float& slopeY) const
+{
+	const int cellX = (int)x;
+	const int cellY = (int)y;
+	const int index = cellY * resolution + cellX;
+
+	const float offsetX = x - (float)cellX;
+	const float offsetY = y - (float)cellY;
+
+	float ground00 = heightMap[index] + sedimentMap[index];
+	float ground10 = heightMap[index + 1] + sedimentMap[index + 1];
+	float ground01 = heightMap[index + resolution] + sedimentMap[index + resolution];
+	float ground11 = heightMap[index + resolution + 1] + sedimentMap[index + resolution + 1];
+
+	slopeX = (ground10 - ground00) * (1.0f - offsetY) + (ground11 - ground01) * offsetY;
+	slopeY = (ground01 - ground00) * (1.0f - offsetX) + (ground11 - ground10) * offsetX;
+
+	return (ground00 * (1.0f - offsetX) + ground10 * offsetX) * (1.0f - offsetY) + (ground01 * (1.0f - offsetX) + ground11 * offsetX) * offsetY;
+}
+
+void DropletErosion::deposit(float* sedimentMap, Droplet& droplet, float amount) const
+{
+	const int cellX = (int)droplet.positionX;
+	const int cellY = (int)droplet.positionY;
+	const int index = cellY * resolution + cellX;
+
+	const float offsetX = droplet.positionX - (float)cellX;
+	const float offsetY = droplet.positionY - (float)cellY;
+
+	sedimentMap[index] += amount * (1.0f - offsetX) * (1.0f - offsetY);
+	sedimentMap[index + 1] += amount * offsetX * (1.0f - offsetY);
+	sedimentMap[index + resolution] += amount * (1.0f - offsetX) * offsetY;
+	sedimentMap[index + resolution + 1] += amount * offsetX * offsetY;
+
+	droplet.sediment -= amount;
+}
+
+float DropletErosion::erode(float* heightMap, float* sedimentMap, int cellX, int cellY, float amount) const
+{
+	const int radius = settings.radius;
+	const int centre = cellY * resolution + cellX;
+	const int cells = (int)brushOffsets.size();
+
+	float taken = 0.0f;
+
+	if (cellX >= radius && cellY >= radius && cellX + radius < resolution && cellY + radius < resolution)
+	{
+		for (int b = 0; b < cells; b++)
+		{
+			float share = amount * brushWeights[b];
+
+			wear(heightMap, sedimentMap, centre + brushOffsets[b], share);
+			taken += share;
+		}
+
+		return taken;
+	}
+
+	//Near the edge of the map the brush loses the cells off it, and the ones left share the whole amount
+	float total = 0.0f;
+
+	for (int b = 0; b < cells; b++)
+	{
+		int x = cellX + brushX[b];
+		int y = cellY + brushY[b];
+
+		if (x >= 0 && y >= 0 && x < resolution && y < resolution)
+		{
+			total += brushWeights[b];
+		}
+	}
+
+	for (int b = 0; b < cells; b++)
+	{
+		int x = cellX + brushX[b];
+		int y = cellY + brushY[b];
+
+		if (x >= 0 && y >= 0 && x < resolution && y < resolution)
+		{
+			float share = amount * (brushWeights[b] / total);
+
+			wear(heightMap, sedimentMap, centre + brushOffsets[b], share);
+			taken += share;
+		}
+	}
+
+	return taken;
+}
\ No newline at end of file
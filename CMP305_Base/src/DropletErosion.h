@@ -0,0 +1,80 @@
+#pragma once
+
+#include "DXF.h"
+#include <vector>
+
+//How the droplets behave, in height map cells and heights
+struct DropletSettings
+{
+	int radius = 3;	//Cells around a droplet its erosion is spread over, up to maxRadius
+	int lifetime = 30;	//Steps a droplet takes before it is dropped, whatever it still carries
+	float inertia = 0.05f;	//How much a droplet keeps going the way it was, rather than turning straight downhill
+	float capacity = 4.0f;	//Sediment a droplet can carry for each unit of height it drops, at unit speed and water
+	float minimumCapacity = 0.01f;	//Droplets on flat ground still carry a little, or they would drop everything at once
+	float erosion = 0.3f;	//Fraction of the spare capacity worn away each step
+	float deposition = 0.3f;	//Fraction of the excess sediment dropped each step
+	float evaporation = 0.01f;	//Fraction of the water lost each step
+	float gravity = 4.0f;	//Speeds droplets up as they drop and slows them as they climb
+	float startSpeed = 1.0f;
+	float startWater = 1.0f;
+};
+
+//A droplet part way through its life, so one DropletErosion can run any number of them and a droplet can be paused and carried on later
+struct Droplet
+{
+	float positionX = 0.0f;
+	float positionY = 0.0f;
+	float directionX = 0.0f;
+	float directionY = 0.0f;
+	float speed = 1.0f;
+	float water = 1.0f;
+	float sediment = 0.0f;
+	int steps = 0;
+};
+
+//Rain droplet erosion, where each droplet runs downhill from where it lands, wearing the ground away where it has room for more sediment
+//and dropping what it carries where it slows down or has to climb
+//Heights and slopes are blended from the four cells around a droplet, it deposits onto those four cells and erodes a brush of the cells around its own
+//The brush is worked out once for the radius and the map's width, as offsets into the maps and weights, so a step only has to look them up
+//The ground is the height map plus the loose sediment on it, droplets wear the loose sediment away first and drop what they carry back onto it
+class DropletErosion
+{
+public:
+	DropletErosion(int resolution, const DropletSettings& settings);
+	~DropletErosion();
+
+	//A droplet landing at a point on the map, with the settings' speed and water
+	Droplet launch(float x, float y) const;
+
+	//Runs a droplet until its lifetime is up, leaving whatever it still carries where it stops, or until it runs off the map and takes it away
+	void fly(float* heightMap, float* sedimentMap, Droplet& droplet) const;
+
+	//Runs a droplet the way fly does until it finishes, returning false, or until its next step would touch a cell outside the cells
+	//from regionMin up to but not including regionMax, returning true with the droplet left as it was before that step
+	//Sides of the region on or past the edge of the map are not checked, droplets stop there as they do in fly
+	//A step only touches cells within getReach of the cell the droplet starts it in, so droplets in regions that do not overlap can run at the same time
+	bool flyWithin(float* heightMap, float* sedimentMap, Droplet& droplet, XMINT2 regionMin, XMINT2 regionMax) const;
+
+	int getReach() const { return settings.radius + 1; }
+
+	static const int maxRadius = 16;
+
+private:
+	//The ground at a point blended from the four cells around it, with its slope along each axis
+	float sampleGround(const float* heightMap, const float* sedimentMap, float x, float y, float& slopeX, float& slopeY) const;
+
+	//Drops amount of the droplet's sediment onto the four cells around it, blended by where it is between them
+	void deposit(float* sedimentMap, Droplet& droplet, float amount) const;
+
+	//Wears amount away from the brush around a cell, returning what was taken so the droplet carries exactly that
+	float erode(float* heightMap, float* sedimentMap, int cellX, int cellY, float amount) const;
+
+	int resolution;
+	DropletSettings settings;
+
+	//The cells of the brush, as offsets from its centre along each axis and in the maps, with weights falling off to the edge and adding up to one
+	std::vector<int> brushX;
+	std::vector<int> brushY;
+	std::vector<int> brushOffsets;
+	std::vector<float> brushWeights;
+};
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "DXF.h"
+
+//The six planes bounding what a camera can see, used to skip anything that lies completely outside them
+class Frustum
+{
+public:
+	Frustum() {}
+
+	//Pulls the planes out of the combined world, view and projection matrix (Gribb and Hartmann's method)
+	Frustum(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection)
+	{
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, XMMatrixMultiply(XMMatrixMultiply(world, view), projection));
+
+		//DirectX multiplies row vectors, so each plane is built from the columns of the matrix
+		for (int axis = 0; axis < 3; axis++)
+		{
+			planes[axis * 2] = XMFLOAT4(m.m[0][3] + m.m[0][axis], m.m[1][3] + m.m[1][axis], m.m[2][3] + m.m[2][axis], m.m[3][3] + m.m[3][axis]);
+			planes[axis * 2 + 1] = XMFLOAT4(m.m[0][3] - m.m[0][axis], m.m[1][3] - m.m[1][axis], m.m[2][3] - m.m[2][axis], m.m[3][3] - m.m[3][axis]);
+		}
+
+		//Direct3D clips depth to [0, w] rather than [-w, w], so the near plane is just the z column
+		planes[4] = XMFLOAT4(m.m[0][2], m.m[1][2], m.m[2][2], m.m[3][2]);
+	}
+
+	//False only when the box is certainly outside, boxes near a corner may still pass
+	bool intersects(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax) const
+	{
+		for (const XMFLOAT4& plane : planes)
+		{
+			//Test the corner furthest along the plane's normal, if even that is behind the plane so is the whole box
+			float x = plane.x >= 0.0f ? boundsMax.x : boundsMin.x;
+			float y = plane.y >= 0.0f ? boundsMax.y : boundsMin.y;
+			float z = plane.z >= 0.0f ? boundsMax.z : boundsMin.z;
+
+			if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+private:
+	XMFLOAT4 planes[6];	//Left, right, bottom, top, near, far
+};
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "HydraulicErosion.h"
+
+#include <cmath>
+#include <emmintrin.h>
+
+//Water shallower than this is treated as still, rather than dividing its flow by almost nothing
+static const float minimumDepth = 0.001f;
+
+//The same comparisons _mm_min_ps and _mm_max_ps make, so the scalar and vector passes agree to the bit
+static inline float minimum(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static inline float maximum(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+HydraulicErosion::HydraulicErosion(int resolution, const HydraulicSettings& settings) :
+	resolution(resolution),
+	settings(settings)
+{
+	const size_t cells = (size_t)resolution * resolution;
+
+	water.assign(cells, settings.rain * settings.timeStep);
+
+	for (std::vector<float>* grid : { &fluxLeft, &fluxRight, &fluxBack, &fluxForward, &tilt, &concentration, &suspended, &transported })
+	{
+		grid->assign(cells, 0.0f);
+	}
+}
+
+HydraulicErosion::~HydraulicErosion()
+{
+}
+
+void HydraulicErosion::outflow(const float* heightMap, const float* sedimentMap, int rowStart, int rowEnd)
+{
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		int i = 1;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			i = outflowRowSSE2(heightMap, sedimentMap, j);
+		}
+
+		outflowCell(heightMap, sedimentMap, 0, j);
+
+		for (; i < resolution; i++)
+		{
+			outflowCell(heightMap, sedimentMap, i, j);
+		}
+	}
+}
+
+void HydraulicErosion::transport(int rowStart, int rowEnd)
+{
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		int i = 1;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			i = transportRowSSE2(j);
+		}
+
+		transportCell(0, j);
+
+		for (; i < resolution; i++)
+		{
+			transportCell(i, j);
+		}
+	}
+}
+
+void HydraulicErosion::erode(float* heightMap, float* sedimentMap, int rowStart, int rowEnd)
+{
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		int i = 1;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			i = erodeRowSSE2(heightMap, sedimentMap, j);
+		}
+
+		erodeCell(heightMap, sedimentMap, 0, j);
+
+		for (; i < resolution; i++)
+		{
+			erodeCell(heightMap, sedimentMap, i, j);
+		}
+	}
+}
+
+void HydraulicErosion::settle(float* sedimentMap, int rowStart, int rowEnd) const
+{
+	for (int index = rowStart * resolution; index < rowEnd * resolution; index++)
+	{
+		sedimentMap[index] += suspended[index];
+	}
+}
+
+void HydraulicErosion::outflowCell(const float* heightMap, const float* sedimentMap, int i, int j)
+{
+	const int index = (j * resolution) + i;
+
+	//A neighbour off the edge of the map is the cell itself, so it has no slope to it and its pipe is closed below
+	const int left = i > 0 ? index - 1 : index;
+	const int right = i < resolution - 1 ? index + 1 : index;
+	const int back = j > 0 ? index - resolution : index;
+	const int forward = j < resolution - 1 ? index + resolution : index;
+
+	const float ground = heightMap[index] + sedimentMap[index];
+	const float groundLeft = heightMap[left] + sedimentMap[left];
+	const float groundRight = heightMap[right] + sedimentMap[right];
+	const float groundBack = heightMap[back] + sedimentMap[back];
+	const float groundForward = heightMap[forward] + sedimentMap[forward];
+
+	const float depth = water[index];
+	const float surface = ground + depth;
+	const float pipe = settings.timeStep * settings.gravity;
+
+	//Each pipe's flow is sped up by the drop in water surface along it, but never runs backwards
+	float outLeft = i > 0 ? maximum(fluxLeft[index] + pipe * (surface - (groundLeft + water[left])), 0.0f) : 0.0f;
+	float outRight = i < resolution - 1 ? maximum(fluxRight[index] + pipe * (surface - (groundRight + water[right])), 0.0f) : 0.0f;
+	float outBack = j > 0 ? maximum(fluxBack[index] + pipe * (surface - (groundBack + water[back])), 0.0f) : 0.0f;
+	float outForward = j < resolution - 1 ? maximum(fluxForward[index] + pipe * (surface - (groundForward + water[forward])), 0.0f) : 0.0f;
+
+	//A cell cannot lose more water in a step than it holds
+	float needed = (((outLeft + outRight) + outBack) + outForward) * settings.timeStep;
+	float scale = needed > depth ? depth / needed : 1.0f;
+
+	fluxLeft[index] = outLeft * scale;
+	fluxRight[index] = outRight * scale;
+	fluxBack[index] = outBack * scale;
+	fluxForward[index] = outForward * scale;
+
+	//Worked out here while the ground is still as it was, erode changes it
+	float slopeX = (groundRight - groundLeft) * 0.5f;
+	float slopeY = (groundForward - groundBack) * 0.5f;
+	float steepness = (slopeX * slopeX) + (slopeY * slopeY);
+
+	tilt[index] = maximum(sqrtf(steepness / (1.0f + steepness)), settings.minimumTilt);
+
+	//The sediment is spread evenly through the water, so each pipe takes the same share of it as of the water
+	concentration[index] = depth > 0.0f ? (suspended[index] * settings.timeStep) / depth : 0.0f;
+}
+
+void HydraulicErosion::transportCell(int i, int j)
+{
+	const int index = (j * resolution) + i;
+
+	float leaving = (((fluxLeft[index] + fluxRight[index]) + fluxBack[index]) + fluxForward[index]) * concentration[index];
+
+	float fromLeft = i > 0 ? fluxRight[index - 1] * concentration[index - 1] : 0.0f;
+	float fromRight = i < resolution - 1 ? fluxLeft[index + 1] * concentration[index + 1] : 0.0f;
+	float fromBack = j > 0 ? fluxForward[index - resolution] * concentration[index - resolution] : 0.0f;
+	float fromForward = j < resolution - 1 ? fluxBack[index + resolution] * concentration[index + resolution] : 0.0f;
+
+	transported[index] = (suspended[index] - leaving) + (((fromLeft + fromRight) + fromBack) + fromForward);
+}
+
+void HydraulicErosion::erodeCell(float* heightMap, float* sedimentMap, int i, int j)
+{
+	const int index = (j * resolution) + i;
+
+	float fromLeft = i > 0 ? fluxRight[index - 1] : 0.0f;
+	float fromRight = i < resolution - 1 ? fluxLeft[index + 1] : 0.0f;
+	float fromBack = j > 0 ? fluxForward[index - resolution] : 0.0f;
+	float fromForward = j < resolution - 1 ? fluxBack[index + resolution] : 0.0f;
+
+	float inflow = ((fromLeft + fromRight) + fromBack) + fromForward;
+	float outflow = ((fluxLeft[index] + fluxRight[index]) + fluxBack[index]) + fluxForward[index];
+
+	float depth = water[index];
+	float newDepth = maximum(depth + settings.timeStep * (inflow - outflow), 0.0f);
+	float meanDepth = (depth + newDepth) * 0.5f;
+
+	//The water passing through the cell along each axis, divided by its depth for how fast it is going
+	float flowX = ((fromLeft - fluxLeft[index]) + (fluxRight[index] - fromRight)) * 0.5f;
+	float flowY = ((fromBack - fluxBack[index]) + (fluxForward[index] - fromForward)) * 0.5f;
+	float u = meanDepth > minimumDepth ? flowX / meanDepth : 0.0f;
+	float v = meanDepth > minimumDepth ? flowY / meanDepth : 0.0f;
+
+	//Faster water down a steeper slope can carry more, it picks up what it has room for and drops what it has too much of
+	float capacity = settings.capacity * tilt[index] * sqrtf((u * u) + (v * v));
+	float carried = transported[index];
+	float change = capacity > carried ? settings.dissolving * (capacity - carried) : settings.deposition * (capacity - carried);
+
+	//Loose sediment is worn away before the ground under it, and dropped sediment joins it
+	float loose = sedimentMap[index];
+	float taken = change > 0.0f ? minimum(change, maximum(loose, 0.0f)) : change;
+
+	sedimentMap[index] = loose - taken;
+	heightMap[index] -= change - taken;
+	suspended[index] = carried + change;
+
+	water[index] = newDepth * (1.0f - settings.evaporation * settings.timeStep) + settings.rain * settings.timeStep;
+}
+
+//The vector kernels repeat the cell passes operation for operation, so they give the same results
+
+static inline __m128 selectSSE2(__m128 mask, __m128 whenSet, __m128 otherwise)
+{
+	return _mm_or_ps(_mm_and_ps(mask, whenSet), _mm_andnot_ps(mask, otherwise));
+}
+
+int HydraulicErosion::outflowRowSSE2(const float* heightMap, const float* sedimentMap, int j)
+{
+	const int row = j * resolution;
+	const int back = j > 0 ? row - resolution : row;
+	const int forward = j < resolution - 1 ? row + resolution : row;
+
+	//The back and forward pipes of the first and last rows are closed
+	const __m128 hasBack = _mm_castsi128_ps(_mm_set1_epi32(j > 0 ? -1 : 0));
+	const __m128 hasForward = _mm_castsi128_ps(_mm_set1_epi32(j < resolution - 1 ? -1 : 0));
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 step = _mm_set1_ps(settings.timeStep);
+	const __m128 pipe = _mm_set1_ps(settings.timeStep * settings.gravity);
+	const __m128 minimumTilt = _mm_set1_ps(settings.minimumTilt);
+
+	int i = 1;
+
+	for (; i + 4 <= resolution - 1; i += 4)
+	{
+		const int index = row + i;
+
+		__m128 ground = _mm_add_ps(_mm_loadu_ps(&heightMap[index]), _mm_loadu_ps(&sedimentMap[index]));
+		__m128 groundLeft = _mm_add_ps(_mm_loadu_ps(&heightMap[index - 1]), _mm_loadu_ps(&sedimentMap[index - 1]));
+		__m128 groundRight = _mm_add_ps(_mm_loadu_ps(&heightMap[index + 1]), _mm_loadu_ps(&sedimentMap[index + 1]));
+		__m128 groundBack = _mm_add_ps(_mm_loadu_ps(&heightMap[back + i]), _mm_loadu_ps(&sedimentMap[back + i]));
+		__m128 groundForward = _mm_add_ps(_mm_loadu_ps(&heightMap[forward + i]), _mm_loadu_ps(&sedimentMap[forward + i]));
+
+		__m128 depth = _mm_loadu_ps(&water[index]);
+		__m128 surface = _mm_add_ps(ground, depth);
+
+		__m128 outLeft = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(&fluxLeft[index]), _mm_mul_ps(pipe, _mm_sub_ps(surface, _mm_add_ps(groundLeft, _mm_loadu_ps(&water[index - 1]))))), zero);
+		__m128 outRight = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(&fluxRight[index]), _mm_mul_ps(pipe, _mm_sub_ps(surface, _mm_add_ps(groundRight, _mm_loadu_ps(&water[index + 1]))))), zero);
+		__m128 outBack = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(&fluxBack[index]), _mm_mul_ps(pipe, _mm_sub_ps(surface, _mm_add_ps(groundBack, _mm_loadu_ps(&water[back + i]))))), zero);
+		__m128 outForward = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(&fluxForward[index]), _mm_mul_ps(pipe, _mm_sub_ps(surface, _mm_add_ps(groundForward, _mm_loadu_ps(&water[forward + i]))))), zero);
+
+		outBack = _mm_and_ps(hasBack, outBack);
+		outForward = _mm_and_ps(hasForward, outForward);
+
+		__m128 needed = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(outLeft, outRight), outBack), outForward), step);
+		__m128 scale = selectSSE2(_mm_cmpgt_ps(needed, depth), _mm_div_ps(depth, needed), one);
+
+		_mm_storeu_ps(&fluxLeft[index], _mm_mul_ps(outLeft, scale));
+		_mm_storeu_ps(&fluxRight[index], _mm_mul_ps(outRight, scale));
+		_mm_storeu_ps(&fluxBack[index], _mm_mul_ps(outBack, scale));
+		_mm_storeu_ps(&fluxForward[index], _mm_mul_ps(outForward, scale));
+
+		__m128 slopeX = _mm_mul_ps(_mm_sub_ps(groundRight, groundLeft), half);
+		__m128 slopeY = _mm_mul_ps(_mm_sub_ps(groundForward, groundBack), half);
+		__m128 steepness = _mm_add_ps(_mm_mul_ps(slopeX, slopeX), _mm_mul_ps(slopeY, slopeY));
+
+		_mm_storeu_ps(&tilt[index], _mm_max_ps(_mm_sqrt_ps(_mm_div_ps(steepness, _mm_add_ps(one, steepness))), minimumTilt));
+
+		__m128 wet = _mm_cmpgt_ps(depth, zero);
+		_mm_storeu_ps(&concentration[index], _mm_and_ps(wet, _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&suspended[index]), step), depth)));
+	}
+
+	return i;
+}
+
+int HydraulicErosion::transportRowSSE2(int j)
+{
+	const int row = j * resolution;
+	const int back = j > 0 ? row - resolution : row;
+	const int forward = j < resolution - 1 ? row + resolution : row;
+
+	const __m128 hasBack = _mm_castsi128_ps(_mm_set1_epi32(j > 0 ? -1 : 0));
+	const __m128 hasForward = _mm_castsi128_ps(_mm_set1_epi32(j < resolution - 1 ? -1 : 0));
+
+	int i = 1;
+
+	for (; i + 4 <= resolution - 1; i += 4)
+	{
+		const int index = row + i;
+
+		__m128 outflow = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(&fluxLeft[index]), _mm_loadu_ps(&fluxRight[index])), _mm_loadu_ps(&fluxBack[index])), _mm_loadu_ps(&fluxForward[index]));
+		__m128 leaving = _mm_mul_ps(outflow, _mm_loadu_ps(&concentration[index]));
+
+		__m128 fromLeft = _mm_mul_ps(_mm_loadu_ps(&fluxRight[index - 1]), _mm_loadu_ps(&concentration[index - 1]));
+		__m128 fromRight = _mm_mul_ps(_mm_loadu_ps(&fluxLeft[index + 1]), _mm_loadu_ps(&concentration[index + 1]));
+		__m128 fromBack = _mm_and_ps(hasBack, _mm_mul_ps(_mm_loadu_ps(&fluxForward[back + i]), _mm_loadu_ps(&concentration[back + i])));
+		__m128 fromForward = _mm_and_ps(hasForward, _mm_mul_ps(_mm_loadu_ps(&fluxBack[forward + i]), _mm_loadu_ps(&concentration[forward + i])));
+
+		__m128 arriving = _mm_add_ps(_mm_add_ps(_mm_add_ps(fromLeft, fromRight), fromBack), fromForward);
+
+		_mm_storeu_ps(&transported[index], _mm_add_ps(_mm_sub_ps(_mm_loadu_ps(&suspended[index]), leaving), arriving));
+	}
+
+	return i;
+}
+
+int HydraulicErosion::erodeRowSSE2(float* heightMap, float* sedimentMap, int j)
+{
+	const int row = j * resolution;
+	const int back = j > 0 ? row - resolution : row;
+	const int forward = j < resolution - 1 ? row + resolution : row;
+
+	const __m128 hasBack = _mm_castsi128_ps(_mm_set1_epi32(j > 0 ? -1 : 0));
+	const __m128 hasForward = _mm_castsi128_ps(_mm_set1_epi32(j < resolution - 1 ? -1 : 0));
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 step = _mm_set1_ps(settings.timeStep);
+	const __m128 shallowest = _mm_set1_ps(minimumDepth);
+	const __m128 capacityScale = _mm_set1_ps(settings.capacity);
+	const __m128 dissolving = _mm_set1_ps(settings.dissolving);
+	const __m128 deposition = _mm_set1_ps(settings.deposition);
+	const __m128 keep = _mm_set1_ps(1.0f - settings.evaporation * settings.timeStep);
+	const __m128 rainfall = _mm_set1_ps(settings.rain * settings.timeStep);
+
+	int i = 1;
+
+	for (; i + 4 <= resolution - 1; i += 4)
+	{
+		const int index = row + i;
+
+		__m128 left = _mm_loadu_ps(&fluxLeft[index]);
+		__m128 right = _mm_loadu_ps(&fluxRight[index]);
+		__m128 backward = _mm_loadu_ps(&fluxBack[index]);
+		__m128 onward = _mm_loadu_ps(&fluxForward[index]);
+
+		__m128 fromLeft = _mm_loadu_ps(&fluxRight[index - 1]);
+		__m128 fromRight = _mm_loadu_ps(&fluxLeft[index + 1]);
+		__m128 fromBack = _mm_and_ps(hasBack, _mm_loadu_ps(&fluxForward[back + i]));
+		__m128 fromForward = _mm_and_ps(hasForward, _mm_loadu_ps(&fluxBack[forward + i]));
+
+		__m128 inflow = _mm_add_ps(_mm_add_ps(_mm_add_ps(fromLeft, fromRight), fromBack), fromForward);
+		__m128 outflow = _mm_add_ps(_mm_add_ps(_mm_add_ps(left, right), backward), onward);
+
+		__m128 depth = _mm_loadu_ps(&water[index]);
+		__m128 newDepth = _mm_max_ps(_mm_add_ps(depth, _mm_mul_ps(step, _mm_sub_ps(inflow, outflow))), zero);
+		__m128 meanDepth = _mm_mul_ps(_mm_add_ps(depth, newDepth), half);
+
+		__m128 flowX = _mm_mul_ps(_mm_add_ps(_mm_sub_ps(fromLeft, left), _mm_sub_ps(right, fromRight)), half);
+		__m128 flowY = _mm_mul_ps(_mm_add_ps(_mm_sub_ps(fromBack, backward), _mm_sub_ps(onward, fromForward)), half);
+		__m128 deep = _mm_cmpgt_ps(meanDepth, shallowest);
+		__m128 u = _mm_and_ps(deep, _mm_div_ps(flowX, meanDepth));
+		__m128 v = _mm_and_ps(deep, _mm_div_ps(flowY, meanDepth));
+
+		__m128 capacity = _mm_mul_ps(_mm_mul_ps(capacityScale, _mm_loadu_ps(&tilt[index])), _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v))));
+		__m128 carried = _mm_loadu_ps(&transported[index]);
+		__m128 spare = _mm_sub_ps(capacity, carried);
+		__m128 change = selectSSE2(_mm_cmpgt_ps(capacity, carried), _mm_mul_ps(dissolving, spare), _mm_mul_ps(deposition, spare));
+
+		__m128 loose = _mm_loadu_ps(&sedimentMap[index]);
+		__m128 taken = selectSSE2(_mm_cmpgt_ps(change, zero), _mm_min_ps(change, _mm_max_ps(loose, zero)), change);
+
+		_mm_storeu_ps(&sedimentMap[index], _mm_sub_ps(loose, taken));
+		_mm_storeu_ps(&heightMap[index], _mm_sub_ps(_mm_loadu_ps(&heightMap[index]), _mm_sub_ps(change, taken)));
+		_mm_storeu_ps(&suspended[index], _mm_add_ps(carried, change));
+
+		_mm_storeu_ps(&water[index], _mm_add_ps(_mm_mul_ps(newDepth, keep), rainfall));
+	}
+
+	return i;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include "CpuFeatures.h"
+
+//How the water behaves, in height map cells and seconds
+struct HydraulicSettings
+{
+	float timeStep = 0.05f;
+	float rain = 0.01f;	//Depth of water falling on every cell each second
+	float gravity = 9.81f;	//Pushes water through the pipes between cells, faster down steeper water surfaces
+	float capacity = 0.1f;	//Sediment the water in a cell can carry, for every cell a second it flows down a slope
+	float dissolving = 0.3f;	//Fraction of the spare capacity picked up from the ground each step
+	float deposition = 0.3f;	//Fraction of the excess sediment dropped each step
+	float evaporation = 0.05f;	//Fraction of the water lost each second
+	float minimumTilt = 0.05f;	//Flat ground still carries a little, or standing water would never move anything
+};
+
+//Grid based hydraulic erosion using the virtual pipe model, where every cell holds a column of water joined to its four neighbours by pipes
+//Each step works out the flow through the pipes from the difference in water surface, carries the suspended sediment along the same pipes,
+//then moves the water and lets it pick up or drop sediment depending on how fast it flows down the slope
+//A step is three passes, each one only writing the cells it is given from values the passes before it have finished,
+//so every pass can be split into bands of rows on different threads and gives the same result however it is split
+//Sediment only ever moves between the ground and the water or between neighbouring cells, so none is made or lost on the way
+//The ground is the height map plus the loose sediment on it, water wears the loose sediment away first and drops what it carries back onto it
+class HydraulicErosion
+{
+public:
+	//Dry grids for a map of the given size, with the first step's rain already fallen
+	HydraulicErosion(int resolution, const HydraulicSettings& settings);
+	~HydraulicErosion();
+
+	//The three passes of a step, each over the rows [rowStart, rowEnd) and each finished across the whole map before the next is started
+	//The flow out of every cell from the water surfaces around it
+	void outflow(const float* heightMap, const float* sedimentMap, int rowStart, int rowEnd);
+	//The suspended sediment carried through the pipes along with the water
+	void transport(int rowStart, int rowEnd);
+	//The water that flowed in and out, the sediment it picks up or drops, then evaporation and the next step's rain
+	void erode(float* heightMap, float* sedimentMap, int rowStart, int rowEnd);
+
+	//Drops whatever sediment the water still carries where it is, for when the erosion stops
+	void settle(float* sedimentMap, int rowStart, int rowEnd) const;
+
+	const float* getWater() const { return water.data(); }
+	const float* getSuspended() const { return suspended.data(); }
+
+	//Only changes how fast the passes run, every level gives the same results
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+
+private:
+	//The passes for a single cell, which the vector kernels fall back to at the edges of the map
+	void outflowCell(const float* heightMap, const float* sedimentMap, int i, int j);
+	void transportCell(int i, int j);
+	void erodeCell(float* heightMap, float* sedimentMap, int i, int j);
+
+	//The cells from column 1 up to where the kernel stopped, short of a whole vector from the last column
+	//AVX2 would only widen the arithmetic, the passes wait on their loads and stores, so SSE2 is all they have
+	int outflowRowSSE2(const float* heightMap, const float* sedimentMap, int j);
+	int transportRowSSE2(int j);
+	int erodeRowSSE2(float* heightMap, float* sedimentMap, int j);
+
+	int resolution;
+	HydraulicSettings settings;
+
+	std::vector<float> water;
+
+	//Flow out of each cell through its pipe to the left (x - 1), right (x + 1), back (y - 1) and forward (y + 1), never negative
+	std::vector<float> fluxLeft;
+	std::vector<float> fluxRight;
+	std::vector<float> fluxBack;
+	std::vector<float> fluxForward;
+
+	std::vector<float> tilt;	//Sine of the ground's slope, at least minimumTilt
+	std::vector<float> concentration;	//Sediment each unit of flow out of a cell takes with it over a step
+
+	std::vector<float> suspended;	//Sediment carried by the water in each cell
+	std::vector<float> transported;	//Where transport writes it, so the cells it reads are never changed under it
+
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
+};
\ No newline at end of file
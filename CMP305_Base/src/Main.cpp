@@ -1,18 +1,23 @@
 // Main.cpp
 #include "System.h"
 #include "Application.h"
+#include "Benchmark.h"
 
-#include <ctime>
+#include <cstring>
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline, int iCmdshow)
 {
-	Application* app = new Application();
-	System* system;
+	//Launching with -benchmark times the terrain generation without opening a window, writing the results as text and as JSON
+	if (pScmdline && strstr(pScmdline, "-benchmark"))
+	{
+		Benchmark benchmark;
+		benchmark.run("benchmark.txt", "benchmark.json");
 
-	int t = std::time(0);
+		return 0;
+	}
 
-	srand(t);
-	//srand(std::time(0));
+	Application* app = new Application();
+	System* system;
 
 	// Create the system object.
 	system = new System(app, 1200, 675, true, false);
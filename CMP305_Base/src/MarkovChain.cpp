@@ -22,7 +22,7 @@ MarkovChain::~MarkovChain()
 {
 }
 
-std::string MarkovChain::generateSentence(char* start)
+std::string MarkovChain::generateSentence(char* start, Random& random)
 {
 	std::string sentence, next;
 	int min = 0;
@@ -38,7 +38,7 @@ std::string MarkovChain::generateSentence(char* start)
 	else
 	{
 		//If there is no starting sample, pick a random one from the lookup table
-		int index = rand() % lookupTable.size();
+		int index = random.nextInt((int)lookupTable.size());
 
 		sentence = lookupTable.at(index).text.first;
 		next = sentence;
@@ -49,7 +49,7 @@ std::string MarkovChain::generateSentence(char* start)
 	while(true)
 	{
 		//Create the next sequence of characters to sample with
-		next += sampleNextCharacter(next.c_str(), sampleSize);
+		next += sampleNextCharacter(next.c_str(), sampleSize, random);
 		next.erase(next.begin());
 
 		//This character signifies that an appropriate ending word has been generated
@@ -65,7 +65,7 @@ std::string MarkovChain::generateSentence(char* start)
 	return sentence;
 }
 
-std::string MarkovChain::sampleNextCharacter(const char* start, int sample)
+std::string MarkovChain::sampleNextCharacter(const char* start, int sample, Random& random)
 {
 	std::string startWord = std::string(start);
 	std::vector<MarkovWord> possibleNext;
@@ -96,15 +96,15 @@ std::string MarkovChain::sampleNextCharacter(const char* start, int sample)
 	{
 		std::sort(possibleNext.begin(), possibleNext.end(), orderProbability());
 
-		float random = float(rand() % 100);
+		float chance = float(random.nextInt(100));
 		float interval = 0.0f;
-		random /= 100.0f;
+		chance /= 100.0f;
 
 		for (MarkovWord& word : possibleNext)
 		{
 			next = word.text.second;
 
-			if (random <= (word.probability + interval))
+			if (chance <= (word.probability + interval))
 			{
 				break;
 			}
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 
+#include "Random.h"
+
 struct MarkovWord
 {
 	std::pair<std::string, std::string> text;
@@ -17,10 +19,10 @@ public:
 	MarkovChain(const char* fileName, int sample);
 	~MarkovChain();
 
-	std::string generateSentence(char* startWord);
+	std::string generateSentence(char* startWord, Random& random);
 
 private:
-	std::string sampleNextCharacter(const char* start, int sample);
+	std::string sampleNextCharacter(const char* start, int sample, Random& random);
 
 	void generateLookupTable(const char* fileName, int sample);
 	void loadTextData(const char* fileName);
@@ -118,6 +118,12 @@ public:
 		return  t * t * t * (t * (t * 6 - 15) + 10);
 	}
 
+	//Slope of fadeImproved, 30t^2(t - 1)^2
+	static const inline float fadeImprovedDerivative(float t)
+	{
+		return t * t * (t * (t * 30 - 60) + 30);
+	}
+
 	static const inline XMFLOAT2 modulus(XMFLOAT2& a, XMFLOAT2 b)
 	{
 		XMFLOAT2 result;
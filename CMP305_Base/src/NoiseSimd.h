@@ -0,0 +1,67 @@
+#pragma once
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+//Vector building blocks shared by the noise generators' batch kernels
+
+//Lattice coordinates wrap around the 512 entry permutation tables
+static inline __m128i wrapLatticeSSE2(__m128i value)
+{
+	return _mm_and_si128(value, _mm_set1_epi32(511));
+}
+
+//SSE2 can only truncate, which rounds negative values up, so those are stepped back down by one
+static inline __m128i floorSSE2(__m128 value)
+{
+	__m128i truncated = _mm_cvttps_epi32(value);
+	__m128 roundedUp = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), value);
+
+	return _mm_add_epi32(truncated, _mm_castps_si128(roundedUp));
+}
+
+//SSE2 has no gather, so the lanes are looked up one at a time
+static inline __m128i gatherSSE2(const int* table, __m128i index)
+{
+	alignas(16) int lanes[4];
+	_mm_store_si128((__m128i*)lanes, index);
+
+	return _mm_set_epi32(table[lanes[3]], table[lanes[2]], table[lanes[1]], table[lanes[0]]);
+}
+
+static inline __m128 gatherSSE2(const float* table, __m128i index)
+{
+	alignas(16) int lanes[4];
+	_mm_store_si128((__m128i*)lanes, index);
+
+	return _mm_set_ps(table[lanes[3]], table[lanes[2]], table[lanes[1]], table[lanes[0]]);
+}
+
+static inline __m128i gatherSSE2(const uint16_t* table, __m128i index)
+{
+	alignas(16) int lanes[4];
+	_mm_store_si128((__m128i*)lanes, index);
+
+	return _mm_set_epi32(table[lanes[3]], table[lanes[2]], table[lanes[1]], table[lanes[0]]);
+}
+
+//SSE2 only multiplies the even lanes, so the odd ones are shifted down and multiplied separately, keeping the low 32 bits of each product
+static inline __m128i multiplySSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m256i wrapLatticeAVX2(__m256i value)
+{
+	return _mm256_and_si256(value, _mm256_set1_epi32(511));
+}
+
+//AVX2 can only gather 32-bit lanes, so a 16-bit table is read two entries at a time and the one above masked off
+//The table needs a spare entry on the end for the last one's read to stay inside it
+static inline __m256i gatherAVX2(const uint16_t* table, __m256i index)
+{
+	return _mm256_and_si256(_mm256_i32gather_epi32((const int*)table, index, 2), _mm256_set1_epi32(0xFFFF));
+}
\ No newline at end of file
@@ -4,11 +4,11 @@
 #include <algorithm>
 
 #include "MathsUtils.h"
+#include "NoiseSimd.h"
 
-PerlinNoise::PerlinNoise()
+PerlinNoise::PerlinNoise(uint64_t seed)
 {
-	setupPermutationTable();
-	setupGradientTables();
+	reseed(seed);
 }
 
 PerlinNoise::~PerlinNoise()
@@ -16,33 +16,39 @@ PerlinNoise::~PerlinNoise()
 
 }
 
-float PerlinNoise::generatePerlin1D(float point)
+void PerlinNoise::reseed(uint64_t seed)
 {
-	point = MathsUtils::clamp(point, 0.0f, 511.0f);
+	setupPermutationTable(seed);
+	setupGradientTables(seed);
+}
+
+float PerlinNoise::generatePerlin1D(float point) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
 
-	int min = (int)point;
-	int max = (int)point + 1;
+	int min = (int)floorf(point);
+	int max = min + 1;
 
 	float remainders[2] = { point - (float)min, point - (float)max };
 
 	float easing = MathsUtils::fadeOriginal(remainders[0]);
 
-	int i = permutationTable.at(min);
-	int j = permutationTable.at(max);
+	int i = permutation[min & latticeMask];
+	int j = permutation[max & latticeMask];
 
 	int gradIndex[2] =
 	{
-		permutationTable.at(MathsUtils::clamp(i + min, 0, 511)),
-		permutationTable.at(MathsUtils::clamp(j + max, 0, 511))
+		permutation[(i + (min & latticeMask)) & latticeMask],
+		permutation[(j + (max & latticeMask)) & latticeMask]
 	};
 
-	float u = remainders[0] * gradientTable1D.at(gradIndex[0]);
-	float v = remainders[1] * gradientTable1D.at(gradIndex[1]);
+	float u = remainders[0] * gradientX[gradIndex[0]];
+	float v = remainders[1] * gradientX[gradIndex[1]];
 
 	return MathsUtils::interpolate(u, v, easing);
 }
 
-float PerlinNoise::generatePerlin2D(float x, float y)
+float PerlinNoise::generatePerlin2D(float x, float y, int period) const noexcept
 {
 	//Take point on height map and scale by frequency
 	//Pass into perlin function
@@ -52,20 +58,28 @@ float PerlinNoise::generatePerlin2D(float x, float y)
 	//Interpolate between surrounding grid points based on new point
 	//Final scalar output is the value for the height map
 
-	int xMin = (int)x;
-	int yMin = (int)y;
-	int xMax = (int)x + 1;
-	int yMax = (int)y + 1;
+	const uint16_t* permutation = permutationTable;
+
+	//Flooring rather than truncating keeps every cell the same size on both sides of zero
+	int xMin = (int)floorf(x);
+	int yMin = (int)floorf(y);
+	int xMax = xMin + 1;
+	int yMax = yMin + 1;
+
+	//The lattice wraps around the table, so the noise carries on past 512 and below zero instead of flattening out
+	int xCells[2], yCells[2];
+	latticeCells(xMin, period, xCells);
+	latticeCells(yMin, period, yCells);
 
-	int i = permutationTable.at(MathsUtils::clamp(xMin, 0, 511));
-	int j = permutationTable.at(MathsUtils::clamp(xMax, 0, 511));
+	int i = permutation[xCells[0]];
+	int j = permutation[xCells[1]];
 
 	int gradIndex[4] =
 	{
-		permutationTable.at(MathsUtils::clamp(i + yMin, 0, 511)),
-		permutationTable.at(MathsUtils::clamp(j + yMin, 0, 511)),
-		permutationTable.at(MathsUtils::clamp(i + yMax, 0, 511)),
-		permutationTable.at(MathsUtils::clamp(j + yMax, 0, 511))
+		permutation[(i + yCells[0]) & latticeMask],
+		permutation[(j + yCells[0]) & latticeMask],
+		permutation[(i + yCells[1]) & latticeMask],
+		permutation[(j + yCells[1]) & latticeMask]
 	};
 
 	float fracDist[4] = { x - xMin, y - yMin, x - xMax, y - yMax };
@@ -75,22 +89,22 @@ float PerlinNoise::generatePerlin2D(float x, float y)
 
 	float gradX, gradY, u, v, a, b;
 
-	gradX = gradientTable2D.at(gradIndex[0]).first;
-	gradY = gradientTable2D.at(gradIndex[0]).second;
+	gradX = gradientX[gradIndex[0]];
+	gradY = gradientY[gradIndex[0]];
 	u = MathsUtils::scalarProduct(fracDist[0], fracDist[1], gradX, gradY);
 
-	gradX = gradientTable2D.at(gradIndex[1]).first;
-	gradY = gradientTable2D.at(gradIndex[1]).second;
+	gradX = gradientX[gradIndex[1]];
+	gradY = gradientY[gradIndex[1]];
 	v = MathsUtils::scalarProduct(fracDist[2], fracDist[1], gradX, gradY);
 
 	a = MathsUtils::interpolate(u, v, easingX);
 
-	gradX = gradientTable2D.at(gradIndex[2]).first;
-	gradY = gradientTable2D.at(gradIndex[2]).second;
+	gradX = gradientX[gradIndex[2]];
+	gradY = gradientY[gradIndex[2]];
 	u = MathsUtils::scalarProduct(fracDist[0], fracDist[3], gradX, gradY);
 
-	gradX = gradientTable2D.at(gradIndex[3]).first;
-	gradY = gradientTable2D.at(gradIndex[3]).second;
+	gradX = gradientX[gradIndex[3]];
+	gradY = gradientY[gradIndex[3]];
 	v = MathsUtils::scalarProduct(fracDist[2], fracDist[3], gradX, gradY);
 
 	b = MathsUtils::interpolate(u, v, easingX);
@@ -98,78 +112,931 @@ float PerlinNoise::generatePerlin2D(float x, float y)
 	return MathsUtils::interpolate(a, b, easingY);
 }
 
-float PerlinNoise::generateImprovedPerlin(float x, float y)
+float PerlinNoise::generateImprovedPerlin(float x, float y, int period) const noexcept
 {
-	int xMin = (int)x;
-	int yMin = (int)y;
-	int xMax = (int)x + 1;
-	int yMax = (int)y + 1;
+	int xMin = (int)floorf(x);
+	int yMin = (int)floorf(y);
 
-	float fracDist[4] = { x - xMin, y - yMin, x - xMax, y - yMax };
+	int xCells[2], yCells[2];
+	latticeCells(xMin, period, xCells);
+	latticeCells(yMin, period, yCells);
+
+	return improvedPerlinCell(xCells, yCells, x - (float)xMin, y - (float)yMin);
+}
+
+float PerlinNoise::generateImprovedPerlinFar(double x, double y) const noexcept
+{
+	//Only the cell's position modulo the table matters, so it is reduced in 64 bits and just the offset inside it is narrowed to float
+	double xFloor = floor(x);
+	double yFloor = floor(y);
+
+	int xCells[2], yCells[2];
+	latticeCells((int)((int64_t)xFloor & latticeMask), 0, xCells);
+	latticeCells((int)((int64_t)yFloor & latticeMask), 0, yCells);
+
+	return improvedPerlinCell(xCells, yCells, (float)(x - xFloor), (float)(y - yFloor));
+}
+
+//The table entries for a cell's two lattice lines, the one it starts on and the next
+//With a period the cell is brought into 0 to period - 1 first and the line after the last one is the first again, which is what makes the noise repeat
+void PerlinNoise::latticeCells(int cell, int period, int cells[2]) const noexcept
+{
+	if (period > 0)
+	{
+		cell %= period;
+		cell += cell < 0 ? period : 0;
+
+		cells[0] = cell & latticeMask;
+		cells[1] = (cell + 1 == period ? 0 : cell + 1) & latticeMask;
+		return;
+	}
+
+	cells[0] = cell & latticeMask;
+	cells[1] = (cell + 1) & latticeMask;
+}
+
+//The noise inside one lattice cell, given the table entries for its lines and how far into it the point is
+//Every index is masked into the table, which keeps the lookups free of branches and the table small enough to stay in L1
+float PerlinNoise::improvedPerlinCell(const int xCells[2], const int yCells[2], float fracX, float fracY) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	float fracDist[4] = { fracX, fracY, fracX - 1.0f, fracY - 1.0f };
 
 	float easingX = MathsUtils::fadeImproved(fracDist[0]);
 	float easingY = MathsUtils::fadeImproved(fracDist[1]);
 
-	int i = permutationTable.at(MathsUtils::clamp(xMin, 0, 511));
-	int j = permutationTable.at(MathsUtils::clamp(xMax, 0, 511));
-	int k = permutationTable.at(MathsUtils::clamp(yMin, 0, 511));
-	int l = permutationTable.at(MathsUtils::clamp(yMax, 0, 511));
+	int i = permutation[xCells[0]];
+	int j = permutation[xCells[1]];
 
 	XMFLOAT2 gradient;
 	float u, v, a, b;
 
-	gradient = generateGrad(permutationTable.at(MathsUtils::clamp(i + yMin, 0, 511)), fracDist[0], fracDist[1]);
+	gradient = generateGrad(permutation[(i + yCells[0]) & latticeMask], fracDist[0], fracDist[1]);
 	u = MathsUtils::scalarProduct(fracDist[0], fracDist[1], gradient.x, gradient.y);
-	gradient = generateGrad(permutationTable.at(MathsUtils::clamp(j + yMin, 0, 511)), fracDist[2], fracDist[1]);
+	gradient = generateGrad(permutation[(j + yCells[0]) & latticeMask], fracDist[2], fracDist[1]);
 	v = MathsUtils::scalarProduct(fracDist[2], fracDist[1], gradient.x, gradient.y);
 	a = MathsUtils::interpolate(u, v, easingX);
 
-	gradient = generateGrad(permutationTable.at(MathsUtils::clamp(i + yMax, 0, 511)), fracDist[0], fracDist[3]);
+	gradient = generateGrad(permutation[(i + yCells[1]) & latticeMask], fracDist[0], fracDist[3]);
 	u = MathsUtils::scalarProduct(fracDist[0], fracDist[3], gradient.x, gradient.y);
-	gradient = generateGrad(permutationTable.at(MathsUtils::clamp(j + yMax, 0, 511)), fracDist[2], fracDist[3]);
+	gradient = generateGrad(permutation[(j + yCells[1]) & latticeMask], fracDist[2], fracDist[3]);
 	v = MathsUtils::scalarProduct(fracDist[2], fracDist[3], gradient.x, gradient.y);
 	b = MathsUtils::interpolate(u, v, easingX);
 
 	return MathsUtils::interpolate(a, b, easingY);
 }
 
-XMFLOAT2 PerlinNoise::generateGrad(int hash, float x, float y)
+float PerlinNoise::generateImprovedPerlin3D(float x, float y, float z) const noexcept
+{
+	int xMin = (int)floorf(x);
+	int yMin = (int)floorf(y);
+	int zMin = (int)floorf(z);
+
+	int xCells[2], yCells[2], zCells[2];
+	latticeCells(xMin, 0, xCells);
+	latticeCells(yMin, 0, yCells);
+	latticeCells(zMin, 0, zCells);
+
+	return improvedPerlin3DCell(xCells, yCells, zCells, x - (float)xMin, y - (float)yMin, z - (float)zMin);
+}
+
+void PerlinNoise::generateImprovedPerlin3DSpan(float x0, float dx, float y, float z, int count, float* output, int first) const noexcept
+{
+	int yMin = (int)floorf(y);
+	int zMin = (int)floorf(z);
+
+	int yCells[2], zCells[2];
+	latticeCells(yMin, 0, yCells);
+	latticeCells(zMin, 0, zCells);
+
+	for (int n = 0; n < count; n++)
+	{
+		float x = x0 + (float)(first + n) * dx;
+		int xMin = (int)floorf(x);
+
+		int xCells[2];
+		latticeCells(xMin, 0, xCells);
+
+		output[n] = improvedPerlin3DCell(xCells, yCells, zCells, x - (float)xMin, y - (float)yMin, z - (float)zMin);
+	}
+}
+
+//Perlin's reference gradients, the hash picks one of the twelve directions to the edges of the cube with four of them doubled up to make sixteen
+//Looked up by position in { x, y, z } rather than tested, like generateGrad's, as the hashes would mispredict
+static const uint8_t gradient3DU[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 };
+static const uint8_t gradient3DV[16] = { 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 0, 2 };
+static const float gradient3DSignU[16] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+static const float gradient3DSignV[16] = { 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f };
+
+static inline float gradDot3D(int hash, float x, float y, float z)
 {
 	int h = hash & 15;
+	const float choices[3] = { x, y, z };
+
+	return choices[gradient3DU[h]] * gradient3DSignU[h] + choices[gradient3DV[h]] * gradient3DSignV[h];
+}
 
-	float u = h < 8 ? x : y;
-	float v = h < 4 ? y : h == 12 || h == 14 ? x : 0;
+//Each corner is hashed through the table one axis at a time, x then y then z
+float PerlinNoise::improvedPerlin3DCell(const int xCells[2], const int yCells[2], const int zCells[2], float fracX, float fracY, float fracZ) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	float fracDist[6] = { fracX, fracY, fracZ, fracX - 1.0f, fracY - 1.0f, fracZ - 1.0f };
+
+	float easingX = MathsUtils::fadeImproved(fracDist[0]);
+	float easingY = MathsUtils::fadeImproved(fracDist[1]);
+	float easingZ = MathsUtils::fadeImproved(fracDist[2]);
+
+	int i = permutation[xCells[0]];
+	int j = permutation[xCells[1]];
+
+	int rows[4] =
+	{
+		permutation[(i + yCells[0]) & latticeMask],
+		permutation[(j + yCells[0]) & latticeMask],
+		permutation[(i + yCells[1]) & latticeMask],
+		permutation[(j + yCells[1]) & latticeMask]
+	};
+
+	float u, v, a, b, front, back;
+
+	u = gradDot3D(permutation[(rows[0] + zCells[0]) & latticeMask], fracDist[0], fracDist[1], fracDist[2]);
+	v = gradDot3D(permutation[(rows[1] + zCells[0]) & latticeMask], fracDist[3], fracDist[1], fracDist[2]);
+	a = MathsUtils::interpolate(u, v, easingX);
+	u = gradDot3D(permutation[(rows[2] + zCells[0]) & latticeMask], fracDist[0], fracDist[4], fracDist[2]);
+	v = gradDot3D(permutation[(rows[3] + zCells[0]) & latticeMask], fracDist[3], fracDist[4], fracDist[2]);
+	b = MathsUtils::interpolate(u, v, easingX);
+	front = MathsUtils::interpolate(a, b, easingY);
+
+	u = gradDot3D(permutation[(rows[0] + zCells[1]) & latticeMask], fracDist[0], fracDist[1], fracDist[5]);
+	v = gradDot3D(permutation[(rows[1] + zCells[1]) & latticeMask], fracDist[3], fracDist[1], fracDist[5]);
+	a = MathsUtils::interpolate(u, v, easingX);
+	u = gradDot3D(permutation[(rows[2] + zCells[1]) & latticeMask], fracDist[0], fracDist[4], fracDist[5]);
+	v = gradDot3D(permutation[(rows[3] + zCells[1]) & latticeMask], fracDist[3], fracDist[4], fracDist[5]);
+	b = MathsUtils::interpolate(u, v, easingX);
+	back = MathsUtils::interpolate(a, b, easingY);
+
+	return MathsUtils::interpolate(front, back, easingZ);
+}
+
+void PerlinNoise::generateImprovedPerlinPoints(const float* x, const float* y, int count, float* output) const noexcept
+{
+	int done = 0;
 
-	u = (h & 2) == 0 ? u : -u;
-	v = (h & 2) == 0 ? v : -v;
+	if (simdLevel == SimdLevel::AVX2)
+	{
+		done = improvedPerlinPointsAVX2(x, y, count, output);
+	}
+
+	else if (simdLevel == SimdLevel::SSE2)
+	{
+		done = improvedPerlinPointsSSE2(x, y, count, output);
+	}
 
-	return XMFLOAT2(u, v);
+	for (int n = done; n < count; n++)
+	{
+		output[n] = generateImprovedPerlin(x[n], y[n]);
+	}
 }
 
-void PerlinNoise::setupPermutationTable()
+float PerlinNoise::generateImprovedPerlinDerivatives(float x, float y, float& derivativeX, float& derivativeY) const noexcept
 {
+	const uint16_t* permutation = permutationTable;
+
+	int xMin = (int)floorf(x);
+	int yMin = (int)floorf(y);
+
+	const int xCells[2] = { xMin & latticeMask, (xMin + 1) & latticeMask };
+	const int yCells[2] = { yMin & latticeMask, (yMin + 1) & latticeMask };
+
+	float fracDist[4] = { x - (float)xMin, y - (float)yMin, 0.0f, 0.0f };
+	fracDist[2] = fracDist[0] - 1.0f;
+	fracDist[3] = fracDist[1] - 1.0f;
+
+	float easingX = MathsUtils::fadeImproved(fracDist[0]);
+	float easingY = MathsUtils::fadeImproved(fracDist[1]);
+	float easingSlopeX = MathsUtils::fadeImprovedDerivative(fracDist[0]);
+	float easingSlopeY = MathsUtils::fadeImprovedDerivative(fracDist[1]);
+
+	int i = permutation[xCells[0]];
+	int j = permutation[xCells[1]];
+
+	//The corners, and how each one changes with x and y, in the order improvedPerlinCell visits them
+	float corners[4], cornersX[4], cornersY[4];
+	corners[0] = gradDerivatives(permutation[(i + yCells[0]) & latticeMask], fracDist[0], fracDist[1], cornersX[0], cornersY[0]);
+	corners[1] = gradDerivatives(permutation[(j + yCells[0]) & latticeMask], fracDist[2], fracDist[1], cornersX[1], cornersY[1]);
+	corners[2] = gradDerivatives(permutation[(i + yCells[1]) & latticeMask], fracDist[0], fracDist[3], cornersX[2], cornersY[2]);
+	corners[3] = gradDerivatives(permutation[(j + yCells[1]) & latticeMask], fracDist[2], fracDist[3], cornersX[3], cornersY[3]);
+
+	float a = MathsUtils::interpolate(corners[0], corners[1], easingX);
+	float b = MathsUtils::interpolate(corners[2], corners[3], easingX);
+
+	//Product rule through each interpolation, the weight only changes along its own axis
+	float aX = MathsUtils::interpolate(cornersX[0], cornersX[1], easingX) + easingSlopeX * (corners[1] - corners[0]);
+	float bX = MathsUtils::interpolate(cornersX[2], cornersX[3], easingX) + easingSlopeX * (corners[3] - corners[2]);
+	float aY = MathsUtils::interpolate(cornersY[0], cornersY[1], easingX);
+	float bY = MathsUtils::interpolate(cornersY[2], cornersY[3], easingX);
+
+	derivativeX = MathsUtils::interpolate(aX, bX, easingY);
+	derivativeY = MathsUtils::interpolate(aY, bY, easingY) + easingSlopeY * (b - a);
+
+	return MathsUtils::interpolate(a, b, easingY);
+}
+
+void PerlinNoise::generateImprovedPerlinDerivativeSpan(float x0, float dx, float y, int count, float* output, float* derivativeX, float* derivativeY, int first) const noexcept
+{
+	int done = 0;
+
+	if (simdLevel == SimdLevel::AVX2)
+	{
+		done = improvedPerlinDerivativeSpanAVX2(x0, dx, y, first, count, output, derivativeX, derivativeY);
+	}
+
+	else if (simdLevel == SimdLevel::SSE2)
+	{
+		done = improvedPerlinDerivativeSpanSSE2(x0, dx, y, first, count, output, derivativeX, derivativeY);
+	}
+
+	for (int n = done; n < count; n++)
+	{
+		output[n] = generateImprovedPerlinDerivatives(x0 + (float)(first + n) * dx, y, derivativeX[n], derivativeY[n]);
+	}
+}
+
+void PerlinNoise::generateImprovedPerlinSpan(float x0, float dx, float y, int count, float* output, int first, int period) const noexcept
+{
+	if (period > 0)
+	{
+		improvedPerlinSpanPeriodic(x0, dx, y, first, count, output, period);
+		return;
+	}
+
+	int done = 0;
+
+	//The vector kernels handle as many whole batches as they can, the scalar path finishes the remainder
+	if (simdLevel == SimdLevel::AVX2)
+	{
+		done = improvedPerlinSpanAVX2(x0, dx, y, first, count, output, nullptr);
+	}
+
+	else if (simdLevel == SimdLevel::SSE2)
+	{
+		done = improvedPerlinSpanSSE2(x0, dx, y, first, count, output, nullptr);
+	}
+
+	improvedPerlinSpanScalar(x0, dx, y, first, done, count, output, nullptr);
+}
+
+//Rather than every sample wrapping its cell into the period, which needs a division, the cells a span crosses are wrapped once up front
+//The samples then look their cells up by how far they are past the lowest one, which costs no more than masking them into the table
+//A long span is done a piece at a time so the wrapped cells fit on the stack, each piece counting from its own first keeps every sample where it was
+void PerlinNoise::improvedPerlinSpanPeriodic(float x0, float dx, float y, int first, int count, float* output, int period) const noexcept
+{
+	const int capacity = 512;
+	int cells[capacity];
+	int hashes[capacity];
+
+	//The positions' rounding can put the two ends one more cell apart than their distance, and the last cell needs the line after it too
+	int pieceLength = count;
+
+	if ((float)count * fabsf(dx) > (float)(capacity - 4))
+	{
+		pieceLength = (std::max)(1, (int)((float)(capacity - 4) / fabsf(dx)));
+	}
+
+	for (int start = 0; start < count; start += pieceLength)
+	{
+		int length = (std::min)(pieceLength, count - start);
+		int pieceFirst = first + start;
+
+		//The positions only ever move one way along a span, so its ends hold the lowest and highest cells
+		float firstX = x0 + (float)pieceFirst * dx;
+		float lastX = x0 + (float)(pieceFirst + length - 1) * dx;
+		int lowestCell = (int)floorf((std::min)(firstX, lastX));
+		int lines = (int)floorf((std::max)(firstX, lastX)) - lowestCell + 2;
+
+		for (int k = 0; k < lines; k++)
+		{
+			int pair[2];
+			latticeCells(lowestCell + k, period, pair);
+
+			cells[k] = pair[0];
+			hashes[k] = permutationTable[pair[0]];
+		}
+
+		const WrappedCells wrapped = { period, lowestCell, cells, hashes };
+		int done = 0;
+
+		if (simdLevel == SimdLevel::AVX2)
+		{
+			done = improvedPerlinSpanAVX2(x0, dx, y, pieceFirst, length, output + start, &wrapped);
+		}
+
+		else if (simdLevel == SimdLevel::SSE2)
+		{
+			done = improvedPerlinSpanSSE2(x0, dx, y, pieceFirst, length, output + start, &wrapped);
+		}
+
+		improvedPerlinSpanScalar(x0, dx, y, pieceFirst, done, length, output + start, &wrapped);
+	}
+}
+
+void PerlinNoise::improvedPerlinSpanScalar(float x0, float dx, float y, int first, int start, int count, float* output, const WrappedCells* wrapped) const noexcept
+{
+	if (!wrapped)
+	{
+		for (int n = start; n < count; n++)
+		{
+			output[n] = generateImprovedPerlin(x0 + (float)(first + n) * dx, y);
+		}
+
+		return;
+	}
+
+	//The same steps as generateImprovedPerlin, with the wrapped cells looked up
+	int yMin = (int)floorf(y);
+	int yCells[2];
+	latticeCells(yMin, wrapped->period, yCells);
+
+	for (int n = start; n < count; n++)
+	{
+		float x = x0 + (float)(first + n) * dx;
+		int xMin = (int)floorf(x);
+		int line = xMin - wrapped->lowestCell;
+
+		const int xCells[2] = { wrapped->cells[line], wrapped->cells[line + 1] };
+		output[n] = improvedPerlinCell(xCells, yCells, x - (float)xMin, y - (float)yMin);
+	}
+}
+
+//The vector kernels repeat the scalar arithmetic operation for operation, so they give the same results
+
+static inline __m128 fadeImprovedSSE2(__m128 t)
+{
+	__m128 inner = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+	inner = _mm_add_ps(_mm_mul_ps(t, inner), _mm_set1_ps(10.0f));
+
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+static inline __m128 lerpSSE2(__m128 first, __m128 second, __m128 weight)
+{
+	return _mm_add_ps(first, _mm_mul_ps(weight, _mm_sub_ps(second, first)));
+}
+
+//Vector version of generateGrad followed by the scalar product with the distance
+static inline __m128 gradDotSSE2(__m128i hash, __m128 x, __m128 y)
+{
+	__m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+
+	__m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+	__m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	__m128 is12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+	__m128 negate = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+
+	__m128 u = _mm_or_ps(_mm_and_ps(below8, x), _mm_andnot_ps(below8, y));
+	__m128 v = _mm_or_ps(_mm_and_ps(below4, y), _mm_andnot_ps(below4, _mm_and_ps(is12or14, x)));
+
+	u = _mm_xor_ps(u, negate);
+	v = _mm_xor_ps(v, negate);
+
+	return _mm_add_ps(_mm_mul_ps(x, u), _mm_mul_ps(y, v));
+}
+
+int PerlinNoise::improvedPerlinSpanSSE2(float x0, float dx, float y, int first, int count, float* output, const WrappedCells* wrapped) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	//Every sample in the row shares y, so that axis is only worked out once
+	const int yMin = (int)floorf(y);
+	const float yFrac = y - (float)yMin;
+	const __m128 fracY[2] = { _mm_set1_ps(yFrac), _mm_set1_ps(yFrac - 1.0f) };
+	const __m128 easingY = _mm_set1_ps(MathsUtils::fadeImproved(yFrac));
+	int yLines[2];
+	latticeCells(yMin, wrapped ? wrapped->period : 0, yLines);
+	const __m128i yCells[2] = { _mm_set1_epi32(yLines[0]), _mm_set1_epi32(yLines[1]) };
+
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128 oneFloat = _mm_set1_ps(1.0f);
+	const __m128 step = _mm_set1_ps(dx);
+	const __m128 start = _mm_set1_ps(x0);
+	const __m128i lowestCell = _mm_set1_epi32(wrapped ? wrapped->lowestCell : 0);
+
+	int n = 0;
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 index = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + n), _mm_set_epi32(3, 2, 1, 0)));
+		__m128 x = _mm_add_ps(start, _mm_mul_ps(index, step));
+
+		__m128i xMin = floorSSE2(x);
+
+		__m128 fracX[2];
+		fracX[0] = _mm_sub_ps(x, _mm_cvtepi32_ps(xMin));
+		fracX[1] = _mm_sub_ps(fracX[0], oneFloat);
+		__m128 easingX = fadeImprovedSSE2(fracX[0]);
+
+		__m128i i, j;
+
+		//The same way for the whole span, so the branch costs next to nothing
+		if (wrapped)
+		{
+			__m128i line = _mm_sub_epi32(xMin, lowestCell);
+			i = gatherSSE2(wrapped->hashes, line);
+			j = gatherSSE2(wrapped->hashes, _mm_add_epi32(line, one));
+		}
+
+		else
+		{
+			i = gatherSSE2(permutation, wrapLatticeSSE2(xMin));
+			j = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(xMin, one)));
+		}
+
+		__m128i hashes[4] =
+		{
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, yCells[0]))),
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(j, yCells[0]))),
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, yCells[1]))),
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(j, yCells[1])))
+		};
+
+		__m128 a = lerpSSE2(gradDotSSE2(hashes[0], fracX[0], fracY[0]), gradDotSSE2(hashes[1], fracX[1], fracY[0]), easingX);
+		__m128 b = lerpSSE2(gradDotSSE2(hashes[2], fracX[0], fracY[1]), gradDotSSE2(hashes[3], fracX[1], fracY[1]), easingX);
+
+		_mm_storeu_ps(&output[n], lerpSSE2(a, b, easingY));
+	}
+
+	return n;
+}
+
+//Like the span kernel, but every lane has its own y, so the rows of the cell are looked up per lane too
+int PerlinNoise::improvedPerlinPointsSSE2(const float* xs, const float* ys, int count, float* output) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128 oneFloat = _mm_set1_ps(1.0f);
+
+	int n = 0;
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 x = _mm_loadu_ps(&xs[n]);
+		__m128 y = _mm_loadu_ps(&ys[n]);
+
+		__m128i xMin = floorSSE2(x);
+		__m128i yMin = floorSSE2(y);
+
+		__m128 fracX[2], fracY[2];
+		fracX[0] = _mm_sub_ps(x, _mm_cvtepi32_ps(xMin));
+		fracX[1] = _mm_sub_ps(fracX[0], oneFloat);
+		fracY[0] = _mm_sub_ps(y, _mm_cvtepi32_ps(yMin));
+		fracY[1] = _mm_sub_ps(fracY[0], oneFloat);
+		__m128 easingX = fadeImprovedSSE2(fracX[0]);
+		__m128 easingY = fadeImprovedSSE2(fracY[0]);
+
+		__m128i yCells[2] = { wrapLatticeSSE2(yMin), wrapLatticeSSE2(_mm_add_epi32(yMin, one)) };
+
+		__m128i i = gatherSSE2(permutation, wrapLatticeSSE2(xMin));
+		__m128i j = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(xMin, one)));
+
+		__m128i hashes[4] =
+		{
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, yCells[0]))),
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(j, yCells[0]))),
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, yCells[1]))),
+			gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(j, yCells[1])))
+		};
+
+		__m128 a = lerpSSE2(gradDotSSE2(hashes[0], fracX[0], fracY[0]), gradDotSSE2(hashes[1], fracX[1], fracY[0]), easingX);
+		__m128 b = lerpSSE2(gradDotSSE2(hashes[2], fracX[0], fracY[1]), gradDotSSE2(hashes[3], fracX[1], fracY[1]), easingX);
+
+		_mm_storeu_ps(&output[n], lerpSSE2(a, b, easingY));
+	}
+
+	return n;
+}
+
+static inline __m128 fadeImprovedDerivativeSSE2(__m128 t)
+{
+	__m128 inner = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(30.0f)), _mm_set1_ps(60.0f));
+	inner = _mm_add_ps(_mm_mul_ps(t, inner), _mm_set1_ps(30.0f));
+
+	return _mm_mul_ps(_mm_mul_ps(t, t), inner);
+}
+
+//Vector version of gradDerivatives
+static inline __m128 gradDerivativesSSE2(__m128i hash, __m128 x, __m128 y, __m128& derivativeX, __m128& derivativeY)
+{
+	__m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+
+	__m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+	__m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	__m128 is12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+	__m128 negate = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+
+	__m128 u = _mm_or_ps(_mm_and_ps(below8, x), _mm_andnot_ps(below8, y));
+	__m128 v = _mm_or_ps(_mm_and_ps(below4, y), _mm_andnot_ps(below4, _mm_and_ps(is12or14, x)));
+
+	__m128 uX = _mm_xor_ps(_mm_and_ps(below8, x), negate);
+	__m128 vX = _mm_xor_ps(_mm_and_ps(is12or14, y), negate);
+	__m128 uY = _mm_xor_ps(_mm_andnot_ps(below8, x), negate);
+	__m128 vY = _mm_xor_ps(_mm_and_ps(below4, y), negate);
+
+	u = _mm_xor_ps(u, negate);
+	v = _mm_xor_ps(v, negate);
+
+	derivativeX = _mm_add_ps(_mm_add_ps(u, uX), vX);
+	derivativeY = _mm_add_ps(_mm_add_ps(v, uY), vY);
+
+	return _mm_add_ps(_mm_mul_ps(x, u), _mm_mul_ps(y, v));
+}
+
+int PerlinNoise::improvedPerlinDerivativeSpanSSE2(float x0, float dx, float y, int first, int count, float* output, float* derivativeX, float* derivativeY) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	const int yMin = (int)floorf(y);
+	const float yFrac = y - (float)yMin;
+	const __m128 fracY[2] = { _mm_set1_ps(yFrac), _mm_set1_ps(yFrac - 1.0f) };
+	const __m128 easingY = _mm_set1_ps(MathsUtils::fadeImproved(yFrac));
+	const __m128 easingSlopeY = _mm_set1_ps(MathsUtils::fadeImprovedDerivative(yFrac));
+	const __m128i yCells[2] = { _mm_set1_epi32(yMin & latticeMask), _mm_set1_epi32((yMin + 1) & latticeMask) };
+
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128 oneFloat = _mm_set1_ps(1.0f);
+	const __m128 step = _mm_set1_ps(dx);
+	const __m128 start = _mm_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 index = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + n), _mm_set_epi32(3, 2, 1, 0)));
+		__m128 x = _mm_add_ps(start, _mm_mul_ps(index, step));
+
+		__m128i xMin = floorSSE2(x);
+
+		__m128 fracX[2];
+		fracX[0] = _mm_sub_ps(x, _mm_cvtepi32_ps(xMin));
+		fracX[1] = _mm_sub_ps(fracX[0], oneFloat);
+		__m128 easingX = fadeImprovedSSE2(fracX[0]);
+		__m128 easingSlopeX = fadeImprovedDerivativeSSE2(fracX[0]);
+
+		__m128i i = gatherSSE2(permutation, wrapLatticeSSE2(xMin));
+		__m128i j = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(xMin, one)));
+
+		__m128 corners[4], cornersX[4], cornersY[4];
+		corners[0] = gradDerivativesSSE2(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, yCells[0]))), fracX[0], fracY[0], cornersX[0], cornersY[0]);
+		corners[1] = gradDerivativesSSE2(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(j, yCells[0]))), fracX[1], fracY[0], cornersX[1], cornersY[1]);
+		corners[2] = gradDerivativesSSE2(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, yCells[1]))), fracX[0], fracY[1], cornersX[2], cornersY[2]);
+		corners[3] = gradDerivativesSSE2(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(j, yCells[1]))), fracX[1], fracY[1], cornersX[3], cornersY[3]);
+
+		__m128 a = lerpSSE2(corners[0], corners[1], easingX);
+		__m128 b = lerpSSE2(corners[2], corners[3], easingX);
+
+		__m128 aX = _mm_add_ps(lerpSSE2(cornersX[0], cornersX[1], easingX), _mm_mul_ps(easingSlopeX, _mm_sub_ps(corners[1], corners[0])));
+		__m128 bX = _mm_add_ps(lerpSSE2(cornersX[2], cornersX[3], easingX), _mm_mul_ps(easingSlopeX, _mm_sub_ps(corners[3], corners[2])));
+		__m128 aY = lerpSSE2(cornersY[0], cornersY[1], easingX);
+		__m128 bY = lerpSSE2(cornersY[2], cornersY[3], easingX);
+
+		_mm_storeu_ps(&derivativeX[n], lerpSSE2(aX, bX, easingY));
+		_mm_storeu_ps(&derivativeY[n], _mm_add_ps(lerpSSE2(aY, bY, easingY), _mm_mul_ps(easingSlopeY, _mm_sub_ps(b, a))));
+		_mm_storeu_ps(&output[n], lerpSSE2(a, b, easingY));
+	}
+
+	return n;
+}
+
+static inline __m256 fadeImprovedAVX2(__m256 t)
+{
+	__m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+	inner = _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(10.0f));
+
+	return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+static inline __m256 lerpAVX2(__m256 first, __m256 second, __m256 weight)
+{
+	return _mm256_add_ps(first, _mm256_mul_ps(weight, _mm256_sub_ps(second, first)));
+}
+
+static inline __m256 gradDotAVX2(__m256i hash, __m256 x, __m256 y)
+{
+	__m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+
+	__m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+	__m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+	__m256 is12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+	__m256 negate = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+
+	__m256 u = _mm256_blendv_ps(y, x, below8);
+	__m256 v = _mm256_blendv_ps(_mm256_and_ps(is12or14, x), y, below4);
+
+	u = _mm256_xor_ps(u, negate);
+	v = _mm256_xor_ps(v, negate);
+
+	return _mm256_add_ps(_mm256_mul_ps(x, u), _mm256_mul_ps(y, v));
+}
+
+int PerlinNoise::improvedPerlinSpanAVX2(float x0, float dx, float y, int first, int count, float* output, const WrappedCells* wrapped) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	const int yMin = (int)floorf(y);
+	const float yFrac = y - (float)yMin;
+	const __m256 fracY[2] = { _mm256_set1_ps(yFrac), _mm256_set1_ps(yFrac - 1.0f) };
+	const __m256 easingY = _mm256_set1_ps(MathsUtils::fadeImproved(yFrac));
+	int yLines[2];
+	latticeCells(yMin, wrapped ? wrapped->period : 0, yLines);
+	const __m256i yCells[2] = { _mm256_set1_epi32(yLines[0]), _mm256_set1_epi32(yLines[1]) };
+
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256 oneFloat = _mm256_set1_ps(1.0f);
+	const __m256 step = _mm256_set1_ps(dx);
+	const __m256 start = _mm256_set1_ps(x0);
+	const __m256i lowestCell = _mm256_set1_epi32(wrapped ? wrapped->lowestCell : 0);
+
+	int n = 0;
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 index = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(first + n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+		__m256 x = _mm256_add_ps(start, _mm256_mul_ps(index, step));
+
+		__m256 xFloor = _mm256_floor_ps(x);
+		__m256i xMin = _mm256_cvttps_epi32(xFloor);
+
+		__m256 fracX[2];
+		fracX[0] = _mm256_sub_ps(x, xFloor);
+		fracX[1] = _mm256_sub_ps(fracX[0], oneFloat);
+		__m256 easingX = fadeImprovedAVX2(fracX[0]);
+
+		__m256i i, j;
+
+		if (wrapped)
+		{
+			__m256i line = _mm256_sub_epi32(xMin, lowestCell);
+			i = _mm256_i32gather_epi32(wrapped->hashes, line, 4);
+			j = _mm256_i32gather_epi32(wrapped->hashes, _mm256_add_epi32(line, one), 4);
+		}
+
+		else
+		{
+			i = gatherAVX2(permutation, wrapLatticeAVX2(xMin));
+			j = gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(xMin, one)));
+		}
+
+		__m256i hashes[4] =
+		{
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, yCells[0]))),
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(j, yCells[0]))),
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, yCells[1]))),
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(j, yCells[1])))
+		};
+
+		__m256 a = lerpAVX2(gradDotAVX2(hashes[0], fracX[0], fracY[0]), gradDotAVX2(hashes[1], fracX[1], fracY[0]), easingX);
+		__m256 b = lerpAVX2(gradDotAVX2(hashes[2], fracX[0], fracY[1]), gradDotAVX2(hashes[3], fracX[1], fracY[1]), easingX);
+
+		_mm256_storeu_ps(&output[n], lerpAVX2(a, b, easingY));
+	}
+
+	//Avoids the penalty for switching back to the non-VEX encoded SSE code that follows
+	_mm256_zeroupper();
+
+	return n;
+}
+
+int PerlinNoise::improvedPerlinPointsAVX2(const float* xs, const float* ys, int count, float* output) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256 oneFloat = _mm256_set1_ps(1.0f);
+
+	int n = 0;
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&xs[n]);
+		__m256 y = _mm256_loadu_ps(&ys[n]);
+
+		__m256 xFloor = _mm256_floor_ps(x);
+		__m256 yFloor = _mm256_floor_ps(y);
+		__m256i xMin = _mm256_cvttps_epi32(xFloor);
+		__m256i yMin = _mm256_cvttps_epi32(yFloor);
+
+		__m256 fracX[2], fracY[2];
+		fracX[0] = _mm256_sub_ps(x, xFloor);
+		fracX[1] = _mm256_sub_ps(fracX[0], oneFloat);
+		fracY[0] = _mm256_sub_ps(y, yFloor);
+		fracY[1] = _mm256_sub_ps(fracY[0], oneFloat);
+		__m256 easingX = fadeImprovedAVX2(fracX[0]);
+		__m256 easingY = fadeImprovedAVX2(fracY[0]);
+
+		__m256i yCells[2] = { wrapLatticeAVX2(yMin), wrapLatticeAVX2(_mm256_add_epi32(yMin, one)) };
+
+		__m256i i = gatherAVX2(permutation, wrapLatticeAVX2(xMin));
+		__m256i j = gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(xMin, one)));
+
+		__m256i hashes[4] =
+		{
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, yCells[0]))),
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(j, yCells[0]))),
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, yCells[1]))),
+			gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(j, yCells[1])))
+		};
+
+		__m256 a = lerpAVX2(gradDotAVX2(hashes[0], fracX[0], fracY[0]), gradDotAVX2(hashes[1], fracX[1], fracY[0]), easingX);
+		__m256 b = lerpAVX2(gradDotAVX2(hashes[2], fracX[0], fracY[1]), gradDotAVX2(hashes[3], fracX[1], fracY[1]), easingX);
+
+		_mm256_storeu_ps(&output[n], lerpAVX2(a, b, easingY));
+	}
+
+	_mm256_zeroupper();
+
+	return n;
+}
+
+static inline __m256 fadeImprovedDerivativeAVX2(__m256 t)
+{
+	__m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(30.0f)), _mm256_set1_ps(60.0f));
+	inner = _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(30.0f));
+
+	return _mm256_mul_ps(_mm256_mul_ps(t, t), inner);
+}
+
+static inline __m256 gradDerivativesAVX2(__m256i hash, __m256 x, __m256 y, __m256& derivativeX, __m256& derivativeY)
+{
+	__m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+
+	__m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+	__m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+	__m256 is12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+	__m256 negate = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+
+	__m256 u = _mm256_blendv_ps(y, x, below8);
+	__m256 v = _mm256_blendv_ps(_mm256_and_ps(is12or14, x), y, below4);
+
+	__m256 uX = _mm256_xor_ps(_mm256_and_ps(below8, x), negate);
+	__m256 vX = _mm256_xor_ps(_mm256_and_ps(is12or14, y), negate);
+	__m256 uY = _mm256_xor_ps(_mm256_andnot_ps(below8, x), negate);
+	__m256 vY = _mm256_xor_ps(_mm256_and_ps(below4, y), negate);
+
+	u = _mm256_xor_ps(u, negate);
+	v = _mm256_xor_ps(v, negate);
+
+	derivativeX = _mm256_add_ps(_mm256_add_ps(u, uX), vX);
+	derivativeY = _mm256_add_ps(_mm256_add_ps(v, uY), vY);
+
+	return _mm256_add_ps(_mm256_mul_ps(x, u), _mm256_mul_ps(y, v));
+}
+
+int PerlinNoise::improvedPerlinDerivativeSpanAVX2(float x0, float dx, float y, int first, int count, float* output, float* derivativeX, float* derivativeY) const noexcept
+{
+	const uint16_t* permutation = permutationTable;
+
+	const int yMin = (int)floorf(y);
+	const float yFrac = y - (float)yMin;
+	const __m256 fracY[2] = { _mm256_set1_ps(yFrac), _mm256_set1_ps(yFrac - 1.0f) };
+	const __m256 easingY = _mm256_set1_ps(MathsUtils::fadeImproved(yFrac));
+	const __m256 easingSlopeY = _mm256_set1_ps(MathsUtils::fadeImprovedDerivative(yFrac));
+	const __m256i yCells[2] = { _mm256_set1_epi32(yMin & latticeMask), _mm256_set1_epi32((yMin + 1) & latticeMask) };
+
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256 oneFloat = _mm256_set1_ps(1.0f);
+	const __m256 step = _mm256_set1_ps(dx);
+	const __m256 start = _mm256_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 index = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(first + n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+		__m256 x = _mm256_add_ps(start, _mm256_mul_ps(index, step));
+
+		__m256 xFloor = _mm256_floor_ps(x);
+		__m256i xMin = _mm256_cvttps_epi32(xFloor);
+
+		__m256 fracX[2];
+		fracX[0] = _mm256_sub_ps(x, xFloor);
+		fracX[1] = _mm256_sub_ps(fracX[0], oneFloat);
+		__m256 easingX = fadeImprovedAVX2(fracX[0]);
+		__m256 easingSlopeX = fadeImprovedDerivativeAVX2(fracX[0]);
+
+		__m256i i = gatherAVX2(permutation, wrapLatticeAVX2(xMin));
+		__m256i j = gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(xMin, one)));
+
+		__m256 corners[4], cornersX[4], cornersY[4];
+		corners[0] = gradDerivativesAVX2(gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, yCells[0]))), fracX[0], fracY[0], cornersX[0], cornersY[0]);
+		corners[1] = gradDerivativesAVX2(gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(j, yCells[0]))), fracX[1], fracY[0], cornersX[1], cornersY[1]);
+		corners[2] = gradDerivativesAVX2(gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, yCells[1]))), fracX[0], fracY[1], cornersX[2], cornersY[2]);
+		corners[3] = gradDerivativesAVX2(gatherAVX2(permutation, wrapLatticeAVX2(_mm256_add_epi32(j, yCells[1]))), fracX[1], fracY[1], cornersX[3], cornersY[3]);
+
+		__m256 a = lerpAVX2(corners[0], corners[1], easingX);
+		__m256 b = lerpAVX2(corners[2], corners[3], easingX);
+
+		__m256 aX = _mm256_add_ps(lerpAVX2(cornersX[0], cornersX[1], easingX), _mm256_mul_ps(easingSlopeX, _mm256_sub_ps(corners[1], corners[0])));
+		__m256 bX = _mm256_add_ps(lerpAVX2(cornersX[2], cornersX[3], easingX), _mm256_mul_ps(easingSlopeX, _mm256_sub_ps(corners[3], corners[2])));
+		__m256 aY = lerpAVX2(cornersY[0], cornersY[1], easingX);
+		__m256 bY = lerpAVX2(cornersY[2], cornersY[3], easingX);
+
+		_mm256_storeu_ps(&derivativeX[n], lerpAVX2(aX, bX, easingY));
+		_mm256_storeu_ps(&derivativeY[n], _mm256_add_ps(lerpAVX2(aY, bY, easingY), _mm256_mul_ps(easingSlopeY, _mm256_sub_ps(b, a))));
+		_mm256_storeu_ps(&output[n], lerpAVX2(a, b, easingY));
+	}
+
+	_mm256_zeroupper();
+
+	return n;
+}
+
+//The hash picks u and v out of x, y and zero, and whether both are negated
+//A hash is as good as random, so testing it would mispredict often, instead each choice is looked up by position in { x, y, 0 }
+static const uint8_t gradientU[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 };
+static const uint8_t gradientV[16] = { 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 0, 2 };
+static const float gradientSign[16] = { 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f };
+
+//Which of { x, y, 0 } u and v change by along each axis, for the slopes
+static const uint8_t gradientUX[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2 };
+static const uint8_t gradientUY[16] = { 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t gradientVX[16] = { 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2 };
+static const uint8_t gradientVY[16] = { 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 };
+
+XMFLOAT2 PerlinNoise::generateGrad(int hash, float x, float y) const noexcept
+{
+	int h = hash & 15;
+	const float choices[3] = { x, y, 0.0f };
+
+	//Multiplying by -1 flips the sign bit and nothing else, exactly like negating
+	return XMFLOAT2(choices[gradientU[h]] * gradientSign[h], choices[gradientV[h]] * gradientSign[h]);
+}
+
+//The corner's contribution, the scalar product of the distance with generateGrad's vector, and its slope
+//generateGrad builds its vector from the distance itself, so the slope picks up both halves of the product rule
+float PerlinNoise::gradDerivatives(int hash, float x, float y, float& derivativeX, float& derivativeY) const noexcept
+{
+	int h = hash & 15;
+	const float choices[3] = { x, y, 0.0f };
+	const float sign = gradientSign[h];
+
+	float u = choices[gradientU[h]] * sign;
+	float v = choices[gradientV[h]] * sign;
+
+	//The distance times how u and v change with each axis
+	float uX = choices[gradientUX[h]] * sign;
+	float vX = choices[gradientVX[h]] * sign;
+	float uY = choices[gradientUY[h]] * sign;
+	float vY = choices[gradientVY[h]] * sign;
+
+	derivativeX = (u + uX) + vX;
+	derivativeY = (v + uY) + vY;
+
+	return MathsUtils::scalarProduct(x, y, u, v);
+}
+
+void PerlinNoise::setupPermutationTable(uint64_t seed)
+{
+	Random random(Random::deriveKey(seed, RandomStream::Permutation));
+
 	//Assigning values uniformly to permutation table
-	for (int i = 0; i < 512; i++)
+	for (int i = 0; i < latticeSize; i++)
 	{
-		permutationTable.push_back(i);
+		permutationTable[i] = (uint16_t)i;
 	}
 
-	std::random_shuffle(permutationTable.begin(), permutationTable.end());
+	//Fisher-Yates shuffle
+	for (int i = latticeSize - 1; i > 0; i--)
+	{
+		std::swap(permutationTable[i], permutationTable[random.nextInt(i + 1)]);
+	}
+
+	//Only ever read as the upper half of the last entry's gather, then masked off
+	permutationTable[latticeSize] = 0;
 }
 
-void PerlinNoise::setupGradientTables()
+void PerlinNoise::setupGradientTables(uint64_t seed)
 {
-	for (int j = 0; j < 512; j++)
+	Random random(Random::deriveKey(seed, RandomStream::Gradients));
+
+	for (int j = 0; j < latticeSize; j++)
 	{
-		float gradX = (float)(rand() % 512);
-		float gradY = (float)(rand() % 512);
+		float gradX = (float)random.nextInt(512);
+		float gradY = (float)random.nextInt(512);
+
+		//A zero length gradient cannot be normalised
+		while (gradX == 256.0f && gradY == 256.0f)
+		{
+			gradY = (float)random.nextInt(512);
+		}
 
 		gradX = ((gradX - 256.0f) / 256.0f);
 		gradY = ((gradY - 256.0f) / 256.0f);
 
 		MathsUtils::normalise2D(gradX, gradY);
 
-		gradientTable1D.push_back(gradX);
-		gradientTable2D.push_back(std::pair<float, float>(gradX, gradY));
+		gradientX[j] = gradX;
+		gradientY[j] = gradY;
 	}
 }
\ No newline at end of file
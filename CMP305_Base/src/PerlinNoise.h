@@ -1,26 +1,91 @@
 #pragma once
 
 #include "DXF.h"
-#include <vector>
+
+#include "CpuFeatures.h"
+#include "Random.h"
 
 class PerlinNoise
 {
 public:
-	PerlinNoise();
+	PerlinNoise(uint64_t seed = 0);
 	~PerlinNoise();
 
-	float generatePerlin1D(float point);
-	float generatePerlin2D(float x, float y);
-	float generateImprovedPerlin(float x, float y);
+	//Rebuilds the permutation and gradient tables, the same seed always gives the same noise
+	void reseed(uint64_t seed);
+
+	float generatePerlin1D(float point) const noexcept;
+
+	//A period above zero makes the noise repeat every period lattice cells along both axes, for heightmaps that tile seamlessly
+	//It wraps the cells before they are hashed, so the last cell of a tile blends into the first exactly as the next tile starts
+	float generatePerlin2D(float x, float y, int period = 0) const noexcept;
+	float generateImprovedPerlin(float x, float y, int period = 0) const noexcept;
+
+	//The lattice repeats every 512 cells, and a float can no longer place a point inside a cell once it is millions of cells out
+	//This takes double coordinates and wraps the cell in 64 bits first, so points far from the origin keep their full detail
+	float generateImprovedPerlinFar(double x, double y) const noexcept;
+
+	//Fills output with count samples along a row, the n-th one taken at (x0 + (first + n) * dx, y)
+	//Counting from first rather than moving x0 gives a sample exactly the same position whichever span it is part of
+	void generateImprovedPerlinSpan(float x0, float dx, float y, int count, float* output, int first = 0, int period = 0) const noexcept;
+
+	//Improved Perlin noise in three dimensions, using Perlin's reference gradients towards the edges of the cube
+	//A volume can fold back over itself where a height map cannot, so this is what caves and overhangs are carved with
+	float generateImprovedPerlin3D(float x, float y, float z) const noexcept;
+
+	//Fills output with count samples along x, the n-th one taken at (x0 + (first + n) * dx, y, z), with the y and z cells only worked out once
+	void generateImprovedPerlin3DSpan(float x0, float dx, float y, float z, int count, float* output, int first = 0) const noexcept;
+
+	//Fills output with count samples at arbitrary points, the n-th one taken at (x[n], y[n]), for samples that do not lie along a row
+	void generateImprovedPerlinPoints(const float* x, const float* y, int count, float* output) const noexcept;
+
+	//The same noise along with its slope, worked out exactly from the fade curves instead of by sampling the neighbours
+	//The value returned is bit-identical to generateImprovedPerlin's
+	float generateImprovedPerlinDerivatives(float x, float y, float& derivativeX, float& derivativeY) const noexcept;
+	void generateImprovedPerlinDerivativeSpan(float x0, float dx, float y, int count, float* output, float* derivativeX, float* derivativeY, int first = 0) const noexcept;
+
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
 
 private:
-	std::vector<int> permutationTable;
+	static const int latticeSize = 512;
+	static const int latticeMask = latticeSize - 1;	//Lattice coordinates wrap around the 512 entry permutation table
+
+	//Fixed arrays inside the object rather than vectors, so a lookup is one load from a known offset and all of them fit in L1 together
+	//The entries only run up to 511, which 16 bits holds, halving the table; the spare entry on the end is for the AVX2 gathers
+	alignas(16) uint16_t permutationTable[latticeSize + 1];
+
+	//The original noise's gradients, kept as separate x and y arrays, the 1D noise uses the x components on their own
+	alignas(16) float gradientX[latticeSize];
+	alignas(16) float gradientY[latticeSize];
+
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
+
+	XMFLOAT2 generateGrad(int hash, float x, float y) const noexcept;
+	void latticeCells(int cell, int period, int cells[2]) const noexcept;
+	float improvedPerlinCell(const int xCells[2], const int yCells[2], float fracX, float fracY) const noexcept;
+	float gradDerivatives(int hash, float x, float y, float& derivativeX, float& derivativeY) const noexcept;
+	float improvedPerlin3DCell(const int xCells[2], const int yCells[2], const int zCells[2], float fracX, float fracY, float fracZ) const noexcept;
 
-	std::vector<float> gradientTable1D;
-	std::vector<std::pair<float, float>> gradientTable2D;
+	//The cells a periodic span crosses, already wrapped into the period and masked into the table, starting from lowestCell
+	//hashes holds the permutation entry for each one, which is all the vector kernels need
+	struct WrappedCells
+	{
+		int period;
+		int lowestCell;
+		const int* cells;
+		const int* hashes;
+	};
 
-	XMFLOAT2 generateGrad(int hash, float x, float y);
+	void improvedPerlinSpanPeriodic(float x0, float dx, float y, int first, int count, float* output, int period) const noexcept;
+	void improvedPerlinSpanScalar(float x0, float dx, float y, int first, int start, int count, float* output, const WrappedCells* wrapped) const noexcept;
+	int improvedPerlinSpanSSE2(float x0, float dx, float y, int first, int count, float* output, const WrappedCells* wrapped) const noexcept;
+	int improvedPerlinSpanAVX2(float x0, float dx, float y, int first, int count, float* output, const WrappedCells* wrapped) const noexcept;
+	int improvedPerlinPointsSSE2(const float* x, const float* y, int count, float* output) const noexcept;
+	int improvedPerlinPointsAVX2(const float* x, const float* y, int count, float* output) const noexcept;
+	int improvedPerlinDerivativeSpanSSE2(float x0, float dx, float y, int first, int count, float* output, float* derivativeX, float* derivativeY) const noexcept;
+	int improvedPerlinDerivativeSpanAVX2(float x0, float dx, float y, int first, int count, float* output, float* derivativeX, float* derivativeY) const noexcept;
 
-	void setupPermutationTable();
-	void setupGradientTables();
+	void setupPermutationTable(uint64_t seed);
+	void setupGradientTables(uint64_t seed);
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+//Identifiers for the independent random streams each generator draws from
+enum class RandomStream : uint64_t
+{
+	Permutation = 1,
+	Gradients,
+	HeightMap,
+	Fault,
+	WindErosion,
+	MarkovChain,
+	Simplex,
+	Worley,
+	DropletErosion
+};
+
+//Counter-based random number generator (SplitMix64 style)
+//Every value is a pure function of a key and a counter, so any stream can be jumped into at any position.
+//That lets work be split between threads or tiles and still give exactly the same numbers as running it in order.
+class Random
+{
+public:
+	Random(uint64_t randomKey = 0, uint64_t startCounter = 0) : key(randomKey), counter(startCounter) {}
+
+	//Builds the key for an independent stream, e.g. deriveKey(seed, tile, octave)
+	static const inline uint64_t deriveKey(uint64_t seed, uint64_t a = 0, uint64_t b = 0)
+	{
+		uint64_t result = mix(seed + 0x9E3779B97F4A7C15ull);
+		result = mix(result ^ (a + 0xD1B54A32D192ED03ull));
+		result = mix(result ^ (b + 0x8CB92BA72F3D8DD7ull));
+
+		return result;
+	}
+
+	static const inline uint64_t deriveKey(uint64_t seed, RandomStream stream, uint64_t b = 0)
+	{
+		return deriveKey(seed, (uint64_t)stream, b);
+	}
+
+	//The value at a given position in a stream, without needing a generator object
+	static const inline uint32_t at(uint64_t randomKey, uint64_t position)
+	{
+		return (uint32_t)(mix(randomKey + position * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	//Uniform integer in [0, upper)
+	static const inline int at(uint64_t randomKey, uint64_t position, int upper)
+	{
+		return (int)(((uint64_t)at(randomKey, position) * (uint64_t)upper) >> 32);
+	}
+
+	uint32_t nextUInt() { return at(key, counter++); }
+	int nextInt(int upper) { return at(key, counter++, upper); }
+	float nextFloat() { return (float)(nextUInt() >> 8) * (1.0f / 16777216.0f); }	//Uniform in [0, 1)
+
+	uint64_t getKey() const { return key; }
+	uint64_t getCounter() const { return counter; }
+
+private:
+	//Stafford's variant 13 of the MurmurHash3 finaliser, as used by SplitMix64
+	static const inline uint64_t mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+		return z ^ (z >> 31);
+	}
+
+	uint64_t key;
+	uint64_t counter;
+};
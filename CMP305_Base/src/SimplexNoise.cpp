@@ -0,0 +1,774 @@
+#include "SimplexNoise.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "NoiseSimd.h"
+
+static const float skew2D = 0.36602540378f;	//(sqrt(3) - 1) / 2, turns the grid of triangles into a grid of squares
+static const float unskew2D = 0.21132486540f;	//(3 - sqrt(3)) / 6, and back again
+static const float skew3D = 1.0f / 3.0f;
+static const float unskew3D = 1.0f / 6.0f;
+
+//The largest value each kernel can reach, found by sampling, so the output spans -1 to 1
+static const float scale2D = 99.83685f;	//Unit gradients with a radius of sqrt(0.5), shared by both 2D generators
+static const float scaleSimplex3D = 76.0f;
+static const float scaleOpenSimplex3D = 32.0f;
+
+//OpenSimplex2 hashes lattice points by multiplying with large odd constants rather than through a table
+static const uint64_t primeX = 0x5205402B9270C86Full;
+static const uint64_t primeY = 0x598CD327003817B5ull;
+static const uint64_t primeZ = 0x5BCC226E9FA0BACBull;
+static const uint64_t hashMultiplier = 0x53A3F72DEEC546F5ull;
+static const uint64_t seedFlip3D = 0xAD2AB84D169129D7ull;	//Separates the two interleaved lattices in 3D
+
+//The twelve edges of a cube, padded to sixteen with four of them again as in improved Perlin noise
+static const float gradients3D[16][3] =
+{
+	{ 1.0f, 1.0f, 0.0f }, { -1.0f, 1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { -1.0f, -1.0f, 0.0f },
+	{ 1.0f, 0.0f, 1.0f }, { -1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, -1.0f },
+	{ 0.0f, 1.0f, 1.0f }, { 0.0f, -1.0f, 1.0f }, { 0.0f, 1.0f, -1.0f }, { 0.0f, -1.0f, -1.0f },
+	{ 1.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, -1.0f }
+};
+
+SimplexNoise::SimplexNoise(uint64_t seed)
+{
+	const float pi = 3.14159265f;
+
+	//Half a step off the axes, so no gradient lines up with the grid
+	for (int g = 0; g < 16; g++)
+	{
+		float angle = ((float)g + 0.5f) * (2.0f * pi / 16.0f);
+		simplexGradientX[g] = cosf(angle);
+		simplexGradientY[g] = sinf(angle);
+	}
+
+	for (int g = 0; g < 32; g++)
+	{
+		float angle = ((float)g + 0.5f) * (2.0f * pi / 32.0f);
+		openGradientX[g] = cosf(angle);
+		openGradientY[g] = sinf(angle);
+	}
+
+	reseed(seed);
+}
+
+SimplexNoise::~SimplexNoise()
+{
+
+}
+
+void SimplexNoise::reseed(uint64_t seed)
+{
+	Random random(Random::deriveKey(seed, RandomStream::Simplex));
+
+	permutationTable.clear();
+
+	for (int i = 0; i < 512; i++)
+	{
+		permutationTable.push_back(i);
+	}
+
+	//Fisher-Yates shuffle
+	for (int i = 511; i > 0; i--)
+	{
+		std::swap(permutationTable[i], permutationTable[random.nextInt(i + 1)]);
+	}
+
+	hashSeed = Random::deriveKey(seed, RandomStream::Simplex, 1);
+}
+
+//One corner's contribution, which fades to nothing at a distance of sqrt(0.5)
+static inline float simplexCorner(float x, float y, float gradientX, float gradientY)
+{
+	float t = 0.5f - x * x - y * y;
+
+	if (t <= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	t = t * t;
+
+	return t * t * (gradientX * x + gradientY * y);
+}
+
+float SimplexNoise::generateSimplex2D(float x, float y) const
+{
+	const int* permutation = permutationTable.data();
+
+	//Skew the point into the square grid to find which cell it is in
+	float s = (x + y) * skew2D;
+	int i = (int)floorf(x + s);
+	int j = (int)floorf(y + s);
+
+	//Then unskew the cell's first corner to get the point's offset from it
+	float t = (float)(i + j) * unskew2D;
+	float x0 = x - ((float)i - t);
+	float y0 = y - ((float)j - t);
+
+	//Each cell is two triangles, the middle corner is a step along whichever axis the point is further along
+	int i1 = x0 > y0 ? 1 : 0;
+	int j1 = 1 - i1;
+
+	float x1 = x0 - (float)i1 + unskew2D;
+	float y1 = y0 - (float)j1 + unskew2D;
+	float x2 = x0 - 1.0f + 2.0f * unskew2D;
+	float y2 = y0 - 1.0f + 2.0f * unskew2D;
+
+	int ii = i & latticeMask;
+	int jj = j & latticeMask;
+
+	int hashes[3] =
+	{
+		permutation[(permutation[ii] + jj) & latticeMask] & 15,
+		permutation[(permutation[(ii + i1) & latticeMask] + ((jj + j1) & latticeMask)) & latticeMask] & 15,
+		permutation[(permutation[(ii + 1) & latticeMask] + ((jj + 1) & latticeMask)) & latticeMask] & 15
+	};
+
+	float n0 = simplexCorner(x0, y0, simplexGradientX[hashes[0]], simplexGradientY[hashes[0]]);
+	float n1 = simplexCorner(x1, y1, simplexGradientX[hashes[1]], simplexGradientY[hashes[1]]);
+	float n2 = simplexCorner(x2, y2, simplexGradientX[hashes[2]], simplexGradientY[hashes[2]]);
+
+	return (n0 + n1 + n2) * scale2D;
+}
+
+float SimplexNoise::generateSimplex3D(float x, float y, float z) const
+{
+	const int* permutation = permutationTable.data();
+
+	float s = (x + y + z) * skew3D;
+	int i = (int)floorf(x + s);
+	int j = (int)floorf(y + s);
+	int k = (int)floorf(z + s);
+
+	float t = (float)(i + j + k) * unskew3D;
+	float offsets[4][3];
+	offsets[0][0] = x - ((float)i - t);
+	offsets[0][1] = y - ((float)j - t);
+	offsets[0][2] = z - ((float)k - t);
+
+	//The cube is six tetrahedra, picked by the order of the offsets along each axis
+	int steps[2][3] = { { 0, 0, 0 }, { 1, 1, 1 } };
+	const float* o = offsets[0];
+
+	if (o[0] >= o[1])
+	{
+		if (o[1] >= o[2]) { steps[0][0] = 1; steps[1][2] = 0; }
+		else if (o[0] >= o[2]) { steps[0][0] = 1; steps[1][1] = 0; }
+		else { steps[0][2] = 1; steps[1][1] = 0; }
+	}
+
+	else
+	{
+		if (o[1] < o[2]) { steps[0][2] = 1; steps[1][0] = 0; }
+		else if (o[0] < o[2]) { steps[0][1] = 1; steps[1][0] = 0; }
+		else { steps[0][1] = 1; steps[1][2] = 0; }
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		offsets[1][axis] = o[axis] - (float)steps[0][axis] + unskew3D;
+		offsets[2][axis] = o[axis] - (float)steps[1][axis] + 2.0f * unskew3D;
+		offsets[3][axis] = o[axis] - 1.0f + 3.0f * unskew3D;
+	}
+
+	const int corners[4][3] = { { 0, 0, 0 }, { steps[0][0], steps[0][1], steps[0][2] }, { steps[1][0], steps[1][1], steps[1][2] }, { 1, 1, 1 } };
+
+	float total = 0.0f;
+
+	for (int c = 0; c < 4; c++)
+	{
+		const float* d = offsets[c];
+		float falloff = 0.5f - d[0] * d[0] - d[1] * d[1] - d[2] * d[2];
+
+		if (falloff <= 0.0f)
+		{
+			continue;
+		}
+
+		int hash = permutation[(permutation[(permutation[(i + corners[c][0]) & latticeMask] + ((j + corners[c][1]) & latticeMask)) & latticeMask] + ((k + corners[c][2]) & latticeMask)) & latticeMask] & 15;
+		const float* gradient = gradients3D[hash];
+
+		falloff *= falloff;
+		total += falloff * falloff * (gradient[0] * d[0] + gradient[1] * d[1] + gradient[2] * d[2]);
+	}
+
+	return total * scaleSimplex3D;
+}
+
+float SimplexNoise::openGradient2D(uint64_t xHash, uint64_t yHash, float dx, float dy) const
+{
+	uint64_t hash = (hashSeed ^ xHash ^ yHash) * hashMultiplier;
+	int g = (int)(hash >> 59);
+
+	return openGradientX[g] * dx + openGradientY[g] * dy;
+}
+
+float SimplexNoise::openGradient3D(uint64_t seed, uint64_t xHash, uint64_t yHash, uint64_t zHash, float dx, float dy, float dz) const
+{
+	uint64_t hash = ((seed ^ xHash) ^ (yHash ^ zHash)) * hashMultiplier;
+	const float* gradient = gradients3D[hash >> 60];
+
+	return gradient[0] * dx + gradient[1] * dy + gradient[2] * dz;
+}
+
+float SimplexNoise::generateOpenSimplex2D(float x, float y) const
+{
+	float s = (x + y) * skew2D;
+	float xs = x + s;
+	float ys = y + s;
+
+	int xsb = (int)floorf(xs);
+	int ysb = (int)floorf(ys);
+	float xi = xs - (float)xsb;
+	float yi = ys - (float)ysb;
+
+	uint64_t xHash = (uint64_t)(int64_t)xsb * primeX;
+	uint64_t yHash = (uint64_t)(int64_t)ysb * primeY;
+
+	float t = (xi + yi) * -unskew2D;
+	float dx0 = xi + t;
+	float dy0 = yi + t;
+
+	float value = 0.0f;
+
+	//The two corners on the cell's diagonal always take part
+	float a0 = 0.5f - dx0 * dx0 - dy0 * dy0;
+
+	if (a0 > 0.0f)
+	{
+		value += (a0 * a0) * (a0 * a0) * openGradient2D(xHash, yHash, dx0, dy0);
+	}
+
+	float dx1 = dx0 - (1.0f - 2.0f * unskew2D);
+	float dy1 = dy0 - (1.0f - 2.0f * unskew2D);
+	float a1 = 0.5f - dx1 * dx1 - dy1 * dy1;
+
+	if (a1 > 0.0f)
+	{
+		value += (a1 * a1) * (a1 * a1) * openGradient2D(xHash + primeX, yHash + primeY, dx1, dy1);
+	}
+
+	//Plus whichever of the other two is on the point's side of it
+	if (dy0 > dx0)
+	{
+		float dx2 = dx0 + unskew2D;
+		float dy2 = dy0 - (1.0f - unskew2D);
+		float a2 = 0.5f - dx2 * dx2 - dy2 * dy2;
+
+		if (a2 > 0.0f)
+		{
+			value += (a2 * a2) * (a2 * a2) * openGradient2D(xHash, yHash + primeY, dx2, dy2);
+		}
+	}
+
+	else
+	{
+		float dx2 = dx0 - (1.0f - unskew2D);
+		float dy2 = dy0 + unskew2D;
+		float a2 = 0.5f - dx2 * dx2 - dy2 * dy2;
+
+		if (a2 > 0.0f)
+		{
+			value += (a2 * a2) * (a2 * a2) * openGradient2D(xHash + primeX, yHash, dx2, dy2);
+		}
+	}
+
+	return value * scale2D;
+}
+
+//Two body-centred cubic lattices offset by half a cell, each point only has to visit the nearest corner of each and one neighbour
+float SimplexNoise::generateOpenSimplex3D(float x, float y, float z) const
+{
+	//Rotate so the lattice's main diagonal points up the y axis rather than along (1, 1, 1)
+	float r = (2.0f / 3.0f) * (x + y + z);
+	float xr = r - x;
+	float yr = r - y;
+	float zr = r - z;
+
+	int xrb = (int)floorf(xr + 0.5f);
+	int yrb = (int)floorf(yr + 0.5f);
+	int zrb = (int)floorf(zr + 0.5f);
+	float xri = xr - (float)xrb;
+	float yri = yr - (float)yrb;
+	float zri = zr - (float)zrb;
+
+	//Which way each axis points back towards the cell, and how far the point is from the face on that side
+	int xSign = xri < 0.0f ? 1 : -1;
+	int ySign = yri < 0.0f ? 1 : -1;
+	int zSign = zri < 0.0f ? 1 : -1;
+	float ax0 = (float)xSign * -xri;
+	float ay0 = (float)ySign * -yri;
+	float az0 = (float)zSign * -zri;
+
+	uint64_t xHash = (uint64_t)(int64_t)xrb * primeX;
+	uint64_t yHash = (uint64_t)(int64_t)yrb * primeY;
+	uint64_t zHash = (uint64_t)(int64_t)zrb * primeZ;
+	uint64_t seed = hashSeed;
+
+	float value = 0.0f;
+	float a = (0.6f - xri * xri) - (yri * yri + zri * zri);
+
+	for (int lattice = 0; ; lattice++)
+	{
+		if (a > 0.0f)
+		{
+			value += (a * a) * (a * a) * openGradient3D(seed, xHash, yHash, zHash, xri, yri, zri);
+		}
+
+		//The neighbour across the face the point is closest to
+		if (ax0 >= ay0 && ax0 >= az0)
+		{
+			float b = a + ax0 + ax0;
+
+			if (b > 1.0f)
+			{
+				b -= 1.0f;
+				value += (b * b) * (b * b) * openGradient3D(seed, xHash - (uint64_t)(int64_t)xSign * primeX, yHash, zHash, xri + (float)xSign, yri, zri);
+			}
+		}
+
+		else if (ay0 > ax0 && ay0 >= az0)
+		{
+			float b = a + ay0 + ay0;
+
+			if (b > 1.0f)
+			{
+				b -= 1.0f;
+				value += (b * b) * (b * b) * openGradient3D(seed, xHash, yHash - (uint64_t)(int64_t)ySign * primeY, zHash, xri, yri + (float)ySign, zri);
+			}
+		}
+
+		else
+		{
+			float b = a + az0 + az0;
+
+			if (b > 1.0f)
+			{
+				b -= 1.0f;
+				value += (b * b) * (b * b) * openGradient3D(seed, xHash, yHash, zHash - (uint64_t)(int64_t)zSign * primeZ, xri, yri, zri + (float)zSign);
+			}
+		}
+
+		if (lattice == 1)
+		{
+			break;
+		}
+
+		//Step to the nearest corner of the second lattice, half a cell over on every axis
+		ax0 = 0.5f - ax0;
+		ay0 = 0.5f - ay0;
+		az0 = 0.5f - az0;
+
+		xri = (float)xSign * ax0;
+		yri = (float)ySign * ay0;
+		zri = (float)zSign * az0;
+
+		a += (0.75f - ax0) - (ay0 + az0);
+
+		xHash += xSign < 0 ? primeX : 0;
+		yHash += ySign < 0 ? primeY : 0;
+		zHash += zSign < 0 ? primeZ : 0;
+
+		xSign = -xSign;
+		ySign = -ySign;
+		zSign = -zSign;
+
+		seed ^= seedFlip3D;
+	}
+
+	return value * scaleOpenSimplex3D;
+}
+
+void SimplexNoise::generateSimplexSpan(float x0, float dx, float y, int count, float* output, int first) const
+{
+	int done = 0;
+
+	if (simdLevel == SimdLevel::AVX2)
+	{
+		done = simplexSpanAVX2(x0, dx, y, first, count, output);
+	}
+
+	else if (simdLevel == SimdLevel::SSE2)
+	{
+		done = simplexSpanSSE2(x0, dx, y, first, count, output);
+	}
+
+	for (int n = done; n < count; n++)
+	{
+		output[n] = generateSimplex2D(x0 + (float)(first + n) * dx, y);
+	}
+}
+
+//The 64-bit multiplies in OpenSimplex2's hash have no SSE2 or AVX2 equivalent, so its spans stay scalar
+void SimplexNoise::generateOpenSimplexSpan(float x0, float dx, float y, int count, float* output, int first) const
+{
+	for (int n = 0; n < count; n++)
+	{
+		output[n] = generateOpenSimplex2D(x0 + (float)(first + n) * dx, y);
+	}
+}
+
+void SimplexNoise::generateSimplex3DSpan(float x0, float dx, float y, float z, int count, float* output, int first) const
+{
+	int done = 0;
+
+	if (simdLevel == SimdLevel::AVX2)
+	{
+		done = simplex3DSpanAVX2(x0, dx, y, z, first, count, output);
+	}
+
+	else if (simdLevel == SimdLevel::SSE2)
+	{
+		done = simplex3DSpanSSE2(x0, dx, y, z, first, count, output);
+	}
+
+	for (int n = done; n < count; n++)
+	{
+		output[n] = generateSimplex3D(x0 + (float)(first + n) * dx, y, z);
+	}
+}
+
+void SimplexNoise::generateOpenSimplex3DSpan(float x0, float dx, float y, float z, int count, float* output, int first) const
+{
+	for (int n = 0; n < count; n++)
+	{
+		output[n] = generateOpenSimplex3D(x0 + (float)(first + n) * dx, y, z);
+	}
+}
+
+//The vector kernels repeat the scalar arithmetic operation for operation, so they give the same results
+//A corner that is too far away is masked to zero rather than skipped
+
+static inline __m128 simplexCornerSSE2(__m128 x, __m128 y, __m128 gradientX, __m128 gradientY)
+{
+	__m128 t = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+	__m128 inside = _mm_cmpgt_ps(t, _mm_setzero_ps());
+
+	t = _mm_mul_ps(t, t);
+
+	__m128 dot = _mm_add_ps(_mm_mul_ps(gradientX, x), _mm_mul_ps(gradientY, y));
+
+	return _mm_and_ps(inside, _mm_mul_ps(_mm_mul_ps(t, t), dot));
+}
+
+int SimplexNoise::simplexSpanSSE2(float x0, float dx, float y, int first, int count, float* output) const
+{
+	const int* permutation = permutationTable.data();
+
+	const __m128 yv = _mm_set1_ps(y);
+	const __m128 skew = _mm_set1_ps(skew2D);
+	const __m128 unskew = _mm_set1_ps(unskew2D);
+	const __m128 secondUnskew = _mm_set1_ps(2.0f * unskew2D);
+	const __m128 oneFloat = _mm_set1_ps(1.0f);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i fifteen = _mm_set1_epi32(15);
+	const __m128 step = _mm_set1_ps(dx);
+	const __m128 start = _mm_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 index = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + n), _mm_set_epi32(3, 2, 1, 0)));
+		__m128 x = _mm_add_ps(start, _mm_mul_ps(index, step));
+
+		__m128 s = _mm_mul_ps(_mm_add_ps(x, yv), skew);
+		__m128i i = floorSSE2(_mm_add_ps(x, s));
+		__m128i j = floorSSE2(_mm_add_ps(yv, s));
+
+		__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), unskew);
+		__m128 xOffset = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+		__m128 yOffset = _mm_sub_ps(yv, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+		__m128 alongX = _mm_cmpgt_ps(xOffset, yOffset);
+		__m128i i1 = _mm_and_si128(_mm_castps_si128(alongX), one);
+		__m128i j1 = _mm_sub_epi32(one, i1);
+
+		__m128 x1 = _mm_add_ps(_mm_sub_ps(xOffset, _mm_cvtepi32_ps(i1)), unskew);
+		__m128 y1 = _mm_add_ps(_mm_sub_ps(yOffset, _mm_cvtepi32_ps(j1)), unskew);
+		__m128 x2 = _mm_add_ps(_mm_sub_ps(xOffset, oneFloat), secondUnskew);
+		__m128 y2 = _mm_add_ps(_mm_sub_ps(yOffset, oneFloat), secondUnskew);
+
+		__m128i ii = wrapLatticeSSE2(i);
+		__m128i jj = wrapLatticeSSE2(j);
+
+		__m128i h0 = _mm_and_si128(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(gatherSSE2(permutation, ii), jj))), fifteen);
+		__m128i h1 = _mm_and_si128(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(ii, i1))), wrapLatticeSSE2(_mm_add_epi32(jj, j1))))), fifteen);
+		__m128i h2 = _mm_and_si128(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(ii, one))), wrapLatticeSSE2(_mm_add_epi32(jj, one))))), fifteen);
+
+		__m128 n0 = simplexCornerSSE2(xOffset, yOffset, gatherSSE2(simplexGradientX, h0), gatherSSE2(simplexGradientY, h0));
+		__m128 n1 = simplexCornerSSE2(x1, y1, gatherSSE2(simplexGradientX, h1), gatherSSE2(simplexGradientY, h1));
+		__m128 n2 = simplexCornerSSE2(x2, y2, gatherSSE2(simplexGradientX, h2), gatherSSE2(simplexGradientY, h2));
+
+		_mm_storeu_ps(&output[n], _mm_mul_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), _mm_set1_ps(scale2D)));
+	}
+
+	return n;
+}
+
+static inline __m256 simplexCornerAVX2(__m256 x, __m256 y, __m256 gradientX, __m256 gradientY)
+{
+	__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+	__m256 inside = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+	t = _mm256_mul_ps(t, t);
+
+	__m256 dot = _mm256_add_ps(_mm256_mul_ps(gradientX, x), _mm256_mul_ps(gradientY, y));
+
+	return _mm256_and_ps(inside, _mm256_mul_ps(_mm256_mul_ps(t, t), dot));
+}
+
+int SimplexNoise::simplexSpanAVX2(float x0, float dx, float y, int first, int count, float* output) const
+{
+	const int* permutation = permutationTable.data();
+
+	const __m256 yv = _mm256_set1_ps(y);
+	const __m256 skew = _mm256_set1_ps(skew2D);
+	const __m256 unskew = _mm256_set1_ps(unskew2D);
+	const __m256 secondUnskew = _mm256_set1_ps(2.0f * unskew2D);
+	const __m256 oneFloat = _mm256_set1_ps(1.0f);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i fifteen = _mm256_set1_epi32(15);
+	const __m256 step = _mm256_set1_ps(dx);
+	const __m256 start = _mm256_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 index = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(first + n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+		__m256 x = _mm256_add_ps(start, _mm256_mul_ps(index, step));
+
+		__m256 s = _mm256_mul_ps(_mm256_add_ps(x, yv), skew);
+		__m256 iFloor = _mm256_floor_ps(_mm256_add_ps(x, s));
+		__m256 jFloor = _mm256_floor_ps(_mm256_add_ps(yv, s));
+		__m256i i = _mm256_cvttps_epi32(iFloor);
+		__m256i j = _mm256_cvttps_epi32(jFloor);
+
+		__m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(i, j)), unskew);
+		__m256 xOffset = _mm256_sub_ps(x, _mm256_sub_ps(iFloor, t));
+		__m256 yOffset = _mm256_sub_ps(yv, _mm256_sub_ps(jFloor, t));
+
+		__m256 alongX = _mm256_cmp_ps(xOffset, yOffset, _CMP_GT_OQ);
+		__m256i i1 = _mm256_and_si256(_mm256_castps_si256(alongX), one);
+		__m256i j1 = _mm256_sub_epi32(one, i1);
+
+		__m256 x1 = _mm256_add_ps(_mm256_sub_ps(xOffset, _mm256_cvtepi32_ps(i1)), unskew);
+		__m256 y1 = _mm256_add_ps(_mm256_sub_ps(yOffset, _mm256_cvtepi32_ps(j1)), unskew);
+		__m256 x2 = _mm256_add_ps(_mm256_sub_ps(xOffset, oneFloat), secondUnskew);
+		__m256 y2 = _mm256_add_ps(_mm256_sub_ps(yOffset, oneFloat), secondUnskew);
+
+		__m256i ii = wrapLatticeAVX2(i);
+		__m256i jj = wrapLatticeAVX2(j);
+
+		__m256i h0 = _mm256_and_si256(_mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(_mm256_i32gather_epi32(permutation, ii, 4), jj)), 4), fifteen);
+		__m256i h1 = _mm256_and_si256(_mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(_mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(ii, i1)), 4), wrapLatticeAVX2(_mm256_add_epi32(jj, j1)))), 4), fifteen);
+		__m256i h2 = _mm256_and_si256(_mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(_mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(ii, one)), 4), wrapLatticeAVX2(_mm256_add_epi32(jj, one)))), 4), fifteen);
+
+		__m256 n0 = simplexCornerAVX2(xOffset, yOffset, _mm256_i32gather_ps(simplexGradientX, h0, 4), _mm256_i32gather_ps(simplexGradientY, h0, 4));
+		__m256 n1 = simplexCornerAVX2(x1, y1, _mm256_i32gather_ps(simplexGradientX, h1, 4), _mm256_i32gather_ps(simplexGradientY, h1, 4));
+		__m256 n2 = simplexCornerAVX2(x2, y2, _mm256_i32gather_ps(simplexGradientX, h2, 4), _mm256_i32gather_ps(simplexGradientY, h2, 4));
+
+		_mm256_storeu_ps(&output[n], _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), _mm256_set1_ps(scale2D)));
+	}
+
+	//Avoids the penalty for switching back to the non-VEX encoded SSE code that follows
+	_mm256_zeroupper();
+
+	return n;
+}
+
+//In 3D the tetrahedron is picked from three comparisons of the offsets rather than branches, each step is whether that axis comes before the other two
+//The gradients are read from gradients3D as a flat table, three floats to a hash
+
+static inline __m128 simplex3DCornerSSE2(const float* gradients, __m128i hash, __m128 x, __m128 y, __m128 z)
+{
+	__m128 falloff = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+	__m128 inside = _mm_cmpgt_ps(falloff, _mm_setzero_ps());
+
+	falloff = _mm_mul_ps(falloff, falloff);
+
+	__m128i row = _mm_add_epi32(_mm_slli_epi32(hash, 1), hash);
+	__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gatherSSE2(gradients, row), x), _mm_mul_ps(gatherSSE2(gradients, _mm_add_epi32(row, _mm_set1_epi32(1))), y)),
+		_mm_mul_ps(gatherSSE2(gradients, _mm_add_epi32(row, _mm_set1_epi32(2))), z));
+
+	return _mm_and_ps(inside, _mm_mul_ps(_mm_mul_ps(falloff, falloff), dot));
+}
+
+int SimplexNoise::simplex3DSpanSSE2(float x0, float dx, float y, float z, int first, int count, float* output) const
+{
+	const int* permutation = permutationTable.data();
+	const float* gradients = &gradients3D[0][0];
+
+	const __m128 yv = _mm_set1_ps(y);
+	const __m128 zv = _mm_set1_ps(z);
+	const __m128 skew = _mm_set1_ps(skew3D);
+	const __m128 unskew = _mm_set1_ps(unskew3D);
+	const __m128 secondUnskew = _mm_set1_ps(2.0f * unskew3D);
+	const __m128 thirdUnskew = _mm_set1_ps(3.0f * unskew3D);
+	const __m128 oneFloat = _mm_set1_ps(1.0f);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i fifteen = _mm_set1_epi32(15);
+	const __m128 step = _mm_set1_ps(dx);
+	const __m128 start = _mm_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 index = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + n), _mm_set_epi32(3, 2, 1, 0)));
+		__m128 x = _mm_add_ps(start, _mm_mul_ps(index, step));
+
+		__m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, yv), zv), skew);
+		__m128i i = floorSSE2(_mm_add_ps(x, s));
+		__m128i j = floorSSE2(_mm_add_ps(yv, s));
+		__m128i k = floorSSE2(_mm_add_ps(zv, s));
+
+		__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), unskew);
+		__m128 xOffset = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+		__m128 yOffset = _mm_sub_ps(yv, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+		__m128 zOffset = _mm_sub_ps(zv, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+		__m128i xy = _mm_castps_si128(_mm_cmpge_ps(xOffset, yOffset));
+		__m128i xz = _mm_castps_si128(_mm_cmpge_ps(xOffset, zOffset));
+		__m128i yz = _mm_castps_si128(_mm_cmpge_ps(yOffset, zOffset));
+
+		__m128i i1 = _mm_and_si128(_mm_and_si128(xy, xz), one);
+		__m128i j1 = _mm_and_si128(_mm_andnot_si128(xy, yz), one);
+		__m128i k1 = _mm_andnot_si128(_mm_or_si128(xz, yz), one);
+		__m128i i2 = _mm_and_si128(_mm_or_si128(xy, xz), one);
+		__m128i j2 = _mm_andnot_si128(_mm_andnot_si128(yz, xy), one);
+		__m128i k2 = _mm_andnot_si128(_mm_and_si128(xz, yz), one);
+
+		__m128 x1 = _mm_add_ps(_mm_sub_ps(xOffset, _mm_cvtepi32_ps(i1)), unskew);
+		__m128 y1 = _mm_add_ps(_mm_sub_ps(yOffset, _mm_cvtepi32_ps(j1)), unskew);
+		__m128 z1 = _mm_add_ps(_mm_sub_ps(zOffset, _mm_cvtepi32_ps(k1)), unskew);
+		__m128 x2 = _mm_add_ps(_mm_sub_ps(xOffset, _mm_cvtepi32_ps(i2)), secondUnskew);
+		__m128 y2 = _mm_add_ps(_mm_sub_ps(yOffset, _mm_cvtepi32_ps(j2)), secondUnskew);
+		__m128 z2 = _mm_add_ps(_mm_sub_ps(zOffset, _mm_cvtepi32_ps(k2)), secondUnskew);
+		__m128 x3 = _mm_add_ps(_mm_sub_ps(xOffset, oneFloat), thirdUnskew);
+		__m128 y3 = _mm_add_ps(_mm_sub_ps(yOffset, oneFloat), thirdUnskew);
+		__m128 z3 = _mm_add_ps(_mm_sub_ps(zOffset, oneFloat), thirdUnskew);
+
+		const __m128i corners[4][3] = { { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() }, { i1, j1, k1 }, { i2, j2, k2 }, { one, one, one } };
+		__m128i hashes[4];
+
+		for (int c = 0; c < 4; c++)
+		{
+			__m128i hash = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(i, corners[c][0])));
+			hash = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(hash, wrapLatticeSSE2(_mm_add_epi32(j, corners[c][1])))));
+			hash = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(hash, wrapLatticeSSE2(_mm_add_epi32(k, corners[c][2])))));
+			hashes[c] = _mm_and_si128(hash, fifteen);
+		}
+
+		__m128 total = _mm_setzero_ps();
+		total = _mm_add_ps(total, simplex3DCornerSSE2(gradients, hashes[0], xOffset, yOffset, zOffset));
+		total = _mm_add_ps(total, simplex3DCornerSSE2(gradients, hashes[1], x1, y1, z1));
+		total = _mm_add_ps(total, simplex3DCornerSSE2(gradients, hashes[2], x2, y2, z2));
+		total = _mm_add_ps(total, simplex3DCornerSSE2(gradients, hashes[3], x3, y3, z3));
+
+		_mm_storeu_ps(&output[n], _mm_mul_ps(total, _mm_set1_ps(scaleSimplex3D)));
+	}
+
+	return n;
+}
+
+static inline __m256 simplex3DCornerAVX2(const float* gradients, __m256i hash, __m256 x, __m256 y, __m256 z)
+{
+	__m256 falloff = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+	__m256 inside = _mm256_cmp_ps(falloff, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+	falloff = _mm256_mul_ps(falloff, falloff);
+
+	__m256i row = _mm256_add_epi32(_mm256_slli_epi32(hash, 1), hash);
+	__m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(gradients, row, 4), x), _mm256_mul_ps(_mm256_i32gather_ps(gradients + 1, row, 4), y)),
+		_mm256_mul_ps(_mm256_i32gather_ps(gradients + 2, row, 4), z));
+
+	return _mm256_and_ps(inside, _mm256_mul_ps(_mm256_mul_ps(falloff, falloff), dot));
+}
+
+int SimplexNoise::simplex3DSpanAVX2(float x0, float dx, float y, float z, int first, int count, float* output) const
+{
+	const int* permutation = permutationTable.data();
+	const float* gradients = &gradients3D[0][0];
+
+	const __m256 yv = _mm256_set1_ps(y);
+	const __m256 zv = _mm256_set1_ps(z);
+	const __m256 skew = _mm256_set1_ps(skew3D);
+	const __m256 unskew = _mm256_set1_ps(unskew3D);
+	const __m256 secondUnskew = _mm256_set1_ps(2.0f * unskew3D);
+	const __m256 thirdUnskew = _mm256_set1_ps(3.0f * unskew3D);
+	const __m256 oneFloat = _mm256_set1_ps(1.0f);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i fifteen = _mm256_set1_epi32(15);
+	const __m256 step = _mm256_set1_ps(dx);
+	const __m256 start = _mm256_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 index = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(first + n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+		__m256 x = _mm256_add_ps(start, _mm256_mul_ps(index, step));
+
+		__m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, yv), zv), skew);
+		__m256 iFloor = _mm256_floor_ps(_mm256_add_ps(x, s));
+		__m256 jFloor = _mm256_floor_ps(_mm256_add_ps(yv, s));
+		__m256 kFloor = _mm256_floor_ps(_mm256_add_ps(zv, s));
+		__m256i i = _mm256_cvttps_epi32(iFloor);
+		__m256i j = _mm256_cvttps_epi32(jFloor);
+		__m256i k = _mm256_cvttps_epi32(kFloor);
+
+		__m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(i, j), k)), unskew);
+		__m256 xOffset = _mm256_sub_ps(x, _mm256_sub_ps(iFloor, t));
+		__m256 yOffset = _mm256_sub_ps(yv, _mm256_sub_ps(jFloor, t));
+		__m256 zOffset = _mm256_sub_ps(zv, _mm256_sub_ps(kFloor, t));
+
+		__m256i xy = _mm256_castps_si256(_mm256_cmp_ps(xOffset, yOffset, _CMP_GE_OQ));
+		__m256i xz = _mm256_castps_si256(_mm256_cmp_ps(xOffset, zOffset, _CMP_GE_OQ));
+		__m256i yz = _mm256_castps_si256(_mm256_cmp_ps(yOffset, zOffset, _CMP_GE_OQ));
+
+		__m256i i1 = _mm256_and_si256(_mm256_and_si256(xy, xz), one);
+		__m256i j1 = _mm256_and_si256(_mm256_andnot_si256(xy, yz), one);
+		__m256i k1 = _mm256_andnot_si256(_mm256_or_si256(xz, yz), one);
+		__m256i i2 = _mm256_and_si256(_mm256_or_si256(xy, xz), one);
+		__m256i j2 = _mm256_andnot_si256(_mm256_andnot_si256(yz, xy), one);
+		__m256i k2 = _mm256_andnot_si256(_mm256_and_si256(xz, yz), one);
+
+		__m256 x1 = _mm256_add_ps(_mm256_sub_ps(xOffset, _mm256_cvtepi32_ps(i1)), unskew);
+		__m256 y1 = _mm256_add_ps(_mm256_sub_ps(yOffset, _mm256_cvtepi32_ps(j1)), unskew);
+		__m256 z1 = _mm256_add_ps(_mm256_sub_ps(zOffset, _mm256_cvtepi32_ps(k1)), unskew);
+		__m256 x2 = _mm256_add_ps(_mm256_sub_ps(xOffset, _mm256_cvtepi32_ps(i2)), secondUnskew);
+		__m256 y2 = _mm256_add_ps(_mm256_sub_ps(yOffset, _mm256_cvtepi32_ps(j2)), secondUnskew);
+		__m256 z2 = _mm256_add_ps(_mm256_sub_ps(zOffset, _mm256_cvtepi32_ps(k2)), secondUnskew);
+		__m256 x3 = _mm256_add_ps(_mm256_sub_ps(xOffset, oneFloat), thirdUnskew);
+		__m256 y3 = _mm256_add_ps(_mm256_sub_ps(yOffset, oneFloat), thirdUnskew);
+		__m256 z3 = _mm256_add_ps(_mm256_sub_ps(zOffset, oneFloat), thirdUnskew);
+
+		const __m256i corners[4][3] = { { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() }, { i1, j1, k1 }, { i2, j2, k2 }, { one, one, one } };
+		__m256i hashes[4];
+
+		for (int c = 0; c < 4; c++)
+		{
+			__m256i hash = _mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(i, corners[c][0])), 4);
+			hash = _mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(hash, wrapLatticeAVX2(_mm256_add_epi32(j, corners[c][1])))), 4);
+			hash = _mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(hash, wrapLatticeAVX2(_mm256_add_epi32(k, corners[c][2])))), 4);
+			hashes[c] = _mm256_and_si256(hash, fifteen);
+		}
+
+		__m256 total = _mm256_setzero_ps();
+		total = _mm256_add_ps(total, simplex3DCornerAVX2(gradients, hashes[0], xOffset, yOffset, zOffset));
+		total = _mm256_add_ps(total, simplex3DCornerAVX2(gradients, hashes[1], x1, y1, z1));
+		total = _mm256_add_ps(total, simplex3DCornerAVX2(gradients, hashes[2], x2, y2, z2));
+		total = _mm256_add_ps(total, simplex3DCornerAVX2(gradients, hashes[3], x3, y3, z3));
+
+		_mm256_storeu_ps(&output[n], _mm256_mul_ps(total, _mm256_set1_ps(scaleSimplex3D)));
+	}
+
+	//Avoids the penalty for switching back to the non-VEX encoded SSE code that follows
+	_mm256_zeroupper();
+
+	return n;
+}
\ No newline at end of file
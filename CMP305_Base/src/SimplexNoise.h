@@ -0,0 +1,60 @@
+#pragma once
+
+#include "DXF.h"
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "Random.h"
+
+//Noise built on triangles (tetrahedra in 3D) rather than squares, so each sample blends three corners instead of four
+//Simplex is Ken Perlin's 2001 design hashed through a permutation table like PerlinNoise
+//OpenSimplex2 (the fast variant) hashes lattice points with large primes instead and uses a different lattice in 3D, trading a little speed for fewer axis-aligned artefacts
+//Every generator returns values in roughly -1 to 1
+class SimplexNoise
+{
+public:
+	SimplexNoise(uint64_t seed = 0);
+	~SimplexNoise();
+
+	//Rebuilds the permutation table and the hashing seed, the same seed always gives the same noise
+	void reseed(uint64_t seed);
+
+	float generateSimplex2D(float x, float y) const;
+	float generateSimplex3D(float x, float y, float z) const;
+
+	float generateOpenSimplex2D(float x, float y) const;
+	float generateOpenSimplex3D(float x, float y, float z) const;
+
+	//Fill output with count samples along a row, the n-th one taken at (x0 + (first + n) * dx, y), like PerlinNoise's spans
+	void generateSimplexSpan(float x0, float dx, float y, int count, float* output, int first = 0) const;
+	void generateOpenSimplexSpan(float x0, float dx, float y, int count, float* output, int first = 0) const;
+
+	//The same along x through a volume, the n-th sample taken at (x0 + (first + n) * dx, y, z), like PerlinNoise's 3D span
+	void generateSimplex3DSpan(float x0, float dx, float y, float z, int count, float* output, int first = 0) const;
+	void generateOpenSimplex3DSpan(float x0, float dx, float y, float z, int count, float* output, int first = 0) const;
+
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+
+private:
+	static const int latticeMask = 511;
+
+	std::vector<int> permutationTable;
+	uint64_t hashSeed = 0;
+
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
+
+	//Unit gradients spread evenly around the circle, 16 for Simplex and 32 for OpenSimplex2
+	float simplexGradientX[16];
+	float simplexGradientY[16];
+	float openGradientX[32];
+	float openGradientY[32];
+
+	float openGradient2D(uint64_t xHash, uint64_t yHash, float dx, float dy) const;
+	float openGradient3D(uint64_t seed, uint64_t xHash, uint64_t yHash, uint64_t zHash, float dx, float dy, float dz) const;
+
+	int simplexSpanSSE2(float x0, float dx, float y, int first, int count, float* output) const;
+	int simplexSpanAVX2(float x0, float dx, float y, int first, int count, float* output) const;
+	int simplex3DSpanSSE2(float x0, float dx, float y, float z, int first, int count, float* output) const;
+	int simplex3DSpanAVX2(float x0, float dx, float y, float z, int first, int count, float* output) const;
+};
\ No newline at end of file
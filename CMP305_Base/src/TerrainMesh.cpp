@@ -1,8 +1,22 @@
 #include "TerrainMesh.h"
 
+#include <algorithm>
+#include <utility>
+
 TerrainMesh::TerrainMesh( ID3D11Device* device, ID3D11DeviceContext* deviceContext, int lresolution ) :
 	PlaneMesh( device, deviceContext, lresolution ) 
 {
+	//PlaneMesh builds its own buffers, which the chunks replace
+	if( vertexBuffer != NULL ) {
+		vertexBuffer->Release();
+		vertexBuffer = NULL;
+	}
+
+	if( indexBuffer != NULL ) {
+		indexBuffer->Release();
+		indexBuffer = NULL;
+	}
+
 	Resize( resolution );
 	Regenerate( device, deviceContext );
 
@@ -17,6 +31,13 @@ TerrainMesh::~TerrainMesh()
 	heightMap = 0;
 	delete[] sedimentMap;
 	sedimentMap = 0;
+	delete[] slopeMap;
+	slopeMap = 0;
+	delete[] vertices;
+	vertices = 0;
+
+	ReleaseChunks();
+	ReleaseIndexBuffers();
 }
 
 
@@ -41,6 +62,8 @@ void TerrainMesh::BuildHeightMap()
 			sedimentMap[(i * resolution) + j] = 0.0f;
 		}
 	}	
+
+	MarkAllDirty();
 }
 
 void TerrainMesh::Resize( int newResolution )
@@ -54,43 +77,122 @@ void TerrainMesh::Resize( int newResolution )
 
 	heightMap = new float[resolution * resolution];
 
-	if( vertexBuffer != NULL )
-	{
-		vertexBuffer->Release();
-	}
-
-	vertexBuffer = NULL;
+	ReleaseChunks();
 
 	if (sedimentMap)
 	{
 		delete[] sedimentMap;
 	}
 
-	sedimentMap = new float[resolution * resolution];
+	//Zeroed as the erosion reads it, a new map has no sediment on it yet
+	sedimentMap = new float[resolution * resolution]();
+
+	delete[] slopeMap;
+	slopeMap = new float[resolution * resolution * 2];
+
+	warpCached = false;
+
+	delete[] vertices;
+	vertices = new VertexType[resolution * resolution];
+
+	MarkAllDirty();
 }
 
 // Set up the heightmap and create or update the appropriate buffers
 void TerrainMesh::Regenerate( ID3D11Device * device, ID3D11DeviceContext * deviceContext )
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	int index, i, j;
-	float positionX, height, positionZ, u, v, increment;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	
 	//Calculate and store the height values
 	//BuildHeightMap();
 
+	//After a resize the whole layout has to be built again, otherwise only the edited heights are refreshed
+	const bool rebuild = chunks.empty();
+
+	if( rebuild ) {
+		BuildVertexLayout();
+		BuildChunks();
+		MarkAllDirty();
+	}
+
+	if( dirtyRegion.isEmpty() ) {
+		return;
+	}
+
+	//Normals are averaged from the quads around each vertex, so they change one cell further out than the heights
+	HeightMapRegion normalRegion = dirtyRegion.expanded( 1, resolution );
+
+	UpdateVertices( dirtyRegion );
+	UpdateChunkMetrics( dirtyRegion );
+
+	//If we've not yet created our Vertex and Index buffers, do that now
+	//Only the vertex buffers depend on the heights, the index buffers are reused whenever a chunk size has been seen before
+	if( rebuild ) {
+		CreateBuffers( device, vertices );
+	}
+	else {
+		//If we've already made our buffers, only send along the vertices that changed
+		UploadVertices( deviceContext, normalRegion );
+	}
+
+	dirtyRegion = HeightMapRegion();
+}
+
+void TerrainMesh::Cull( const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection )
+{
+	Frustum frustum( world, view, projection );
+
+	visibleChunks.clear();
+
+	for( int c = 0; c < (int)chunks.size(); c++ ) {
+		if( frustum.intersects( chunks[c].boundsMin, chunks[c].boundsMax ) ) {
+			visibleChunks.push_back( c );
+		}
+	}
+
+	drawnChunks.clear();
+
+	for( int c : visibleChunks ) {
+		drawnChunks.push_back( &chunks[c] );
+	}
+}
+
+void TerrainMesh::sendChunkData( ID3D11DeviceContext* deviceContext, int drawnChunk, D3D_PRIMITIVE_TOPOLOGY top )
+{
+	const TerrainChunk& chunk = *drawnChunks[drawnChunk];
+
+	unsigned int stride;
+	unsigned int offset;
+
+	// Set vertex buffer stride and offset.
+	stride = sizeof( VertexType );
+	offset = 0;
+
+	deviceContext->IASetVertexBuffers( 0, 1, &chunk.vertexBuffer, &stride, &offset );
+	deviceContext->IASetIndexBuffer( chunk.indexBuffer, chunk.indexFormat, 0 );
+	deviceContext->IASetPrimitiveTopology( top );
+}
+
+void TerrainMesh::MarkDirty( int minX, int minY, int maxX, int maxY )
+{
+	dirtyRegion.include( minX, minY, maxX, maxY );
+	dirtyRegion = dirtyRegion.expanded( 0, resolution );
+	slopesValid = false;
+}
+
+void TerrainMesh::MarkAllDirty()
+{
+	MarkDirty( 0, 0, resolution - 1, resolution - 1 );
+}
+
+//Fill in the parts of each vertex that only depend on the resolution, positions on the plane and UV coords
+void TerrainMesh::BuildVertexLayout()
+{
+	int index, i, j;
+	float positionX, positionZ, u, v, increment;
+
 	// Calculate the number of vertices in the terrain mesh.
 	// We share vertices in this mesh, so the vertex count is simply the terrain 'resolution'
-	// and the index count is the number of resulting triangles * 3 OR the number of quads * 6
 	vertexCount = resolution * resolution;
 
-	indexCount = ( ( resolution - 1 ) * ( resolution - 1 ) ) * 6;
-	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-
 	index = 0;
 
 	// UV coords.
@@ -107,8 +209,7 @@ void TerrainMesh::Regenerate( ID3D11Device * device, ID3D11DeviceContext * devic
 			positionX = (float)i * scale;
 			positionZ = (float)( j ) * scale;
 
-			height = heightMap[index];
-			vertices[index].position = XMFLOAT3( positionX, height, positionZ );
+			vertices[index].position = XMFLOAT3( positionX, 0.0f, positionZ );
 			vertices[index].texture = XMFLOAT2( u, v );
 
 			u += increment;
@@ -117,128 +218,550 @@ void TerrainMesh::Regenerate( ID3D11Device * device, ID3D11DeviceContext * devic
 		u = 0;
 		v += increment;
 	}
+}
 
-	//Set up index list
-	index = 0;
-	for( j = 0; j < ( resolution - 1 ); j++ ) {
-		for( i = 0; i < ( resolution - 1 ); i++ ) {
+//Refresh the heights in a region, then the face and smoothed normals that depend on them
+void TerrainMesh::UpdateVertices( const HeightMapRegion& region )
+{
+	//Normals depend on the neighbouring heights, so they change one vertex further out
+	HeightMapRegion normalRegion = region.expanded( 1, resolution );
 
-			//Build index array
-			indices[index] = ( j*resolution ) + i;
-			indices[index + 1] = ( ( j + 1 ) * resolution ) + ( i + 1 );
-			indices[index + 2] = ( ( j + 1 ) * resolution ) + i;
-
-			indices[index + 3] = ( j * resolution ) + i;
-			indices[index + 4] = ( j * resolution ) + ( i + 1 );
-			indices[index + 5] = ( ( j + 1 ) * resolution ) + ( i + 1 );
-			index += 6;
-		}
-	}
-
-	//Set up normals
-	for( j = 0; j < ( resolution - 1 ); j++ ) {
-		for( i = 0; i < ( resolution - 1 ); i++ ) {
-			//Calculate the plane normals
-			XMFLOAT3 a, b, c;	//Three corner vertices
-			a = vertices[j * resolution + i].position;
-			b = vertices[j * resolution + i + 1].position;
-			c = vertices[( j + 1 ) * resolution + i].position;
-
-			//Two edges
-			XMFLOAT3 ab( c.x - a.x, c.y - a.y, c.z - a.z );
-			XMFLOAT3 ac( b.x - a.x, b.y - a.y, b.z - a.z );
-			
-			//Calculate the cross product
-			XMFLOAT3 cross;
-			cross.x = ab.y * ac.z - ab.z * ac.y;
-			cross.y = ab.z * ac.x - ab.x * ac.z;
-			cross.z = ab.x * ac.y - ab.y * ac.x;
-			float mag = ( cross.x * cross.x ) + ( cross.y * cross.y ) + ( cross.z * cross.z );
-			mag = sqrtf( mag );
-			cross.x/= mag;
-			cross.y /= mag;
-			cross.z /= mag;
-			vertices[j * resolution + i].normal = cross;
-		}
-	}
-
-	//Smooth the normals by averaging the normals from the surrounding planes
-	XMFLOAT3 smoothedNormal( 0, 1, 0 );
-	for( j = 0; j < resolution; j++ ) {
-		for( i = 0; i < resolution; i++ ) {
-			smoothedNormal.x = 0;
-			smoothedNormal.y = 0;
-			smoothedNormal.z = 0;
-			float count = 0;
-			//Left planes
-			if( ( i - 1 ) >= 0 ) {
-				//Top planes
-				if( ( j ) < ( resolution - 1 ) ) {
-					smoothedNormal.x += vertices[j * resolution + ( i - 1 )].normal.x;
-					smoothedNormal.y += vertices[j * resolution + ( i - 1 )].normal.y;
-					smoothedNormal.z += vertices[j * resolution + ( i - 1 )].normal.z;
-					count++;
+	for( int j = region.minY; j <= region.maxY; j++ ) {
+		for( int i = region.minX; i <= region.maxX; i++ ) {
+			vertices[j * resolution + i].position.y = heightMap[j * resolution + i];
+		}
+	}
+
+	//Set up normals, straight from the height map a band of rows at a time
+	const float scale = terrainSize / (float)resolution;
+	const int stride = sizeof( VertexType ) / sizeof( float );
+
+	workers.parallelFor( normalRegion.maxY - normalRegion.minY + 1, [&]( int start, int end ) {
+		if( slopesValid ) {
+			normalGenerator.generateFromSlopes( slopeMap, &slopeMap[resolution * resolution], resolution, normalRegion.minY + start, normalRegion.minY + end, normalRegion.minX, normalRegion.maxX + 1, &vertices[0].normal.x, stride );
+		}
+		else {
+			normalGenerator.generate( heightMap, resolution, scale, normalRegion.minY + start, normalRegion.minY + end, normalRegion.minX, normalRegion.maxX + 1, &vertices[0].normal.x, stride );
+		}
+	} );
+}
+
+//Split the grid into chunks of up to chunkQuads quads a side, the last row and column of chunks take whatever is left over
+void TerrainMesh::BuildChunks()
+{
+	const int quads = resolution - 1;
+	const float scale = terrainSize / (float)resolution;
+
+	chunksPerSide = ( quads + chunkQuads - 1 ) / chunkQuads;
+
+	chunks.clear();
+	chunks.resize( chunksPerSide * chunksPerSide );
+	lodErrors.assign( chunks.size() * lodLevels, 0.0f );
+
+	for( int cy = 0; cy < chunksPerSide; cy++ ) {
+		for( int cx = 0; cx < chunksPerSide; cx++ ) {
+			TerrainChunk& chunk = chunks[cy * chunksPerSide + cx];
+
+			chunk.startX = cx * chunkQuads;
+			chunk.startY = cy * chunkQuads;
+			chunk.width = ( quads - chunk.startX < chunkQuads ? quads - chunk.startX : chunkQuads ) + 1;
+			chunk.height = ( quads - chunk.startY < chunkQuads ? quads - chunk.startY : chunkQuads ) + 1;
+
+			//The heights are filled in by UpdateChunkMetrics
+			chunk.boundsMin = XMFLOAT3( (float)chunk.startX * scale, 0.0f, (float)chunk.startY * scale );
+			chunk.boundsMax = XMFLOAT3( (float)( chunk.startX + chunk.width - 1 ) * scale, 0.0f, (float)( chunk.startY + chunk.height - 1 ) * scale );
+		}
+	}
+
+	//Each parent covers the two by two below it, down the right and bottom of the map there may only be one column or row of them
+	//A parent can only be drawn at its depth's level or coarser, so there is no point going further up than the coarsest level
+	parents.clear();
+	parentStarts.clear();
+	parentsPerSide.clear();
+
+	for( int depth = 1; depth < lodLevels && ( 1 << ( depth - 1 ) ) < chunksPerSide; depth++ ) {
+		const int side = ( chunksPerSide + ( 1 << depth ) - 1 ) >> depth;
+
+		parentStarts.push_back( (int)parents.size() );
+		parentsPerSide.push_back( side );
+
+		for( int py = 0; py < side; py++ ) {
+			for( int px = 0; px < side; px++ ) {
+				const int lastX = ( ( px + 1 ) << depth ) < chunksPerSide ? ( ( px + 1 ) << depth ) - 1 : chunksPerSide - 1;
+				const int lastY = ( ( py + 1 ) << depth ) < chunksPerSide ? ( ( py + 1 ) << depth ) - 1 : chunksPerSide - 1;
+				const TerrainChunk& first = chunks[( py << depth ) * chunksPerSide + ( px << depth )];
+				const TerrainChunk& last = chunks[lastY * chunksPerSide + lastX];
+
+				TerrainChunk parent;
+				parent.startX = first.startX;
+				parent.startY = first.startY;
+				parent.width = last.startX + last.width - first.startX;
+				parent.height = last.startY + last.height - first.startY;
+				parent.depth = depth;
+				parent.level = depth;
+
+				parent.boundsMin = XMFLOAT3( first.boundsMin.x, 0.0f, first.boundsMin.z );
+				parent.boundsMax = XMFLOAT3( last.boundsMax.x, 0.0f, last.boundsMax.z );
+
+				parents.push_back( parent );
+			}
+		}
+	}
+
+	parentErrors.assign( parents.size() * lodLevels, 0.0f );
+}
+
+//The chunk at a position in the grid of a depth of the quadtree, depth zero being the chunks themselves, or null past the edge of the map
+TerrainChunk* TerrainMesh::FindChunk( int depth, int x, int y )
+{
+	const int side = depth == 0 ? chunksPerSide : parentsPerSide[depth - 1];
+
+	if( x < 0 || y < 0 || x >= side || y >= side ) {
+		return nullptr;
+	}
+
+	return depth == 0 ? &chunks[y * chunksPerSide + x] : &parents[parentStarts[depth - 1] + y * side + x];
+}
+
+//Vertices along a side of a chunk's buffer, every (1 << depth)-th one of the height map's plus the last
+static int BufferVertices( int vertices, int depth )
+{
+	const int spacing = 1 << depth;
+
+	return ( vertices - 1 + spacing - 1 ) / spacing + 1;
+}
+
+//The vertex offsets drawn along a side of quads at a given step, the last vertex is always kept so the chunk covers its whole area
+static void LevelPositions( int quads, int step, std::vector<int>& positions )
+{
+	positions.clear();
+
+	for( int p = 0; p < quads; p += step ) {
+		positions.push_back( p );
+	}
+
+	positions.push_back( quads );
+}
+
+//Refit the height range and level of detail errors of every chunk overlapping a changed region
+void TerrainMesh::UpdateChunkMetrics( const HeightMapRegion& region )
+{
+	std::vector<int> changed;
+
+	for( int c = 0; c < (int)chunks.size(); c++ ) {
+		const TerrainChunk& chunk = chunks[c];
+
+		if( chunk.startX > region.maxX || chunk.startX + chunk.width - 1 < region.minX || chunk.startY > region.maxY || chunk.startY + chunk.height - 1 < region.minY ) {
+			continue;
+		}
+
+		changed.push_back( c );
+	}
+
+	workers.parallelFor( (int)changed.size(), [&]( int start, int end ) {
+		for( int n = start; n < end; n++ ) {
+			TerrainChunk& chunk = chunks[changed[n]];
+
+			float lowest = heightMap[chunk.startY * resolution + chunk.startX];
+			float highest = lowest;
+
+			for( int j = chunk.startY; j < chunk.startY + chunk.height; j++ ) {
+				for( int i = chunk.startX; i < chunk.startX + chunk.width; i++ ) {
+					float height = heightMap[j * resolution + i];
+
+					lowest = height < lowest ? height : lowest;
+					highest = height > highest ? height : highest;
+				}
+			}
+
+			chunk.boundsMin.y = lowest;
+			chunk.boundsMax.y = highest;
+
+			//Coarser levels can only ever be less accurate, so each error is at least the one before it
+			float* errors = &lodErrors[changed[n] * lodLevels];
+			errors[0] = 0.0f;
+
+			for( int level = 1; level < lodLevels; level++ ) {
+				float error = MeasureChunkError( chunk, level );
+				errors[level] = error > errors[level - 1] ? error : errors[level - 1];
+			}
+		}
+	} );
+
+	//A parent's height range is its children's together, so the depths are refit from the bottom up
+	for( int depth = 1; depth <= (int)parentStarts.size(); depth++ ) {
+		const int side = parentsPerSide[depth - 1];
+
+		for( int py = 0; py < side; py++ ) {
+			for( int px = 0; px < side; px++ ) {
+				TerrainChunk& parent = *FindChunk( depth, px, py );
+
+				if( parent.startX > region.maxX || parent.startX + parent.width - 1 < region.minX || parent.startY > region.maxY || parent.startY + parent.height - 1 < region.minY ) {
+					continue;
+				}
+
+				const TerrainChunk& corner = *FindChunk( depth - 1, px * 2, py * 2 );
+				parent.boundsMin.y = corner.boundsMin.y;
+				parent.boundsMax.y = corner.boundsMax.y;
+
+				//Drawn at a level, a parent is as far out as the worst of its children at it
+				float* errors = &parentErrors[( parentStarts[depth - 1] + py * side + px ) * lodLevels];
+
+				for( int level = 0; level < lodLevels; level++ ) {
+					errors[level] = 0.0f;
 				}
-				//Bottom planes
-				if( ( j - 1 ) >= 0 ) {
-					smoothedNormal.x += vertices[( j - 1 ) * resolution + ( i - 1 )].normal.x;
-					smoothedNormal.y += vertices[( j - 1 ) * resolution + ( i - 1 )].normal.y;
-					smoothedNormal.z += vertices[( j - 1 ) * resolution + ( i - 1 )].normal.z;
-					count++;
+
+				for( int b = 0; b < 2; b++ ) {
+					for( int a = 0; a < 2; a++ ) {
+						const int childX = px * 2 + a;
+						const int childY = py * 2 + b;
+						const TerrainChunk* child = FindChunk( depth - 1, childX, childY );
+
+						if( child == nullptr ) {
+							continue;
+						}
+
+						parent.boundsMin.y = child->boundsMin.y < parent.boundsMin.y ? child->boundsMin.y : parent.boundsMin.y;
+						parent.boundsMax.y = child->boundsMax.y > parent.boundsMax.y ? child->boundsMax.y : parent.boundsMax.y;
+
+						const float* childErrors = depth == 1 ? &lodErrors[( childY * chunksPerSide + childX ) * lodLevels] : &parentErrors[( parentStarts[depth - 2] + childY * parentsPerSide[depth - 2] + childX ) * lodLevels];
+
+						for( int level = 0; level < lodLevels; level++ ) {
+							errors[level] = childErrors[level] > errors[level] ? childErrors[level] : errors[level];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+//Compare every height in a chunk with the surface the triangles of a coarser level pass through at that point
+float TerrainMesh::MeasureChunkError( const TerrainChunk& chunk, int level ) const
+{
+	std::vector<int> columns, rows;
+	LevelPositions( chunk.width - 1, 1 << level, columns );
+	LevelPositions( chunk.height - 1, 1 << level, rows );
+
+	float maxError = 0.0f;
+
+	for( size_t m = 0; m + 1 < rows.size(); m++ ) {
+		for( size_t k = 0; k + 1 < columns.size(); k++ ) {
+			const int x0 = chunk.startX + columns[k];
+			const int x1 = chunk.startX + columns[k + 1];
+			const int y0 = chunk.startY + rows[m];
+			const int y1 = chunk.startY + rows[m + 1];
+
+			const float h00 = heightMap[y0 * resolution + x0];
+			const float h10 = heightMap[y0 * resolution + x1];
+			const float h01 = heightMap[y1 * resolution + x0];
+			const float h11 = heightMap[y1 * resolution + x1];
+
+			for( int j = y0; j <= y1; j++ ) {
+				for( int i = x0; i <= x1; i++ ) {
+					float u = (float)( i - x0 ) / (float)( x1 - x0 );
+					float v = (float)( j - y0 ) / (float)( y1 - y0 );
+
+					//Each quad is split along the diagonal from (x0, y0) to (x1, y1), the same way the indices are built
+					float surface = v >= u ? h00 + u * ( h11 - h01 ) + v * ( h01 - h00 ) : h00 + u * ( h10 - h00 ) + v * ( h11 - h10 );
+					float error = fabsf( heightMap[j * resolution + i] - surface );
+
+					maxError = error > maxError ? error : maxError;
+				}
+			}
+		}
+	}
+
+	return maxError;
+}
+
+void TerrainMesh::SelectLevels( ID3D11Device* device, const XMFLOAT3& cameraPosition, const XMMATRIX& projection, float viewportHeight )
+{
+	//A place in the quadtree, depth zero being the chunks
+	struct Node
+	{
+		int depth;
+		int x;
+		int y;
+	};
+
+	const int top = (int)parentStarts.size();
+	const int topSide = top == 0 ? chunksPerSide : parentsPerSide[top - 1];
+	std::vector<Node> pending;
+
+	if( lodEnabled ) {
+		//How many pixels one world unit covers at a distance of one unit
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4( &m, projection );
+		const float pixelsPerUnit = viewportHeight * 0.5f * m.m[1][1];
+
+		auto coarsestLevel = [&]( const TerrainChunk& chunk, const float* errors ) {
+			//Distance to the nearest point of the chunk's box
+			float dx = cameraPosition.x < chunk.boundsMin.x ? chunk.boundsMin.x - cameraPosition.x : ( cameraPosition.x > chunk.boundsMax.x ? cameraPosition.x - chunk.boundsMax.x : 0.0f );
+			float dy = cameraPosition.y < chunk.boundsMin.y ? chunk.boundsMin.y - cameraPosition.y : ( cameraPosition.y > chunk.boundsMax.y ? cameraPosition.y - chunk.boundsMax.y : 0.0f );
+			float dz = cameraPosition.z < chunk.boundsMin.z ? chunk.boundsMin.z - cameraPosition.z : ( cameraPosition.z > chunk.boundsMax.z ? cameraPosition.z - chunk.boundsMax.z : 0.0f );
+			float distance = sqrtf( dx * dx + dy * dy + dz * dz );
+
+			//The error allowed grows with distance, since it covers fewer pixels further away
+			float allowed = distance * lodPixelError / pixelsPerUnit;
+
+			int level = 0;
+			while( level + 1 < lodLevels && errors[level + 1] <= allowed ) {
+				level++;
+			}
+
+			return level;
+		};
+
+		//From the top of the quadtree down, a parent far enough away to be drawn at its depth's level or coarser gives that level to every chunk under it
+		//Measured from its nearest point with its worst child's error, so some of them come out finer than on their own, in return for one draw
+		for( int y = 0; y < topSide; y++ ) {
+			for( int x = 0; x < topSide; x++ ) {
+				pending.push_back( { top, x, y } );
+			}
+		}
+
+		while( !pending.empty() ) {
+			const Node node = pending.back();
+			pending.pop_back();
+
+			if( node.depth == 0 ) {
+				const int c = node.y * chunksPerSide + node.x;
+				chunks[c].level = coarsestLevel( chunks[c], &lodErrors[c * lodLevels] );
+				continue;
+			}
+
+			const int index = parentStarts[node.depth - 1] + node.y * parentsPerSide[node.depth - 1] + node.x;
+			const int level = coarsestLevel( parents[index], &parentErrors[index * lodLevels] );
+
+			if( level >= node.depth ) {
+				const int lastX = ( ( node.x + 1 ) << node.depth ) < chunksPerSide ? ( node.x + 1 ) << node.depth : chunksPerSide;
+				const int lastY = ( ( node.y + 1 ) << node.depth ) < chunksPerSide ? ( node.y + 1 ) << node.depth : chunksPerSide;
+
+				for( int cy = node.y << node.depth; cy < lastY; cy++ ) {
+					for( int cx = node.x << node.depth; cx < lastX; cx++ ) {
+						chunks[cy * chunksPerSide + cx].level = level;
+					}
 				}
+
+				continue;
 			}
-			//right planes
-			if( ( i ) <( resolution - 1 ) ) {
 
-				//Top planes
-				if( ( j ) < ( resolution - 1 ) ) {
-					smoothedNormal.x += vertices[j * resolution + i].normal.x;
-					smoothedNormal.y += vertices[j * resolution + i].normal.y;
-					smoothedNormal.z += vertices[j * resolution + i].normal.z;
-					count++;
+			for( int b = 0; b < 2; b++ ) {
+				for( int a = 0; a < 2; a++ ) {
+					if( FindChunk( node.depth - 1, node.x * 2 + a, node.y * 2 + b ) != nullptr ) {
+						pending.push_back( { node.depth - 1, node.x * 2 + a, node.y * 2 + b } );
+					}
 				}
-				//Bottom planes
-				if( ( j - 1 ) >= 0 ) {
-					smoothedNormal.x += vertices[( j - 1 ) * resolution + i].normal.x;
-					smoothedNormal.y += vertices[( j - 1 ) * resolution + i].normal.y;
-					smoothedNormal.z += vertices[( j - 1 ) * resolution + i].normal.z;
-					count++;
+			}
+		}
+
+		//Refine any chunk more than one level coarser than a neighbour, repeating until no chunk changes
+		bool changed = true;
+		while( changed ) {
+			changed = false;
+
+			for( int cy = 0; cy < chunksPerSide; cy++ ) {
+				for( int cx = 0; cx < chunksPerSide; cx++ ) {
+					int& level = chunks[cy * chunksPerSide + cx].level;
+					const int neighbours[4][2] = { { cx - 1, cy }, { cx + 1, cy }, { cx, cy - 1 }, { cx, cy + 1 } };
+
+					for( const auto& neighbour : neighbours ) {
+						if( neighbour[0] < 0 || neighbour[0] >= chunksPerSide || neighbour[1] < 0 || neighbour[1] >= chunksPerSide ) {
+							continue;
+						}
+
+						int limit = chunks[neighbour[1] * chunksPerSide + neighbour[0]].level + 1;
+
+						if( level > limit ) {
+							level = limit;
+							changed = true;
+						}
+					}
 				}
 			}
-			smoothedNormal.x /= count;
-			smoothedNormal.y /= count;
-			smoothedNormal.z /= count;
+		}
+	}
 
-			float mag = sqrt( ( smoothedNormal.x * smoothedNormal.x ) + ( smoothedNormal.y * smoothedNormal.y ) + ( smoothedNormal.z * smoothedNormal.z ) );
-			smoothedNormal.x /= mag;
-			smoothedNormal.y /= mag;
-			smoothedNormal.z /= mag;
+	else {
+		for( TerrainChunk& chunk : chunks ) {
+			chunk.level = 0;
+		}
+	}
 
-			vertices[j * resolution + i].normal = smoothedNormal;
+	for( int cy = 0; cy < chunksPerSide; cy++ ) {
+		for( int cx = 0; cx < chunksPerSide; cx++ ) {
+			TerrainChunk& chunk = chunks[cy * chunksPerSide + cx];
+
+			//Stitch every side that borders a coarser chunk
+			auto coarser = [&]( int nx, int ny ) {
+				return nx >= 0 && nx < chunksPerSide && ny >= 0 && ny < chunksPerSide && chunks[ny * chunksPerSide + nx].level > chunk.level;
+			};
+
+			chunk.stitchedEdges = 0;
+			chunk.stitchedEdges |= coarser( cx - 1, cy ) ? TerrainChunk::EdgeMinX : 0;
+			chunk.stitchedEdges |= coarser( cx + 1, cy ) ? TerrainChunk::EdgeMaxX : 0;
+			chunk.stitchedEdges |= coarser( cx, cy - 1 ) ? TerrainChunk::EdgeMinY : 0;
+			chunk.stitchedEdges |= coarser( cx, cy + 1 ) ? TerrainChunk::EdgeMaxY : 0;
+			chunk.error = getChunkError( cy * chunksPerSide + cx, chunk.level );
 		}
 	}
-	//If we've not yet created our dyanmic Vertex and Index buffers, do that now
-	if( vertexBuffer == NULL ) {
-		CreateBuffers( device, vertices, indices );
+
+	//Keeping neighbours within a level can have split up a parent's chunks again, so each parent is only drawn if its children still agree
+	//Children at one level draw exactly the triangles their parent would at it, as every chunk starts on a multiple of the coarsest spacing
+	//So a parent stands in for them when they all share a level its buffer can draw, and each of its outer sides is stitched all along or not at all
+	std::vector<char> visible( chunks.size(), 0 );
+	std::vector<char> merged( parents.size(), 0 );
+	std::vector<char> seen( parents.size(), 0 );	//Whether any chunk under a parent is visible
+
+	for( int c : visibleChunks ) {
+		visible[c] = 1;
 	}
-	else {
-		//If we've already made our buffers, update the information
-		D3D11_MAPPED_SUBRESOURCE mappedResource;
-		ZeroMemory( &mappedResource, sizeof( D3D11_MAPPED_SUBRESOURCE ) );
 
-		//  Disable GPU access to the vertex buffer data.
-		deviceContext->Map( vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource );
-		//  Update the vertex buffer here.
-		memcpy( mappedResource.pData, vertices, sizeof( VertexType ) * vertexCount );
-		//  Reenable GPU access to the vertex buffer data.
-		deviceContext->Unmap( vertexBuffer, 0 );
+	auto isMerged = [&]( int depth, int x, int y ) {
+		return depth == 0 || merged[parentStarts[depth - 1] + y * parentsPerSide[depth - 1] + x] != 0;
+	};
+
+	auto isSeen = [&]( int depth, int x, int y ) {
+		return depth == 0 ? visible[y * chunksPerSide + x] != 0 : seen[parentStarts[depth - 1] + y * parentsPerSide[depth - 1] + x] != 0;
+	};
+
+	for( int depth = 1; depth <= (int)parentStarts.size(); depth++ ) {
+		const int side = parentsPerSide[depth - 1];
+
+		for( int py = 0; py < side; py++ ) {
+			for( int px = 0; px < side; px++ ) {
+				const int index = parentStarts[depth - 1] + py * side + px;
+				TerrainChunk& parent = parents[index];
+
+				const int columns = FindChunk( depth - 1, px * 2 + 1, py * 2 ) != nullptr ? 2 : 1;
+				const int rows = FindChunk( depth - 1, px * 2, py * 2 + 1 ) != nullptr ? 2 : 1;
+				const TerrainChunk& corner = *FindChunk( depth - 1, px * 2, py * 2 );
+				const TerrainChunk& right = *FindChunk( depth - 1, px * 2 + columns - 1, py * 2 );
+				const TerrainChunk& bottom = *FindChunk( depth - 1, px * 2, py * 2 + rows - 1 );
+
+				bool mergeable = lodEnabled && corner.level >= depth;
+				float error = 0.0f;
+
+				for( int b = 0; b < rows; b++ ) {
+					for( int a = 0; a < columns; a++ ) {
+						const TerrainChunk& child = *FindChunk( depth - 1, px * 2 + a, py * 2 + b );
+
+						mergeable = mergeable && isMerged( depth - 1, px * 2 + a, py * 2 + b ) && child.level == corner.level;
+						mergeable = mergeable && ( a != 0 || ( child.stitchedEdges & TerrainChunk::EdgeMinX ) == ( corner.stitchedEdges & TerrainChunk::EdgeMinX ) );
+						mergeable = mergeable && ( a != columns - 1 || ( child.stitchedEdges & TerrainChunk::EdgeMaxX ) == ( right.stitchedEdges & TerrainChunk::EdgeMaxX ) );
+						mergeable = mergeable && ( b != 0 || ( child.stitchedEdges & TerrainChunk::EdgeMinY ) == ( corner.stitchedEdges & TerrainChunk::EdgeMinY ) );
+						mergeable = mergeable && ( b != rows - 1 || ( child.stitchedEdges & TerrainChunk::EdgeMaxY ) == ( bottom.stitchedEdges & TerrainChunk::EdgeMaxY ) );
+
+						error = child.error > error ? child.error : error;
+						seen[index] = seen[index] || isSeen( depth - 1, px * 2 + a, py * 2 + b );
+					}
+				}
+
+				if( mergeable ) {
+					merged[index] = 1;
+					parent.level = corner.level;
+					parent.error = error;
+					parent.stitchedEdges = ( corner.stitchedEdges & ( TerrainChunk::EdgeMinX | TerrainChunk::EdgeMinY ) ) | ( right.stitchedEdges & TerrainChunk::EdgeMaxX ) | ( bottom.stitchedEdges & TerrainChunk::EdgeMaxY );
+				}
+			}
+		}
 	}
 
-	// Release the arrays now that the buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-	delete[] indices;
-	indices = 0;
+	//Walk down from the top of the quadtree, drawing the highest merged parent over anything visible and only the visible chunks elsewhere
+	for( int y = 0; y < topSide; y++ ) {
+		for( int x = 0; x < topSide; x++ ) {
+			pending.push_back( { top, x, y } );
+		}
+	}
+
+	drawnChunks.clear();
+
+	while( !pending.empty() ) {
+		const Node node = pending.back();
+		pending.pop_back();
+
+		if( !isSeen( node.depth, node.x, node.y ) ) {
+			continue;
+		}
+
+		if( isMerged( node.depth, node.x, node.y ) ) {
+			drawnChunks.push_back( FindChunk( node.depth, node.x, node.y ) );
+			continue;
+		}
+
+		for( int b = 1; b >= 0; b-- ) {
+			for( int a = 1; a >= 0; a-- ) {
+				if( FindChunk( node.depth - 1, node.x * 2 + a, node.y * 2 + b ) != nullptr ) {
+					pending.push_back( { node.depth - 1, node.x * 2 + a, node.y * 2 + b } );
+				}
+			}
+		}
+	}
+
+	for( TerrainChunk* chunk : drawnChunks ) {
+		SelectIndexBuffer( device, *chunk );
+	}
+}
+
+//Copy the changed vertices into the vertex buffers of the chunks they belong to, a row at a time
+//A row of a chunk is contiguous in the full vertex array, so no copying is needed on the CPU
+void TerrainMesh::UploadVertices( ID3D11DeviceContext* deviceContext, const HeightMapRegion& region )
+{
+	D3D11_BOX box;
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+
+	for( TerrainChunk& chunk : chunks ) {
+		int minX = region.minX > chunk.startX ? region.minX : chunk.startX;
+		int minY = region.minY > chunk.startY ? region.minY : chunk.startY;
+		int maxX = region.maxX < chunk.startX + chunk.width - 1 ? region.maxX : chunk.startX + chunk.width - 1;
+		int maxY = region.maxY < chunk.startY + chunk.height - 1 ? region.maxY : chunk.startY + chunk.height - 1;
+
+		if( maxX < minX || maxY < minY ) {
+			continue;
+		}
+
+		for( int j = minY; j <= maxY; j++ ) {
+			int first = ( j - chunk.startY ) * chunk.width + ( minX - chunk.startX );
+
+			box.left = sizeof( VertexType ) * first;
+			box.right = sizeof( VertexType ) * ( first + maxX - minX + 1 );
+			deviceContext->UpdateSubresource( chunk.vertexBuffer, 0, &box, &vertices[j * resolution + minX], 0, 0 );
+		}
+	}
+
+	//A parent only keeps some of each row, so the rows it keeps inside the region are gathered and sent whole
+	std::vector<int> columns, rows;
+	std::vector<VertexType> row;
+
+	for( TerrainChunk& parent : parents ) {
+		if( parent.startX > region.maxX || parent.startX + parent.width - 1 < region.minX || parent.startY > region.maxY || parent.startY + parent.height - 1 < region.minY ) {
+			continue;
+		}
+
+		LevelPositions( parent.width - 1, 1 << parent.depth, columns );
+		LevelPositions( parent.height - 1, 1 << parent.depth, rows );
+		row.resize( columns.size() );
+
+		for( size_t m = 0; m < rows.size(); m++ ) {
+			const int j = parent.startY + rows[m];
+
+			if( j < region.minY || j > region.maxY ) {
+				continue;
+			}
+
+			for( size_t k = 0; k < columns.size(); k++ ) {
+				row[k] = vertices[j * resolution + parent.startX + columns[k]];
+			}
+
+			box.left = (UINT)( sizeof( VertexType ) * m * columns.size() );
+			box.right = (UINT)( sizeof( VertexType ) * ( m + 1 ) * columns.size() );
+			deviceContext->UpdateSubresource( parent.vertexBuffer, 0, &box, row.data(), 0, 0 );
+		}
+	}
 }
 
 void TerrainMesh::renderSampleTerrain(float dt)
@@ -256,42 +779,65 @@ void TerrainMesh::renderSampleTerrain(float dt)
 
 	//float pVel[3] = { 1.0f, 0.0f, 1.0f };
 	//float wVel[3] = { 1.0f, -1.0f, 1.0f };
-	//windErosion(dt, 5000, pVel, wVel, 0.7f, 0.025f, 0.5f, 0.01f, 0.5f, true);
+	//windErosion(dt, 5000, pVel, wVel, 0.7f, 0.025f, 0.5f, 0.01f, 0.5f, true, 0);
 }
 
 void TerrainMesh::flatten()
 {
-	for (int j = 0; j < (resolution); j++)
+	workers.parallelFor(resolution, [&](int start, int end)
 	{
-		for (int i = 0; i < (resolution); i++)
+		for (int j = start; j < end; j++)
 		{
-			heightMap[(i * resolution) + j] = 0.0f;
+			for (int i = 0; i < (resolution); i++)
+			{
+				heightMap[(j * resolution) + i] = 0.0f;
+				slopeMap[(j * resolution) + i] = 0.0f;
+				slopeMap[((resolution + j) * resolution) + i] = 0.0f;
+			}
 		}
-	}
+	});
+
+	MarkAllDirty();
+
+	//A flat map's slope is known, so generateDerivativeFBM can keep adding to it
+	slopesValid = true;
 }
 
 void TerrainMesh::invert()
 {
-	for (int j = 0; j < (resolution); j++)
+	workers.parallelFor(resolution, [&](int start, int end)
 	{
-		for (int i = 0; i < (resolution); i++)
+		for (int j = start; j < end; j++)
 		{
-			heightMap[(i * resolution) + j] *= -1.0f;
+			for (int i = 0; i < (resolution); i++)
+			{
+				heightMap[(j * resolution) + i] *= -1.0f;
+			}
 		}
-	}
+	});
+
+	MarkAllDirty();
 }
 
-void TerrainMesh::random()
+void TerrainMesh::random(uint64_t seed)
 {
-	float height = 0.0f;
+	const uint64_t key = Random::deriveKey(seed, RandomStream::HeightMap);
 
-	for (int j = 0; j < (resolution); j++)
+	//Each cell draws the number at its own index in the stream, so rows can be filled in any order
+	workers.parallelFor(resolution, [&](int start, int end)
 	{
-		for (int i = 0; i < (resolution); i++)
+		for (int j = start; j < end; j++)
 		{
-			heightMap[(j * resolution) + i] = (float)((rand() % (int)amplitude) + 1);
+			for (int i = 0; i < (resolution); i++)
+			{
+				int index = (j * resolution) + i;
+
+				heightMap[index] = (float)(Random::at(key, index, (int)amplitude) + 1);
+			}
 		}
-	}
+	});
+
+	MarkAllDirty();
 }
 
 void TerrainMesh::smooth(int itr)
@@ -342,89 +888,536 @@ void TerrainMesh::smooth(int itr)
 			}
 		}
 	}
+
+	MarkAllDirty();
 }
 
-void TerrainMesh::fault(int itr)
+int TerrainMesh::thermalErosion(float talusAngle, float rate, int iterations, float threshold)
 {
-	float faultFactor = 1.0f / itr;
-	float faultMultiplier = 1.0f + faultFactor;
+	//The talus as a height difference between neighbouring vertices, which are terrainSize / resolution apart
+	const float talus = tanf(talusAngle * (XM_PI / 180.0f)) * (terrainSize / (float)resolution);
 
-	for (int k = 0; k < itr; k++)
-	{
-		float startPoint[2] = { (rand() % resolution), (rand() % resolution) };	//P1
-		float endPoint[2] = { (rand() % resolution), (rand() % resolution) };	//P2
+	ThermalErosion slope(resolution, talus, rate);
 
-		float nextPoint[2] = { 0.0f, 0.0f };	//The coordinates of the next vertex to check
+	//Each iteration reads one map and writes the other, so the heights it reads never change under it
+	float* heights = heightMap;
+	float* settled = new float[resolution * resolution];
+	std::vector<float> shed(resolution);
 
-		XMFLOAT3 lineOne = { endPoint[0] - startPoint[0], endPoint[1] - startPoint[1], 0.0f };	//L1
-		XMFLOAT3 lineTwo = { 0.0f, 0.0f, 0.0f };	//L2
-		XMFLOAT3 cross{};	//To store the result of the cross product
+	int iteration = 0;
 
-		for (int j = 0; j < (resolution); j++)
+	for (; iteration < iterations; iteration++)
+	{
+		std::fill(shed.begin(), shed.end(), 0.0f);
+
+		workers.parallelFor(resolution, [&](int start, int end)
 		{
-			nextPoint[0] = (float)j;
+			shed[start] = slope.slide(heights, start, end);
+		});
+
+		if (*std::max_element(shed.begin(), shed.end()) <= threshold)
+		{
+			break;
+		}
+
+		workers.parallelFor(resolution, [&](int start, int end)
+		{
+			slope.settle(heights, settled, start, end);
+		});
+
+		std::swap(heights, settled);
+	}
+
+	if (heights != heightMap)
+	{
+		std::copy(heights, heights + resolution * resolution, heightMap);
+		settled = heights;
+	}
+
+	delete[] settled;
+
+	MarkAllDirty();
+
+	return iteration;
+}
+
+void TerrainMesh::fault(int itr, uint64_t seed)
+{
+	float faultFactor = 1.0f / itr;
+	float faultMultiplier = 1.0f + faultFactor;
+
+	//The fault lines are picked up front, so the rows can then be split between threads in any way
+	std::vector<XMFLOAT2> startPoints(itr);	//P1
+	std::vector<XMFLOAT3> lines(itr);	//L1
+	std::vector<float> offsets(itr);
+
+	Random random(Random::deriveKey(seed, RandomStream::Fault));
+
+	for (int k = 0; k < itr; k++)
+	{
+		float startPoint[2] = { (float)random.nextInt(resolution), (float)random.nextInt(resolution) };
+		float endPoint[2] = { (float)random.nextInt(resolution), (float)random.nextInt(resolution) };
+
+		startPoints[k] = XMFLOAT2(startPoint[0], startPoint[1]);
+		lines[k] = XMFLOAT3(endPoint[0] - startPoint[0], endPoint[1] - startPoint[1], 0.0f);
+		offsets[k] = amplitude * faultMultiplier;
+
+		faultMultiplier -= faultFactor;
+	}
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		float nextPoint[2] = { 0.0f, 0.0f };	//The coordinates of the next vertex to check
+
+		XMFLOAT3 lineTwo = { 0.0f, 0.0f, 0.0f };	//L2
+		XMFLOAT3 cross{};	//To store the result of the cross product
+
+		for (int j = start; j < end; j++)
+		{
+			nextPoint[0] = (float)j;
 
 			for (int i = 0; i < (resolution); i++)
 			{
 				nextPoint[1] = (float)i;
 
-				lineTwo = { startPoint[0] - nextPoint[0], startPoint[1] - nextPoint[1], 0.0f };
+				float height = heightMap[(j * resolution) + i];
+
+				for (int k = 0; k < itr; k++)
+				{
+					lineTwo = { startPoints[k].x - nextPoint[0], startPoints[k].y - nextPoint[1], 0.0f };
 
-				XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&lineOne), XMLoadFloat3(&lineTwo)));
+					XMStoreFloat3(&cross, XMVector3Cross(XMLoadFloat3(&lines[k]), XMLoadFloat3(&lineTwo)));
+
+					if (cross.z > 0.0f)
+					{
+						height += offsets[k];
+					}
+
+					else if (cross.z <= 0.0f)
+					{
+						height -= offsets[k];
+					}
+				}
+
+				heightMap[(j * resolution) + i] = height;
+			}
+		}
+	});
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::perlinOriginal()
+{
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		for (int j = start; j < end; j++)
+		{
+			for (int i = 0; i < (resolution); i++)
+			{
+				float height = heightMap[(j * resolution) + i];
 
-				if (cross.z > 0.0f)
+				float x = (float)i * frequency;	//Scaling the input for noise
+				float y = (float)j * frequency;
+
+				height += noise.generatePerlin2D(x, y) * amplitude;
+
+				heightMap[(j * resolution) + i] = height;
+			}
+		}
+	});
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::perlinImproved()
+{
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heightMap[j * resolution];
+
+			//Scaling the input for noise, a whole row of samples is generated at once
+			noise.generateImprovedPerlinSpan(0.0f, frequency, (float)j * frequency, resolution, samples.data());
+
+			for (int i = 0; i < (resolution); i++)
+			{
+				row[i] += samples[i] * amplitude;
+			}
+		}
+	});
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::worley(WorleyFeature feature, WorleyDistance distance, float jitter)
+{
+	cellular.setFeature(feature);
+	cellular.setDistance(distance);
+	cellular.setJitter(jitter);
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heightMap[j * resolution];
+
+			cellular.generateWorleySpan(0.0f, frequency, (float)j * frequency, resolution, samples.data());
+
+			for (int i = 0; i < (resolution); i++)
+			{
+				row[i] += samples[i] * amplitude;
+			}
+		}
+	});
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::generateFBM(int octaves, float ampl, float freq)
+{
+	std::vector<float> a, f;
+	setupOctaves(octaves, ampl, freq, a, f);
+
+	//All octaves are built for one row while it is still in cache, so each height is only read and written once
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heightMap[j * resolution];
+
+			for (int o = 0; o < octaves; o++)
+			{
+				noiseSpan(f[o], (float)j * f[o], resolution, samples.data());
+
+				for (int i = 0; i < (resolution); i++)
 				{
-					heightMap[(j * resolution) + i] += (amplitude * faultMultiplier);
+					row[i] += samples[i] * a[o];
 				}
+			}
+		}
+	});
 
-				else if (cross.z <= 0.0f)
+	MarkAllDirty();
+}
+
+void TerrainMesh::generateRidgedFBM(int octaves, float ampl, float freq)
+{
+	std::vector<float> a, f;
+	setupOctaves(octaves, ampl, freq, a, f);
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heightMap[j * resolution];
+
+			for (int o = 0; o < octaves; o++)
+			{
+				noiseSpan(f[o], (float)j * f[o], resolution, samples.data());
+
+				for (int i = 0; i < (resolution); i++)
 				{
-					heightMap[(j * resolution) + i] -= (amplitude * faultMultiplier);
+					float height = row[i] - samples[i] * a[o];
+
+					if (height < (-a[o]))	//Negative amplitude represents the lowest point of the height map
+					{
+						height = sqrtf(height * height);
+					}
+
+					row[i] = height;
 				}
 			}
+
+			//Inverting here saves the extra sweep over the map that invert() would need
+			for (int i = 0; i < (resolution); i++)
+			{
+				row[i] = -row[i];
+			}
 		}
+	});
 
-		faultMultiplier -= faultFactor;
-	}
+	MarkAllDirty();
 }
 
-void TerrainMesh::perlinOriginal()
+void TerrainMesh::generateDerivativeFBM(int octaves, float ampl, float freq, float erosion)
 {
-	for (int j = 0; j < (resolution); j++)
+	std::vector<float> a, f;
+	setupOctaves(octaves, ampl, freq, a, f);
+
+	const float scale = terrainSize / (float)resolution;
+
+	//Marking the terrain dirty forgets the slopes, so note whether the ones already there can be added to first
+	const bool slopesKnown = slopesValid && erosion == 0.0f;
+
+	workers.parallelFor(resolution, [&](int start, int end)
 	{
-		for (int i = 0; i < (resolution); i++)
+		std::vector<float> samples(resolution), derivativeX(resolution), derivativeY(resolution);
+		std::vector<float> sumX(resolution), sumY(resolution);	//Every octave's slope so far in its own noise units, which is what the erosion damps by
+
+		for (int j = start; j < end; j++)
 		{
-			float height = heightMap[(j * resolution) + i];
+			float* row = &heightMap[j * resolution];
+			float* slopesX = &slopeMap[j * resolution];
+			float* slopesZ = &slopeMap[(resolution + j) * resolution];
+
+			for (int i = 0; i < (resolution); i++)
+			{
+				sumX[i] = 0.0f;
+				sumY[i] = 0.0f;
+			}
+
+			for (int o = 0; o < octaves; o++)
+			{
+				noise.generateImprovedPerlinDerivativeSpan(0.0f, f[o], (float)j * f[o], resolution, samples.data(), derivativeX.data(), derivativeY.data());
+
+				//A vertex is f[o] further into the noise and scale further across the terrain than the one before it
+				const float slopeScale = a[o] * f[o] / scale;
+
+				if (slopesKnown)
+				{
+					for (int i = 0; i < (resolution); i++)
+					{
+						row[i] += samples[i] * a[o];
+						slopesX[i] += derivativeX[i] * slopeScale;
+						slopesZ[i] += derivativeY[i] * slopeScale;
+					}
+				}
+
+				else if (erosion == 0.0f)
+				{
+					for (int i = 0; i < (resolution); i++)
+					{
+						row[i] += samples[i] * a[o];
+					}
+				}
+
+				else
+				{
+					for (int i = 0; i < (resolution); i++)
+					{
+						sumX[i] += derivativeX[i];
+						sumY[i] += derivativeY[i];
+
+						row[i] += samples[i] * a[o] / (1.0f + erosion * (sumX[i] * sumX[i] + sumY[i] * sumY[i]));
+					}
+				}
+			}
+		}
+	});
+
+	MarkAllDirty();
+
+	//The damped sum's slope also depends on how fast the damping changes, which would take the noise's second derivatives
+	//So eroded terrain, or any added onto a map whose slope is not known, keeps differencing its normals from the heights like every other operator
+	slopesValid = slopesKnown;
+}
+
+void TerrainMesh::generateWarpedFBM(int octaves, float ampl, float freq, int warpOctaves, float warpFrequency, float warpStrength)
+{
+	UpdateWarpField(warpOctaves, warpFrequency);
+
+	std::vector<float> a, f;
+	setupOctaves(octaves, ampl, freq, a, f);
+
+	const float* warpX = &warpField[0];
+	const float* warpY = &warpField[resolution * resolution];
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> positionX(resolution), positionY(resolution);
+		std::vector<float> pointX(resolution), pointY(resolution), samples(resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heightMap[j * resolution];
+
+			//Where each vertex samples the noise, in vertices, before each octave's frequency scales it
+			for (int i = 0; i < (resolution); i++)
+			{
+				positionX[i] = (float)i + warpX[j * resolution + i] * warpStrength;
+				positionY[i] = (float)j + warpY[j * resolution + i] * warpStrength;
+			}
 
-			float x = (float)i * frequency;	//Scaling the input for noise
-			float y = (float)j * frequency;
+			for (int o = 0; o < octaves; o++)
+			{
+				for (int i = 0; i < (resolution); i++)
+				{
+					pointX[i] = positionX[i] * f[o];
+					pointY[i] = positionY[i] * f[o];
+				}
 
-			height += noise.generatePerlin2D(x, y) * amplitude;
+				noise.generateImprovedPerlinPoints(pointX.data(), pointY.data(), resolution, samples.data());
 
-			heightMap[(j * resolution) + i] = height;
+				for (int i = 0; i < (resolution); i++)
+				{
+					row[i] += samples[i] * a[o];
+				}
+			}
 		}
+	});
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::generateTileableFBM(int octaves, float ampl, float freq)
+{
+	std::vector<float> a, f;
+	setupOctaves(octaves, ampl, freq, a, f);
+
+	const int tileSize = resolution - 1;
+	std::vector<int> periods(f.size());
+
+	for (int o = 0; o < octaves; o++)
+	{
+		//At least one cell, as a period of zero would turn the repeat off
+		periods[o] = (int)roundf((float)tileSize * f[o]);
+		periods[o] = periods[o] < 1 ? 1 : periods[o];
+		f[o] = (float)periods[o] / (float)tileSize;
 	}
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(resolution);
+
+		for (int j = start; j < end; j++)
+		{
+			float* row = &heightMap[j * resolution];
+
+			//The last row is sampled as the first, rather than a period further on, so the two match exactly
+			int tileRow = j == tileSize ? 0 : j;
+
+			for (int o = 0; o < octaves; o++)
+			{
+				noise.generateImprovedPerlinSpan(0.0f, f[o], (float)tileRow * f[o], tileSize, samples.data(), 0, periods[o]);
+				samples[tileSize] = samples[0];
+
+				for (int i = 0; i < (resolution); i++)
+				{
+					row[i] += samples[i] * a[o];
+				}
+			}
+		}
+	});
+
+	MarkAllDirty();
 }
 
-void TerrainMesh::perlinImproved()
+//Rebuilds the warp only when it would come out differently, each component is an FBM halving in amplitude and doubling in frequency
+void TerrainMesh::UpdateWarpField(int octaves, float frequency)
 {
-	for (int j = 0; j < (resolution); j++)
+	if (warpCached && octaves == warpOctaves && frequency == warpFrequency)
 	{
-		for (int i = 0; i < (resolution); i++)
+		return;
+	}
+
+	const int cells = resolution * resolution;
+	warpField.assign(cells * 2, 0.0f);
+
+	//The y component samples the same noise far away from the x component, so the two are unrelated
+	const float offsetX = 5.2f;
+	const float offsetY = 1.3f;
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		std::vector<float> samples(resolution);
+
+		for (int j = start; j < end; j++)
 		{
-			float height = heightMap[(j * resolution) + i];
+			float* rowX = &warpField[j * resolution];
+			float* rowY = &warpField[cells + j * resolution];
+
+			float currentAmplitude = 1.0f;
+			float currentFrequency = frequency;
+
+			for (int o = 0; o < octaves; o++)
+			{
+				noise.generateImprovedPerlinSpan(0.0f, currentFrequency, (float)j * currentFrequency, resolution, samples.data());
+
+				for (int i = 0; i < (resolution); i++)
+				{
+					rowX[i] += samples[i] * currentAmplitude;
+				}
 
-			float x = (float)i * frequency;	//Scaling the input for noise
-			float y = (float)j * frequency;
+				noise.generateImprovedPerlinSpan(offsetX, currentFrequency, (float)j * currentFrequency + offsetY, resolution, samples.data());
 
-			height += noise.generateImprovedPerlin(x, y) * amplitude;
+				for (int i = 0; i < (resolution); i++)
+				{
+					rowY[i] += samples[i] * currentAmplitude;
+				}
 
-			heightMap[(j * resolution) + i] = height;
+				currentAmplitude *= 0.5f;
+				currentFrequency *= 2.0f;
+			}
 		}
+	});
+
+	warpOctaves = octaves;
+	warpFrequency = frequency;
+	warpCached = true;
+}
+
+void TerrainMesh::brush(float x, float z, float radius, float strength)
+{
+	//Convert from world space into height map cells
+	const float scale = terrainSize / (float)resolution;
+	const float centreX = x / scale;
+	const float centreY = z / scale;
+	const float cellRadius = radius / scale;
+
+	if (cellRadius <= 0.0f)
+	{
+		return;
 	}
+
+	int minX = (int)floorf(centreX - cellRadius);
+	int minY = (int)floorf(centreY - cellRadius);
+	int maxX = (int)ceilf(centreX + cellRadius);
+	int maxY = (int)ceilf(centreY + cellRadius);
+
+	minX = minX < 0 ? 0 : minX;
+	minY = minY < 0 ? 0 : minY;
+	maxX = maxX > resolution - 1 ? resolution - 1 : maxX;
+	maxY = maxY > resolution - 1 ? resolution - 1 : maxY;
+
+	if (maxX < minX || maxY < minY)
+	{
+		return;
+	}
+
+	const float radiusSquared = cellRadius * cellRadius;
+
+	for (int j = minY; j <= maxY; j++)
+	{
+		for (int i = minX; i <= maxX; i++)
+		{
+			float dx = (float)i - centreX;
+			float dy = (float)j - centreY;
+			float distanceSquared = (dx * dx) + (dy * dy);
+
+			if (distanceSquared < radiusSquared)
+			{
+				//Smooth falloff that reaches zero at the edge of the brush
+				float falloff = 1.0f - (distanceSquared / radiusSquared);
+
+				heightMap[(j * resolution) + i] += strength * falloff * falloff;
+			}
+		}
+	}
+
+	MarkDirty(minX, minY, maxX, maxY);
 }
 
-void TerrainMesh::generateFBM(int octaves, float ampl, float freq)
+void TerrainMesh::generateFBMMultiPass(int octaves, float ampl, float freq)
 {
 	float height = 0.0f;
 	float x = 0.0f;
@@ -454,9 +1447,11 @@ void TerrainMesh::generateFBM(int octaves, float ampl, float freq)
 		a *= ampl;
 		f *= freq;
 	}
+
+	MarkAllDirty();
 }
 
-void TerrainMesh::generateRidgedFBM(int octaves, float ampl, float freq)
+void TerrainMesh::generateRidgedFBMMultiPass(int octaves, float ampl, float freq)
 {
 	float height = 0.0f;
 	float x = 0.0f;
@@ -493,43 +1488,55 @@ void TerrainMesh::generateRidgedFBM(int octaves, float ampl, float freq)
 	}
 
 	invert();
+
+	MarkAllDirty();
 }
 
-void TerrainMesh::windErosion(float dt, int itr, float* pVel, float* wVel, float sed, float sus, float abr, float rgh, float set, bool weigh)
+//Where the j-th particle of an erosion keyed by key starts, on the boundary it is blown in from
+WindParticle TerrainMesh::spawnWindParticle(uint64_t key, int j, const float* pVel) const
 {
-	for (int j = 0; j < itr; j++)
+	WindParticle originParticle;
+
+	//Spawn new particles on a boundary, each particle's position comes from its own place in the stream
+	int shift = Random::at(key, j, resolution + resolution);
+
+	if (shift < resolution)	//Spawn along x boundary
 	{
-		WindParticle originParticle;
-		int index = 0;
-		//Spawn new particles on a boundary
-		int shift = rand() % (resolution + resolution);
+		originParticle.position.x = shift;
 
-		if (shift < resolution)	//Spawn along x boundary
-		{
-			originParticle.position.x = shift;
+		if (originParticle.velocity.z > 0.0f)
+		originParticle.position.y = 0;
+		else
+		originParticle.position.y = (resolution - 1);
+	}
 
-			if (originParticle.velocity.z > 0.0f)
-			originParticle.position.y = 0;
-			else
-			originParticle.position.y = (resolution - 1);
-		}
+	else //Spawn along z boundary
+	{
+		originParticle.position.y = shift - resolution;
 
-		else //Spawn along z boundary
-		{
-			originParticle.position.y = shift - resolution;
+		if (originParticle.velocity.x > 0.0f)
+			originParticle.position.x = 0;
+		else
+			originParticle.position.x = (resolution - 1);
+	}
 
-			if (originParticle.velocity.x > 0.0f)
-				originParticle.position.x = 0;
-			else
-				originParticle.position.x = (resolution - 1);
-		}
+	originParticle.velocity.x = pVel[0];
+	originParticle.velocity.y = pVel[1];
+	originParticle.velocity.z = pVel[2];
 
-		originParticle.velocity.x = pVel[0];
-		originParticle.velocity.y = pVel[1];
-		originParticle.velocity.z = pVel[2];
+	return originParticle;
+}
+
+void TerrainMesh::windErosion(float dt, int itr, float* pVel, float* wVel, float sed, float sus, float abr, float rgh, float set, bool weigh, uint64_t seed)
+{
+	const uint64_t key = Random::deriveKey(seed, RandomStream::WindErosion);
+
+	for (int j = 0; j < itr; j++)
+	{
+		WindParticle originParticle = spawnWindParticle(key, j, pVel);
 
 		//Keeping the edge of the terrain constant to prevent particles from slipping and creating pits
-		index = (int)((originParticle.position.y * resolution) + originParticle.position.x);
+		int index = (int)((originParticle.position.y * resolution) + originParticle.position.x);
 		float edgeHeight = heightMap[index];
 
 		WindErosion wind(wVel[0], wVel[1], wVel[2]);
@@ -538,41 +1545,466 @@ void TerrainMesh::windErosion(float dt, int itr, float* pVel, float* wVel, float
 
 		heightMap[index] = edgeHeight;
 	}
+
+	MarkAllDirty();
+}
+
+template<typename CellOf, typename FlyTile>
+void TerrainMesh::flyTiled(int count, int tileSize, int batchSize, CellOf cellOf, FlyTile flyTile)
+{
+	const int tilesPerSide = (resolution + tileSize - 1) / tileSize;
+	const int reach = tileSize / 2 - 2;	//How far past its tile an item may go, leaving a gap between the cells touched from two tiles run together
+
+	//The items waiting in each tile, always in the order they were launched
+	std::vector<std::vector<int>> waiting(tilesPerSide * tilesPerSide);
+	std::vector<std::vector<int>> paused(waiting.size());
+	std::vector<int> tiles;
+
+	auto tileOf = [&](int item)
+	{
+		const XMINT2 cell = cellOf(item);
+
+		return (cell.y / tileSize) * tilesPerSide + (cell.x / tileSize);
+	};
+
+	int launched = 0;
+	int running = 0;
+
+	//Each round launches another batch then runs every tile once, in four passes so that no two tiles run together are next to each other
+	//An item that reaches the edge of where its tile may go waits for the next round, in the tile it has reached
+	while (launched < count || running > 0)
+	{
+		for (int end = (std::min)(count, launched + batchSize); launched < end; launched++)
+		{
+			waiting[tileOf(launched)].push_back(launched);
+			running++;
+		}
+
+		for (int colour = 0; colour < 4; colour++)
+		{
+			tiles.clear();
+
+			for (int tileY = colour / 2; tileY < tilesPerSide; tileY += 2)
+			{
+				for (int tileX = colour % 2; tileX < tilesPerSide; tileX += 2)
+				{
+					if (!waiting[tileY * tilesPerSide + tileX].empty())
+					{
+						tiles.push_back(tileY * tilesPerSide + tileX);
+					}
+				}
+			}
+
+			workers.parallelFor((int)tiles.size(), [&](int start, int end)
+			{
+				for (int t = start; t < end; t++)
+				{
+					const int tile = tiles[t];
+					const XMINT2 regionMin((tile % tilesPerSide) * tileSize - reach, (tile / tilesPerSide) * tileSize - reach);
+					const XMINT2 regionMax(regionMin.x + tileSize + 2 * reach, regionMin.y + tileSize + 2 * reach);
+
+					flyTile(waiting[tile], regionMin, regionMax, paused[tile]);
+
+					waiting[tile].clear();
+				}
+			});
+		}
+
+		//Sorted back into the tiles they have reached, tile by tile and in launch order within each, which only depends on where they got to
+		running = 0;
+
+		for (std::vector<int>& items : paused)
+		{
+			for (int item : items)
+			{
+				waiting[tileOf(item)].push_back(item);
+				running++;
+			}
+
+			items.clear();
+		}
+
+		for (std::vector<int>& items : waiting)
+		{
+			std::sort(items.begin(), items.end());
+		}
+	}
+}
+
+void TerrainMesh::windErosionParallel(float dt, int itr, float* pVel, float* wVel, float sed, float sus, float abr, float rgh, float set, bool weigh, uint64_t seed)
+{
+	const uint64_t key = Random::deriveKey(seed, RandomStream::WindErosion);
+
+	//Every particle shares the one set of settings, their own wind and sediment travel in their flights
+	WindErosion wind(wVel[0], wVel[1], wVel[2]);
+	wind.setWindAttributes(sed, sus, abr, rgh, set, weigh);
+
+	std::vector<WindFlight> flights(itr > 0 ? itr : 0);
+	std::vector<std::pair<int, float>> edges(flights.size());
+
+	for (int j = 0; j < itr; j++)
+	{
+		flights[j] = wind.launch(spawnWindParticle(key, j, pVel));
+
+		//The cells particles start from keep the heights they had before any of them flew, so the edge of the terrain stays put as in windErosion
+		int index = (int)((flights[j].particle.position.y * resolution) + flights[j].particle.position.x);
+		edges[j] = std::make_pair(index, heightMap[index]);
+	}
+
+	auto cellOf = [&](int particle)
+	{
+		return XMINT2((int)flights[particle].particle.position.x, (int)flights[particle].particle.position.y);
+	};
+
+	flyTiled(itr, windTileSize, windBatchSize, cellOf, [&](const std::vector<int>& particles, XMINT2 regionMin, XMINT2 regionMax, std::vector<int>& paused)
+	{
+		//Each thread keeps its batch's arrays from tile to tile, so they are only allocated as they grow
+		static thread_local WindBatch batch;
+
+		//A tile's particles fly together in lock-step, in launch order
+		wind.flyBatchWithin(dt, amplitude, heightMap, sedimentMap, flights.data(), particles.data(), (int)particles.size(), resolution, regionMin, regionMax, batch, paused);
+	});
+
+	for (const std::pair<int, float>& edge : edges)
+	{
+		heightMap[edge.first] = edge.second;
+	}
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::hydraulicErosion(int iterations, const HydraulicSettings& settings)
+{
+	HydraulicErosion water(resolution, settings);
+
+	for (int step = 0; step < iterations; step++)
+	{
+		workers.parallelFor(resolution, [&](int start, int end)
+		{
+			water.outflow(heightMap, sedimentMap, start, end);
+		});
+
+		workers.parallelFor(resolution, [&](int start, int end)
+		{
+			water.transport(start, end);
+		});
+
+		workers.parallelFor(resolution, [&](int start, int end)
+		{
+			water.erode(heightMap, sedimentMap, start, end);
+		});
+	}
+
+	workers.parallelFor(resolution, [&](int start, int end)
+	{
+		water.settle(sedimentMap, start, end);
+	});
+
+	MarkAllDirty();
+}
+
+//Where the j-th droplet of an erosion keyed by key lands, anywhere a droplet can sample the four cells around it
+Droplet TerrainMesh::spawnDroplet(const DropletErosion& droplets, uint64_t key, int j) const
+{
+	Random random(key, (uint64_t)j * 2);
+
+	float x = random.nextFloat() * (float)(resolution - 1);
+	float y = random.nextFloat() * (float)(resolution - 1);
+
+	return droplets.launch(x, y);
+}
+
+void TerrainMesh::dropletErosion(int droplets, const DropletSettings& settings, uint64_t seed)
+{
+	const uint64_t key = Random::deriveKey(seed, RandomStream::DropletErosion);
+
+	DropletErosion rain(resolution, settings);
+
+	for (int j = 0; j < droplets; j++)
+	{
+		Droplet droplet = spawnDroplet(rain, key, j);
+		rain.fly(heightMap, sedimentMap, droplet);
+	}
+
+	MarkAllDirty();
+}
+
+void TerrainMesh::dropletErosionParallel(int droplets, const DropletSettings& settings, uint64_t seed)
+{
+	const uint64_t key = Random::deriveKey(seed, RandomStream::DropletErosion);
+
+	DropletErosion rain(resolution, settings);
+
+	std::vector<Droplet> drops(droplets > 0 ? droplets : 0);
+
+	for (int j = 0; j < droplets; j++)
+	{
+		drops[j] = spawnDroplet(rain, key, j);
+	}
+
+	auto cellOf = [&](int drop)
+	{
+		return XMINT2((int)drops[drop].positionX, (int)drops[drop].positionY);
+	};
+
+	flyTiled(droplets, dropletTileSize, dropletBatchSize, cellOf, [&](const std::vector<int>& tileDroplets, XMINT2 regionMin, XMINT2 regionMax, std::vector<int>& paused)
+	{
+		//A tile's droplets run one after another, in the order they landed
+		for (int drop : tileDroplets)
+		{
+			if (rain.flyWithin(heightMap, sedimentMap, drops[drop], regionMin, regionMax))
+			{
+				paused.push_back(drop);
+			}
+		}
+	});
+
+	MarkAllDirty();
+}
+
+//Work out the amplitude and frequency of every octave ahead of time, in the same order the octave loop would
+void TerrainMesh::setupOctaves(int octaves, float ampl, float freq, std::vector<float>& a, std::vector<float>& f)
+{
+	a.resize(octaves > 0 ? octaves : 0);
+	f.resize(octaves > 0 ? octaves : 0);
+
+	float currentAmplitude = amplitude;
+	float currentFrequency = frequency;
+
+	for (int o = 0; o < octaves; o++)
+	{
+		a[o] = currentAmplitude;
+		f[o] = currentFrequency;
+
+		currentAmplitude *= ampl;
+		currentFrequency *= freq;
+	}
+}
+
+//A row of samples, the n-th one taken at (n * dx, y), from the noise the FBM operators are set to use
+void TerrainMesh::noiseSpan(float dx, float y, int count, float* output) const
+{
+	if (noiseType == NoiseType::Simplex)
+	{
+		simplex.generateSimplexSpan(0.0f, dx, y, count, output);
+	}
+
+	else if (noiseType == NoiseType::OpenSimplex2)
+	{
+		simplex.generateOpenSimplexSpan(0.0f, dx, y, count, output);
+	}
+
+	else
+	{
+		noise.generateImprovedPerlinSpan(0.0f, dx, y, count, output);
+	}
+}
+
+//Fill in two triangles for every quad drawn at a chunk's level
+//Vertices on a stitched side are merged down onto the positions the coarser neighbour uses, and the triangles that collapse are left out
+template<typename Index>
+static void BuildChunkIndices( int width, int height, int level, int stitchedEdges, std::vector<Index>& indices )
+{
+	const int step = 1 << level;
+	std::vector<int> columns, rows;
+	LevelPositions( width - 1, step, columns );
+	LevelPositions( height - 1, step, rows );
+
+	auto snap = [&]( int position, int quads ) {
+		return position == quads ? position : ( position / ( 2 * step ) ) * ( 2 * step );
+	};
+
+	auto vertex = [&]( int x, int y ) {
+		if( ( y == 0 && ( stitchedEdges & TerrainChunk::EdgeMinY ) ) || ( y == height - 1 && ( stitchedEdges & TerrainChunk::EdgeMaxY ) ) ) {
+			x = snap( x, width - 1 );
+		}
+
+		if( ( x == 0 && ( stitchedEdges & TerrainChunk::EdgeMinX ) ) || ( x == width - 1 && ( stitchedEdges & TerrainChunk::EdgeMaxX ) ) ) {
+			y = snap( y, height - 1 );
+		}
+
+		return (Index)( ( y * width ) + x );
+	};
+
+	auto triangle = [&]( Index a, Index b, Index c ) {
+		if( a != b && b != c && a != c ) {
+			indices.push_back( a );
+			indices.push_back( b );
+			indices.push_back( c );
+		}
+	};
+
+	indices.clear();
+
+	for( size_t m = 0; m + 1 < rows.size(); m++ ) {
+		for( size_t k = 0; k + 1 < columns.size(); k++ ) {
+			int x0 = columns[k], x1 = columns[k + 1];
+			int y0 = rows[m], y1 = rows[m + 1];
+
+			//Build index array
+			triangle( vertex( x0, y0 ), vertex( x1, y1 ), vertex( x0, y1 ) );
+			triangle( vertex( x0, y0 ), vertex( x1, y0 ), vertex( x1, y1 ) );
+		}
+	}
+}
+
+//Point the chunk at the cached index buffer for its size, level and stitching, building it the first time the combination is used
+void TerrainMesh::SelectIndexBuffer( ID3D11Device* device, TerrainChunk& chunk )
+{
+	//A parent's buffer is a coarser grid, so its level counts on from the spacing of that grid
+	const int columns = BufferVertices( chunk.width, chunk.depth );
+	const int rows = BufferVertices( chunk.height, chunk.depth );
+	const int level = chunk.level - chunk.depth;
+
+	const uint64_t key = ( (uint64_t)columns << 32 ) | ( (uint64_t)rows << 16 ) | (uint64_t)( level << 4 ) | (uint64_t)chunk.stitchedEdges;
+	auto cached = indexBuffers.find( key );
+
+	if( cached == indexBuffers.end() ) {
+		//Drop the variant that has gone unused the longest to keep GPU memory bounded
+		if( (int)indexBuffers.size() >= maxCachedIndexBuffers ) {
+			auto oldest = indexBuffers.begin();
+			for( auto it = indexBuffers.begin(); it != indexBuffers.end(); it++ ) {
+				if( it->second.lastUsed < oldest->second.lastUsed ) {
+					oldest = it;
+				}
+			}
+
+			if( oldest->second.buffer != NULL ) {
+				oldest->second.buffer->Release();
+			}
+			indexBuffers.erase( oldest );
+		}
+
+		CachedIndexBuffer entry;
+
+		//Every vertex of a chunk can be addressed with 16 bits, which halves the size of the buffer
+		const bool shortIndices = columns * rows <= 65536;
+		const UINT indexSize = shortIndices ? sizeof( unsigned short ) : sizeof( unsigned long );
+		std::vector<unsigned short> shorts;
+		std::vector<unsigned long> longs;
+		void* indices;
+
+		if( shortIndices ) {
+			BuildChunkIndices( columns, rows, level, chunk.stitchedEdges, shorts );
+			indices = shorts.data();
+			entry.indexCount = (int)shorts.size();
+			entry.format = DXGI_FORMAT_R16_UINT;
+		}
+		else {
+			BuildChunkIndices( columns, rows, level, chunk.stitchedEdges, longs );
+			indices = longs.data();
+			entry.indexCount = (int)longs.size();
+			entry.format = DXGI_FORMAT_R32_UINT;
+		}
+
+		D3D11_BUFFER_DESC indexBufferDesc;
+		D3D11_SUBRESOURCE_DATA indexData;
+
+		// Set up the description of the static index buffer.
+		indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		indexBufferDesc.ByteWidth = indexSize * entry.indexCount;
+		indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		indexBufferDesc.CPUAccessFlags = 0;
+		indexBufferDesc.MiscFlags = 0;
+		indexBufferDesc.StructureByteStride = 0;
+		// Give the subresource structure a pointer to the index data.
+		indexData.pSysMem = indices;
+		indexData.SysMemPitch = 0;
+		indexData.SysMemSlicePitch = 0;
+
+		// Create the index buffer.
+		device->CreateBuffer( &indexBufferDesc, &indexData, &entry.buffer );
+
+		cached = indexBuffers.insert( std::make_pair( key, entry ) ).first;
+	}
+
+	cached->second.lastUsed = ++indexBufferUses;
+
+	chunk.indexBuffer = cached->second.buffer;
+	chunk.indexFormat = cached->second.format;
+	chunk.indexCount = cached->second.indexCount;
 }
 
-//Create the vertex and index buffers that will be passed along to the graphics card for rendering
-//For CMP305, you don't need to worry so much about how or why yet, but notice the Vertex buffer is DYNAMIC here as we are changing the values often
-void TerrainMesh::CreateBuffers( ID3D11Device* device, VertexType* vertices, unsigned long* indices ) {
-
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-
-	// Set up the description of the dyanmic vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	vertexBufferDesc.ByteWidth = sizeof( VertexType ) * vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer( &vertexBufferDesc, &vertexData, &vertexBuffer );
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof( unsigned long ) * indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-
-	// Create the index buffer.
-	device->CreateBuffer( &indexBufferDesc, &indexData, &indexBuffer );
+void TerrainMesh::ReleaseIndexBuffers()
+{
+	for( auto& cached : indexBuffers ) {
+		if( cached.second.buffer != NULL ) {
+			cached.second.buffer->Release();
+		}
+	}
+
+	indexBuffers.clear();
+}
+
+void TerrainMesh::ReleaseChunks()
+{
+	for( TerrainChunk& chunk : chunks ) {
+		if( chunk.vertexBuffer != NULL ) {
+			chunk.vertexBuffer->Release();
+		}
+	}
+
+	for( TerrainChunk& parent : parents ) {
+		if( parent.vertexBuffer != NULL ) {
+			parent.vertexBuffer->Release();
+		}
+	}
+
+	chunks.clear();
+	visibleChunks.clear();
+	drawnChunks.clear();
+	parents.clear();
+	parentStarts.clear();
+	parentsPerSide.clear();
+	parentErrors.clear();
+}
+
+//Create the vertex buffers that will be passed along to the graphics card for rendering, one per chunk
+//For CMP305, you don't need to worry so much about how or why yet, but notice the Vertex buffers are DEFAULT here so parts of them can be updated with UpdateSubresource
+void TerrainMesh::CreateBuffers( ID3D11Device* device, VertexType* vertices ) {
+
+	std::vector<VertexType> chunkVertices;
+	std::vector<int> columns, rows;
+
+	//The chunks, then their parents
+	for( size_t n = 0; n < chunks.size() + parents.size(); n++ ) {
+		TerrainChunk& chunk = n < chunks.size() ? chunks[n] : parents[n - chunks.size()];
+
+		//Gather the chunk's rows out of the full grid, a parent only keeps the vertices at its spacing
+		LevelPositions( chunk.width - 1, 1 << chunk.depth, columns );
+		LevelPositions( chunk.height - 1, 1 << chunk.depth, rows );
+		chunkVertices.resize( columns.size() * rows.size() );
+
+		for( size_t m = 0; m < rows.size(); m++ ) {
+			const VertexType* row = &vertices[( chunk.startY + rows[m] ) * resolution + chunk.startX];
+
+			if( chunk.depth == 0 ) {
+				memcpy( &chunkVertices[m * columns.size()], row, sizeof( VertexType ) * columns.size() );
+				continue;
+			}
+
+			for( size_t k = 0; k < columns.size(); k++ ) {
+				chunkVertices[m * columns.size() + k] = row[columns[k]];
+			}
+		}
+
+		D3D11_BUFFER_DESC vertexBufferDesc;
+		D3D11_SUBRESOURCE_DATA vertexData;
+
+		// Set up the description of the vertex buffer.
+		vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		vertexBufferDesc.ByteWidth = (UINT)( sizeof( VertexType ) * chunkVertices.size() );
+		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexBufferDesc.CPUAccessFlags = 0;
+		vertexBufferDesc.MiscFlags = 0;
+		vertexBufferDesc.StructureByteStride = 0;
+		// Give the subresource structure a pointer to the vertex data.
+		vertexData.pSysMem = chunkVertices.data();
+		vertexData.SysMemPitch = 0;
+		vertexData.SysMemSlicePitch = 0;
+		// Now create the vertex buffer.
+		device->CreateBuffer( &vertexBufferDesc, &vertexData, &chunk.vertexBuffer );
+
+		SelectIndexBuffer( device, chunk );
+	}
 }
\ No newline at end of file
@@ -2,7 +2,98 @@
 
 #include "PlaneMesh.h"
 #include "PerlinNoise.h"
+#include "SimplexNoise.h"
+#include "WorleyNoise.h"
+#include "Random.h"
 #include "WindErosion.h"
+#include "HydraulicErosion.h"
+#include "DropletErosion.h"
+#include "ThermalErosion.h"
+#include "ThreadPool.h"
+#include "TerrainNormals.h"
+#include "Frustum.h"
+
+#include <map>
+
+//Which noise the FBM operators build their octaves from
+enum class NoiseType
+{
+	ImprovedPerlin,	//Four corners a sample, as the terrain has always used
+	Simplex,	//Three corners a sample
+	OpenSimplex2	//Three corners a sample, hashed without a table and with fewer grid-aligned artefacts
+};
+
+//An inclusive rectangle of height map cells
+struct HeightMapRegion
+{
+	int minX = 0;
+	int minY = 0;
+	int maxX = -1;
+	int maxY = -1;
+
+	bool isEmpty() const { return maxX < minX || maxY < minY; }
+
+	//Grows the region so it also covers the given rectangle
+	void include(int x0, int y0, int x1, int y1)
+	{
+		if (isEmpty())
+		{
+			minX = x0; minY = y0; maxX = x1; maxY = y1;
+			return;
+		}
+
+		minX = x0 < minX ? x0 : minX;
+		minY = y0 < minY ? y0 : minY;
+		maxX = x1 > maxX ? x1 : maxX;
+		maxY = y1 > maxY ? y1 : maxY;
+	}
+
+	//The region grown by a border on every side, kept inside a map of the given size
+	HeightMapRegion expanded(int border, int size) const
+	{
+		HeightMapRegion result;
+		result.minX = minX - border < 0 ? 0 : minX - border;
+		result.minY = minY - border < 0 ? 0 : minY - border;
+		result.maxX = maxX + border > size - 1 ? size - 1 : maxX + border;
+		result.maxY = maxY + border > size - 1 ? size - 1 : maxY + border;
+
+		return result;
+	}
+};
+
+//A block of the terrain with its own vertex buffer, so it can be skipped when the camera cannot see it
+//Chunks are also merged into a quadtree of parents, each covering two by two of the ones below, so distant parts of the map can be drawn at once
+struct TerrainChunk
+{
+	int startX = 0;	//First vertex of the chunk in the height map
+	int startY = 0;
+	int width = 0;	//Height map vertices along each side, neighbouring chunks share the vertices on their common edge
+	int height = 0;
+
+	//How many times chunks were merged to make this one, a parent's buffer only keeps every (1 << depth)-th vertex plus the last along each side
+	int depth = 0;
+
+	XMFLOAT3 boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	//Sides whose vertices are merged to match a coarser neighbour, so no cracks open between levels of detail
+	enum Edge
+	{
+		EdgeMinX = 1,
+		EdgeMaxX = 2,
+		EdgeMinY = 4,
+		EdgeMaxY = 8
+	};
+
+	int level = 0;	//Level of detail, each level doubles the spacing between the vertices drawn, a parent is never finer than its own buffer
+	int stitchedEdges = 0;
+	float error = 0.0f;	//Largest height difference from the full detail grid at the level drawn
+
+	ID3D11Buffer* vertexBuffer = nullptr;
+	ID3D11Buffer* indexBuffer = nullptr;	//Shared between every chunk of the same size, level and stitching, owned by the terrain's cache
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+	int indexCount = 0;
+};
 
 class TerrainMesh : public PlaneMesh
 {
@@ -15,22 +106,107 @@ public:
 	void Resize( int newResolution );
 	void Regenerate( ID3D11Device* device, ID3D11DeviceContext* deviceContext );
 
+	//Works out which chunks can be seen, only those are drawn until the next call
+	void Cull( const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection );
+
+	//The terrain is drawn one chunk at a time, each with its own buffers and index count
+	//Until SelectLevels merges them, the chunks drawn are the visible ones
+	void sendChunkData( ID3D11DeviceContext* deviceContext, int drawnChunk, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+	int getChunkIndexCount( int drawnChunk ) const { return drawnChunks[drawnChunk]->indexCount; }
+	int getDrawnChunkCount() const { return (int)drawnChunks.size(); }
+	const TerrainChunk& getDrawnChunk( int drawnChunk ) const { return *drawnChunks[drawnChunk]; }
+	int getVisibleChunkCount() const { return (int)visibleChunks.size(); }
+	int getVisibleChunk( int visibleChunk ) const { return visibleChunks[visibleChunk]; }
+	int getChunkCount() const { return (int)chunks.size(); }
+	const TerrainChunk& getChunk( int chunk ) const { return chunks[chunk]; }
+	int getChunksPerSide() const { return chunksPerSide; }
+
+	//Picks the coarsest level for each chunk that stays within the pixel error at its distance from the camera
+	//Working down from the top of the quadtree, a parent far enough away for its own buffer gives its level to every chunk under it
+	//Neighbours are kept within one level of each other and the finer side is stitched to the coarser one
+	//Then any two by two chunks (or parents) at the same level, coarse enough for their parent's buffer and stitched the same way along each outer side,
+	//are drawn as their parent instead, so a far away stretch of the map costs one draw rather than one per chunk
+	void SelectLevels( ID3D11Device* device, const XMFLOAT3& cameraPosition, const XMMATRIX& projection, float viewportHeight );
+
+	//The largest height difference between the full detail grid and what a chunk draws at a given level
+	float getChunkError( int chunk, int level ) const { return lodErrors[chunk * lodLevels + level]; }
+
+	void setLodEnabled( bool enabled ) { lodEnabled = enabled; }
+	bool getLodEnabled() const { return lodEnabled; }
+	void setLodPixelError( float pixels ) { lodPixelError = pixels; }
+	float getLodPixelError() const { return lodPixelError; }
+
+	//Operators record which cells they changed, so Regenerate only rebuilds and uploads the vertices around them
+	void MarkDirty( int minX, int minY, int maxX, int maxY );
+	void MarkAllDirty();
+
 	void renderSampleTerrain(float dt);
 
 	void flatten();
 	void invert();
-	void random();
+	void random(uint64_t seed);
 
 	void smooth(int itr);
-	void fault(int itr);
+
+	//Slides ground steeper than talusAngle, in degrees, down onto the lower vertices around it, shedding rate of the excess each iteration
+	//Stops after the given number of iterations, or sooner once no vertex sheds more than threshold in one, returning how many it ran
+	//Every iteration is split into bands of rows across the worker threads, the result is the same however many there are
+	int thermalErosion(float talusAngle, float rate, int iterations, float threshold);
+	void fault(int itr, uint64_t seed);
 
 	void perlinOriginal();
 	void perlinImproved();
 
+	//Adds cellular noise at the terrain's amplitude and frequency, e.g. F1 for bowls and plateaus or F2 - F1 for cracks
+	void worley(WorleyFeature feature, WorleyDistance distance, float jitter);
+
 	void generateFBM(int octaves, float ampl, float freq);
 	void generateRidgedFBM(int octaves, float freq, float ampl);
 
-	void windErosion(float dt, int itr, float* pVel, float* wVel, float sed, float sus, float abr, float rgh, float set, bool weigh);
+	//FBM built from the noise's exact slope as well as its value, added to the heights like generateFBM and matching it bit for bit with no erosion
+	//If the map's slope was already known, after flatten or another call, Regenerate then takes the normals straight from the summed slopes
+	//Erosion damps each octave by the slope of the ones before it in this call, 1 / (1 + erosion * slope^2), so steep sides come out smoother than ridges and valleys
+	//It is here for the eroded look, not for speed: the slopes cost more to sum than the normals they replace, so generateFBM is quicker for plain terrain
+	void generateDerivativeFBM(int octaves, float ampl, float freq, float erosion = 0.0f);
+
+	//FBM sampled at points pushed around by a second FBM, fbm(p + strength * warp(p)), for twisted, folded looking terrain
+	//The warp is an improved Perlin FBM of its own with warpOctaves octaves starting at warpFrequency, measured in vertices
+	//It is kept between calls and only rebuilt when its octaves, frequency, the seed or the resolution change, so tweaking the base FBM or the strength is cheap
+	void generateWarpedFBM(int octaves, float ampl, float freq, int warpOctaves, float warpFrequency, float warpStrength);
+
+	//Improved Perlin FBM that repeats every resolution - 1 vertices, so copies of the map laid edge to edge join without a seam
+	//Each octave's frequency is rounded to a whole number of lattice cells across the tile, which becomes that octave's period
+	//The last row and column are the first ones again, the vertices two neighbouring tiles share
+	void generateTileableFBM(int octaves, float ampl, float freq);
+
+	//Raises (or lowers, with a negative strength) a round patch of terrain centred on a point in world space
+	void brush(float x, float z, float radius, float strength);
+
+	//Original octave-by-octave sweeps, kept to verify and benchmark the fused versions against
+	void generateFBMMultiPass(int octaves, float ampl, float freq);
+	void generateRidgedFBMMultiPass(int octaves, float ampl, float freq);
+
+	void windErosion(float dt, int itr, float* pVel, float* wVel, float sed, float sus, float abr, float rgh, float set, bool weigh, uint64_t seed);
+
+	//The same erosion flown across the worker threads, windBatchSize particles launched at a time
+	//The map is split into windTileSize tiles flown in four passes, one for each pairing of odd or even column with odd or even row,
+	//so the tiles flown together are a whole tile apart on both axes and their particles never touch the same cells
+	//Each tile's particles fly as one WindBatch, stepping in lock-step with vector instructions
+	//The result only depends on the seed, however many threads there are or which instructions are used; it differs from windErosion's, whose particles fly strictly one after another
+	void windErosionParallel(float dt, int itr, float* pVel, float* wVel, float sed, float sus, float abr, float rgh, float set, bool weigh, uint64_t seed);
+
+	//Rains on the whole map and lets the water run downhill for the given number of steps, wearing the ground away and carrying it off
+	//Every step is split into bands of rows across the worker threads, the result is the same however many there are
+	//The sediment still in the water when it stops is dropped where it is, onto the sediment map
+	void hydraulicErosion(int iterations, const HydraulicSettings& settings);
+
+	//Rains droplets one after another on random points of the map, each running downhill until its lifetime is up or it runs off the edge
+	void dropletErosion(int droplets, const DropletSettings& settings, uint64_t seed);
+
+	//The same droplets run across the worker threads, dropletBatchSize landing at a time
+	//Tiled like windErosionParallel, so droplets running at the same time are always in tiles too far apart for them to touch the same cells
+	//The result only depends on the seed, however many threads there are; it differs from dropletErosion's, whose droplets run strictly one after another
+	void dropletErosionParallel(int droplets, const DropletSettings& settings, uint64_t seed);
 
 	const inline int GetResolution() { return resolution; }
 
@@ -38,17 +214,117 @@ public:
 	void setFrequency(float freq) { frequency = freq; }
 	float getFrequency() const { return frequency; }
 	int getAmplitude() const { return amplitude; }
+	const float* getHeightMap() const { return heightMap; }
+	const float* getSedimentMap() const { return sedimentMap; }
+	const void* getVertexData() const { return vertices; }
+	int getVertexCount() const { return vertexCount; }
+	float getTerrainSize() const { return terrainSize; }
+
+	//Seeds the noise tables, the random operators take their own seed when they are applied
+	void setNoiseSeed(uint64_t seed) { noise.reseed(seed); simplex.reseed(seed); cellular.reseed(seed); warpCached = false; }
+
+	//Picks the noise generateFBM and generateRidgedFBM use, the multi-pass versions always use improved Perlin
+	void setNoiseType(NoiseType type) { noiseType = type; }
+	NoiseType getNoiseType() const { return noiseType; }
+
+	//How many threads the height map operators split their rows across
+	void setThreadCount(int threads) { workers.resize(threads); }
+	int getThreadCount() const { return workers.getThreadCount(); }
+
+	//Changing how normals are worked out rebuilds every one of them on the next Regenerate
+	void setNormalMode(NormalMode mode) { normalGenerator.setMode(mode); MarkAllDirty(); }
+	NormalMode getNormalMode() const { return normalGenerator.getMode(); }
+
+	static const int chunkQuads = 64;	//Quads along each side of a chunk, small enough for 16-bit indices
+	static const int lodLevels = 7;	//Down to a single quad per chunk
+	static const int windTileSize = 64;	//Cells along each side of windErosionParallel's tiles
+	static const int windBatchSize = 2048;	//Particles windErosionParallel launches each round
+	static const int dropletTileSize = 64;	//Cells along each side of dropletErosionParallel's tiles
+	static const int dropletBatchSize = 4096;	//Droplets dropletErosionParallel lands each round
 
 private:
-	void CreateBuffers( ID3D11Device* device, VertexType* vertices, unsigned long* indices );
+	//The grid topology only depends on the chunk size, so each size's index buffer is built once and reused
+	struct CachedIndexBuffer
+	{
+		ID3D11Buffer* buffer = nullptr;
+		DXGI_FORMAT format = DXGI_FORMAT_R32_UINT;
+		int indexCount = 0;
+		uint64_t lastUsed = 0;
+	};
+
+	void CreateBuffers( ID3D11Device* device, VertexType* vertices );
+	void SelectIndexBuffer( ID3D11Device* device, TerrainChunk& chunk );
+	void ReleaseIndexBuffers();
+	void ReleaseChunks();
+	void BuildVertexLayout();
+	void BuildChunks();
+	TerrainChunk* FindChunk( int depth, int x, int y );
+	void UpdateChunkMetrics( const HeightMapRegion& region );
+	float MeasureChunkError( const TerrainChunk& chunk, int level ) const;
+	void UpdateVertices( const HeightMapRegion& region );
+	void UploadVertices( ID3D11DeviceContext* deviceContext, const HeightMapRegion& region );
+	void setupOctaves(int octaves, float ampl, float freq, std::vector<float>& a, std::vector<float>& f);
+	void noiseSpan(float dx, float y, int count, float* output) const;
+	void UpdateWarpField(int octaves, float frequency);
+	WindParticle spawnWindParticle(uint64_t key, int j, const float* pVel) const;
+	Droplet spawnDroplet(const DropletErosion& droplets, uint64_t key, int j) const;
+
+	//Runs count items that wander over the map, like particles or droplets, across the worker threads in square tiles of tileSize cells
+	//Launches batchSize more each round, then calls flyTile(items, regionMin, regionMax, paused) once for every tile that has any, in launch order,
+	//with the region the tile's items may touch; flyTile adds the ones that reached its edge to paused, and cellOf(item) says which tile they wait in
+	//Tiles run together share the parity of their column and of their row, so they are always two apart and the order items touch each cell in only depends on where they go, not on the threads
+	template<typename CellOf, typename FlyTile>
+	void flyTiled(int count, int tileSize, int batchSize, CellOf cellOf, FlyTile flyTile);
 
 	const float m_UVscale = 10.0f;			//Tile the UV map 10 times across the plane
 	const float terrainSize = 100.0f;		//What is the width and height of our terrain
-	float* heightMap;
-	float* sedimentMap;
+	float* heightMap = nullptr;
+	float* sedimentMap = nullptr;
+
+	//Height change per unit along x for every vertex, followed by the same along z, only kept up to date by flatten and generateDerivativeFBM
+	//Any other edit marks the terrain dirty, which goes back to working the normals out from the heights
+	float* slopeMap = nullptr;
+	bool slopesValid = false;
+
+	//Both components of generateWarpedFBM's warp for every vertex, x for the whole map then y, before the strength scales them
+	std::vector<float> warpField;
+	int warpOctaves = 0;
+	float warpFrequency = 0.0f;
+	bool warpCached = false;
+
+	//Kept between regenerates so a small edit only has to touch the vertices around it
+	VertexType* vertices = nullptr;
+	HeightMapRegion dirtyRegion;
+
+	std::vector<TerrainChunk> chunks;
+	std::vector<int> visibleChunks;
+	std::vector<TerrainChunk*> drawnChunks;
+	int chunksPerSide = 0;
+
+	//The quadtree above the chunks, every parent of depth one in rows, then depth two and so on up to the level a chunk can be drawn down to
+	std::vector<TerrainChunk> parents;
+	std::vector<int> parentStarts;	//Where each depth begins in parents, depth one first
+	std::vector<int> parentsPerSide;
+	std::vector<float> parentErrors;	//lodLevels errors for each parent, the largest of its children's at each level
+
+	std::vector<float> lodErrors;	//lodLevels errors for each chunk, one after another
+	bool lodEnabled = true;
+	float lodPixelError = 2.0f;	//How far, in pixels, a coarser level may move the surface on screen
+
+	//Each depth uses at most four chunk sizes (full, right edge, bottom edge and corner), each with a variant per level and set of stitched edges
+	//Every variant one map can use fits, so the ones in use this frame are never the oldest
+	static const int maxCachedIndexBuffers = 2048;
+	std::map<uint64_t, CachedIndexBuffer> indexBuffers;	//Keyed by chunk size, level and stitched edges
+	uint64_t indexBufferUses = 0;
 
 	float amplitude;
 	float frequency;
 
 	PerlinNoise noise;
+	SimplexNoise simplex;
+	WorleyNoise cellular;
+	NoiseType noiseType = NoiseType::ImprovedPerlin;
+
+	ThreadPool workers;
+	TerrainNormals normalGenerator;
 };
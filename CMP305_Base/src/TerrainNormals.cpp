@@ -0,0 +1,394 @@
+#include "TerrainNormals.h"
+
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <emmintrin.h>
+
+static inline void storeNormal(float* normals, int normalStride, int index, float x, float y, float z)
+{
+	float* normal = &normals[(size_t)index * normalStride];
+
+	normal[0] = x;
+	normal[1] = y;
+	normal[2] = z;
+}
+
+//The lanes are written out one vertex at a time, since the normals sit inside interleaved vertices
+static inline void storeNormalsSSE2(float* normals, int normalStride, int index, __m128 x, __m128 y, __m128 z)
+{
+	float lanes[3][4];
+
+	_mm_storeu_ps(lanes[0], x);
+	_mm_storeu_ps(lanes[1], y);
+	_mm_storeu_ps(lanes[2], z);
+
+	for (int l = 0; l < 4; l++)
+	{
+		storeNormal(normals, normalStride, index + l, lanes[0][l], lanes[1][l], lanes[2][l]);
+	}
+}
+
+//Flips the sign bit, which unlike subtracting from zero matches the scalar unary minus for zero slopes too
+static inline __m128 negateSSE2(__m128 value)
+{
+	return _mm_xor_ps(value, _mm_set1_ps(-0.0f));
+}
+
+static inline __m128 lengthSSE2(__m128 x, __m128 y, __m128 z)
+{
+	return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+}
+
+void TerrainNormals::generate(const float* heights, int resolution, float spacing, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const
+{
+	if (resolution < 2 || rowStart >= rowEnd || columnStart >= columnEnd)
+	{
+		return;
+	}
+
+	if (mode == NormalMode::CentralDifference)
+	{
+		centralDifference(heights, resolution, spacing, rowStart, rowEnd, columnStart, columnEnd, normals, normalStride);
+	}
+
+	else
+	{
+		smoothed(heights, resolution, spacing, rowStart, rowEnd, columnStart, columnEnd, normals, normalStride);
+	}
+}
+
+//Unit normals of the quads [start, end) along one row of quads, the same plane normal the mesh has always used
+void TerrainNormals::faceRow(const float* heights, int resolution, float spacing, int row, int start, int end, float* x, float* y, float* z) const
+{
+	const float* current = &heights[row * resolution];
+	const float* next = &heights[(row + 1) * resolution];
+
+	int i = start;
+
+	//AVX2 would only widen the arithmetic, the loads and the interleaved stores cost the same, so SSE2 covers both
+	if (simdLevel != SimdLevel::Scalar)
+	{
+		const __m128 s = _mm_set1_ps(spacing);
+		const __m128 up = _mm_set1_ps(spacing * spacing);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(&current[i]);
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(&current[i + 1]), a);
+			__m128 dz = _mm_sub_ps(_mm_loadu_ps(&next[i]), a);
+
+			__m128 faceX = negateSSE2(_mm_mul_ps(s, dx));
+			__m128 faceZ = negateSSE2(_mm_mul_ps(s, dz));
+			__m128 mag = lengthSSE2(faceX, up, faceZ);
+
+			_mm_storeu_ps(&x[i], _mm_div_ps(faceX, mag));
+			_mm_storeu_ps(&y[i], _mm_div_ps(up, mag));
+			_mm_storeu_ps(&z[i], _mm_div_ps(faceZ, mag));
+		}
+	}
+
+	for (; i < end; i++)
+	{
+		float a = current[i];
+		float dx = current[i + 1] - a;
+		float dz = next[i] - a;
+
+		//The cross product of the two quad edges, with the zero terms left out
+		float faceX = -(spacing * dx);
+		float faceY = spacing * spacing;
+		float faceZ = -(spacing * dz);
+		float mag = sqrtf((faceX * faceX + faceY * faceY) + faceZ * faceZ);
+
+		x[i] = faceX / mag;
+		y[i] = faceY / mag;
+		z[i] = faceZ / mag;
+	}
+}
+
+void TerrainNormals::smoothed(const float* heights, int resolution, float spacing, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const
+{
+	const int quads = resolution - 1;
+
+	//Only the quads touching the requested columns are needed
+	const int faceStart = columnStart - 1 < 0 ? 0 : columnStart - 1;
+	const int faceEnd = columnEnd < quads ? columnEnd : quads;
+
+	//Two rows of face normals are kept, the quads above the current vertex row and the ones below it
+	std::vector<float> faces(6 * quads);
+	float* top[3] = { &faces[0], &faces[quads], &faces[2 * quads] };
+	float* bottom[3] = { &faces[3 * quads], &faces[4 * quads], &faces[5 * quads] };
+
+	if (rowStart >= 1)
+	{
+		faceRow(heights, resolution, spacing, rowStart - 1, faceStart, faceEnd, top[0], top[1], top[2]);
+	}
+
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		//The quads above the last row are the ones below this one
+		for (int c = 0; c < 3; c++)
+		{
+			std::swap(top[c], bottom[c]);
+		}
+
+		const bool hasTop = j < quads;
+		const bool hasBottom = j >= 1;
+
+		if (hasTop)
+		{
+			faceRow(heights, resolution, spacing, j, faceStart, faceEnd, top[0], top[1], top[2]);
+		}
+
+		auto smoothVertex = [&](int i)
+		{
+			//Smooth the normals by averaging the normals from the surrounding planes
+			float smoothed[3] = { 0.0f, 0.0f, 0.0f };
+
+			for (int c = 0; c < 3; c++)
+			{
+				//Left planes
+				if ((i - 1) >= 0)
+				{
+					if (hasTop)
+					{
+						smoothed[c] += top[c][i - 1];
+					}
+
+					if (hasBottom)
+					{
+						smoothed[c] += bottom[c][i - 1];
+					}
+				}
+
+				//Right planes
+				if (i < quads)
+				{
+					if (hasTop)
+					{
+						smoothed[c] += top[c][i];
+					}
+
+					if (hasBottom)
+					{
+						smoothed[c] += bottom[c][i];
+					}
+				}
+			}
+
+			float count = (float)(((i - 1) >= 0 ? 1 : 0) + (i < quads ? 1 : 0)) * (float)((hasTop ? 1 : 0) + (hasBottom ? 1 : 0));
+
+			for (int c = 0; c < 3; c++)
+			{
+				smoothed[c] /= count;
+			}
+
+			float mag = sqrtf((smoothed[0] * smoothed[0] + smoothed[1] * smoothed[1]) + smoothed[2] * smoothed[2]);
+
+			storeNormal(normals, normalStride, j * resolution + i, smoothed[0] / mag, smoothed[1] / mag, smoothed[2] / mag);
+		};
+
+		int i = columnStart;
+
+		//Vertices away from the edges always have all four quads, so they can be done a few at a time
+		if (simdLevel != SimdLevel::Scalar && hasTop && hasBottom)
+		{
+			const int interiorEnd = columnEnd < quads ? columnEnd : quads;
+			const __m128 four = _mm_set1_ps(4.0f);
+
+			for (; i < 1; i++)
+			{
+				smoothVertex(i);
+			}
+
+			for (; i + 4 <= interiorEnd; i += 4)
+			{
+				__m128 sum[3];
+
+				for (int c = 0; c < 3; c++)
+				{
+					//Same order as smoothVertex, so both give exactly the same normals
+					sum[c] = _mm_add_ps(_mm_setzero_ps(), _mm_loadu_ps(&top[c][i - 1]));
+					sum[c] = _mm_add_ps(sum[c], _mm_loadu_ps(&bottom[c][i - 1]));
+					sum[c] = _mm_add_ps(sum[c], _mm_loadu_ps(&top[c][i]));
+					sum[c] = _mm_add_ps(sum[c], _mm_loadu_ps(&bottom[c][i]));
+					sum[c] = _mm_div_ps(sum[c], four);
+				}
+
+				__m128 mag = lengthSSE2(sum[0], sum[1], sum[2]);
+
+				storeNormalsSSE2(normals, normalStride, j * resolution + i, _mm_div_ps(sum[0], mag), _mm_div_ps(sum[1], mag), _mm_div_ps(sum[2], mag));
+			}
+		}
+
+		for (; i < columnEnd; i++)
+		{
+			smoothVertex(i);
+		}
+	}
+}
+
+void TerrainNormals::centralDifference(const float* heights, int resolution, float spacing, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const
+{
+	const int quads = resolution - 1;
+
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		//Edges fall back to a one-sided difference
+		const int up = j > 0 ? j - 1 : j;
+		const int down = j < quads ? j + 1 : j;
+		const float zScale = 1.0f / (float)(down - up);
+
+		const float* row = &heights[j * resolution];
+		const float* above = &heights[up * resolution];
+		const float* below = &heights[down * resolution];
+
+		auto differenceVertex = [&](int i)
+		{
+			const int left = i > 0 ? i - 1 : i;
+			const int right = i < quads ? i + 1 : i;
+
+			//The height change per cell, with the spacing kept in y so it matches the face normals
+			float x = -((row[right] - row[left]) * (1.0f / (float)(right - left)));
+			float y = spacing;
+			float z = -((below[i] - above[i]) * zScale);
+			float mag = sqrtf((x * x + y * y) + z * z);
+
+			storeNormal(normals, normalStride, j * resolution + i, x / mag, y / mag, z / mag);
+		};
+
+		int i = columnStart;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			const int interiorEnd = columnEnd < quads ? columnEnd : quads;
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 s = _mm_set1_ps(spacing);
+			const __m128 zStep = _mm_set1_ps(zScale);
+
+			for (; i < 1; i++)
+			{
+				differenceVertex(i);
+			}
+
+			for (; i + 4 <= interiorEnd; i += 4)
+			{
+				__m128 x = negateSSE2(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&row[i + 1]), _mm_loadu_ps(&row[i - 1])), half));
+				__m128 z = negateSSE2(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&below[i]), _mm_loadu_ps(&above[i])), zStep));
+				__m128 mag = lengthSSE2(x, s, z);
+
+				storeNormalsSSE2(normals, normalStride, j * resolution + i, _mm_div_ps(x, mag), _mm_div_ps(s, mag), _mm_div_ps(z, mag));
+			}
+		}
+
+		for (; i < columnEnd; i++)
+		{
+			differenceVertex(i);
+		}
+	}
+}
+
+void TerrainNormals::generateFromSlopes(const float* slopesX, const float* slopesZ, int resolution, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const
+{
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		const float* rowX = &slopesX[j * resolution];
+		const float* rowZ = &slopesZ[j * resolution];
+
+		int i = columnStart;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			const __m128 up = _mm_set1_ps(1.0f);
+
+			for (; i + 4 <= columnEnd; i += 4)
+			{
+				__m128 x = negateSSE2(_mm_loadu_ps(&rowX[i]));
+				__m128 z = negateSSE2(_mm_loadu_ps(&rowZ[i]));
+				__m128 mag = lengthSSE2(x, up, z);
+
+				storeNormalsSSE2(normals, normalStride, j * resolution + i, _mm_div_ps(x, mag), _mm_div_ps(up, mag), _mm_div_ps(z, mag));
+			}
+		}
+
+		for (; i < columnEnd; i++)
+		{
+			float x = -rowX[i];
+			float z = -rowZ[i];
+			float mag = sqrtf((x * x + 1.0f) + z * z);
+
+			storeNormal(normals, normalStride, j * resolution + i, x / mag, 1.0f / mag, z / mag);
+		}
+	}
+}
+
+void TerrainNormals::generateReference(const float* heights, int resolution, float spacing, float* normals, int normalStride)
+{
+	const int quads = resolution - 1;
+	std::vector<float> faceNormals(3 * quads * quads);
+
+	//Set up normals
+	for (int j = 0; j < quads; j++)
+	{
+		for (int i = 0; i < quads; i++)
+		{
+			//Calculate the plane normals
+			float a[3] = { (float)i * spacing, heights[j * resolution + i], (float)j * spacing };
+			float b[3] = { (float)(i + 1) * spacing, heights[j * resolution + i + 1], (float)j * spacing };
+			float c[3] = { (float)i * spacing, heights[(j + 1) * resolution + i], (float)(j + 1) * spacing };
+
+			//Two edges
+			float ab[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float ac[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+
+			//Calculate the cross product
+			float cross[3];
+			cross[0] = ab[1] * ac[2] - ab[2] * ac[1];
+			cross[1] = ab[2] * ac[0] - ab[0] * ac[2];
+			cross[2] = ab[0] * ac[1] - ab[1] * ac[0];
+			float mag = sqrtf((cross[0] * cross[0]) + (cross[1] * cross[1]) + (cross[2] * cross[2]));
+
+			for (int n = 0; n < 3; n++)
+			{
+				faceNormals[3 * (j * quads + i) + n] = cross[n] / mag;
+			}
+		}
+	}
+
+	//Smooth the normals by averaging the normals from the surrounding planes
+	for (int j = 0; j < resolution; j++)
+	{
+		for (int i = 0; i < resolution; i++)
+		{
+			float smoothed[3] = { 0.0f, 0.0f, 0.0f };
+			float count = 0;
+
+			const int neighbours[4][2] = { { i - 1, j }, { i - 1, j - 1 }, { i, j }, { i, j - 1 } };
+
+			for (const auto& quad : neighbours)
+			{
+				if (quad[0] >= 0 && quad[0] < quads && quad[1] >= 0 && quad[1] < quads)
+				{
+					for (int n = 0; n < 3; n++)
+					{
+						smoothed[n] += faceNormals[3 * (quad[1] * quads + quad[0]) + n];
+					}
+
+					count++;
+				}
+			}
+
+			float mag = 0.0f;
+
+			for (int n = 0; n < 3; n++)
+			{
+				smoothed[n] /= count;
+				mag += smoothed[n] * smoothed[n];
+			}
+
+			mag = sqrtf(mag);
+
+			storeNormal(normals, normalStride, j * resolution + i, smoothed[0] / mag, smoothed[1] / mag, smoothed[2] / mag);
+		}
+	}
+}
\ No newline at end of file
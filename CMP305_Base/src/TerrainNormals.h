@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+//How vertex normals are worked out from the height grid
+enum class NormalMode
+{
+	Smoothed,	//Average of the normals of the (up to) four quads around each vertex, as the terrain has always been shaded
+	CentralDifference	//Slope between the neighbouring heights, cheaper and a little softer
+};
+
+//Builds vertex normals straight from a square height grid, a row of vertices at a time in SIMD lanes
+//Only the heights are read, so any band of rows can be handed to a different thread
+class TerrainNormals
+{
+public:
+	//Writes the normals of the vertices in rows [rowStart, rowEnd) and columns [columnStart, columnEnd)
+	//normals points at the x of the first vertex's normal, with normalStride floats between one vertex and the next
+	void generate(const float* heights, int resolution, float spacing, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const;
+
+	//Normals of the same vertices from known slopes instead of the heights, the height change per unit along x and along z in two grids
+	void generateFromSlopes(const float* slopesX, const float* slopesZ, int resolution, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const;
+
+	//Original two-pass face then smooth normals, kept to verify and benchmark the kernel against
+	static void generateReference(const float* heights, int resolution, float spacing, float* normals, int normalStride);
+
+	void setMode(NormalMode normalMode) { mode = normalMode; }
+	NormalMode getMode() const { return mode; }
+
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+
+private:
+	void smoothed(const float* heights, int resolution, float spacing, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const;
+	void centralDifference(const float* heights, int resolution, float spacing, int rowStart, int rowEnd, int columnStart, int columnEnd, float* normals, int normalStride) const;
+
+	void faceRow(const float* heights, int resolution, float spacing, int row, int start, int end, float* x, float* y, float* z) const;
+
+	NormalMode mode = NormalMode::Smoothed;
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
+};
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include "TerrainStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+//Packs a tile's position into a single key, negative positions included
+static uint64_t tileKey(int tileX, int tileY)
+{
+	return ((uint64_t)(uint32_t)tileX << 32) | (uint64_t)(uint32_t)tileY;
+}
+
+TerrainStreamer::TerrainStreamer(uint64_t seed, int threads) :
+	noise(seed),
+	generators(ThreadPool::backgroundPoolSize(threads))
+{
+	maxPendingTiles = (generators.getThreadCount() - 1) * 2;
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+	Flush();
+
+	if (indexBuffer != NULL)
+	{
+		indexBuffer->Release();
+		indexBuffer = NULL;
+	}
+}
+
+void TerrainStreamer::Update(ID3D11Device* device, const XMFLOAT3& cameraPosition)
+{
+	frame++;
+
+	if (indexBuffer == NULL)
+	{
+		CreateIndexBuffer(device);
+	}
+
+	UploadCompleted(device);
+
+	struct Request
+	{
+		float distance;
+		int tileX;
+		int tileY;
+	};
+
+	std::vector<Request> missing;
+	std::set<uint64_t> inRange;
+
+	residentTiles = 0;
+
+	const float tileSize = getTileSize();
+	const int minX = (int)floorf((cameraPosition.x - viewDistance) / tileSize);
+	const int maxX = (int)floorf((cameraPosition.x + viewDistance) / tileSize);
+	const int minY = (int)floorf((cameraPosition.z - viewDistance) / tileSize);
+	const int maxY = (int)floorf((cameraPosition.z + viewDistance) / tileSize);
+
+	for (int ty = minY; ty <= maxY; ty++)
+	{
+		for (int tx = minX; tx <= maxX; tx++)
+		{
+			//Distance across the ground to the nearest point of the tile
+			float left = (float)tx * tileSize;
+			float top = (float)ty * tileSize;
+			float dx = cameraPosition.x < left ? left - cameraPosition.x : (std::max)(0.0f, cameraPosition.x - (left + tileSize));
+			float dz = cameraPosition.z < top ? top - cameraPosition.z : (std::max)(0.0f, cameraPosition.z - (top + tileSize));
+			float distance = sqrtf(dx * dx + dz * dz);
+
+			if (distance > viewDistance)
+			{
+				continue;
+			}
+
+			const uint64_t key = tileKey(tx, ty);
+			auto cached = tiles.find(key);
+
+			//A tile is only asked of the cache once, when it comes into range, not again every frame it stays there or waits on a worker
+			const bool requested = wanted.find(key) == wanted.end();
+			inRange.insert(key);
+
+			if (cached != tiles.end())
+			{
+				cached->second->lastUsed = frame;
+				residentTiles++;
+
+				if (requested)
+				{
+					cacheHits++;
+				}
+
+				continue;
+			}
+
+			if (requested)
+			{
+				cacheMisses++;
+			}
+
+			if (pending.find(key) == pending.end())
+			{
+				missing.push_back({ distance, tx, ty });
+			}
+		}
+	}
+
+	wanted.swap(inRange);
+
+	//The closest tiles are the most noticeable gaps, so they go to the workers first
+	std::sort(missing.begin(), missing.end(), [](const Request& a, const Request& b) { return a.distance < b.distance; });
+
+	for (const Request& request : missing)
+	{
+		if ((int)pending.size() >= maxPendingTiles)
+		{
+			break;
+		}
+
+		TerrainTile* tile = new TerrainTile();
+		tile->tileX = request.tileX;
+		tile->tileY = request.tileY;
+		tile->requested = std::chrono::high_resolution_clock::now();
+
+		pending[tileKey(request.tileX, request.tileY)] = tile;
+
+		generators.submit([this, tile]()
+		{
+			GenerateTile(*tile);
+
+			std::lock_guard<std::mutex> lock(completedMutex);
+			completed.push_back(tile);
+			completedSignal.notify_all();
+		});
+	}
+
+	EvictOldest();
+}
+
+void TerrainStreamer::Cull(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection)
+{
+	Frustum frustum(world, view, projection);
+
+	visibleTiles.clear();
+
+	for (auto& cached : tiles)
+	{
+		TerrainTile* tile = cached.second;
+
+		//Tiles outside view distance stay cached in case the camera comes back, but are not drawn
+		if (tile->lastUsed == frame && frustum.intersects(tile->boundsMin, tile->boundsMax))
+		{
+			visibleTiles.push_back(tile);
+		}
+	}
+}
+
+void TerrainStreamer::sendTileData(ID3D11DeviceContext* deviceContext, int visibleTile, D3D_PRIMITIVE_TOPOLOGY top)
+{
+	unsigned int stride = sizeof(TerrainTile::Vertex);
+	unsigned int offset = 0;
+
+	deviceContext->IASetVertexBuffers(0, 1, &visibleTiles[visibleTile]->vertexBuffer, &stride, &offset);
+	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	deviceContext->IASetPrimitiveTopology(top);
+}
+
+const TerrainTile* TerrainStreamer::getTile(int tileX, int tileY) const
+{
+	auto cached = tiles.find(tileKey(tileX, tileY));
+
+	return cached != tiles.end() ? cached->second : nullptr;
+}
+
+void TerrainStreamer::WaitForPending()
+{
+	std::unique_lock<std::mutex> lock(completedMutex);
+	completedSignal.wait(lock, [this]() { return completed.size() == pending.size(); });
+}
+
+void TerrainStreamer::setNoiseSeed(uint64_t seed)
+{
+	Flush();
+	noise.reseed(seed);
+}
+
+void TerrainStreamer::setFractal(int octaveCount, float octaveAmplitude, float octaveFrequency, float octaveGain, float octaveLacunarity)
+{
+	if (octaveCount == octaves && octaveAmplitude == amplitude && octaveFrequency == frequency && octaveGain == gain && octaveLacunarity == lacunarity)
+	{
+		return;
+	}
+
+	Flush();
+
+	octaves = octaveCount;
+	amplitude = octaveAmplitude;
+	frequency = octaveFrequency;
+	gain = octaveGain;
+	lacunarity = octaveLacunarity;
+}
+
+void TerrainStreamer::ResetStatistics()
+{
+	//The tiles already in range are asked for again, so every tile generated from here on has been counted as a miss
+	wanted.clear();
+
+	cacheHits = 0;
+	cacheMisses = 0;
+	tilesGenerated = 0;
+	tilesEvicted = 0;
+	totalLatency = 0.0;
+	maxLatency = 0.0;
+	totalGenerationTime = 0.0;
+}
+
+//Runs on a worker, so it only reads the noise and settings, which never change while a tile is pending
+void TerrainStreamer::GenerateTile(TerrainTile& tile) const
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//The first padded vertex, in vertices from the world origin
+	const int firstX = tile.tileX * tileQuads - 1;
+	const int firstY = tile.tileY * tileQuads - 1;
+
+	tile.heights.assign(paddedVertices * paddedVertices, 0.0f);
+
+	//The same octaves and row spans as TerrainMesh::generateFBM, counted from the world origin instead of the corner of the map
+	std::vector<float> samples(paddedVertices);
+	float currentAmplitude = amplitude;
+	float currentFrequency = frequency;
+
+	for (int o = 0; o < octaves; o++)
+	{
+		for (int j = 0; j < paddedVertices; j++)
+		{
+			float* row = &tile.heights[j * paddedVertices];
+
+			noise.generateImprovedPerlinSpan(0.0f, currentFrequency, (float)(firstY + j) * currentFrequency, paddedVertices, samples.data(), firstX);
+
+			for (int i = 0; i < paddedVertices; i++)
+			{
+				row[i] += samples[i] * currentAmplitude;
+			}
+		}
+
+		currentAmplitude *= gain;
+		currentFrequency *= lacunarity;
+	}
+
+	//Normals for every vertex inside the border, which has all of its neighbours
+	std::vector<float> normals(paddedVertices * paddedVertices * 3);
+	normalGenerator.generate(tile.heights.data(), paddedVertices, vertexSpacing, 1, paddedVertices - 1, 1, paddedVertices - 1, normals.data(), 3);
+
+	tile.vertices.resize(tileVertices * tileVertices);
+
+	float lowest = tile.heights[paddedVertices + 1];
+	float highest = lowest;
+
+	for (int j = 0; j < tileVertices; j++)
+	{
+		for (int i = 0; i < tileVertices; i++)
+		{
+			const int padded = (j + 1) * paddedVertices + (i + 1);
+			const int worldX = firstX + 1 + i;
+			const int worldY = firstY + 1 + j;
+			const float height = tile.heights[padded];
+
+			TerrainTile::Vertex& vertex = tile.vertices[j * tileVertices + i];
+			vertex.position = XMFLOAT3((float)worldX * vertexSpacing, height, (float)worldY * vertexSpacing);
+			vertex.texture = XMFLOAT2((float)worldX * uvPerVertex, (float)worldY * uvPerVertex);
+			vertex.normal = XMFLOAT3(normals[padded * 3], normals[padded * 3 + 1], normals[padded * 3 + 2]);
+
+			lowest = height < lowest ? height : lowest;
+			highest = height > highest ? height : highest;
+		}
+	}
+
+	tile.boundsMin = XMFLOAT3((float)(firstX + 1) * vertexSpacing, lowest, (float)(firstY + 1) * vertexSpacing);
+	tile.boundsMax = XMFLOAT3((float)(firstX + 1 + tileQuads) * vertexSpacing, highest, (float)(firstY + 1 + tileQuads) * vertexSpacing);
+
+	tile.generationMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//Give every finished tile its vertex buffer and move it into the cache
+void TerrainStreamer::UploadCompleted(ID3D11Device* device)
+{
+	std::vector<TerrainTile*> finished;
+
+	{
+		std::lock_guard<std::mutex> lock(completedMutex);
+		finished.swap(completed);
+	}
+
+	auto now = std::chrono::high_resolution_clock::now();
+
+	for (TerrainTile* tile : finished)
+	{
+		pending.erase(tileKey(tile->tileX, tile->tileY));
+
+		D3D11_BUFFER_DESC vertexBufferDesc;
+		D3D11_SUBRESOURCE_DATA vertexData;
+
+		//A tile never changes once built, so its buffer can be immutable
+		vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		vertexBufferDesc.ByteWidth = sizeof(TerrainTile::Vertex) * (UINT)tile->vertices.size();
+		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexBufferDesc.CPUAccessFlags = 0;
+		vertexBufferDesc.MiscFlags = 0;
+		vertexBufferDesc.StructureByteStride = 0;
+		vertexData.pSysMem = tile->vertices.data();
+		vertexData.SysMemPitch = 0;
+		vertexData.SysMemSlicePitch = 0;
+		device->CreateBuffer(&vertexBufferDesc, &vertexData, &tile->vertexBuffer);
+
+		//The heights are small and kept for looking up the ground, the vertices now live on the GPU
+		std::vector<TerrainTile::Vertex>().swap(tile->vertices);
+
+		tile->lastUsed = frame;
+		tiles[tileKey(tile->tileX, tile->tileY)] = tile;
+		memoryUsed += tileBytes();
+
+		double latency = std::chrono::duration<double, std::milli>(now - tile->requested).count();
+		tilesGenerated++;
+		totalLatency += latency;
+		maxLatency = latency > maxLatency ? latency : maxLatency;
+		totalGenerationTime += tile->generationMilliseconds;
+	}
+}
+
+//Every tile has the same grid, so one index buffer serves them all
+void TerrainStreamer::CreateIndexBuffer(ID3D11Device* device)
+{
+	std::vector<unsigned short> indices;
+	indices.reserve(tileQuads * tileQuads * 6);
+
+	for (int j = 0; j < tileQuads; j++)
+	{
+		for (int i = 0; i < tileQuads; i++)
+		{
+			unsigned short bottomLeft = (unsigned short)(j * tileVertices + i);
+			unsigned short bottomRight = (unsigned short)(bottomLeft + 1);
+			unsigned short topLeft = (unsigned short)(bottomLeft + tileVertices);
+			unsigned short topRight = (unsigned short)(topLeft + 1);
+
+			//Same winding and diagonal as the terrain's chunks
+			indices.push_back(bottomLeft);
+			indices.push_back(topRight);
+			indices.push_back(topLeft);
+
+			indices.push_back(bottomLeft);
+			indices.push_back(bottomRight);
+			indices.push_back(topRight);
+		}
+	}
+
+	D3D11_BUFFER_DESC indexBufferDesc;
+	D3D11_SUBRESOURCE_DATA indexData;
+
+	indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	indexBufferDesc.ByteWidth = sizeof(unsigned short) * (UINT)indices.size();
+	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.CPUAccessFlags = 0;
+	indexBufferDesc.MiscFlags = 0;
+	indexBufferDesc.StructureByteStride = 0;
+	indexData.pSysMem = indices.data();
+	indexData.SysMemPitch = 0;
+	indexData.SysMemSlicePitch = 0;
+	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+
+	indexCount = (int)indices.size();
+}
+
+//Drop the tiles that have gone unused the longest until the cache fits its budget
+//Tiles within view distance this frame are never dropped, so a budget that is too small is exceeded rather than leaving holes
+void TerrainStreamer::EvictOldest()
+{
+	while (memoryUsed > memoryBudget)
+	{
+		auto oldest = tiles.end();
+
+		for (auto it = tiles.begin(); it != tiles.end(); it++)
+		{
+			if (it->second->lastUsed < frame && (oldest == tiles.end() || it->second->lastUsed < oldest->second->lastUsed))
+			{
+				oldest = it;
+			}
+		}
+
+		if (oldest == tiles.end())
+		{
+			return;
+		}
+
+		ReleaseTile(oldest->second);
+		tiles.erase(oldest);
+		memoryUsed -= tileBytes();
+		tilesEvicted++;
+	}
+}
+
+//Wait for the workers, then throw away every tile
+void TerrainStreamer::Flush()
+{
+	WaitForPending();
+
+	for (TerrainTile* tile : completed)
+	{
+		ReleaseTile(tile);
+	}
+
+	for (auto& cached : tiles)
+	{
+		ReleaseTile(cached.second);
+	}
+
+	completed.clear();
+	pending.clear();
+	tiles.clear();
+	visibleTiles.clear();
+	wanted.clear();
+	memoryUsed = 0;
+}
+
+void TerrainStreamer::ReleaseTile(TerrainTile* tile)
+{
+	if (tile->vertexBuffer != NULL)
+	{
+		tile->vertexBuffer->Release();
+	}
+
+	delete tile;
+}
+
+//What one cached tile costs, its vertex buffer on the GPU and its padded heights on the CPU
+size_t TerrainStreamer::tileBytes() const
+{
+	return sizeof(TerrainTile::Vertex) * tileVertices * tileVertices + sizeof(float) * paddedVertices * paddedVertices + sizeof(TerrainTile);
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "DXF.h"
+#include "PerlinNoise.h"
+#include "ThreadPool.h"
+#include "TerrainNormals.h"
+#include "Frustum.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+//One square of the streamed world, generated in the background and kept until the cache needs the room
+struct TerrainTile
+{
+	//Laid out like BaseMesh's VertexType, so the light shader draws tiles exactly like the terrain
+	struct Vertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT2 texture;
+		XMFLOAT3 normal;
+	};
+
+	int tileX = 0;	//Position in the grid of tiles, tile (0, 0) starts at the world origin
+	int tileY = 0;
+
+	//The tile's vertices plus a border of one on every side, so the normals along its edges match its neighbours'
+	std::vector<float> heights;
+	std::vector<Vertex> vertices;	//Only kept until they have been copied to the vertex buffer
+
+	XMFLOAT3 boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	ID3D11Buffer* vertexBuffer = nullptr;
+	uint64_t lastUsed = 0;	//Frame the tile was last within view distance
+
+	std::chrono::high_resolution_clock::time_point requested;
+	double generationMilliseconds = 0.0;	//Time a worker spent building it, not counting the wait in the queue
+};
+
+//An endless terrain made of tiles around the camera, each one generated from world space coordinates by worker threads
+//Heights are a pure function of a vertex's position in the world, so a tile always comes out the same and its edges meet its neighbours'
+class TerrainStreamer
+{
+public:
+	TerrainStreamer(uint64_t seed = 0, int threads = 0);	//Background workers, zero leaves one hardware core free for rendering
+	~TerrainStreamer();
+
+	//Uploads the tiles the workers have finished, then queues the missing ones within view distance, nearest first
+	void Update(ID3D11Device* device, const XMFLOAT3& cameraPosition);
+
+	//Works out which of the tiles in range can be seen, only those are drawn until the next call
+	void Cull(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection);
+
+	//Tiles are drawn one at a time like the terrain's chunks, every tile shares the same index buffer
+	void sendTileData(ID3D11DeviceContext* deviceContext, int visibleTile, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	int getIndexCount() const { return indexCount; }
+	int getVisibleTileCount() const { return (int)visibleTiles.size(); }
+
+	//A tile that has finished generating, or null if it is not in the cache
+	const TerrainTile* getTile(int tileX, int tileY) const;
+
+	//Blocks until the workers have finished every queued tile, the next Update uploads them
+	void WaitForPending();
+
+	//Changing how the world is generated throws away every tile built the old way
+	void setNoiseSeed(uint64_t seed);
+	void setFractal(int octaves, float amplitude, float frequency, float gain, float lacunarity);
+
+	void setViewDistance(float distance) { viewDistance = distance; }
+	float getViewDistance() const { return viewDistance; }
+	void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+	size_t getMemoryBudget() const { return memoryBudget; }
+	size_t getMemoryUsed() const { return memoryUsed; }
+
+	int getCachedTileCount() const { return (int)tiles.size(); }
+	int getPendingTileCount() const { return (int)pending.size(); }
+	float getTileSize() const { return tileQuads * vertexSpacing; }
+
+	//Counted once per tile each time it comes into view distance, a hit is one that was already in the cache
+	uint64_t getCacheHits() const { return cacheHits; }
+	uint64_t getCacheMisses() const { return cacheMisses; }
+
+	//The tiles within view distance at the last Update, and how many of them were ready to draw
+	int getWantedTileCount() const { return (int)wanted.size(); }
+	int getResidentTileCount() const { return residentTiles; }
+	uint64_t getTilesGenerated() const { return tilesGenerated; }
+	uint64_t getTilesEvicted() const { return tilesEvicted; }
+	double getAverageLatency() const { return tilesGenerated ? totalLatency / (double)tilesGenerated : 0.0; }	//Milliseconds from request to drawable
+	double getMaxLatency() const { return maxLatency; }
+	double getAverageGenerationTime() const { return tilesGenerated ? totalGenerationTime / (double)tilesGenerated : 0.0; }
+	void ResetStatistics();
+
+	static const int tileQuads = 64;	//Quads along each side of a tile, the same as a terrain chunk
+	static const int tileVertices = tileQuads + 1;
+	static const int paddedVertices = tileVertices + 2;
+
+private:
+	void GenerateTile(TerrainTile& tile) const;
+	void UploadCompleted(ID3D11Device* device);
+	void CreateIndexBuffer(ID3D11Device* device);
+	void EvictOldest();
+	void Flush();
+	void ReleaseTile(TerrainTile* tile);
+
+	size_t tileBytes() const;
+
+	const float vertexSpacing = 100.0f / 128.0f;	//The same spacing as the default 128 vertex terrain
+	const float uvPerVertex = 10.0f / 128.0f;	//And the same texture tiling
+
+	float viewDistance = 200.0f;
+	size_t memoryBudget = 32 * 1024 * 1024;
+	size_t memoryUsed = 0;
+	int maxPendingTiles = 1;	//Enough to keep every worker busy without queuing tiles the camera may have left by the time they start
+
+	int octaves = 8;
+	float amplitude = 28.0f;
+	float frequency = 0.015f;
+	float gain = 0.5f;
+	float lacunarity = 1.1f;
+
+	std::map<uint64_t, TerrainTile*> tiles;	//Keyed by tile position, see tileKey
+	std::map<uint64_t, TerrainTile*> pending;	//Queued or being built by a worker
+	std::vector<TerrainTile*> visibleTiles;
+	std::set<uint64_t> wanted;	//Every tile within view distance at the last Update, so tiles staying in range are not counted again
+	uint64_t frame = 0;
+
+	ID3D11Buffer* indexBuffer = nullptr;
+	int indexCount = 0;
+
+	uint64_t cacheHits = 0;
+	uint64_t cacheMisses = 0;
+	int residentTiles = 0;
+	uint64_t tilesGenerated = 0;
+	uint64_t tilesEvicted = 0;
+	double totalLatency = 0.0;
+	double maxLatency = 0.0;
+	double totalGenerationTime = 0.0;
+
+	PerlinNoise noise;
+	TerrainNormals normalGenerator;
+
+	//Finished tiles wait here until the render thread can create their buffers
+	std::mutex completedMutex;
+	std::condition_variable completedSignal;
+	std::vector<TerrainTile*> completed;
+
+	ThreadPool generators;	//Declared last so it is destroyed first, while the tasks can still reach everything above
+};
\ No newline at end of file
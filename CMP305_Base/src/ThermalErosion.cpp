@@ -0,0 +1,249 @@
+#include "ThermalErosion.h"
+
+#include <cmath>
+#include <emmintrin.h>
+
+//Where each neighbour is, in the order the passes visit them
+static const int neighbourX[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int neighbourY[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+//The same comparison _mm_max_ps makes, so the scalar and vector passes agree to the bit
+static inline float maximum(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+ThermalErosion::ThermalErosion(int resolution, float talus, float rate) :
+	resolution(resolution),
+	halfRate(rate * 0.5f)
+{
+	for (int n = 0; n < 8; n++)
+	{
+		limits[n] = (neighbourX[n] != 0 && neighbourY[n] != 0) ? talus * 1.41421356f : talus;
+	}
+
+	share.assign((size_t)resolution * resolution, 0.0f);
+}
+
+ThermalErosion::~ThermalErosion()
+{
+}
+
+float ThermalErosion::slide(const float* heights, int rowStart, int rowEnd)
+{
+	float most = 0.0f;
+
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		int i = 1;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			i = slideRowSSE2(heights, j, most);
+		}
+
+		most = maximum(most, slideCell(heights, 0, j));
+
+		for (; i < resolution; i++)
+		{
+			most = maximum(most, slideCell(heights, i, j));
+		}
+	}
+
+	return most;
+}
+
+void ThermalErosion::settle(const float* heights, float* result, int rowStart, int rowEnd) const
+{
+	for (int j = rowStart; j < rowEnd; j++)
+	{
+		int i = 1;
+
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			i = settleRowSSE2(heights, result, j);
+		}
+
+		settleCell(heights, result, 0, j);
+
+		for (; i < resolution; i++)
+		{
+			settleCell(heights, result, i, j);
+		}
+	}
+}
+
+float ThermalErosion::slideCell(const float* heights, int i, int j)
+{
+	const int index = (j * resolution) + i;
+	const float height = heights[index];
+
+	float total = 0.0f;
+	float largest = 0.0f;
+
+	for (int n = 0; n < 8; n++)
+	{
+		const int x = i + neighbourX[n];
+		const int y = j + neighbourY[n];
+
+		if (x < 0 || y < 0 || x >= resolution || y >= resolution)
+		{
+			continue;
+		}
+
+		float excess = maximum((height - heights[(y * resolution) + x]) - limits[n], 0.0f);
+
+		total += excess;
+		largest = maximum(largest, excess);
+	}
+
+	//Shed onto every lower neighbour by how far it is past the talus, which brings the steepest one part of the way back to it
+	float moved = halfRate * largest;
+	share[index] = total > 0.0f ? moved / total : 0.0f;
+
+	return moved;
+}
+
+void ThermalErosion::settleCell(const float* heights, float* result, int i, int j) const
+{
+	const int index = (j * resolution) + i;
+	const float height = heights[index];
+
+	float inflow = 0.0f;
+	float outflow = 0.0f;
+
+	for (int n = 0; n < 8; n++)
+	{
+		const int x = i + neighbourX[n];
+		const int y = j + neighbourY[n];
+
+		if (x < 0 || y < 0 || x >= resolution || y >= resolution)
+		{
+			continue;
+		}
+
+		const int neighbour = (y * resolution) + x;
+		float difference = heights[neighbour] - height;
+
+		//A neighbour sheds onto this cell by how far it stands above it past the talus, and this cell onto the neighbour the other way round
+		inflow += share[neighbour] * maximum(difference - limits[n], 0.0f);
+		outflow += maximum(-difference - limits[n], 0.0f);
+	}
+
+	result[index] = (height - share[index] * outflow) + inflow;
+}
+
+//The vector kernels repeat the cell passes operation for operation, so they give the same results
+//Only the rows behind and in front can be missing, at the first and last rows, the columns either side always exist for the cells they cover
+
+int ThermalErosion::slideRowSSE2(const float* heights, int j, float& most)
+{
+	const int row = j * resolution;
+	const int back = j > 0 ? row - resolution : row;
+	const int forward = j < resolution - 1 ? row + resolution : row;
+
+	const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	const __m128 hasBack = _mm_castsi128_ps(_mm_set1_epi32(j > 0 ? -1 : 0));
+	const __m128 hasForward = _mm_castsi128_ps(_mm_set1_epi32(j < resolution - 1 ? -1 : 0));
+	const __m128 present[8] = { hasBack, hasBack, hasBack, all, all, hasForward, hasForward, hasForward };
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 rate = _mm_set1_ps(halfRate);
+
+	__m128 limit[8];
+
+	for (int n = 0; n < 8; n++)
+	{
+		limit[n] = _mm_set1_ps(limits[n]);
+	}
+
+	__m128 mostMoved = zero;
+	int i = 1;
+
+	for (; i + 4 <= resolution - 1; i += 4)
+	{
+		const __m128 height = _mm_loadu_ps(&heights[row + i]);
+		const __m128 neighbours[8] =
+		{
+			_mm_loadu_ps(&heights[back + i - 1]), _mm_loadu_ps(&heights[back + i]), _mm_loadu_ps(&heights[back + i + 1]),
+			_mm_loadu_ps(&heights[row + i - 1]), _mm_loadu_ps(&heights[row + i + 1]),
+			_mm_loadu_ps(&heights[forward + i - 1]), _mm_loadu_ps(&heights[forward + i]), _mm_loadu_ps(&heights[forward + i + 1])
+		};
+
+		__m128 total = zero;
+		__m128 largest = zero;
+
+		for (int n = 0; n < 8; n++)
+		{
+			__m128 excess = _mm_and_ps(present[n], _mm_max_ps(_mm_sub_ps(_mm_sub_ps(height, neighbours[n]), limit[n]), zero));
+
+			total = _mm_add_ps(total, excess);
+			largest = _mm_max_ps(largest, excess);
+		}
+
+		__m128 moved = _mm_mul_ps(rate, largest);
+
+		_mm_storeu_ps(&share[row + i], _mm_and_ps(_mm_cmpgt_ps(total, zero), _mm_div_ps(moved, total)));
+		mostMoved = _mm_max_ps(mostMoved, moved);
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, mostMoved);
+
+	for (float lane : lanes)
+	{
+		most = maximum(most, lane);
+	}
+
+	return i;
+}
+
+int ThermalErosion::settleRowSSE2(const float* heights, float* result, int j) const
+{
+	const int row = j * resolution;
+	const int back = j > 0 ? row - resolution : row;
+	const int forward = j < resolution - 1 ? row + resolution : row;
+
+	const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	const __m128 hasBack = _mm_castsi128_ps(_mm_set1_epi32(j > 0 ? -1 : 0));
+	const __m128 hasForward = _mm_castsi128_ps(_mm_set1_epi32(j < resolution - 1 ? -1 : 0));
+	const __m128 present[8] = { hasBack, hasBack, hasBack, all, all, hasForward, hasForward, hasForward };
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	__m128 limit[8];
+
+	for (int n = 0; n < 8; n++)
+	{
+		limit[n] = _mm_set1_ps(limits[n]);
+	}
+
+	//Where each neighbour is, relative to the cell, in the maps
+	const int offsets[8] = { back - row - 1, back - row, back - row + 1, -1, 1, forward - row - 1, forward - row, forward - row + 1 };
+
+	int i = 1;
+
+	for (; i + 4 <= resolution - 1; i += 4)
+	{
+		const int index = row + i;
+		const __m128 height = _mm_loadu_ps(&heights[index]);
+
+		__m128 inflow = zero;
+		__m128 outflow = zero;
+
+		for (int n = 0; n < 8; n++)
+		{
+			__m128 difference = _mm_sub_ps(_mm_loadu_ps(&heights[index + offsets[n]]), height);
+			__m128 arriving = _mm_mul_ps(_mm_loadu_ps(&share[index + offsets[n]]), _mm_max_ps(_mm_sub_ps(difference, limit[n]), zero));
+			__m128 leaving = _mm_max_ps(_mm_sub_ps(_mm_xor_ps(difference, sign), limit[n]), zero);
+
+			inflow = _mm_add_ps(inflow, _mm_and_ps(present[n], arriving));
+			outflow = _mm_add_ps(outflow, _mm_and_ps(present[n], leaving));
+		}
+
+		_mm_storeu_ps(&result[index], _mm_add_ps(_mm_sub_ps(height, _mm_mul_ps(_mm_loadu_ps(&share[index]), outflow)), inflow));
+	}
+
+	return i;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "CpuFeatures.h"
+
+//Thermal erosion, where ground steeper than its angle of repose slides down onto the lower cells around it until it comes to rest
+//Each iteration is two passes over the eight neighbours of every cell: slide works out what each cell sheds,
+//then settle takes that away and adds what the cells above it shed onto it, writing the new heights to a second map
+//Neither pass writes anything the other cells of the same pass read, so both can be split into bands of rows on different threads
+//and give the same result however they are split
+class ThermalErosion
+{
+public:
+	//talus is the largest height difference that stays put between neighbours along a row or column, diagonal neighbours are allowed root two times as much
+	//rate is the fraction of the steepest excess a cell sheds each iteration, halved so that a rate of one brings a pair of cells to rest in one go
+	ThermalErosion(int resolution, float talus, float rate);
+	~ThermalErosion();
+
+	//What each cell in the rows [rowStart, rowEnd) sheds, returning the most any of them sheds
+	//Has to have finished across the whole map before settle starts
+	float slide(const float* heights, int rowStart, int rowEnd);
+
+	//The rows' new heights written to result, which must not be heights
+	void settle(const float* heights, float* result, int rowStart, int rowEnd) const;
+
+	//Only changes how fast the passes run, every level gives the same results
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+
+private:
+	//The passes for a single cell, which the vector kernels fall back to at the edges of the map
+	float slideCell(const float* heights, int i, int j);
+	void settleCell(const float* heights, float* result, int i, int j) const;
+
+	//The cells from column 1 up to where the kernel stopped, short of a whole vector from the last column
+	//AVX2 would only widen the arithmetic, the passes wait on their loads and stores, so SSE2 is all they have
+	int slideRowSSE2(const float* heights, int j, float& most);
+	int settleRowSSE2(const float* heights, float* result, int j) const;
+
+	int resolution;
+	float halfRate;
+
+	//The height difference each neighbour is allowed, in the order the passes visit them: the row behind, the cell's own row, then the row in front
+	float limits[8];
+
+	std::vector<float> share;	//Fraction of each excess over the talus a cell sheds onto that neighbour
+
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
+};
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+
+ThreadPool::ThreadPool(int threads)
+{
+	resize(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+}
+
+void ThreadPool::resize(int threads)
+{
+	if (threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency();
+	}
+
+	if (threads <= 0)
+	{
+		threads = 1;
+	}
+
+	stopWorkers();
+
+	stopping = false;
+	threadCount = threads;
+
+	//The thread calling parallelFor works through bands as well, so it needs one fewer worker
+	for (int t = 1; t < threadCount; t++)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& function)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	//A few bands per thread keeps everyone busy when some rows take longer than others
+	int bands = threadCount * 4;
+
+	if (bands > count)
+	{
+		bands = count;
+	}
+
+	if (threadCount == 1 || bands == 1)
+	{
+		function(0, count);
+		return;
+	}
+
+	std::atomic<int> nextBand(0);
+	std::mutex doneMutex;
+	std::condition_variable done;
+	int helpersFinished = 0;
+	const int helpers = threadCount - 1;
+
+	auto workThroughBands = [&]()
+	{
+		for (int band = nextBand++; band < bands; band = nextBand++)
+		{
+			int start = (int)(((long long)count * band) / bands);
+			int end = (int)(((long long)count * (band + 1)) / bands);
+
+			function(start, end);
+		}
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (int h = 0; h < helpers; h++)
+		{
+			tasks.push_back([&]()
+			{
+				workThroughBands();
+
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				helpersFinished++;
+				done.notify_one();
+			});
+		}
+	}
+
+	wake.notify_all();
+
+	workThroughBands();
+
+	//The helper tasks refer to this stack frame, so every one of them has to finish before returning
+	std::unique_lock<std::mutex> lock(doneMutex);
+	done.wait(lock, [&]() { return helpersFinished == helpers; });
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	if (workers.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+
+	wake.notify_one();
+}
+
+int ThreadPool::backgroundPoolSize(int workers)
+{
+	if (workers <= 0)
+	{
+		workers = (int)std::thread::hardware_concurrency() - 1;
+	}
+
+	return (workers > 1 ? workers : 1) + 1;
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping && tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void ThreadPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	workers.clear();
+}
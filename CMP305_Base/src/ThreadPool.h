@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of worker threads that the height map operators split their rows across
+class ThreadPool
+{
+public:
+	ThreadPool(int threads = 0);	//Zero uses one thread per hardware core
+	~ThreadPool();
+
+	void resize(int threads);
+	int getThreadCount() const { return threadCount; }
+
+	//Splits [0, count) into contiguous bands and calls function(start, end) for each one, returning once every band is done
+	void parallelFor(int count, const std::function<void(int, int)>& function);
+
+	//Queues a task for a worker to run in the background and returns straight away
+	//A pool of one thread has no workers, so the task is run on the calling thread instead
+	void submit(std::function<void()> task);
+
+	//The size of pool that gives submit this many workers, zero leaving one hardware core free for rendering
+	//The thread that calls parallelFor never runs submitted tasks, so the pool needs one more thread than the workers wanted
+	static int backgroundPoolSize(int workers);
+
+private:
+	void workerLoop();
+	void stopWorkers();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	int threadCount = 1;
+	bool stopping = false;
+};
@@ -0,0 +1,650 @@
+#include "VoxelTerrain.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+//Packs a chunk's position into a single key, 21 bits an axis with negative positions included
+static uint64_t chunkKey(int chunkX, int chunkY, int chunkZ)
+{
+	const uint64_t mask = (1 << 21) - 1;
+
+	return (((uint64_t)(uint32_t)chunkX & mask) << 42) | (((uint64_t)(uint32_t)chunkY & mask) << 21) | ((uint64_t)(uint32_t)chunkZ & mask);
+}
+
+//The second tunnel noise is the first moved well away, so the two are unrelated
+static const float tunnelOffset = 137.25f;
+
+VoxelTerrain::VoxelTerrain(uint64_t seed, int threads) :
+	noise(seed),
+	builders(ThreadPool::backgroundPoolSize(threads))
+{
+	chunksPerUpdate = (builders.getThreadCount() - 1) * 2;
+	maxPendingChunks = (builders.getThreadCount() - 1) * 2;
+}
+
+VoxelTerrain::~VoxelTerrain()
+{
+	Flush();
+}
+
+void VoxelTerrain::Update(ID3D11Device* device, const XMFLOAT3& cameraPosition)
+{
+	frame++;
+
+	UploadCompleted(device);
+
+	struct Request
+	{
+		float distance;
+		int chunkX;
+		int chunkY;
+		int chunkZ;
+	};
+
+	std::vector<Request> missing;
+
+	const float chunkSize = getChunkSize();
+	const float reach = groundReach() + overhangReach();
+
+	//Only the layers the surface can reach, everything above is air and everything below solid apart from the odd tunnel
+	const int lowestLayer = (int)floorf(-reach / chunkSize);
+	const int highestLayer = (int)floorf(reach / chunkSize);
+	const int minX = (int)floorf((cameraPosition.x - viewDistance) / chunkSize);
+	const int maxX = (int)floorf((cameraPosition.x + viewDistance) / chunkSize);
+	const int minZ = (int)floorf((cameraPosition.z - viewDistance) / chunkSize);
+	const int maxZ = (int)floorf((cameraPosition.z + viewDistance) / chunkSize);
+
+	for (int cy = lowestLayer; cy <= highestLayer; cy++)
+	{
+		for (int cz = minZ; cz <= maxZ; cz++)
+		{
+			for (int cx = minX; cx <= maxX; cx++)
+			{
+				//Distance to the nearest point of the chunk
+				const float corner[3] = { (float)cx * chunkSize, (float)cy * chunkSize, (float)cz * chunkSize };
+				const float camera[3] = { cameraPosition.x, cameraPosition.y, cameraPosition.z };
+				float squared = 0.0f;
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					float outside = camera[axis] < corner[axis] ? corner[axis] - camera[axis] : (std::max)(0.0f, camera[axis] - (corner[axis] + chunkSize));
+					squared += outside * outside;
+				}
+
+				float distance = sqrtf(squared);
+
+				if (distance > viewDistance)
+				{
+					continue;
+				}
+
+				const uint64_t key = chunkKey(cx, cy, cz);
+				auto cached = chunks.find(key);
+
+				if (cached != chunks.end())
+				{
+					cached->second->lastUsed = frame;
+					continue;
+				}
+
+				if (pending.find(key) == pending.end())
+				{
+					missing.push_back({ distance, cx, cy, cz });
+				}
+			}
+		}
+	}
+
+	//The closest chunks are the most noticeable gaps, so they go to the workers first
+	std::sort(missing.begin(), missing.end(), [](const Request& a, const Request& b) { return a.distance < b.distance; });
+
+	for (const Request& request : missing)
+	{
+		if ((int)pending.size() >= maxPendingChunks)
+		{
+			break;
+		}
+
+		VoxelChunk* chunk = new VoxelChunk();
+		chunk->chunkX = request.chunkX;
+		chunk->chunkY = request.chunkY;
+		chunk->chunkZ = request.chunkZ;
+
+		pending[chunkKey(request.chunkX, request.chunkY, request.chunkZ)] = chunk;
+
+		//Every chunk only reads the noise and writes its own mesh, so the workers can build them while the frame carries on
+		builders.submit([this, chunk]()
+		{
+			BuildChunk(*chunk);
+
+			std::lock_guard<std::mutex> lock(completedMutex);
+			completed.push_back(chunk);
+			completedSignal.notify_all();
+		});
+	}
+
+	EvictOldest();
+}
+
+void VoxelTerrain::Cull(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection)
+{
+	Frustum frustum(world, view, projection);
+
+	visibleChunks.clear();
+
+	for (auto& cached : chunks)
+	{
+		VoxelChunk* chunk = cached.second;
+
+		if (chunk->lastUsed == frame && chunk->indexCount > 0 && frustum.intersects(chunk->boundsMin, chunk->boundsMax))
+		{
+			visibleChunks.push_back(chunk);
+		}
+	}
+}
+
+void VoxelTerrain::sendChunkData(ID3D11DeviceContext* deviceContext, int visibleChunk, D3D_PRIMITIVE_TOPOLOGY top)
+{
+	unsigned int stride = sizeof(VoxelChunk::Vertex);
+	unsigned int offset = 0;
+
+	deviceContext->IASetVertexBuffers(0, 1, &visibleChunks[visibleChunk]->vertexBuffer, &stride, &offset);
+	deviceContext->IASetIndexBuffer(visibleChunks[visibleChunk]->indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	deviceContext->IASetPrimitiveTopology(top);
+}
+
+const VoxelChunk* VoxelTerrain::getChunk(int chunkX, int chunkY, int chunkZ) const
+{
+	auto cached = chunks.find(chunkKey(chunkX, chunkY, chunkZ));
+
+	return cached != chunks.end() ? cached->second : nullptr;
+}
+
+float VoxelTerrain::density(float x, float y, float z) const
+{
+	//The noise is laid out in voxels, like the terrain's is in vertices
+	const float voxelX = x / voxelSize;
+	const float voxelY = y / voxelSize;
+	const float voxelZ = z / voxelSize;
+
+	float ground = 0.0f;
+	float currentAmplitude = amplitude;
+	float currentFrequency = frequency;
+
+	for (int o = 0; o < octaves; o++)
+	{
+		ground += noise.generateImprovedPerlin(voxelX * currentFrequency, voxelZ * currentFrequency) * currentAmplitude;
+
+		currentAmplitude *= gain;
+		currentFrequency *= lacunarity;
+	}
+
+	float solid = ground - y;
+	currentAmplitude = overhangAmplitude;
+	currentFrequency = caveFrequency;
+
+	for (int o = 0; o < overhangOctaves; o++)
+	{
+		solid += noise.generateImprovedPerlin3D(voxelX * currentFrequency, voxelY * currentFrequency, voxelZ * currentFrequency) * currentAmplitude;
+
+		currentAmplitude *= 0.5f;
+		currentFrequency *= 2.0f;
+	}
+
+	//A tunnel runs along where both noises are near zero, scaled so the density changes about as fast as it does across the ground
+	float first = fabsf(noise.generateImprovedPerlin3D(voxelX * caveFrequency, voxelY * caveFrequency, voxelZ * caveFrequency));
+	float second = fabsf(noise.generateImprovedPerlin3D(tunnelOffset + voxelX * caveFrequency, tunnelOffset + voxelY * caveFrequency, tunnelOffset + voxelZ * caveFrequency));
+	float tunnel = ((std::max)(first, second) - tunnelWidth) * (voxelSize / caveFrequency);
+
+	return (std::min)(solid, tunnel);
+}
+
+void VoxelTerrain::WaitForPending()
+{
+	std::unique_lock<std::mutex> lock(completedMutex);
+	completedSignal.wait(lock, [this]() { return completed.size() == pending.size(); });
+}
+
+void VoxelTerrain::setNoiseSeed(uint64_t seed)
+{
+	Flush();
+	noise.reseed(seed);
+}
+
+void VoxelTerrain::setFractal(int octaveCount, float octaveAmplitude, float octaveFrequency, float octaveGain, float octaveLacunarity)
+{
+	if (octaveCount == octaves && octaveAmplitude == amplitude && octaveFrequency == frequency && octaveGain == gain && octaveLacunarity == lacunarity)
+	{
+		return;
+	}
+
+	Flush();
+
+	octaves = octaveCount;
+	amplitude = octaveAmplitude;
+	frequency = octaveFrequency;
+	gain = octaveGain;
+	lacunarity = octaveLacunarity;
+}
+
+void VoxelTerrain::setCaves(float caveOverhangs, float caveScale, float caveWidth)
+{
+	if (caveOverhangs == overhangAmplitude && caveScale == caveFrequency && caveWidth == tunnelWidth)
+	{
+		return;
+	}
+
+	Flush();
+
+	overhangAmplitude = caveOverhangs;
+	caveFrequency = caveScale;
+	tunnelWidth = caveWidth;
+}
+
+void VoxelTerrain::ResetStatistics()
+{
+	chunksBuilt = 0;
+	emptyChunksBuilt = 0;
+	chunksEvicted = 0;
+	trianglesBuilt = 0;
+	totalBuildTime = 0.0;
+}
+
+//Samples the density over the chunk, then meshes it, touching nothing but the chunk so any thread can build it
+void VoxelTerrain::BuildChunk(VoxelChunk& chunk) const
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//The first sample along each axis, in voxels from the world origin, one before the chunk's own first
+	const int firstX = chunk.chunkX * chunkCells - 1;
+	const int firstY = chunk.chunkY * chunkCells - 1;
+	const int firstZ = chunk.chunkZ * chunkCells - 1;
+
+	//The ground under every column, the same octaves and row spans as TerrainStreamer's tiles
+	std::vector<float> ground(gridPoints * gridPoints, 0.0f);
+	std::vector<float> samples(gridPoints);
+	float currentAmplitude = amplitude;
+	float currentFrequency = frequency;
+
+	for (int o = 0; o < octaves; o++)
+	{
+		for (int k = 0; k < gridPoints; k++)
+		{
+			noise.generateImprovedPerlinSpan(0.0f, currentFrequency, (float)(firstZ + k) * currentFrequency, gridPoints, samples.data(), firstX);
+
+			for (int i = 0; i < gridPoints; i++)
+			{
+				ground[k * gridPoints + i] += samples[i] * currentAmplitude;
+			}
+		}
+
+		currentAmplitude *= gain;
+		currentFrequency *= lacunarity;
+	}
+
+	//Nothing can be solid above the highest ground and its overhangs, so a chunk up in the air is empty without sampling the volume
+	const float highestGround = *std::max_element(ground.begin(), ground.end());
+
+	if ((float)firstY * voxelSize > highestGround + overhangReach())
+	{
+		chunk.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return;
+	}
+
+	//The density at every sample, x along the rows, then y, then z
+	std::vector<float> field(gridPoints * gridPoints * gridPoints);
+	std::vector<float> tunnels(gridPoints);
+	const float tunnelScale = voxelSize / caveFrequency;
+
+	for (int k = 0; k < gridPoints; k++)
+	{
+		for (int j = 0; j < gridPoints; j++)
+		{
+			float* row = &field[(k * gridPoints + j) * gridPoints];
+			const float height = (float)(firstY + j) * voxelSize;
+
+			for (int i = 0; i < gridPoints; i++)
+			{
+				row[i] = ground[k * gridPoints + i] - height;
+			}
+
+			currentAmplitude = overhangAmplitude;
+			currentFrequency = caveFrequency;
+
+			for (int o = 0; o < overhangOctaves; o++)
+			{
+				noise.generateImprovedPerlin3DSpan(0.0f, currentFrequency, (float)(firstY + j) * currentFrequency, (float)(firstZ + k) * currentFrequency, gridPoints, samples.data(), firstX);
+
+				for (int i = 0; i < gridPoints; i++)
+				{
+					row[i] += samples[i] * currentAmplitude;
+				}
+
+				currentAmplitude *= 0.5f;
+				currentFrequency *= 2.0f;
+			}
+
+			noise.generateImprovedPerlin3DSpan(0.0f, caveFrequency, (float)(firstY + j) * caveFrequency, (float)(firstZ + k) * caveFrequency, gridPoints, samples.data(), firstX);
+			noise.generateImprovedPerlin3DSpan(tunnelOffset, caveFrequency, tunnelOffset + (float)(firstY + j) * caveFrequency, tunnelOffset + (float)(firstZ + k) * caveFrequency, gridPoints, tunnels.data(), firstX);
+
+			for (int i = 0; i < gridPoints; i++)
+			{
+				float tunnel = ((std::max)(fabsf(samples[i]), fabsf(tunnels[i])) - tunnelWidth) * tunnelScale;
+				row[i] = (std::min)(row[i], tunnel);
+			}
+		}
+	}
+
+	auto sample = [&](int i, int j, int k) { return field[(k * gridPoints + j) * gridPoints + i]; };
+
+	//One vertex for every cell with both solid and empty corners, -1 for the rest
+	std::vector<int> cellVertices(gridCells * gridCells * gridCells, -1);
+	XMFLOAT3 lowest(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 highest(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int k = 0; k < gridCells; k++)
+	{
+		for (int j = 0; j < gridCells; j++)
+		{
+			for (int i = 0; i < gridCells; i++)
+			{
+				//Corner n is offset by its bits, 1 along x, 2 along y and 4 along z
+				float corners[8];
+				int solid = 0;
+
+				for (int n = 0; n < 8; n++)
+				{
+					corners[n] = sample(i + (n & 1), j + ((n >> 1) & 1), k + ((n >> 2) & 1));
+					solid |= corners[n] > 0.0f ? 1 << n : 0;
+				}
+
+				if (solid == 0 || solid == 255)
+				{
+					continue;
+				}
+
+				//The average of where the surface crosses the cell's edges
+				float offset[3] = { 0.0f, 0.0f, 0.0f };
+				int crossings = 0;
+
+				for (int n = 0; n < 8; n++)
+				{
+					for (int axis = 0; axis < 3; axis++)
+					{
+						const int m = n | (1 << axis);
+
+						if (m == n || ((solid >> n) & 1) == ((solid >> m) & 1))
+						{
+							continue;
+						}
+
+						const float along = corners[n] / (corners[n] - corners[m]);
+
+						for (int a = 0; a < 3; a++)
+						{
+							offset[a] += a == axis ? along : (float)((n >> a) & 1);
+						}
+
+						crossings++;
+					}
+				}
+
+				//The density rises into the ground, so the surface faces down its gradient
+				float gradient[3] = { 0.0f, 0.0f, 0.0f };
+
+				for (int n = 0; n < 8; n++)
+				{
+					for (int a = 0; a < 3; a++)
+					{
+						gradient[a] += ((n >> a) & 1) ? corners[n] : -corners[n];
+					}
+				}
+
+				float length = sqrtf(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+				float scale = length > 0.0f ? -1.0f / length : 0.0f;
+
+				//Placed from the cell's position in the world, so the chunks either side of a border give a shared cell exactly the same vertex
+				const float voxelX = (float)(firstX + i) + offset[0] / (float)crossings;
+				const float voxelY = (float)(firstY + j) + offset[1] / (float)crossings;
+				const float voxelZ = (float)(firstZ + k) + offset[2] / (float)crossings;
+
+				VoxelChunk::Vertex vertex;
+				vertex.position = XMFLOAT3(voxelX * voxelSize, voxelY * voxelSize, voxelZ * voxelSize);
+				vertex.texture = XMFLOAT2(voxelX * uvPerVoxel, voxelZ * uvPerVoxel);
+				vertex.normal = XMFLOAT3(gradient[0] * scale, gradient[1] * scale, gradient[2] * scale);
+
+				lowest = XMFLOAT3((std::min)(lowest.x, vertex.position.x), (std::min)(lowest.y, vertex.position.y), (std::min)(lowest.z, vertex.position.z));
+				highest = XMFLOAT3((std::max)(highest.x, vertex.position.x), (std::max)(highest.y, vertex.position.y), (std::max)(highest.z, vertex.position.z));
+
+				cellVertices[(k * gridCells + j) * gridCells + i] = (int)chunk.vertices.size();
+				chunk.vertices.push_back(vertex);
+			}
+		}
+	}
+
+	//A quad across every edge the surface crosses, joining the four cells around it
+	//Only edges starting inside the chunk are used, the ones starting on the shared layer below belong to the neighbour
+	const int steps[3] = { 1, gridCells, gridCells * gridCells };
+
+	for (int k = 1; k < gridPoints - 1; k++)
+	{
+		for (int j = 1; j < gridPoints - 1; j++)
+		{
+			for (int i = 1; i < gridPoints - 1; i++)
+			{
+				const bool inside = sample(i, j, k) > 0.0f;
+				const bool across[3] = { sample(i + 1, j, k) > 0.0f, sample(i, j + 1, k) > 0.0f, sample(i, j, k + 1) > 0.0f };
+				const int cell = (k * gridCells + j) * gridCells + i;
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (inside == across[axis])
+					{
+						continue;
+					}
+
+					//The other two axes in turn, so the four cells go round the edge the same way whichever axis it runs along
+					const int u = steps[(axis + 1) % 3];
+					const int v = steps[(axis + 2) % 3];
+
+					const unsigned short quad[4] =
+					{
+						(unsigned short)cellVertices[cell - u - v],
+						(unsigned short)cellVertices[cell - v],
+						(unsigned short)cellVertices[cell],
+						(unsigned short)cellVertices[cell - u]
+					};
+
+					//Wound so the front faces out of the ground, the edge's solid end decides which way that is
+					if (inside)
+					{
+						chunk.indices.insert(chunk.indices.end(), { quad[0], quad[2], quad[1], quad[0], quad[3], quad[2] });
+					}
+
+					else
+					{
+						chunk.indices.insert(chunk.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+					}
+				}
+			}
+		}
+	}
+
+	chunk.vertexCount = (int)chunk.vertices.size();
+	chunk.indexCount = (int)chunk.indices.size();
+	chunk.boundsMin = lowest;
+	chunk.boundsMax = highest;
+
+	chunk.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//Give the first chunks the workers finished their buffers and move them into the cache, the rest wait for the next Update
+void VoxelTerrain::UploadCompleted(ID3D11Device* device)
+{
+	std::vector<VoxelChunk*> finished;
+
+	{
+		std::lock_guard<std::mutex> lock(completedMutex);
+
+		const size_t uploads = (std::min)(completed.size(), (size_t)chunksPerUpdate);
+
+		finished.assign(completed.begin(), completed.begin() + uploads);
+		completed.erase(completed.begin(), completed.begin() + uploads);
+	}
+
+	for (VoxelChunk* chunk : finished)
+	{
+		const uint64_t key = chunkKey(chunk->chunkX, chunk->chunkY, chunk->chunkZ);
+
+		pending.erase(key);
+		UploadChunk(device, *chunk);
+
+		chunk->lastUsed = frame;
+		chunks[key] = chunk;
+		memoryUsed += chunkBytes(*chunk);
+
+		chunksBuilt++;
+		emptyChunksBuilt += chunk->indexCount == 0 ? 1 : 0;
+		trianglesBuilt += chunk->indexCount / 3;
+		totalBuildTime += chunk->buildMilliseconds;
+	}
+}
+
+//A chunk never changes once built, so its buffers can be immutable
+void VoxelTerrain::UploadChunk(ID3D11Device* device, VoxelChunk& chunk)
+{
+	if (chunk.indexCount > 0)
+	{
+		D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
+		D3D11_SUBRESOURCE_DATA vertexData, indexData;
+
+		vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		vertexBufferDesc.ByteWidth = sizeof(VoxelChunk::Vertex) * (UINT)chunk.vertices.size();
+		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vertexBufferDesc.CPUAccessFlags = 0;
+		vertexBufferDesc.MiscFlags = 0;
+		vertexBufferDesc.StructureByteStride = 0;
+		vertexData.pSysMem = chunk.vertices.data();
+		vertexData.SysMemPitch = 0;
+		vertexData.SysMemSlicePitch = 0;
+		device->CreateBuffer(&vertexBufferDesc, &vertexData, &chunk.vertexBuffer);
+
+		indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		indexBufferDesc.ByteWidth = sizeof(unsigned short) * (UINT)chunk.indices.size();
+		indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		indexBufferDesc.CPUAccessFlags = 0;
+		indexBufferDesc.MiscFlags = 0;
+		indexBufferDesc.StructureByteStride = 0;
+		indexData.pSysMem = chunk.indices.data();
+		indexData.SysMemPitch = 0;
+		indexData.SysMemSlicePitch = 0;
+		device->CreateBuffer(&indexBufferDesc, &indexData, &chunk.indexBuffer);
+	}
+
+	//The mesh now lives on the GPU
+	std::vector<VoxelChunk::Vertex>().swap(chunk.vertices);
+	std::vector<unsigned short>().swap(chunk.indices);
+}
+
+//Drop the chunks that have gone unused the longest until the cache fits its budget
+//Chunks within view distance this frame are never dropped, so a budget that is too small is exceeded rather than leaving holes
+void VoxelTerrain::EvictOldest()
+{
+	while (memoryUsed > memoryBudget)
+	{
+		auto oldest = chunks.end();
+
+		for (auto it = chunks.begin(); it != chunks.end(); it++)
+		{
+			if (it->second->lastUsed < frame && (oldest == chunks.end() || it->second->lastUsed < oldest->second->lastUsed))
+			{
+				oldest = it;
+			}
+		}
+
+		if (oldest == chunks.end())
+		{
+			return;
+		}
+
+		memoryUsed -= chunkBytes(*oldest->second);
+		ReleaseChunk(oldest->second);
+		chunks.erase(oldest);
+		chunksEvicted++;
+	}
+}
+
+//Wait for the workers, then throw away every chunk
+void VoxelTerrain::Flush()
+{
+	WaitForPending();
+
+	for (VoxelChunk* chunk : completed)
+	{
+		ReleaseChunk(chunk);
+	}
+
+	for (auto& cached : chunks)
+	{
+		ReleaseChunk(cached.second);
+	}
+
+	completed.clear();
+	pending.clear();
+	chunks.clear();
+	visibleChunks.clear();
+	memoryUsed = 0;
+}
+
+void VoxelTerrain::ReleaseChunk(VoxelChunk* chunk)
+{
+	if (chunk->vertexBuffer != NULL)
+	{
+		chunk->vertexBuffer->Release();
+	}
+
+	if (chunk->indexBuffer != NULL)
+	{
+		chunk->indexBuffer->Release();
+	}
+
+	delete chunk;
+}
+
+//What one cached chunk costs, its buffers on the GPU and the chunk itself
+size_t VoxelTerrain::chunkBytes(const VoxelChunk& chunk) const
+{
+	return sizeof(VoxelChunk::Vertex) * chunk.vertexCount + sizeof(unsigned short) * chunk.indexCount + sizeof(VoxelChunk);
+}
+
+//The 2D noise stays within about half of each octave's amplitude, so their sum leaves room to spare
+float VoxelTerrain::groundReach() const
+{
+	float reach = 0.0f;
+	float currentAmplitude = amplitude;
+
+	for (int o = 0; o < octaves; o++)
+	{
+		reach += fabsf(currentAmplitude);
+		currentAmplitude *= gain;
+	}
+
+	return reach;
+}
+
+//3D improved Perlin peaks a little above one
+float VoxelTerrain::overhangReach() const
+{
+	float reach = 0.0f;
+	float currentAmplitude = fabsf(overhangAmplitude);
+
+	for (int o = 0; o < overhangOctaves; o++)
+	{
+		reach += currentAmplitude * 1.1f;
+		currentAmplitude *= 0.5f;
+	}
+
+	return reach;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "DXF.h"
+#include "PerlinNoise.h"
+#include "ThreadPool.h"
+#include "Frustum.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+
+//One cube of the voxel world, meshed on its own so chunks can be built in parallel and dropped when the cache needs the room
+struct VoxelChunk
+{
+	//Laid out like BaseMesh's VertexType, so the light shader draws chunks exactly like the terrain
+	struct Vertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT2 texture;
+		XMFLOAT3 normal;
+	};
+
+	int chunkX = 0;	//Position in the grid of chunks, chunk (0, 0, 0) starts at the world origin and y counts upwards
+	int chunkY = 0;
+	int chunkZ = 0;
+
+	//Only kept until they have been copied to the GPU
+	std::vector<Vertex> vertices;
+	std::vector<unsigned short> indices;
+
+	int vertexCount = 0;
+	int indexCount = 0;	//Zero for a chunk the surface does not pass through, which has no buffers at all
+
+	XMFLOAT3 boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	ID3D11Buffer* vertexBuffer = nullptr;
+	ID3D11Buffer* indexBuffer = nullptr;
+	uint64_t lastUsed = 0;	//Frame the chunk was last within view distance
+
+	double buildMilliseconds = 0.0;
+};
+
+//A world made from a density field instead of a height map, solid wherever the density is positive, so it can have caves, arches and overhangs
+//The ground is the same FBM as the streamed world's, 3D noise then pushes overhangs out of it and carves tunnels through it
+//Chunks are meshed with surface nets, the simplest form of dual contouring: a vertex inside every cell the surface passes through,
+//at the average of where it crosses the cell's edges, and a quad joining the four cells around every edge it crosses
+//An edge belongs to exactly one chunk and the vertices only depend on their position in the world, so neighbouring chunks meet without gaps
+class VoxelTerrain
+{
+public:
+	VoxelTerrain(uint64_t seed = 0, int threads = 0);	//Background workers the chunks are meshed on, zero leaves one hardware core free for rendering
+	~VoxelTerrain();
+
+	//Uploads up to getChunksPerUpdate of the chunks the workers have finished, then queues the missing ones within view distance, nearest first
+	//then drops the least recently used chunks the memory budget has no room for
+	void Update(ID3D11Device* device, const XMFLOAT3& cameraPosition);
+
+	//Works out which of the chunks in range can be seen and have something to draw, only those are drawn until the next call
+	void Cull(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection);
+
+	void sendChunkData(ID3D11DeviceContext* deviceContext, int visibleChunk, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	int getVisibleChunkCount() const { return (int)visibleChunks.size(); }
+	int getChunkIndexCount(int visibleChunk) const { return visibleChunks[visibleChunk]->indexCount; }
+
+	//A chunk that has been meshed, or null if it is not in the cache
+	const VoxelChunk* getChunk(int chunkX, int chunkY, int chunkZ) const;
+
+	//Blocks until the workers have finished every queued chunk, the next Update uploads them
+	void WaitForPending();
+
+	//Positive inside the ground and negative in the air, at a point in world space
+	//The same field the chunks are meshed from, though the chunks sample it from their voxels' positions so the two can differ in the last bit
+	float density(float x, float y, float z) const;
+
+	//Changing how the world is generated throws away every chunk built the old way
+	void setNoiseSeed(uint64_t seed);
+	void setFractal(int octaves, float amplitude, float frequency, float gain, float lacunarity);
+
+	//Overhangs are 3D FBM of up to overhangAmplitude added to the ground, tunnels are carved where two 3D noises are both within tunnelWidth of zero
+	//Both are measured in voxels at caveFrequency
+	void setCaves(float overhangAmplitude, float caveFrequency, float tunnelWidth);
+
+	void setViewDistance(float distance) { viewDistance = distance; }
+	float getViewDistance() const { return viewDistance; }
+
+	//Counts the meshes of the cached chunks, an empty chunk still costs its bookkeeping so it is not sampled again
+	void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+	size_t getMemoryBudget() const { return memoryBudget; }
+	size_t getMemoryUsed() const { return memoryUsed; }
+
+	//Creating the buffers for every finished chunk at once would stall the frame, so each Update only uploads this many
+	void setChunksPerUpdate(int chunks) { chunksPerUpdate = chunks > 1 ? chunks : 1; }
+	int getChunksPerUpdate() const { return chunksPerUpdate; }
+
+	int getCachedChunkCount() const { return (int)chunks.size(); }
+	int getPendingChunkCount() const { return (int)pending.size(); }
+	uint64_t getChunksBuilt() const { return chunksBuilt; }
+	uint64_t getEmptyChunksBuilt() const { return emptyChunksBuilt; }	//Ones the surface does not pass through
+	uint64_t getChunksEvicted() const { return chunksEvicted; }
+	uint64_t getTrianglesBuilt() const { return trianglesBuilt; }
+	double getAverageBuildTime() const { return chunksBuilt ? totalBuildTime / (double)chunksBuilt : 0.0; }	//Milliseconds of one thread's time per chunk
+	void ResetStatistics();
+
+	float getChunkSize() const { return chunkCells * voxelSize; }
+
+	static const int chunkCells = 32;	//Cells along each side of a chunk
+	static const int gridPoints = chunkCells + 2;	//Density samples along each side, one more on the low side for the cells shared with the neighbour
+	static const int gridCells = chunkCells + 1;
+
+	//Samples and meshes the chunk at the position already set in it, leaving the mesh in its vertices and indices
+	//Only reads the noise and settings, so chunks can be built on any thread, Update does it for every chunk it caches
+	//Needs about 300 KB of scratch while it runs, the density samples and the vertex of every cell, on top of what the budget counts
+	void BuildChunk(VoxelChunk& chunk) const;
+
+private:
+	void UploadCompleted(ID3D11Device* device);
+	void UploadChunk(ID3D11Device* device, VoxelChunk& chunk);
+	void EvictOldest();
+	void Flush();
+	void ReleaseChunk(VoxelChunk* chunk);
+
+	size_t chunkBytes(const VoxelChunk& chunk) const;
+
+	//How far above and below zero the ground and its overhangs can reach, which sets the layers of chunks that are built
+	float groundReach() const;
+	float overhangReach() const;
+
+	const float voxelSize = 100.0f / 128.0f;	//The same spacing as the default 128 vertex terrain
+	const float uvPerVoxel = 10.0f / 128.0f;	//And the same texture tiling
+
+	float viewDistance = 100.0f;
+	size_t memoryBudget = 64 * 1024 * 1024;
+	size_t memoryUsed = 0;
+	int chunksPerUpdate = 1;
+	int maxPendingChunks = 1;	//Enough to keep every worker busy without queuing chunks the camera may have left by the time they start
+
+	int octaves = 8;
+	float amplitude = 28.0f;
+	float frequency = 0.015f;
+	float gain = 0.5f;
+	float lacunarity = 1.1f;
+
+	static const int overhangOctaves = 3;
+	float overhangAmplitude = 12.0f;
+	float caveFrequency = 0.04f;
+	float tunnelWidth = 0.08f;
+
+	std::map<uint64_t, VoxelChunk*> chunks;	//Keyed by chunk position, see chunkKey
+	std::map<uint64_t, VoxelChunk*> pending;	//Queued, being built by a worker or waiting to be uploaded
+	std::vector<VoxelChunk*> visibleChunks;
+	uint64_t frame = 0;
+
+	uint64_t chunksBuilt = 0;
+	uint64_t emptyChunksBuilt = 0;
+	uint64_t chunksEvicted = 0;
+	uint64_t trianglesBuilt = 0;
+	double totalBuildTime = 0.0;
+
+	PerlinNoise noise;
+
+	//Finished chunks wait here until the render thread can create their buffers
+	std::mutex completedMutex;
+	std::condition_variable completedSignal;
+	std::vector<VoxelChunk*> completed;
+
+	ThreadPool builders;	//Declared last so it is destroyed first, while the tasks can still reach everything above
+};
\ No newline at end of file
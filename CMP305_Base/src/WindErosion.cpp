@@ -1,6 +1,10 @@
 #include "WindErosion.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "MathsUtils.h"
+#include "NoiseSimd.h"
 
 XMFLOAT2 operator +(const XMFLOAT2& lhs, const XMFLOAT2& rhs)
 {
@@ -162,6 +166,496 @@ void WindErosion::fly(float dt, float amplitude, float* heightMap, float* sedime
 	}
 }
 
+WindFlight WindErosion::launch(const WindParticle& particle) const
+{
+	WindFlight flight;
+	flight.particle = particle;
+	flight.windVelocity = windVelocity;
+	flight.height = height;
+	flight.sedimentRate = sedimentRate;
+
+	return flight;
+}
+
+bool WindErosion::flyWithin(float dt, float amplitude, float* heightMap, float* sedimentMap, WindFlight& flight, int resolution, XMINT2 regionMin, XMINT2 regionMax) const
+{
+	bool moved = false;
+
+	while (true)
+	{
+		//The step is worked out on a copy, so the flight is untouched if it turns out to leave the region
+		WindFlight next = flight;
+
+		int x = (int)next.particle.position.x;
+		int y = (int)next.particle.position.y;
+
+		moveFlight(dt, amplitude, heightMap, sedimentMap, next, resolution);
+
+		//Leaving the map ends the flight before the step touches anything, as in fly
+		if (next.particle.position.x < 0.0f || next.particle.position.y < 0.0f || next.particle.position.x >= (float)resolution || next.particle.position.y >= (float)resolution)
+		{
+			return false;
+		}
+
+		int nextX = (int)next.particle.position.x;
+		int nextY = (int)next.particle.position.y;
+
+		if (nextX < regionMin.x || nextY < regionMin.y || nextX >= regionMax.x || nextY >= regionMax.y)
+		{
+			return moved;
+		}
+
+		flight = next;
+		moved = true;
+
+		float speed = MathsUtils::magnitude3(flight.windVelocity.x, flight.windVelocity.y, flight.windVelocity.z);
+
+		erodeStep(dt, heightMap, sedimentMap, flight, speed, x, y, nextX, nextY, resolution);
+
+		//Strength of wind is too low to be noticeable, break and kill particle
+		if (speed < 0.01f)
+		{
+			return false;
+		}
+	}
+}
+
+//Lifts, pulls and moves a particle one step from the cell it is in, without touching the maps
+void WindErosion::moveFlight(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindFlight& flight, int resolution) const
+{
+	const float acceleration = 0.1f;
+
+	int index = ((int)flight.particle.position.y * resolution) + (int)flight.particle.position.x;
+	float ground = heightMap[index] + sedimentMap[index];
+
+	if (flight.height < ground)
+	{
+		//Particles underneath the heightmap are moved upwards
+		flight.height = ground;
+	}
+
+	else if (flight.height > ground)
+	{
+		//Applying gravity to flying particles
+		flight.windVelocity.y -= (dt * acceleration);
+	}
+
+	else
+	{
+		//Calculating the deflection normal with respect to a wind direction
+		XMFLOAT3 normal = deflectionNormalAt(flight.particle, resolution, heightMap, sedimentMap, amplitude);
+
+		if (weightedParticles)
+		{
+			XMFLOAT3 cross = MathsUtils::crossProduct(MathsUtils::crossProduct(flight.windVelocity, normal), normal);
+
+			MathsUtils::normalise3D(cross);
+
+			flight.windVelocity.x = dt * cross.x;
+			flight.windVelocity.y = dt * cross.y;
+			flight.windVelocity.z = dt * cross.z;
+		}
+	}
+
+	//Accelerate wind
+	flight.windVelocity.x += (acceleration * dt * (flight.particle.velocity.x - flight.windVelocity.x));
+	flight.windVelocity.y += (acceleration * dt * (flight.particle.velocity.y - flight.windVelocity.y));
+	flight.windVelocity.z += (acceleration * dt * (flight.particle.velocity.z - flight.windVelocity.z));
+
+	flight.particle.position.x += dt * flight.windVelocity.x;
+	flight.particle.position.y += dt * flight.windVelocity.z;
+
+	flight.height += (dt * flight.windVelocity.y);
+}
+
+//The erosion a particle causes stepping from cell (x, y) to (nextX, nextY), with speed the length of its wind after the step
+void WindErosion::erodeStep(float dt, float* heightMap, float* sedimentMap, WindFlight& flight, float speed, int x, int y, int nextX, int nextY, int resolution) const
+{
+	int index = (y * resolution) + x;
+	int nextIndex = (nextY * resolution) + nextX;
+
+	//Made contact with the surface of the terrain
+	if (flight.height <= heightMap[nextIndex] + sedimentMap[nextIndex])
+	{
+		//Calculate force based on strength of the wind and density of the terrain
+		float force = speed * (sedimentMap[nextIndex] + heightMap[nextIndex] - flight.height);
+
+		//Abrasion occurs - solid ground is eroded, more sediment is created at this position
+		if (sedimentMap[index] <= 0.0f)
+		{
+			sedimentMap[index] = 0.0f;
+			float increment = (dt * abrasion * force * flight.sedimentRate);
+			heightMap[index] -= increment;
+			sedimentMap[index] += increment;
+		}
+
+		else if (sedimentMap[index] > (dt * suspension * force))	//Collided with pile of sediment, particle picks more up and begins sliding
+		{
+			float increment = (dt * suspension * force);
+			sedimentMap[index] -= increment;
+			flight.sedimentRate += increment;
+			cascadeAt(dt, x, y, heightMap, sedimentMap, resolution);
+		}
+
+		else
+		{
+			sedimentMap[index] = 0.0f;
+		}
+	}
+
+	else
+	{	//Did not collide with terrain - particle is flying, begin cascading process
+		float increment = (dt * suspension * flight.sedimentRate);
+		flight.sedimentRate -= increment;
+		sedimentMap[index] += (0.5f * increment);
+		sedimentMap[nextIndex] += (0.5f * increment);
+		cascadeAt(dt, x, y, heightMap, sedimentMap, resolution);
+		cascadeAt(dt, nextX, nextY, heightMap, sedimentMap, resolution);
+	}
+}
+
+//What the vector half of a batch step decided for each lane
+static const int laneFlying = 0;
+static const int laneLost = 1;	//Left the map, so it dies without eroding
+static const int lanePaused = 2;	//Would have left the region, so it keeps its state from before the step
+
+void WindBatch::resize(int lanes)
+{
+	if ((int)positionX.size() >= lanes)
+	{
+		return;
+	}
+
+	for (std::vector<float>* field : { &positionX, &positionY, &velocityX, &velocityY, &velocityZ, &windX, &windY, &windZ, &height, &sedimentRate, &speed })
+	{
+		field->resize(lanes);
+	}
+
+	for (std::vector<int>* field : { &flight, &moved, &cellX, &cellY, &status })
+	{
+		field->resize(lanes);
+	}
+}
+
+void WindErosion::flyBatchWithin(float dt, float amplitude, float* heightMap, float* sedimentMap, WindFlight* flights, const int* particles, int count, int resolution,
+	XMINT2 regionMin, XMINT2 regionMax, WindBatch& batch, std::vector<int>& paused) const
+{
+	batch.resize(count);
+	batch.count = count;
+
+	for (int lane = 0; lane < count; lane++)
+	{
+		const WindFlight& flight = flights[particles[lane]];
+
+		batch.positionX[lane] = flight.particle.position.x;
+		batch.positionY[lane] = flight.particle.position.y;
+		batch.velocityX[lane] = flight.particle.velocity.x;
+		batch.velocityY[lane] = flight.particle.velocity.y;
+		batch.velocityZ[lane] = flight.particle.velocity.z;
+		batch.windX[lane] = flight.windVelocity.x;
+		batch.windY[lane] = flight.windVelocity.y;
+		batch.windZ[lane] = flight.windVelocity.z;
+		batch.height[lane] = flight.height;
+		batch.sedimentRate[lane] = flight.sedimentRate;
+		batch.flight[lane] = particles[lane];
+		batch.moved[lane] = 0;
+	}
+
+	while (batch.count > 0)
+	{
+		int done = 0;
+
+		if (simdLevel == SimdLevel::AVX2)
+		{
+			done = moveLanesAVX2(dt, amplitude, heightMap, sedimentMap, batch, done, resolution, regionMin, regionMax);
+		}
+
+		//Also takes AVX2's leftovers, as the lanes dying off leave batches of every size
+		if (simdLevel != SimdLevel::Scalar)
+		{
+			done = moveLanesSSE2(dt, amplitude, heightMap, sedimentMap, batch, done, resolution, regionMin, regionMax);
+		}
+
+		moveLanes(dt, amplitude, heightMap, sedimentMap, batch, done, batch.count, resolution, regionMin, regionMax);
+
+		//The writes can land on the same cells, so they are made one lane at a time, in order, with the surviving lanes packed down as they go
+		int kept = 0;
+
+		for (int lane = 0; lane < batch.count; lane++)
+		{
+			if (batch.status[lane] == lanePaused)
+			{
+				if (batch.moved[lane])
+				{
+					WindFlight& flight = flights[batch.flight[lane]];
+
+					flight.particle.position = XMFLOAT2(batch.positionX[lane], batch.positionY[lane]);
+					flight.windVelocity = XMFLOAT3(batch.windX[lane], batch.windY[lane], batch.windZ[lane]);
+					flight.height = batch.height[lane];
+					flight.sedimentRate = batch.sedimentRate[lane];
+
+					paused.push_back(batch.flight[lane]);
+				}
+
+				continue;
+			}
+
+			if (batch.status[lane] == laneLost)
+			{
+				continue;
+			}
+
+			WindFlight flight;
+			flight.height = batch.height[lane];
+			flight.sedimentRate = batch.sedimentRate[lane];
+
+			erodeStep(dt, heightMap, sedimentMap, flight, batch.speed[lane], batch.cellX[lane], batch.cellY[lane], (int)batch.positionX[lane], (int)batch.positionY[lane], resolution);
+
+			//Strength of wind is too low to be noticeable, kill particle
+			if (batch.speed[lane] < 0.01f)
+			{
+				continue;
+			}
+
+			batch.sedimentRate[lane] = flight.sedimentRate;
+			batch.moved[lane] = 1;
+
+			if (kept < lane)
+			{
+				batch.positionX[kept] = batch.positionX[lane];
+				batch.positionY[kept] = batch.positionY[lane];
+				batch.velocityX[kept] = batch.velocityX[lane];
+				batch.velocityY[kept] = batch.velocityY[lane];
+				batch.velocityZ[kept] = batch.velocityZ[lane];
+				batch.windX[kept] = batch.windX[lane];
+				batch.windY[kept] = batch.windY[lane];
+				batch.windZ[kept] = batch.windZ[lane];
+				batch.height[kept] = batch.height[lane];
+				batch.sedimentRate[kept] = batch.sedimentRate[lane];
+				batch.flight[kept] = batch.flight[lane];
+				batch.moved[kept] = 1;
+			}
+
+			kept++;
+		}
+
+		batch.count = kept;
+	}
+}
+
+//One lane at a time through the same moveFlight as flyWithin, which the vector kernels fall back to
+void WindErosion::moveLanes(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindBatch& batch, int first, int last, int resolution, XMINT2 regionMin, XMINT2 regionMax) const
+{
+	for (int lane = first; lane < last; lane++)
+	{
+		WindFlight flight;
+		flight.particle.position = XMFLOAT2(batch.positionX[lane], batch.positionY[lane]);
+		flight.particle.velocity = XMFLOAT3(batch.velocityX[lane], batch.velocityY[lane], batch.velocityZ[lane]);
+		flight.windVelocity = XMFLOAT3(batch.windX[lane], batch.windY[lane], batch.windZ[lane]);
+		flight.height = batch.height[lane];
+
+		batch.cellX[lane] = (int)flight.particle.position.x;
+		batch.cellY[lane] = (int)flight.particle.position.y;
+
+		moveFlight(dt, amplitude, heightMap, sedimentMap, flight, resolution);
+
+		if (flight.particle.position.x < 0.0f || flight.particle.position.y < 0.0f || flight.particle.position.x >= (float)resolution || flight.particle.position.y >= (float)resolution)
+		{
+			batch.status[lane] = laneLost;
+			continue;
+		}
+
+		int nextX = (int)flight.particle.position.x;
+		int nextY = (int)flight.particle.position.y;
+
+		if (nextX < regionMin.x || nextY < regionMin.y || nextX >= regionMax.x || nextY >= regionMax.y)
+		{
+			batch.status[lane] = lanePaused;
+			continue;
+		}
+
+		batch.status[lane] = laneFlying;
+		batch.positionX[lane] = flight.particle.position.x;
+		batch.positionY[lane] = flight.particle.position.y;
+		batch.windX[lane] = flight.windVelocity.x;
+		batch.windY[lane] = flight.windVelocity.y;
+		batch.windZ[lane] = flight.windVelocity.z;
+		batch.height[lane] = flight.height;
+		batch.speed[lane] = MathsUtils::magnitude3(flight.windVelocity.x, flight.windVelocity.y, flight.windVelocity.z);
+	}
+}
+
+//The vector kernels repeat moveFlight's arithmetic operation for operation, so they give the same results
+//A particle exactly on the ground is deflected by the normals around it, which is rare enough that its whole vector goes through moveLanes instead
+
+static inline __m128 selectSSE2(__m128 mask, __m128 whenSet, __m128 otherwise)
+{
+	return _mm_or_ps(_mm_and_ps(mask, whenSet), _mm_andnot_ps(mask, otherwise));
+}
+
+int WindErosion::moveLanesSSE2(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindBatch& batch, int first, int resolution, XMINT2 regionMin, XMINT2 regionMax) const
+{
+	const float acceleration = 0.1f;
+
+	const __m128 step = _mm_set1_ps(dt);
+	const __m128 gravity = _mm_set1_ps(dt * acceleration);
+	const __m128 pull = _mm_set1_ps(acceleration * dt);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 edge = _mm_set1_ps((float)resolution);
+	const __m128i width = _mm_set1_epi32(resolution);
+	const __m128i lowestX = _mm_set1_epi32(regionMin.x);
+	const __m128i lowestY = _mm_set1_epi32(regionMin.y);
+	const __m128i highestX = _mm_set1_epi32(regionMax.x - 1);
+	const __m128i highestY = _mm_set1_epi32(regionMax.y - 1);
+
+	int lane = first;
+
+	for (; lane + 4 <= batch.count; lane += 4)
+	{
+		__m128 positionX = _mm_loadu_ps(&batch.positionX[lane]);
+		__m128 positionY = _mm_loadu_ps(&batch.positionY[lane]);
+		__m128 height = _mm_loadu_ps(&batch.height[lane]);
+
+		__m128i cellX = _mm_cvttps_epi32(positionX);
+		__m128i cellY = _mm_cvttps_epi32(positionY);
+		__m128i index = _mm_add_epi32(multiplySSE2(cellY, width), cellX);
+		__m128 ground = _mm_add_ps(gatherSSE2(heightMap, index), gatherSSE2(sedimentMap, index));
+
+		__m128 below = _mm_cmplt_ps(height, ground);
+		__m128 above = _mm_cmpgt_ps(height, ground);
+
+		if (_mm_movemask_ps(_mm_or_ps(below, above)) != 0xF)
+		{
+			moveLanes(dt, amplitude, heightMap, sedimentMap, batch, lane, lane + 4, resolution, regionMin, regionMax);
+			continue;
+		}
+
+		__m128 windX = _mm_loadu_ps(&batch.windX[lane]);
+		__m128 windY = _mm_loadu_ps(&batch.windY[lane]);
+		__m128 windZ = _mm_loadu_ps(&batch.windZ[lane]);
+
+		__m128 nextHeight = selectSSE2(below, ground, height);
+		__m128 nextWindX = windX;
+		__m128 nextWindY = selectSSE2(above, _mm_sub_ps(windY, gravity), windY);
+		__m128 nextWindZ = windZ;
+
+		nextWindX = _mm_add_ps(nextWindX, _mm_mul_ps(pull, _mm_sub_ps(_mm_loadu_ps(&batch.velocityX[lane]), nextWindX)));
+		nextWindY = _mm_add_ps(nextWindY, _mm_mul_ps(pull, _mm_sub_ps(_mm_loadu_ps(&batch.velocityY[lane]), nextWindY)));
+		nextWindZ = _mm_add_ps(nextWindZ, _mm_mul_ps(pull, _mm_sub_ps(_mm_loadu_ps(&batch.velocityZ[lane]), nextWindZ)));
+
+		__m128 nextX = _mm_add_ps(positionX, _mm_mul_ps(step, nextWindX));
+		__m128 nextY = _mm_add_ps(positionY, _mm_mul_ps(step, nextWindZ));
+		nextHeight = _mm_add_ps(nextHeight, _mm_mul_ps(step, nextWindY));
+
+		__m128 lost = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(nextX, zero), _mm_cmplt_ps(nextY, zero)),
+			_mm_or_ps(_mm_cmpge_ps(nextX, edge), _mm_cmpge_ps(nextY, edge)));
+
+		__m128i nextCellX = _mm_cvttps_epi32(nextX);
+		__m128i nextCellY = _mm_cvttps_epi32(nextY);
+		__m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(lowestX, nextCellX), _mm_cmpgt_epi32(lowestY, nextCellY)),
+			_mm_or_si128(_mm_cmpgt_epi32(nextCellX, highestX), _mm_cmpgt_epi32(nextCellY, highestY)));
+		__m128 pausedLanes = _mm_andnot_ps(lost, _mm_castsi128_ps(outside));
+		__m128i status = _mm_or_si128(_mm_and_si128(_mm_castps_si128(lost), _mm_set1_epi32(laneLost)), _mm_and_si128(_mm_castps_si128(pausedLanes), _mm_set1_epi32(lanePaused)));
+
+		//A paused lane keeps the state it had before the step
+		_mm_storeu_ps(&batch.positionX[lane], selectSSE2(pausedLanes, positionX, nextX));
+		_mm_storeu_ps(&batch.positionY[lane], selectSSE2(pausedLanes, positionY, nextY));
+		_mm_storeu_ps(&batch.height[lane], selectSSE2(pausedLanes, height, nextHeight));
+		_mm_storeu_ps(&batch.windX[lane], selectSSE2(pausedLanes, windX, nextWindX));
+		_mm_storeu_ps(&batch.windY[lane], selectSSE2(pausedLanes, windY, nextWindY));
+		_mm_storeu_ps(&batch.windZ[lane], selectSSE2(pausedLanes, windZ, nextWindZ));
+		_mm_storeu_ps(&batch.speed[lane], _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nextWindX, nextWindX), _mm_mul_ps(nextWindY, nextWindY)), _mm_mul_ps(nextWindZ, nextWindZ))));
+
+		_mm_storeu_si128((__m128i*)&batch.cellX[lane], cellX);
+		_mm_storeu_si128((__m128i*)&batch.cellY[lane], cellY);
+		_mm_storeu_si128((__m128i*)&batch.status[lane], status);
+	}
+
+	return lane;
+}
+
+
+int WindErosion::moveLanesAVX2(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindBatch& batch, int first, int resolution, XMINT2 regionMin, XMINT2 regionMax) const
+{
+	const float acceleration = 0.1f;
+
+	const __m256 step = _mm256_set1_ps(dt);
+	const __m256 gravity = _mm256_set1_ps(dt * acceleration);
+	const __m256 pull = _mm256_set1_ps(acceleration * dt);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 edge = _mm256_set1_ps((float)resolution);
+	const __m256i width = _mm256_set1_epi32(resolution);
+	const __m256i lowestX = _mm256_set1_epi32(regionMin.x);
+	const __m256i lowestY = _mm256_set1_epi32(regionMin.y);
+	const __m256i highestX = _mm256_set1_epi32(regionMax.x - 1);
+	const __m256i highestY = _mm256_set1_epi32(regionMax.y - 1);
+
+	int lane = first;
+
+	for (; lane + 8 <= batch.count; lane += 8)
+	{
+		__m256 positionX = _mm256_loadu_ps(&batch.positionX[lane]);
+		__m256 positionY = _mm256_loadu_ps(&batch.positionY[lane]);
+		__m256 height = _mm256_loadu_ps(&batch.height[lane]);
+
+		__m256i cellX = _mm256_cvttps_epi32(positionX);
+		__m256i cellY = _mm256_cvttps_epi32(positionY);
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(cellY, width), cellX);
+		__m256 ground = _mm256_add_ps(_mm256_i32gather_ps(heightMap, index, 4), _mm256_i32gather_ps(sedimentMap, index, 4));
+
+		__m256 below = _mm256_cmp_ps(height, ground, _CMP_LT_OQ);
+		__m256 above = _mm256_cmp_ps(height, ground, _CMP_GT_OQ);
+
+		if (_mm256_movemask_ps(_mm256_or_ps(below, above)) != 0xFF)
+		{
+			moveLanes(dt, amplitude, heightMap, sedimentMap, batch, lane, lane + 8, resolution, regionMin, regionMax);
+			continue;
+		}
+
+		__m256 windX = _mm256_loadu_ps(&batch.windX[lane]);
+		__m256 windY = _mm256_loadu_ps(&batch.windY[lane]);
+		__m256 windZ = _mm256_loadu_ps(&batch.windZ[lane]);
+
+		__m256 nextHeight = _mm256_blendv_ps(height, ground, below);
+		__m256 nextWindX = windX;
+		__m256 nextWindY = _mm256_blendv_ps(windY, _mm256_sub_ps(windY, gravity), above);
+		__m256 nextWindZ = windZ;
+
+		nextWindX = _mm256_add_ps(nextWindX, _mm256_mul_ps(pull, _mm256_sub_ps(_mm256_loadu_ps(&batch.velocityX[lane]), nextWindX)));
+		nextWindY = _mm256_add_ps(nextWindY, _mm256_mul_ps(pull, _mm256_sub_ps(_mm256_loadu_ps(&batch.velocityY[lane]), nextWindY)));
+		nextWindZ = _mm256_add_ps(nextWindZ, _mm256_mul_ps(pull, _mm256_sub_ps(_mm256_loadu_ps(&batch.velocityZ[lane]), nextWindZ)));
+
+		__m256 nextX = _mm256_add_ps(positionX, _mm256_mul_ps(step, nextWindX));
+		__m256 nextY = _mm256_add_ps(positionY, _mm256_mul_ps(step, nextWindZ));
+		nextHeight = _mm256_add_ps(nextHeight, _mm256_mul_ps(step, nextWindY));
+
+		__m256 lost = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(nextX, zero, _CMP_LT_OQ), _mm256_cmp_ps(nextY, zero, _CMP_LT_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(nextX, edge, _CMP_GE_OQ), _mm256_cmp_ps(nextY, edge, _CMP_GE_OQ)));
+
+		__m256i nextCellX = _mm256_cvttps_epi32(nextX);
+		__m256i nextCellY = _mm256_cvttps_epi32(nextY);
+		__m256i outside = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(lowestX, nextCellX), _mm256_cmpgt_epi32(lowestY, nextCellY)),
+			_mm256_or_si256(_mm256_cmpgt_epi32(nextCellX, highestX), _mm256_cmpgt_epi32(nextCellY, highestY)));
+		__m256 pausedLanes = _mm256_andnot_ps(lost, _mm256_castsi256_ps(outside));
+		__m256i status = _mm256_or_si256(_mm256_and_si256(_mm256_castps_si256(lost), _mm256_set1_epi32(laneLost)), _mm256_and_si256(_mm256_castps_si256(pausedLanes), _mm256_set1_epi32(lanePaused)));
+
+		//A paused lane keeps the state it had before the step
+		_mm256_storeu_ps(&batch.positionX[lane], _mm256_blendv_ps(nextX, positionX, pausedLanes));
+		_mm256_storeu_ps(&batch.positionY[lane], _mm256_blendv_ps(nextY, positionY, pausedLanes));
+		_mm256_storeu_ps(&batch.height[lane], _mm256_blendv_ps(nextHeight, height, pausedLanes));
+		_mm256_storeu_ps(&batch.windX[lane], _mm256_blendv_ps(nextWindX, windX, pausedLanes));
+		_mm256_storeu_ps(&batch.windY[lane], _mm256_blendv_ps(nextWindY, windY, pausedLanes));
+		_mm256_storeu_ps(&batch.windZ[lane], _mm256_blendv_ps(nextWindZ, windZ, pausedLanes));
+		_mm256_storeu_ps(&batch.speed[lane], _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nextWindX, nextWindX), _mm256_mul_ps(nextWindY, nextWindY)), _mm256_mul_ps(nextWindZ, nextWindZ))));
+
+		_mm256_storeu_si256((__m256i*)&batch.cellX[lane], cellX);
+		_mm256_storeu_si256((__m256i*)&batch.cellY[lane], cellY);
+		_mm256_storeu_si256((__m256i*)&batch.status[lane], status);
+	}
+
+	return lane;
+}
+
 XMFLOAT3 WindErosion::calculateNormal(int index, int resolution, float* heightMap, float* sedimentMap, float amplitude)
 {
 	XMFLOAT3 normal = { 0.0f, 0.0f, 0.0f };
@@ -295,4 +789,109 @@ void WindErosion::cascade(float dt, int index, float* heightMap, float* sediment
 		sedimentMap[index] -= dt * settling * transfer;
 		sedimentMap[neighbours[m]] += dt * settling * transfer;
 	}
+}
+
+void WindErosion::cascadeAt(float dt, int x, int y, float* heightMap, float* sedimentMap, int resolution) const
+{
+	const int index = (y * resolution) + x;
+	const float rate = dt * settling;
+
+	//Cascading never changes the heights and a neighbour is never the cell itself, so the cell's own values stay in registers
+	//rather than being read back from the maps after every neighbour's transfer
+	const float heightHere = heightMap[index];
+	float sedimentHere = sedimentMap[index];
+
+	//Every neighbour in the same order as cascade, bottom left to top right
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			int neighbourX = x + dx;
+			int neighbourY = y + dy;
+
+			if ((dx == 0 && dy == 0) || neighbourX < 0 || neighbourY < 0 || neighbourX >= resolution || neighbourY >= resolution)
+			{
+				continue;
+			}
+
+			int neighbour = (neighbourY * resolution) + neighbourX;
+
+			//How even or uneven each sediment pile should be
+			float difference = heightHere - heightMap[neighbour];
+			float excess = fabsf(difference) - roughness;
+
+			if (excess <= 0)
+			{
+				continue;
+			}
+
+			//Transfer sediment mass from the larger pile
+			float transfer = difference > 0 ? (std::min)(sedimentHere, excess / 2.0f) : -(std::min)(sedimentMap[neighbour], excess / 2.0f);
+
+			sedimentHere -= rate * transfer;
+			sedimentMap[neighbour] += rate * transfer;
+		}
+	}
+
+	sedimentMap[index] = sedimentHere;
+}
+
+//calculateNormal's gradients, with each neighbour clamped to the map along its own axis
+XMFLOAT3 WindErosion::surfaceNormalAt(int x, int y, int resolution, const float* heightMap, const float* sedimentMap, float amplitude) const
+{
+	const int index = (y * resolution) + x;
+
+	int nI[4] =
+	{
+		(y * resolution) + (std::min)(x + 1, resolution - 1),	//Right along x-axis
+		(y * resolution) + (std::max)(x - 1, 0),	//Left along x-axis
+		((std::min)(y + 1, resolution - 1) * resolution) + x,	//Forward along z-axis
+		((std::max)(y - 1, 0) * resolution) + x	//Back along z-axis
+	};
+
+	XMFLOAT3 n0 = { 0.0f, amplitude * (heightMap[nI[0]] - heightMap[index] + sedimentMap[nI[0]] - sedimentMap[index]), 1.0f };
+	XMFLOAT3 n1 = { 0.0f, amplitude * (heightMap[nI[1]] - heightMap[index] + sedimentMap[nI[1]] - sedimentMap[index]), -1.0f };
+	XMFLOAT3 n2 = { 1.0f, amplitude * (heightMap[nI[2]] - heightMap[index] + sedimentMap[nI[2]] - sedimentMap[index]), 0.0f };
+	XMFLOAT3 n3 = { -1.0f, amplitude * (heightMap[nI[3]] - heightMap[index] + sedimentMap[nI[3]] - sedimentMap[index]), 0.0f };
+
+	XMFLOAT3 normal = { 0.0f, 0.0f, 0.0f };
+	normal = normal + MathsUtils::crossProduct(n0, n2);
+	normal = normal + MathsUtils::crossProduct(n1, n3);
+	normal = normal + MathsUtils::crossProduct(n2, n1);
+	normal = normal + MathsUtils::crossProduct(n3, n0);
+
+	MathsUtils::normalise3D(normal);
+
+	return normal;
+}
+
+//The normals at the four cells around the particle, blended by how far it is across its cell
+XMFLOAT3 WindErosion::deflectionNormalAt(const WindParticle& particle, int resolution, const float* heightMap, const float* sedimentMap, float amplitude) const
+{
+	const int x0 = (int)particle.position.x;
+	const int y0 = (int)particle.position.y;
+	const int x1 = (std::min)(x0 + 1, resolution - 1);
+	const int y1 = (std::min)(y0 + 1, resolution - 1);
+
+	const float weightX = particle.position.x - (float)x0;
+	const float weightY = particle.position.y - (float)y0;
+
+	const XMFLOAT3 corners[4] =
+	{
+		surfaceNormalAt(x0, y0, resolution, heightMap, sedimentMap, amplitude),
+		surfaceNormalAt(x1, y0, resolution, heightMap, sedimentMap, amplitude),
+		surfaceNormalAt(x0, y1, resolution, heightMap, sedimentMap, amplitude),
+		surfaceNormalAt(x1, y1, resolution, heightMap, sedimentMap, amplitude)
+	};
+
+	const float weights[4] = { (1.0f - weightX) * (1.0f - weightY), weightX * (1.0f - weightY), (1.0f - weightX) * weightY, weightX * weightY };
+
+	XMFLOAT3 result = { 0.0f, 0.0f, 0.0f };
+
+	for (int c = 0; c < 4; c++)
+	{
+		result = result + XMFLOAT3(corners[c].x * weights[c], corners[c].y * weights[c], corners[c].z * weights[c]);
+	}
+
+	return result;
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "DXF.h"
+#include <vector>
+
+#include "CpuFeatures.h"
 
 struct WindParticle
 {
@@ -8,6 +11,37 @@ struct WindParticle
 	XMFLOAT3 velocity = { 3.0f, 0.0f, 3.0f };
 };
 
+//A particle part way through its flight, holding the wind and sediment fly keeps inside the WindErosion object
+//With those kept here one WindErosion can fly any number of particles, and a flight can be paused and carried on later
+struct WindFlight
+{
+	WindParticle particle;
+	XMFLOAT3 windVelocity = { 3.0f, -1.0f, 3.0f };
+	float height = 0.0f;
+	float sedimentRate = 0.01f;
+};
+
+//Flights laid out one array per field, so flyBatchWithin can move a whole vector of particles with each instruction
+//The arrays only ever grow, so one batch kept per thread stops them being allocated for every call
+struct WindBatch
+{
+	std::vector<float> positionX, positionY;
+	std::vector<float> velocityX, velocityY, velocityZ;	//The particles' own velocities, which their wind is pulled towards
+	std::vector<float> windX, windY, windZ;
+	std::vector<float> height, sedimentRate;
+	std::vector<int> flight;	//The flight each lane was loaded from, and is written back to if it pauses
+	std::vector<int> moved;	//Whether the lane has taken a step since it was loaded
+
+	//Left by the vector half of each step for the scalar half
+	std::vector<int> cellX, cellY;	//The cell the particle started the step in
+	std::vector<int> status;
+	std::vector<float> speed;	//Length of the wind after the step
+
+	int count = 0;
+
+	void resize(int lanes);
+};
+
 class WindErosion
 {
 public:
@@ -18,9 +52,46 @@ public:
 	void setWindAttributes(float sed, float sus, float abr, float rgh, float set, bool weigh);
 	void fly(float dt, float amplitude, float* heightMap, float* sedimentMap, WindParticle& particle, int resolution);
 
+	//Starts a particle off with this object's wind and sediment, as fly would
+	WindFlight launch(const WindParticle& particle) const;
+
+	//Flies a particle the way fly does until it dies, returning false, or until its next step would end outside the cells from regionMin up to
+	//but not including regionMax, returning true with the flight left as it was before that step
+	//Every cell a step reads or writes is within two of the region, so particles in regions further apart than that can fly at the same time
+	//Unlike fly it looks cells up by row and column, so it stops at every edge of the map instead of wrapping onto the next row,
+	//and blends the normals around the particle's own cell by where it is inside it
+	//A particle that cannot take a single step without leaving the region is moving too fast for it and is dropped
+	bool flyWithin(float dt, float amplitude, float* heightMap, float* sedimentMap, WindFlight& flight, int resolution, XMINT2 regionMin, XMINT2 regionMax) const;
+
+	//flyWithin for count flights at once, taking their steps in lock-step
+	//Each step first moves every particle, reading the maps with vector gathers, then erodes under them one at a time in the order they were given,
+	//so a particle sees the erosion of those flying with it a step later than if they had flown one after another; a batch of one is exactly flyWithin
+	//Flights that would leave the region after moving are written back and added to paused, the others are compacted out of the batch as they die
+	void flyBatchWithin(float dt, float amplitude, float* heightMap, float* sedimentMap, WindFlight* flights, const int* particles, int count, int resolution,
+		XMINT2 regionMin, XMINT2 regionMax, WindBatch& batch, std::vector<int>& paused) const;
+
+	//Only changes how fast flyBatchWithin runs, every level gives the same results
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+
 private:
 	void cascade(float dt, int i, float* heightMap, float* sedimentMap, WindParticle& particle, int resolution);
 
+	//flyWithin's versions, working on a cell's row and column and clamping to the map along each axis
+	void cascadeAt(float dt, int x, int y, float* heightMap, float* sedimentMap, int resolution) const;
+	XMFLOAT3 surfaceNormalAt(int x, int y, int resolution, const float* heightMap, const float* sedimentMap, float amplitude) const;
+	XMFLOAT3 deflectionNormalAt(const WindParticle& particle, int resolution, const float* heightMap, const float* sedimentMap, float amplitude) const;
+
+	//The two halves of a flyWithin step, shared with flyBatchWithin so both fly particles the same way
+	void moveFlight(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindFlight& flight, int resolution) const;
+	void erodeStep(float dt, float* heightMap, float* sedimentMap, WindFlight& flight, float speed, int x, int y, int nextX, int nextY, int resolution) const;
+
+	//The first half of a batch step, for the lanes from first up to last
+	//The kernels start from first and return where they stopped, short of a whole vector from the end, and the rest go one lane at a time
+	void moveLanes(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindBatch& batch, int first, int last, int resolution, XMINT2 regionMin, XMINT2 regionMax) const;
+	int moveLanesSSE2(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindBatch& batch, int first, int resolution, XMINT2 regionMin, XMINT2 regionMax) const;
+	int moveLanesAVX2(float dt, float amplitude, const float* heightMap, const float* sedimentMap, WindBatch& batch, int first, int resolution, XMINT2 regionMin, XMINT2 regionMax) const;
+
 	XMFLOAT3 calculateNormal(int index, int resolution, float* heightMap, float* sedimentMap, float amplitude);
 	XMFLOAT3 calculateDeflectionNormal(WindParticle& particle, int index, int resolution, float* heightMap, float* sedimentMap, float amplitude);
 
@@ -33,4 +104,6 @@ private:
 	float abrasion = 0.01f;
 	float roughness = 0.005f;
 	float settling = 0.05f;
+
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
 };
\ No newline at end of file
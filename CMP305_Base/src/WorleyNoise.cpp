@@ -0,0 +1,349 @@
+#include "WorleyNoise.h"
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+#include "NoiseSimd.h"
+
+WorleyNoise::WorleyNoise(uint64_t seed)
+{
+	reseed(seed);
+}
+
+WorleyNoise::~WorleyNoise()
+{
+
+}
+
+void WorleyNoise::reseed(uint64_t seed)
+{
+	Random random(Random::deriveKey(seed, RandomStream::Worley));
+
+	permutationTable.clear();
+
+	for (int i = 0; i < 512; i++)
+	{
+		permutationTable.push_back(i);
+	}
+
+	//Fisher-Yates shuffle
+	for (int i = 511; i > 0; i--)
+	{
+		std::swap(permutationTable[i], permutationTable[random.nextInt(i + 1)]);
+	}
+
+	offsetX.resize(512);
+	offsetY.resize(512);
+
+	for (int i = 0; i < 512; i++)
+	{
+		offsetX[i] = random.nextFloat() - 0.5f;
+		offsetY[i] = random.nextFloat() - 0.5f;
+	}
+
+	placeFeatures();
+}
+
+void WorleyNoise::setJitter(float amount)
+{
+	jitter = amount < 0.0f ? 0.0f : amount > 1.0f ? 1.0f : amount;
+
+	placeFeatures();
+}
+
+void WorleyNoise::placeFeatures()
+{
+	featureX.resize(512);
+	featureY.resize(512);
+
+	for (int i = 0; i < 512; i++)
+	{
+		featureX[i] = 0.5f + offsetX[i] * jitter;
+		featureY[i] = 0.5f + offsetY[i] * jitter;
+	}
+}
+
+//The metrics and the running two smallest distances, written so the vector kernels can repeat them exactly
+static inline float minimum(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static inline float maximum(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+static inline float measure(WorleyDistance distance, float x, float y)
+{
+	if (distance == WorleyDistance::Manhattan)
+	{
+		return fabsf(x) + fabsf(y);
+	}
+
+	else if (distance == WorleyDistance::Chebyshev)
+	{
+		return maximum(fabsf(x), fabsf(y));
+	}
+
+	//Squared, the root is only taken of the two that are kept
+	return x * x + y * y;
+}
+
+static inline float combine(WorleyDistance distance, WorleyFeature feature, float nearest, float second)
+{
+	if (distance == WorleyDistance::Euclidean)
+	{
+		nearest = sqrtf(nearest);
+		second = sqrtf(second);
+	}
+
+	if (feature == WorleyFeature::F2)
+	{
+		return second;
+	}
+
+	else if (feature == WorleyFeature::F2MinusF1)
+	{
+		return second - nearest;
+	}
+
+	return nearest;
+}
+
+float WorleyNoise::generateWorley(float x, float y) const
+{
+	const int* permutation = permutationTable.data();
+
+	int xMin = (int)floorf(x);
+	int yMin = (int)floorf(y);
+	float fracX = x - (float)xMin;
+	float fracY = y - (float)yMin;
+
+	float nearest = FLT_MAX;
+	float second = FLT_MAX;
+
+	for (int cy = -1; cy <= 1; cy++)
+	{
+		//Rows are hashed first, so a span only has to look up its three rows once
+		int row = permutation[(yMin + cy) & latticeMask];
+
+		for (int cx = -1; cx <= 1; cx++)
+		{
+			int hash = permutation[(row + xMin + cx) & latticeMask];
+
+			float offsetToX = ((float)cx + featureX[hash]) - fracX;
+			float offsetToY = ((float)cy + featureY[hash]) - fracY;
+			float d = measure(distance, offsetToX, offsetToY);
+
+			second = minimum(second, maximum(nearest, d));
+			nearest = minimum(nearest, d);
+		}
+	}
+
+	return combine(distance, feature, nearest, second);
+}
+
+void WorleyNoise::generateWorleySpan(float x0, float dx, float y, int count, float* output, int first) const
+{
+	int done = 0;
+
+	if (simdLevel == SimdLevel::AVX2)
+	{
+		done = worleySpanAVX2(x0, dx, y, first, count, output);
+	}
+
+	else if (simdLevel == SimdLevel::SSE2)
+	{
+		done = worleySpanSSE2(x0, dx, y, first, count, output);
+	}
+
+	for (int n = done; n < count; n++)
+	{
+		output[n] = generateWorley(x0 + (float)(first + n) * dx, y);
+	}
+}
+
+//The vector kernels repeat the scalar search step for step, so they give the same results
+
+static inline __m128 measureSSE2(WorleyDistance distance, __m128 x, __m128 y)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	if (distance == WorleyDistance::Manhattan)
+	{
+		return _mm_add_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y));
+	}
+
+	else if (distance == WorleyDistance::Chebyshev)
+	{
+		return _mm_max_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y));
+	}
+
+	return _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+}
+
+int WorleyNoise::worleySpanSSE2(float x0, float dx, float y, int first, int count, float* output) const
+{
+	const int* permutation = permutationTable.data();
+
+	//Every sample in the row shares y, so its three rows of cells are hashed once
+	const int yMin = (int)floorf(y);
+	const float yFrac = y - (float)yMin;
+	__m128i rows[3];
+
+	for (int cy = -1; cy <= 1; cy++)
+	{
+		rows[cy + 1] = _mm_set1_epi32(permutation[(yMin + cy) & latticeMask]);
+	}
+
+	const __m128 fracY = _mm_set1_ps(yFrac);
+	const __m128 step = _mm_set1_ps(dx);
+	const __m128 start = _mm_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 index = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + n), _mm_set_epi32(3, 2, 1, 0)));
+		__m128 x = _mm_add_ps(start, _mm_mul_ps(index, step));
+
+		__m128i xMin = floorSSE2(x);
+		__m128 fracX = _mm_sub_ps(x, _mm_cvtepi32_ps(xMin));
+
+		__m128 nearest = _mm_set1_ps(FLT_MAX);
+		__m128 second = _mm_set1_ps(FLT_MAX);
+
+		for (int cy = 0; cy < 3; cy++)
+		{
+			__m128 cellY = _mm_set1_ps((float)(cy - 1));
+
+			for (int cx = -1; cx <= 1; cx++)
+			{
+				__m128i hash = gatherSSE2(permutation, wrapLatticeSSE2(_mm_add_epi32(_mm_add_epi32(rows[cy], xMin), _mm_set1_epi32(cx))));
+
+				__m128 offsetToX = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)cx), gatherSSE2(featureX.data(), hash)), fracX);
+				__m128 offsetToY = _mm_sub_ps(_mm_add_ps(cellY, gatherSSE2(featureY.data(), hash)), fracY);
+				__m128 d = measureSSE2(distance, offsetToX, offsetToY);
+
+				second = _mm_min_ps(second, _mm_max_ps(nearest, d));
+				nearest = _mm_min_ps(nearest, d);
+			}
+		}
+
+		if (distance == WorleyDistance::Euclidean)
+		{
+			nearest = _mm_sqrt_ps(nearest);
+			second = _mm_sqrt_ps(second);
+		}
+
+		__m128 result = nearest;
+
+		if (feature == WorleyFeature::F2)
+		{
+			result = second;
+		}
+
+		else if (feature == WorleyFeature::F2MinusF1)
+		{
+			result = _mm_sub_ps(second, nearest);
+		}
+
+		_mm_storeu_ps(&output[n], result);
+	}
+
+	return n;
+}
+
+static inline __m256 measureAVX2(WorleyDistance distance, __m256 x, __m256 y)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+
+	if (distance == WorleyDistance::Manhattan)
+	{
+		return _mm256_add_ps(_mm256_andnot_ps(sign, x), _mm256_andnot_ps(sign, y));
+	}
+
+	else if (distance == WorleyDistance::Chebyshev)
+	{
+		return _mm256_max_ps(_mm256_andnot_ps(sign, x), _mm256_andnot_ps(sign, y));
+	}
+
+	return _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+}
+
+int WorleyNoise::worleySpanAVX2(float x0, float dx, float y, int first, int count, float* output) const
+{
+	const int* permutation = permutationTable.data();
+
+	const int yMin = (int)floorf(y);
+	const float yFrac = y - (float)yMin;
+	__m256i rows[3];
+
+	for (int cy = -1; cy <= 1; cy++)
+	{
+		rows[cy + 1] = _mm256_set1_epi32(permutation[(yMin + cy) & latticeMask]);
+	}
+
+	const __m256 fracY = _mm256_set1_ps(yFrac);
+	const __m256 step = _mm256_set1_ps(dx);
+	const __m256 start = _mm256_set1_ps(x0);
+
+	int n = 0;
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 index = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(first + n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+		__m256 x = _mm256_add_ps(start, _mm256_mul_ps(index, step));
+
+		__m256 xFloor = _mm256_floor_ps(x);
+		__m256i xMin = _mm256_cvttps_epi32(xFloor);
+		__m256 fracX = _mm256_sub_ps(x, xFloor);
+
+		__m256 nearest = _mm256_set1_ps(FLT_MAX);
+		__m256 second = _mm256_set1_ps(FLT_MAX);
+
+		for (int cy = 0; cy < 3; cy++)
+		{
+			__m256 cellY = _mm256_set1_ps((float)(cy - 1));
+
+			for (int cx = -1; cx <= 1; cx++)
+			{
+				__m256i hash = _mm256_i32gather_epi32(permutation, wrapLatticeAVX2(_mm256_add_epi32(_mm256_add_epi32(rows[cy], xMin), _mm256_set1_epi32(cx))), 4);
+
+				__m256 offsetToX = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps((float)cx), _mm256_i32gather_ps(featureX.data(), hash, 4)), fracX);
+				__m256 offsetToY = _mm256_sub_ps(_mm256_add_ps(cellY, _mm256_i32gather_ps(featureY.data(), hash, 4)), fracY);
+				__m256 d = measureAVX2(distance, offsetToX, offsetToY);
+
+				second = _mm256_min_ps(second, _mm256_max_ps(nearest, d));
+				nearest = _mm256_min_ps(nearest, d);
+			}
+		}
+
+		if (distance == WorleyDistance::Euclidean)
+		{
+			nearest = _mm256_sqrt_ps(nearest);
+			second = _mm256_sqrt_ps(second);
+		}
+
+		__m256 result = nearest;
+
+		if (feature == WorleyFeature::F2)
+		{
+			result = second;
+		}
+
+		else if (feature == WorleyFeature::F2MinusF1)
+		{
+			result = _mm256_sub_ps(second, nearest);
+		}
+
+		_mm256_storeu_ps(&output[n], result);
+	}
+
+	//Avoids the penalty for switching back to the non-VEX encoded SSE code that follows
+	_mm256_zeroupper();
+
+	return n;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "DXF.h"
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "Random.h"
+
+//How the distance from a sample to a feature point is measured
+enum class WorleyDistance
+{
+	Euclidean,	//Round cells
+	Manhattan,	//Diamond cells
+	Chebyshev	//Square cells
+};
+
+//Which of the distances to the nearest feature points is returned
+enum class WorleyFeature
+{
+	F1,	//The nearest, bowls around every point
+	F2,	//The second nearest
+	F2MinusF1	//Zero along the borders between cells, for cracks and ridges
+};
+
+//Cellular noise, one feature point scattered inside every lattice cell and each sample measuring how far it is from the nearest of them
+//A point never leaves its own cell, so a sample only searches the 3x3 cells around it
+//That is exact for F1 with a jitter of up to 0.5, beyond it a nearer point two cells away can in rare cases be missed, the usual price of a fixed search
+//Distances are in lattice cells, so F1 stays roughly within 0 to 1
+class WorleyNoise
+{
+public:
+	WorleyNoise(uint64_t seed = 0);
+	~WorleyNoise();
+
+	//Rebuilds the permutation table and the feature points, the same seed always gives the same noise
+	void reseed(uint64_t seed);
+
+	float generateWorley(float x, float y) const;
+
+	//Fill output with count samples along a row, the n-th one taken at (x0 + (first + n) * dx, y), like PerlinNoise's spans
+	void generateWorleySpan(float x0, float dx, float y, int count, float* output, int first = 0) const;
+
+	void setDistance(WorleyDistance metric) { distance = metric; }
+	WorleyDistance getDistance() const { return distance; }
+	void setFeature(WorleyFeature returned) { feature = returned; }
+	WorleyFeature getFeature() const { return feature; }
+
+	//How far a feature point may stray from the middle of its cell, 0 gives a regular grid and 1 lets it reach the cell's edges
+	void setJitter(float amount);
+	float getJitter() const { return jitter; }
+
+	void setSimdLevel(SimdLevel level) { simdLevel = CpuFeatures::clampSimdLevel(level); }
+	SimdLevel getSimdLevel() const { return simdLevel; }
+
+private:
+	static const int latticeMask = 511;
+
+	std::vector<int> permutationTable;
+
+	//Where each hash puts its cell's feature point, as an offset from the middle of the cell before the jitter scales it
+	std::vector<float> offsetX;
+	std::vector<float> offsetY;
+
+	//The same with the jitter applied, measured from the cell's lower corner, so the search only has to look them up
+	std::vector<float> featureX;
+	std::vector<float> featureY;
+
+	WorleyDistance distance = WorleyDistance::Euclidean;
+	WorleyFeature feature = WorleyFeature::F1;
+	float jitter = 1.0f;
+
+	SimdLevel simdLevel = CpuFeatures::bestSimdLevel();
+
+	void placeFeatures();
+
+	int worleySpanSSE2(float x0, float dx, float y, int first, int count, float* output) const;
+	int worleySpanAVX2(float x0, float dx, float y, int first, int count, float* output) const;
+};
\ No newline at end of file